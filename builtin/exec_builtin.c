@@ -61,23 +61,39 @@
 int exec_builtin(FAR const char *appname, FAR char * const *argv,
                  FAR const char *redirfile, int oflags)
 {
-  FAR const struct builtin_s *builtin;
-  posix_spawnattr_t attr;
-  posix_spawn_file_actions_t file_actions;
-  struct sched_param param;
-  pid_t pid;
   int index;
-  int ret;
 
   /* Verify that an application with this name exists */
 
   index = builtin_isavail(appname);
   if (index < 0)
     {
-      ret = ENOENT;
-      goto errout_with_errno;
+      errno = ENOENT;
+      return ERROR;
     }
 
+  return exec_builtin_index(index, argv, redirfile, oflags);
+}
+
+/****************************************************************************
+ * Name: exec_builtin_index
+ *
+ * Description:
+ *   Like exec_builtin(), for a caller that already knows the index of the
+ *   application, e.g. from its own name lookup.
+ *
+ ****************************************************************************/
+
+int exec_builtin_index(int index, FAR char * const *argv,
+                       FAR const char *redirfile, int oflags)
+{
+  FAR const struct builtin_s *builtin;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_t file_actions;
+  struct sched_param param;
+  pid_t pid;
+  int ret;
+
   /* Get information about the builtin */
 
   builtin = builtin_for_index(index);
@@ -258,11 +258,58 @@ static void foc_float_nxscope(FAR struct foc_nxscope_s *nxs,
   ptr = (FAR float *)&motor->vdq_comp;
   nxscope_put_vfloat(&nxs->nxs, i++, ptr, 2);
 #endif
+#if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & FOC_NXSCOPE_PERF)
+  foc_nxscope_perf(nxs, i++, &motor->handler.perf);
+#endif
 
   nxscope_unlock(&nxs->nxs);
 }
 #endif
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+/****************************************************************************
+ * Name: foc_perf_reset
+ ****************************************************************************/
+
+static void foc_perf_reset(FAR struct foc_motor_f32_s *motor)
+{
+  DEBUGASSERT(motor);
+
+  foc_perf_init(&motor->handler.perf);
+#ifdef CONFIG_EXAMPLES_FOC_HAVE_OPENLOOP
+  foc_perf_init(&motor->openloop.perf);
+#endif
+#ifdef CONFIG_EXAMPLES_FOC_HAVE_HALL
+  foc_perf_init(&motor->hall.perf);
+#endif
+#ifdef CONFIG_EXAMPLES_FOC_HAVE_QENCO
+  foc_perf_init(&motor->qenco.perf);
+#endif
+}
+
+/****************************************************************************
+ * Name: foc_perf_summary
+ ****************************************************************************/
+
+static void foc_perf_summary(FAR struct foc_motor_f32_s *motor)
+{
+  DEBUGASSERT(motor);
+
+  PRINTF("f32 inst %d execution time:\n", motor->envp->inst);
+
+  foc_perf_print(&motor->handler.perf, "handler");
+#ifdef CONFIG_EXAMPLES_FOC_HAVE_OPENLOOP
+  foc_perf_print(&motor->openloop.perf, "openloop");
+#endif
+#ifdef CONFIG_EXAMPLES_FOC_HAVE_HALL
+  foc_perf_print(&motor->hall.perf, "hall");
+#endif
+#ifdef CONFIG_EXAMPLES_FOC_HAVE_QENCO
+  foc_perf_print(&motor->qenco.perf, "qenco");
+#endif
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -356,6 +403,12 @@ int foc_float_thr(FAR struct foc_ctrl_env_s *envp)
               goto errout;
             }
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+          /* Do not count the idle time in the handler periods */
+
+          foc_perf_reset(&motor);
+#endif
+
           motor.startstop = false;
         }
 
@@ -474,6 +527,12 @@ int foc_float_thr(FAR struct foc_ctrl_env_s *envp)
 
 errout:
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  /* Print execution time summary */
+
+  foc_perf_summary(&motor);
+#endif
+
   /* Deinit motor controller */
 
   ret = foc_motor_deinit(&motor);
@@ -42,6 +42,12 @@
 #  error CONFIG_LOGGING_NXSCOPE_DISABLE_PUTLOCK must be set to proper operation.
 #endif
 
+#if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & FOC_NXSCOPE_PERF)
+#  ifndef CONFIG_INDUSTRY_FOC_PERF
+#    error CONFIG_INDUSTRY_FOC_PERF must be set for FOC_NXSCOPE_PERF
+#  endif
+#endif
+
 #ifdef CONFIG_LOGGING_NXSCOPE_INTF_SERIAL
 #  ifndef CONFIG_SERIAL_TERMIOS
 #    error CONFIG_SERIAL_TERMIOS must be set to proper operation.
@@ -142,9 +148,9 @@ int foc_nxscope_init(FAR struct foc_nxscope_s *nxs)
 
   /* Get channels per instance */
 
-  for (j = 0; j < CONFIG_MOTOR_FOC_INST; j += 1)
+  for (j = 0; j < 32; j += 1)
     {
-      if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & (1 << j))
+      if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & (1ul << j))
         {
           nxs->ch_per_inst += 1;
         }
@@ -236,6 +242,12 @@ int foc_nxscope_init(FAR struct foc_nxscope_s *nxs)
 #if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & FOC_NXSCOPE_VDQCOMP)
       nxscope_chan_init(&nxs->nxs, i++, "vdqcomp", u.u8, 2, 0);
 #endif
+#if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & FOC_NXSCOPE_PERF)
+      /* Execution time, max execution time, period and jitter in ns */
+
+      u.s.dtype = NXSCOPE_TYPE_UINT32;
+      nxscope_chan_init(&nxs->nxs, i++, "perf", u.u8, 4, 0);
+#endif
 
       if (i > CONFIG_EXAMPLES_FOC_NXSCOPE_CHANNELS)
         {
@@ -311,3 +323,26 @@ void foc_nxscope_work(FAR struct foc_nxscope_s *nxs)
       PRINTF("ERROR: nxscope_recv failed %d\n", ret);
     }
 }
+
+#if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & FOC_NXSCOPE_PERF)
+/****************************************************************************
+ * Name: foc_nxscope_perf
+ ****************************************************************************/
+
+void foc_nxscope_perf(FAR struct foc_nxscope_s *nxs, int ch,
+                      FAR struct foc_perf_s *perf)
+{
+  uint32_t val[4];
+
+  DEBUGASSERT(nxs);
+  DEBUGASSERT(perf);
+
+  val[0] = foc_perf_ns(perf, perf->exec);
+  val[1] = foc_perf_ns(perf, perf->exec_max);
+  val[2] = foc_perf_ns(perf, perf->period);
+  val[3] = (perf->count > 1) ?
+    foc_perf_ns(perf, perf->period_max - perf->period_min) : 0;
+
+  nxscope_put_vuint32(&nxs->nxs, ch, val, 4);
+}
+#endif
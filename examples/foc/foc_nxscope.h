@@ -29,6 +29,10 @@
 
 #include "logging/nxscope/nxscope.h"
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+#  include "industry/foc/foc_perf.h"
+#endif
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
@@ -51,6 +55,7 @@
 #define FOC_NXSCOPE_SPPOS      (1 << 13)  /* Position setpoint */
 #define FOC_NXSCOPE_DQREF      (1 << 14)  /* DQ reference */
 #define FOC_NXSCOPE_VDQCOMP    (1 << 15)  /* VDQ compensation */
+#define FOC_NXSCOPE_PERF       (1 << 16)  /* FOC handler execution time */
                                           /* Max 32-bit */
 
 /****************************************************************************
@@ -89,4 +94,13 @@ void foc_nxscope_deinit(FAR struct foc_nxscope_s *nxs);
 
 void foc_nxscope_work(FAR struct foc_nxscope_s *nxs);
 
+#if (CONFIG_EXAMPLES_FOC_NXSCOPE_CFG & FOC_NXSCOPE_PERF)
+/****************************************************************************
+ * Name: foc_nxscope_perf
+ ****************************************************************************/
+
+void foc_nxscope_perf(FAR struct foc_nxscope_s *nxs, int ch,
+                      FAR struct foc_perf_s *perf);
+#endif
+
 #endif /* __APPS_EXAMPLES_FOC_FOC_NXSCOPE_H */
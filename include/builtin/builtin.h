@@ -82,6 +82,25 @@ extern "C"
 int exec_builtin(FAR const char *appname, FAR char * const *argv,
                  FAR const char *redirfile, int oflags);
 
+/****************************************************************************
+ * Name: exec_builtin_index
+ *
+ * Description:
+ *   Executes the builtin application with the given index, as returned
+ *   by builtin_isavail().  This saves the name lookup of exec_builtin().
+ *
+ * Input Parameter:
+ *   index     - Index of the application in the builtin list.
+ *   argv, redirfile, oflags - As for exec_builtin().
+ *
+ * Returned Value:
+ *   As for exec_builtin().
+ *
+ ****************************************************************************/
+
+int exec_builtin_index(int index, FAR char * const *argv,
+                       FAR const char *redirfile, int oflags);
+
 #undef EXTERN
 #if defined(__cplusplus)
 }
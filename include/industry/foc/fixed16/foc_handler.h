@@ -29,6 +29,8 @@
 
 #include <dspb16.h>
 
+#include "industry/foc/foc_perf.h"
+
 #ifdef CONFIG_INDUSTRY_FOC_CORDIC
 #  include "industry/foc/fixed16/foc_cordic.h"
 #endif
@@ -171,6 +173,9 @@ struct foc_handler_b16_s
   struct foc_handler_ops_b16_s  ops;           /* Handler operations */
   FAR void                     *modulation;    /* Modulation data */
   FAR void                     *control;       /* Controller data */
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  struct foc_perf_s             perf;          /* Execution time */
+#endif
 };
 
 /* Modulation configuration */
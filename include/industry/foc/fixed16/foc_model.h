@@ -63,6 +63,7 @@ struct foc_model_state_b16_s
   dq_frame_b16_t idq;
   b16_t          omega_e;
   b16_t          omega_m;
+  b16_t          angle;
 };
 
 /* Forward declaration */
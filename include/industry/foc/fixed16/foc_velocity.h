@@ -93,6 +93,9 @@ struct foc_velocity_b16_s
 {
   FAR struct foc_velocity_ops_b16_s *ops;
   FAR void                          *data;
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  struct foc_perf_s                  perf;
+#endif
 };
 
 #ifdef CONFIG_INDUSTRY_FOC_VELOCITY_ODIV
@@ -95,6 +95,9 @@ struct foc_angle_f32_s
 {
   FAR struct foc_angle_ops_f32_s *ops;
   FAR void                       *data;
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  struct foc_perf_s               perf;
+#endif
 };
 
 #ifdef CONFIG_INDUSTRY_FOC_ANGLE_OPENLOOP
@@ -29,6 +29,8 @@
 
 #include <dsp.h>
 
+#include "industry/foc/foc_perf.h"
+
 #ifdef CONFIG_INDUSTRY_FOC_CORDIC
 #  include "industry/foc/float/foc_cordic.h"
 #endif
@@ -172,6 +174,9 @@ struct foc_handler_f32_s
   struct foc_handler_ops_f32_s  ops;           /* Handler operations */
   FAR void                     *modulation;    /* Modulation data */
   FAR void                     *control;       /* Controller data */
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  struct foc_perf_s             perf;          /* Execution time */
+#endif
 };
 
 /* Modulation configuration */
@@ -63,6 +63,7 @@ struct foc_model_state_f32_s
   dq_frame_f32_t idq;
   float          omega_e;
   float          omega_m;
+  float          angle;
 };
 
 /* Forward declaration */
@@ -0,0 +1,169 @@
+/****************************************************************************
+ * apps/include/industry/foc/float/foc_multiaxis.h
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __INDUSTRY_FOC_FLOAT_FOC_MULTIAXIS_H
+#define __INDUSTRY_FOC_FLOAT_FOC_MULTIAXIS_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+#include <nuttx/compiler.h>
+
+#include <stdint.h>
+
+#include <dsp.h>
+
+#include "industry/foc/float/foc_handler.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Maximum number of axes handled by one multi-axis handler */
+
+#define FOC_MULTIAXIS_MAX CONFIG_INDUSTRY_FOC_MULTIAXIS_MAX
+
+/****************************************************************************
+ * Public Type Definition
+ ****************************************************************************/
+
+/* Multi-axis controller input.
+ *
+ * All data is kept as structure-of-arrays: element [i] of each array
+ * belongs to axis i.  The caller may write the arrays directly or use
+ * foc_multiaxis_input_f32() to copy a foc_handler_input_f32_s.
+ */
+
+struct foc_multiaxis_in_f32_s
+{
+  float   i_a[FOC_MULTIAXIS_MAX];     /* Phase A current */
+  float   i_b[FOC_MULTIAXIS_MAX];     /* Phase B current */
+  float   i_c[FOC_MULTIAXIS_MAX];     /* Phase C current */
+  float   angle[FOC_MULTIAXIS_MAX];   /* Phase angle in range [0, 2PI) */
+  float   vbus[FOC_MULTIAXIS_MAX];    /* Bus voltage */
+  float   ref_d[FOC_MULTIAXIS_MAX];   /* D reference (current or voltage) */
+  float   ref_q[FOC_MULTIAXIS_MAX];   /* Q reference (current or voltage) */
+  float   comp_d[FOC_MULTIAXIS_MAX];  /* D voltage compensation */
+  float   comp_q[FOC_MULTIAXIS_MAX];  /* Q voltage compensation */
+  int32_t mode[FOC_MULTIAXIS_MAX];    /* enum foc_handler_mode_e */
+};
+
+/* Multi-axis controller configuration and internal state */
+
+struct foc_multiaxis_st_f32_s
+{
+  /* Configuration */
+
+  float id_kp[FOC_MULTIAXIS_MAX];     /* D current PI Kp */
+  float id_ki[FOC_MULTIAXIS_MAX];     /* D current PI Ki */
+  float iq_kp[FOC_MULTIAXIS_MAX];     /* Q current PI Kp */
+  float iq_ki[FOC_MULTIAXIS_MAX];     /* Q current PI Ki */
+  float duty_max[FOC_MULTIAXIS_MAX];  /* Maximum PWM duty cycle */
+
+  /* State */
+
+  float id_int[FOC_MULTIAXIS_MAX];    /* D current PI integral part */
+  float iq_int[FOC_MULTIAXIS_MAX];    /* Q current PI integral part */
+  float sin[FOC_MULTIAXIS_MAX];       /* Phase angle sine */
+  float cos[FOC_MULTIAXIS_MAX];       /* Phase angle cosine */
+  float mag_max[FOC_MULTIAXIS_MAX];   /* Maximum DQ voltage magnitude */
+  float mod_scale[FOC_MULTIAXIS_MAX]; /* Alpha-beta modulation scale */
+  float i_alpha[FOC_MULTIAXIS_MAX];   /* Alpha current */
+  float i_beta[FOC_MULTIAXIS_MAX];    /* Beta current */
+  float i_d[FOC_MULTIAXIS_MAX];       /* D current */
+  float i_q[FOC_MULTIAXIS_MAX];       /* Q current */
+  float v_d[FOC_MULTIAXIS_MAX];       /* D voltage */
+  float v_q[FOC_MULTIAXIS_MAX];       /* Q voltage */
+  float v_alpha[FOC_MULTIAXIS_MAX];   /* Alpha voltage */
+  float v_beta[FOC_MULTIAXIS_MAX];    /* Beta voltage */
+};
+
+/* Multi-axis controller output */
+
+struct foc_multiaxis_out_f32_s
+{
+  float duty_u[FOC_MULTIAXIS_MAX];    /* Phase U duty cycle */
+  float duty_v[FOC_MULTIAXIS_MAX];    /* Phase V duty cycle */
+  float duty_w[FOC_MULTIAXIS_MAX];    /* Phase W duty cycle */
+};
+
+/* Multi-axis FOC handler data */
+
+struct foc_multiaxis_f32_s
+{
+  int                           naxes; /* Number of active axes */
+  struct foc_multiaxis_in_f32_s in;    /* Input data */
+  struct foc_multiaxis_st_f32_s st;    /* Controller state */
+  struct foc_multiaxis_out_f32_s out;  /* Output data */
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  struct foc_perf_s             perf;  /* Execution time */
+#endif
+} aligned_data(16);
+
+typedef struct foc_multiaxis_f32_s foc_multiaxis_f32_t;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: foc_multiaxis_init_f32
+ ****************************************************************************/
+
+int foc_multiaxis_init_f32(FAR foc_multiaxis_f32_t *h, int naxes);
+
+/****************************************************************************
+ * Name: foc_multiaxis_cfg_f32
+ ****************************************************************************/
+
+int foc_multiaxis_cfg_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                          FAR struct foc_initdata_f32_s *ctrl_cfg,
+                          FAR struct foc_mod_cfg_f32_s *mod_cfg);
+
+/****************************************************************************
+ * Name: foc_multiaxis_input_f32
+ ****************************************************************************/
+
+void foc_multiaxis_input_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                             FAR struct foc_handler_input_f32_s *in);
+
+/****************************************************************************
+ * Name: foc_multiaxis_run_f32
+ ****************************************************************************/
+
+void foc_multiaxis_run_f32(FAR foc_multiaxis_f32_t *h);
+
+/****************************************************************************
+ * Name: foc_multiaxis_output_f32
+ ****************************************************************************/
+
+void foc_multiaxis_output_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                              FAR struct foc_handler_output_f32_s *out);
+
+/****************************************************************************
+ * Name: foc_multiaxis_state_f32
+ ****************************************************************************/
+
+void foc_multiaxis_state_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                             FAR struct foc_state_f32_s *state);
+
+#endif /* __INDUSTRY_FOC_FLOAT_FOC_MULTIAXIS_H */
@@ -0,0 +1,104 @@
+/****************************************************************************
+ * apps/include/industry/foc/foc_perf.h
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_INCLUDE_INDUSTRY_FOC_FOC_PERF_H
+#define __APPS_INCLUDE_INDUSTRY_FOC_FOC_PERF_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+#include <nuttx/compiler.h>
+
+#include <stdint.h>
+
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Number of execution time histogram bins.  The last bin collects all
+ * samples that do not fit into the other bins.
+ */
+
+#define FOC_PERF_HIST_BINS CONFIG_INDUSTRY_FOC_PERF_HIST_BINS
+
+/****************************************************************************
+ * Public Type Definition
+ ****************************************************************************/
+
+/* Execution time statistics for one stage of the control loop.
+ * All times are in perf counter ticks, see foc_perf_ns().
+ */
+
+struct foc_perf_s
+{
+  uint32_t freq;                      /* Perf counter frequency */
+  uint32_t bin;                       /* Histogram bin width */
+  uint32_t start;                     /* Last start timestamp */
+  uint32_t exec;                      /* Last execution time */
+  uint32_t exec_min;                  /* Minimum execution time */
+  uint32_t exec_max;                  /* Maximum execution time */
+  uint64_t exec_sum;                  /* Sum of execution times */
+  uint32_t period;                    /* Last start-to-start period */
+  uint32_t period_min;                /* Minimum period */
+  uint32_t period_max;                /* Maximum period */
+  uint32_t count;                     /* Number of measurements */
+  uint32_t hist[FOC_PERF_HIST_BINS];  /* Execution time histogram */
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: foc_perf_init
+ ****************************************************************************/
+
+void foc_perf_init(FAR struct foc_perf_s *perf);
+
+/****************************************************************************
+ * Name: foc_perf_start
+ ****************************************************************************/
+
+void foc_perf_start(FAR struct foc_perf_s *perf);
+
+/****************************************************************************
+ * Name: foc_perf_end
+ ****************************************************************************/
+
+void foc_perf_end(FAR struct foc_perf_s *perf);
+
+/****************************************************************************
+ * Name: foc_perf_ns
+ ****************************************************************************/
+
+uint32_t foc_perf_ns(FAR struct foc_perf_s *perf, uint32_t ticks);
+
+/****************************************************************************
+ * Name: foc_perf_print
+ ****************************************************************************/
+
+void foc_perf_print(FAR struct foc_perf_s *perf, FAR const char *name);
+
+#endif /* CONFIG_INDUSTRY_FOC_PERF */
+#endif /* __APPS_INCLUDE_INDUSTRY_FOC_FOC_PERF_H */
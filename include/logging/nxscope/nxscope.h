@@ -31,6 +31,11 @@
 #include <pthread.h>
 #include <stdint.h>
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+#  include <semaphore.h>
+#  include <stdatomic.h>
+#endif
+
 #include <logging/nxscope/nxscope_chan.h>
 #include <logging/nxscope/nxscope_intf.h>
 #include <logging/nxscope/nxscope_proto.h>
@@ -43,6 +48,13 @@
 #define NXSCOPE_DIV_LEN       (sizeof(struct nxscope_div_data_s))
 #define NXSCOPE_START_LEN     (sizeof(struct nxscope_start_data_s))
 
+/* Stream encoding support */
+
+#if defined(CONFIG_LOGGING_NXSCOPE_DELTA) || \
+    defined(CONFIG_LOGGING_NXSCOPE_LZF)
+#  define NXSCOPE_HAVE_ENCODE 1
+#endif
+
 /* MSB bit in the channel type means a critical channel */
 
 #define NXSCOPE_IS_CRICHAN(chtype) (chtype & 0x80)
@@ -96,8 +108,8 @@ enum nxscope_info_flags_e
 {
   NXSCOPE_FLAGS_DIVIDER_SUPPORT   = (1 << 0),
   NXSCOPE_FLAGS_ACK_SUPPORT       = (1 << 1),
-  NXSCOPE_FLAGS_RES2              = (1 << 2),
-  NXSCOPE_FLAGS_RES3              = (1 << 3),
+  NXSCOPE_FLAGS_DELTA_SUPPORT     = (1 << 2),
+  NXSCOPE_FLAGS_LZF_SUPPORT       = (1 << 3),
   NXSCOPE_FLAGS_RES4              = (1 << 4),
   NXSCOPE_FLAGS_RES5              = (1 << 5),
   NXSCOPE_FLAGS_RES6              = (1 << 6),
@@ -108,14 +120,31 @@ enum nxscope_info_flags_e
 
 enum nxscope_stream_flags_s
 {
-  NXSCOPE_STREAM_FLAGS_OVERFLOW = (1 << 0)
+  NXSCOPE_STREAM_FLAGS_OVERFLOW = (1 << 0),
+  NXSCOPE_STREAM_FLAGS_DELTA    = (1 << 1), /* Delta-encoded samples */
+  NXSCOPE_STREAM_FLAGS_LZF      = (1 << 2)  /* Payload is a LZF block */
+};
+
+/* Nxscope start flags.
+ *
+ * The encoding bits request a stream encoding.  Only encodings reported
+ * in the common info flags are enabled, others are ignored.
+ */
+
+enum nxscope_start_flags_e
+{
+  NXSCOPE_START_FLAGS_START     = (1 << 0), /* Start/stop */
+  NXSCOPE_START_FLAGS_DELTA     = (1 << 1), /* Request delta encoding */
+  NXSCOPE_START_FLAGS_LZF       = (1 << 2), /* Request LZF compression */
+  NXSCOPE_START_FLAGS_ALL       = 0x07
 };
 
 /* Nxscope start frame data */
 
 begin_packed_struct struct nxscope_start_data_s
 {
-  uint8_t  start;                        /* Start/stop flag */
+  uint8_t  start;                        /* Start flags
+                                          * (enum nxscope_start_flags_e) */
 } end_packed_struct;
 
 /* Nxscope enable channel data */
@@ -230,6 +259,12 @@ struct nxscope_sample_s
  *   | 1B       | n bytes      |
  *   +----------+--------------+
  *
+ *   With NXSCOPE_STREAM_FLAGS_DELTA, each element of integer and
+ *   fixed-point samples is the zig-zag LEB128 varint of the difference
+ *   to the previous sample of the channel in this frame (or to zero for
+ *   the first one).  With NXSCOPE_STREAM_FLAGS_LZF, the samples data is
+ *   a single LZF block ("ZV" header) that decompresses to the above.
+ *
  */
 
 struct nxscope_stream_s
@@ -253,6 +288,18 @@ struct nxscope_callbacks_s
   CODE int (*start)(FAR void *priv, bool start);
 };
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+/* Nxscope stream buffer for the double-buffered mode */
+
+struct nxscope_dbuf_s
+{
+  FAR uint8_t   *buf;                    /* Frame buffer */
+  atomic_size_t  i;                      /* Buffer cursor */
+  atomic_uint    writers;                /* Producers writing to buf */
+  atomic_uint    flags;                  /* Stream flags for this frame */
+};
+#endif
+
 /* Nxscope general configuration */
 
 struct nxscope_cfg_s
@@ -362,6 +409,43 @@ struct nxscope_s
   size_t                       stream_i;
   bool                         stream_retry;
 
+#ifdef NXSCOPE_HAVE_ENCODE
+  /* Negotiated stream encoding (enum nxscope_stream_flags_s) */
+
+  uint8_t                      encode;
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  /* Delta encoding history, chmax elements */
+
+  FAR int64_t                **delta_prev;
+  FAR uint8_t                 *delta_sync;
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+  /* LZF scratch buffer and hash table */
+
+  FAR uint8_t                 *lzfbuf;
+  FAR void                    *lzfstate;
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  /* Double-buffered stream data.
+   *
+   * Producers append to dbuf[dbuf_active], nxscope_stream() sends
+   * dbuf[dbuf_send] with the cursor dbuf_sendi.
+   */
+
+  struct nxscope_dbuf_s        dbuf[2];
+  atomic_uint                  dbuf_active;
+  uint8_t                      dbuf_send;
+  size_t                       dbuf_sendi;
+
+  /* Posted by the last producer that leaves a retired buffer */
+
+  sem_t                        dbuf_done;
+#endif
+
 #ifdef CONFIG_LOGGING_NXSCOPE_CRICHANNELS
   /* Critical buffer data */
 
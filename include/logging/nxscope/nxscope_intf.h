@@ -31,6 +31,16 @@
 #  include <termios.h>
 #endif
 
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifdef CONFIG_LOGGING_NXSCOPE_INTF_SHM
+/* Shared memory interface magic ("NXSM") */
+
+#  define NXSCOPE_SHM_MAGIC 0x4d53584e
+#endif
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -89,6 +99,69 @@ struct nxscope_ser_cfg_s
 };
 #endif
 
+#ifdef CONFIG_LOGGING_NXSCOPE_INTF_UDP
+/* Nxscope UDP interface configuration.
+ *
+ * The interface binds to the given port and sends to the address of the
+ * last received command datagram, so the client connects by sending
+ * any request.  Every nxscope frame is sent in its own datagram, so the
+ * stream buffer must not be larger than mtu.  Larger frames are rejected
+ * with -EMSGSIZE.
+ */
+
+struct nxscope_udp_cfg_s
+{
+  uint16_t port;                /* Local UDP port */
+  uint16_t mtu;                 /* Max datagram payload (0 - default) */
+  bool     nonblock;            /* Nonblocking operation */
+};
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_INTF_SHM
+/* Nxscope shared memory ring.
+ *
+ * Single producer, single consumer.  The producer only writes head, the
+ * consumer only writes tail.  Both are free-running byte counters, size
+ * is a power of two and the data is at (head & (size - 1)).
+ */
+
+struct nxscope_shm_ring_s
+{
+  volatile uint32_t head;       /* Written by the producer */
+  volatile uint32_t tail;       /* Written by the consumer */
+  uint32_t          size;       /* Ring data size */
+  uint32_t          off;        /* Data offset from the region start */
+};
+
+/* Nxscope shared memory region header.
+ *
+ * The tx ring carries nxscope frames to the consumer, the rx ring carries
+ * requests from the consumer.
+ */
+
+struct nxscope_shm_hdr_s
+{
+  uint32_t                  magic; /* NXSCOPE_SHM_MAGIC when ready */
+  struct nxscope_shm_ring_s tx;    /* Nxscope -> consumer */
+  struct nxscope_shm_ring_s rx;    /* Consumer -> nxscope */
+};
+
+/* Nxscope shared memory interface configuration.
+ *
+ * If mem is NULL, a region of the given size is created with shm_open()
+ * and the given name, so that another task can map it.  The object is
+ * removed with shm_unlink() on deinit.
+ */
+
+struct nxscope_shm_cfg_s
+{
+  FAR void       *mem;          /* Region or NULL */
+  FAR const char *name;         /* shm_open() name if mem is NULL */
+  size_t          size;         /* Region size */
+  size_t          rxlen;        /* rx ring size, rounded up to 2^n */
+};
+#endif
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -123,4 +196,34 @@ int nxscope_ser_init(FAR struct nxscope_intf_s *intf,
 void nxscope_ser_deinit(FAR struct nxscope_intf_s *intf);
 #endif
 
+#ifdef CONFIG_LOGGING_NXSCOPE_INTF_UDP
+/****************************************************************************
+ * Name: nxscope_udp_init
+ ****************************************************************************/
+
+int nxscope_udp_init(FAR struct nxscope_intf_s *intf,
+                     FAR struct nxscope_udp_cfg_s *cfg);
+
+/****************************************************************************
+ * Name: nxscope_udp_deinit
+ ****************************************************************************/
+
+void nxscope_udp_deinit(FAR struct nxscope_intf_s *intf);
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_INTF_SHM
+/****************************************************************************
+ * Name: nxscope_shm_init
+ ****************************************************************************/
+
+int nxscope_shm_init(FAR struct nxscope_intf_s *intf,
+                     FAR struct nxscope_shm_cfg_s *cfg);
+
+/****************************************************************************
+ * Name: nxscope_shm_deinit
+ ****************************************************************************/
+
+void nxscope_shm_deinit(FAR struct nxscope_intf_s *intf);
+#endif
+
 #endif  /* __APPS_INCLUDE_LOGGING_NXSCOPE_NXSCOPE_INTF_H */
@@ -130,6 +130,10 @@ typedef enum
   MB_ETIMEDOUT                /* timeout error occurred. */
 } eMBErrorCode;
 
+/* Handle of a Modbus slave instance created with eMBInitInst(). */
+
+typedef struct xMBInstance *xMBHandle;
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -240,6 +244,76 @@ eMBErrorCode eMBDisable(void);
 
 eMBErrorCode eMBPoll(void);
 
+#ifdef CONFIG_MB_MULTI_INSTANCE
+/* Initialize an additional Modbus RTU slave instance.
+ *
+ * Each instance has its own serial port, slave address, state machine and
+ * buffers, so one task can serve several buses.  The instance is disabled
+ * after initialization; enable it with eMBEnableInst() and drive it with
+ * eMBPollInst() or eMBPollInstances().  The functions without an instance
+ * handle keep working on the default instance.  All instances share the
+ * function handlers and the register callbacks, which can find out the
+ * instance of the request with xMBGetInst().  All instances must be used
+ * from the same task.
+ *
+ * Input Parameters:
+ *   pxHandle Receives the handle of the new instance.
+ *   eMode Must be MB_RTU.
+ *   ucSlaveAddress, ucPort, ulBaudRate, eParity As for eMBInit().
+ *
+ * Returned Value:
+ *   eMBErrorCode::MB_ENOERR on success, eMBErrorCode::MB_ENORES if all
+ *   CONFIG_MB_MULTI_INSTANCE_MAX instances are in use, or one of the
+ *   error codes of eMBInit().
+ */
+
+eMBErrorCode eMBInitInst(xMBHandle *pxHandle, eMBMode eMode,
+                         uint8_t ucSlaveAddress, uint8_t ucPort,
+                         speed_t ulBaudRate, eMBParity eParity);
+
+/* Release an instance.  It must be disabled.  See eMBClose(). */
+
+eMBErrorCode eMBCloseInst(xMBHandle xHandle);
+
+/* Enable or disable an instance.  See eMBEnable() and eMBDisable(). */
+
+eMBErrorCode eMBEnableInst(xMBHandle xHandle);
+eMBErrorCode eMBDisableInst(xMBHandle xHandle);
+
+/* Poll an instance once.  See eMBPoll().  Unlike eMBPoll() this function
+ * never waits for characters from the serial port.
+ */
+
+eMBErrorCode eMBPollInst(xMBHandle xHandle);
+
+/* Wait for activity on any of the given instances and poll each enabled
+ * one once.  This is the body of an event loop serving several buses:
+ *
+ *   for (;;)
+ *     {
+ *       eMBPollInstances(axBus, 3, 100);
+ *     }
+ *
+ * Input Parameters:
+ *   pxHandles The instances.
+ *   iCount Number of instances, at most CONFIG_MB_MULTI_INSTANCE_MAX.
+ *   iTimeoutMs The longest time to wait for a character, or -1 to wait
+ *     forever.  The wait is shorter while a frame is being received or
+ *     a response is pending.
+ *
+ * Returned Value:
+ *   eMBErrorCode::MB_ENOERR, eMBErrorCode::MB_EINVAL for an invalid
+ *   handle or eMBErrorCode::MB_EIO if waiting failed.
+ */
+
+eMBErrorCode eMBPollInstances(const xMBHandle *pxHandles, int iCount,
+                              int iTimeoutMs);
+
+/* Return the instance being polled, or NULL for the default instance. */
+
+xMBHandle xMBGetInst(void);
+#endif
+
 /* Configure the slave id of the device.
  *
  * This function should be called when the Modbus function Report Slave ID
@@ -245,8 +245,9 @@ eMBErrorCode eMBMasterPoll(void);
  *   ucFunctionCode The Modbus function code for which this handler should
  *     be registers. Valid function codes are in the range 1 to 127.
  *   pxHandler The function handler which should be called in case
- *    such a frame is received. If NULL a previously registered function
- *    handler for this function code is removed.
+ *    such a frame is received. It replaces a handler previously
+ *    registered for this function code. If NULL a previously registered
+ *    function handler for this function code is removed.
  *
  * Returned Value:
  *   eMBErrorCode::MB_ENOERR if the handler has been installed. If no
@@ -427,6 +428,81 @@ eMBMasterReqErrCode eMBMasterReqWriteMultipleCoils(uint8_t ucSndAddr,
 eMBMasterReqErrCode eMBMasterReqReadDiscreteInputs(uint8_t ucSndAddr,
   uint16_t usDiscreteAddr, uint16_t usNDiscreteIn, uint32_t lTimeOut);
 
+#ifdef CONFIG_MB_MASTER_SCHED
+/****************************************************************************
+ * Description:
+ *   Polling scheduler.
+ *
+ *   The scheduler reads a table of register ranges from the slaves, each
+ *   range with its own period, and stores the values in a register image
+ *   owned by the application.  Due ranges of the same slave and function
+ *   that are adjacent or close together are read with one request.  The
+ *   slaves take turns so that a slave with many ranges does not hold up
+ *   the others, and a slave that does not respond is skipped for
+ *   CONFIG_MB_MASTER_SCHED_BACKOFF_MS.  Requests are issued back to back
+ *   through the eMBMasterReqRead*() functions, so eMBMasterPoll() must be
+ *   running in another task as usual.
+ *
+ ****************************************************************************/
+
+typedef struct
+{
+  uint8_t   ucSlave;           /* Slave address */
+  uint8_t   ucFunction;        /* MB_FUNC_READ_HOLDING_REGISTER,
+                                * MB_FUNC_READ_INPUT_REGISTER,
+                                * MB_FUNC_READ_COILS or
+                                * MB_FUNC_READ_DISCRETE_INPUTS */
+  uint16_t  usAddress;         /* First register or bit, as in the PDU */
+  uint16_t  usCount;           /* Number of registers or bits */
+  uint32_t  ulPeriodMs;        /* Read period */
+  void     *pvImage;           /* Registers: uint16_t[usCount] in host
+                                * order.  Bits: uint8_t[(usCount + 7) / 8],
+                                * the first bit in the LSB of byte 0. */
+} xMBMasterPollEntry;
+
+typedef struct
+{
+  uint32_t            ulUpdates;      /* Successful reads */
+  uint32_t            ulErrors;       /* Failed reads */
+  uint32_t            ulLastUpdateMs; /* Monotonic time of the last read */
+  eMBMasterReqErrCode eLastError;     /* Result of the last read */
+} xMBMasterPollStatus;
+
+/* Install a table of at most CONFIG_MB_MASTER_SCHED_NENTRIES entries.  The
+ * table and the images must stay valid until vMBMasterSchedDeinit().
+ * Returns MB_EINVAL if an entry is invalid and MB_ENORES if the
+ * scheduler's response handler cannot be registered.
+ */
+
+eMBErrorCode eMBMasterSchedInit(const xMBMasterPollEntry *pxEntries,
+                                int iCount);
+void vMBMasterSchedDeinit(void);
+
+/* Issue the next due request, if any, and wait for its completion.
+ * Returns the time in milliseconds until the next request is due, 0 if a
+ * request was issued.
+ */
+
+uint32_t ulMBMasterSchedRunOnce(void);
+
+/* Call ulMBMasterSchedRunOnce() until vMBMasterSchedStop() is called. */
+
+eMBErrorCode eMBMasterSchedRun(void);
+void vMBMasterSchedStop(void);
+
+/* Statistics of the entry with index iEntry in the table. */
+
+eMBErrorCode eMBMasterSchedGetStatus(int iEntry,
+                                     xMBMasterPollStatus *pxStatus);
+
+/* The images are written by the task running eMBMasterPoll().  Hold this
+ * lock to read several values of an image consistently.
+ */
+
+void vMBMasterSchedLock(void);
+void vMBMasterSchedUnlock(void);
+#endif
+
 eMBException eMBMasterFuncReportSlaveID(uint8_t *pucFrame, uint16_t *usLen);
 eMBException eMBMasterFuncReadInputRegister(uint8_t *pucFrame,
   uint16_t *usLen);
@@ -47,6 +47,7 @@
 
 #include <nuttx/net/tcp.h>
 
+#include <sys/types.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <limits.h>
@@ -91,8 +92,13 @@
  */
 
 #define HTTPD_MAX_CONTENTLEN  32
-#define HTTPD_MAX_HEADERLEN   220
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+#  define HTTPD_MAX_HEADERLEN 268
+#else
+#  define HTTPD_MAX_HEADERLEN 220
+#endif
 #define HTTPD_MAX_CHUNKEDLEN  16
+#define HTTPD_MAX_ETAGLEN     12
 
 /****************************************************************************
  * Public types
@@ -109,6 +115,11 @@ struct httpd_fs_file
 #ifdef CONFIG_NETUTILS_HTTPD_SENDFILE
   char path[PATH_MAX];
 #endif
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  FAR const char *hdr;                  /* Pre-built "200 OK" header or NULL */
+  int hdrlen;
+  FAR const char *etag;                 /* Quoted entity tag */
+#endif
 };
 
 struct httpd_state
@@ -126,6 +137,21 @@ struct httpd_state
   FAR char *ht_scriptptr;
   uint16_t ht_scriptlen;
   uint16_t ht_sndlen;
+  size_t ht_buflen;                     /* Bytes pending in ht_buffer */
+  uint8_t ht_parse;                     /* Request parser state */
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  char ht_etag[HTTPD_MAX_ETAGLEN];      /* If-None-Match from the request */
+#endif
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+  bool ht_gzip;                         /* Accept-Encoding lists gzip */
+  bool ht_gzipped;                      /* Sending the .gz variant */
+#endif
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+  bool ht_sending;                      /* File body still being sent */
+  off_t ht_sndoff;                      /* Offset of the next body byte */
+  char ht_txbuf[HTTPD_MAX_HEADERLEN];   /* Output the socket did not take */
+  uint16_t ht_txlen;                    /* Bytes pending in ht_txbuf */
+#endif
 };
 
 struct httpd_fsdata_file
@@ -347,6 +347,8 @@ int netlib_parsehttpurl(FAR const char *url, uint16_t *port,
 int netlib_parseurl(FAR const char *str, FAR struct url_s *url);
 #endif
 
+bool netlib_acceptgzip(FAR const char *accept);
+
 /* Generic server logic */
 
 int netlib_listenon(uint16_t portno);
@@ -66,6 +66,12 @@ int foc_angle_init_b16(FAR foc_angle_b16_t *h,
 
   memset(h, 0, sizeof(foc_angle_b16_t));
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  /* Reset execution time statistics */
+
+  foc_perf_init(&h->perf);
+#endif
+
   /* Connect ops */
 
   h->ops = ops;
@@ -184,11 +190,23 @@ int foc_angle_run_b16(FAR foc_angle_b16_t *h,
                        FAR struct foc_angle_in_b16_s *in,
                        FAR struct foc_angle_out_b16_s *out)
 {
+  int ret = OK;
+
   DEBUGASSERT(h);
   DEBUGASSERT(in);
   DEBUGASSERT(out);
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_start(&h->perf);
+#endif
+
   /* Run angle handler */
 
-  return h->ops->run(h, in, out);
+  ret = h->ops->run(h, in, out);
+
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_end(&h->perf);
+#endif
+
+  return ret;
 }
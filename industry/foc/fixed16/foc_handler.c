@@ -84,6 +84,12 @@ int foc_handler_init_b16(FAR foc_handler_b16_t *h,
 
   memset(h, 0, sizeof(foc_handler_b16_t));
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  /* Reset execution time statistics */
+
+  foc_perf_init(&h->perf);
+#endif
+
   /* Connect ops */
 
   h->ops.ctrl = ctrl;
@@ -216,6 +222,10 @@ int foc_handler_run_b16(FAR foc_handler_b16_t *h,
   DEBUGASSERT(in);
   DEBUGASSERT(out);
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_start(&h->perf);
+#endif
+
   /* Do nothing if control mode not specified yet.
    * This also protects against initial state when the controller is
    * started but input data has not yet been provided.
@@ -293,6 +303,10 @@ int foc_handler_run_b16(FAR foc_handler_b16_t *h,
 
   h->ops.mod->run(h, &v_ab_mod, out->duty);
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_end(&h->perf);
+#endif
+
   return ret;
 
 errout:
@@ -300,6 +314,11 @@ errout:
   /* Set duty to zeros */
 
   memset(out->duty, 0, sizeof(b16_t) * CONFIG_MOTOR_FOC_PHASES);
+
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_end(&h->perf);
+#endif
+
   return ret;
 }
 
@@ -289,6 +289,7 @@ static void foc_model_pmsm_state_f32(FAR foc_model_f32_t *h,
   state->idq.q   = model->model.state.i_dq.q;
   state->omega_e = model->model.state.omega_e;
   state->omega_m = model->model.state.omega_m;
+  state->angle   = model->model.state.angle.angle;
 
   /* Get RAW currents */
 
@@ -0,0 +1,576 @@
+/****************************************************************************
+ * apps/industry/foc/float/foc_multiaxis.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "industry/foc/foc_common.h"
+#include "industry/foc/float/foc_multiaxis.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#if CONFIG_MOTOR_FOC_PHASES != 3
+#  error
+#endif
+
+/* Enable current samples correction if 3-shunts */
+
+#if CONFIG_MOTOR_FOC_SHUNTS == 3
+#  define FOC_CORRECT_CURRENT_SAMPLES 1
+#endif
+
+/* Constants */
+
+#define FOC_MA_PI           (3.14159265f)
+#define FOC_MA_2PI          (6.28318531f)
+#define FOC_MA_PI_2         (1.57079633f)
+#define FOC_MA_ONE_BY_SQRT3 (0.57735027f)
+#define FOC_MA_TWO_BY_SQRT3 (1.15470054f)
+#define FOC_MA_SQRT3_BY_TWO (0.86602540f)
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: foc_multiaxis_wrap
+ *
+ * Description:
+ *   Wrap an angle from range [-PI, 3PI) to range [-PI, PI)
+ *
+ ****************************************************************************/
+
+static inline float foc_multiaxis_wrap(float x)
+{
+  return (x >= FOC_MA_PI) ? x - FOC_MA_2PI : x;
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_sin
+ *
+ * Description:
+ *   Branch-free sine approximation for range [-PI, PI).
+ *   Maximum error is about 0.001.
+ *
+ ****************************************************************************/
+
+static inline float foc_multiaxis_sin(float x)
+{
+  float y;
+
+  y = 1.27323954f * x - 0.40528473f * x * fabsf(x);
+  return 0.225f * (y * fabsf(y) - y) + y;
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_clamp
+ ****************************************************************************/
+
+static inline float foc_multiaxis_clamp(float x, float min, float max)
+{
+  return fminf(fmaxf(x, min), max);
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_angle
+ *
+ * Description:
+ *   Update phase angle sine/cosine and voltage scaling for all axes
+ *
+ ****************************************************************************/
+
+static void foc_multiaxis_angle(FAR foc_multiaxis_f32_t *h)
+{
+  float a;
+  float vbase;
+  int   i;
+
+  for (i = 0; i < h->naxes; i += 1)
+    {
+      a = foc_multiaxis_wrap(h->in.angle[i]);
+
+      h->st.sin[i] = foc_multiaxis_sin(a);
+      h->st.cos[i] = foc_multiaxis_sin(foc_multiaxis_wrap(a + FOC_MA_PI_2));
+
+      /* SVM3 base voltage.  The DQ voltage magnitude is limited to the
+       * circle inscribed in the SVM3 hexagon.
+       */
+
+      vbase = fmaxf(h->in.vbus[i], 0.0f) * FOC_MA_ONE_BY_SQRT3;
+
+      h->st.mag_max[i]   = vbase;
+      h->st.mod_scale[i] = (vbase > 0.0f) ? 1.0f / vbase : 0.0f;
+    }
+}
+
+#ifdef FOC_CORRECT_CURRENT_SAMPLES
+/****************************************************************************
+ * Name: foc_multiaxis_current_correct
+ *
+ * Description:
+ *   Reconstruct the current of the phase with the largest duty cycle from
+ *   the two other phases.  The sample for this phase is unreliable because
+ *   its low-side switch was on for the shortest time.  This is the
+ *   multi-axis equivalent of svm3_current_correct().
+ *
+ ****************************************************************************/
+
+static void foc_multiaxis_current_correct(FAR foc_multiaxis_f32_t *h)
+{
+  float ia;
+  float ib;
+  float ic;
+  float du;
+  float dv;
+  float dw;
+  float dmax;
+  float sa;
+  float sb;
+  float sc;
+  int   i;
+
+  for (i = 0; i < h->naxes; i += 1)
+    {
+      ia = h->in.i_a[i];
+      ib = h->in.i_b[i];
+      ic = h->in.i_c[i];
+      du = h->out.duty_u[i];
+      dv = h->out.duty_v[i];
+      dw = h->out.duty_w[i];
+
+      /* Select exactly one phase, also if duty cycles are equal */
+
+      dmax = fmaxf(du, fmaxf(dv, dw));
+      sa   = (du >= dmax) ? 1.0f : 0.0f;
+      sb   = (dv >= dmax) ? 1.0f - sa : 0.0f;
+      sc   = 1.0f - sa - sb;
+
+      h->in.i_a[i] = ia - sa * (ia + ib + ic);
+      h->in.i_b[i] = ib - sb * (ia + ib + ic);
+      h->in.i_c[i] = ic - sc * (ia + ib + ic);
+    }
+}
+#endif
+
+/****************************************************************************
+ * Name: foc_multiaxis_transform
+ *
+ * Description:
+ *   Clarke and Park transformation of the phase currents for all axes
+ *
+ ****************************************************************************/
+
+static void foc_multiaxis_transform(FAR foc_multiaxis_f32_t *h)
+{
+  float alpha;
+  float beta;
+  int   i;
+
+  for (i = 0; i < h->naxes; i += 1)
+    {
+      /* Clarke transform */
+
+      alpha = h->in.i_a[i];
+      beta  = FOC_MA_ONE_BY_SQRT3 * h->in.i_a[i] +
+              FOC_MA_TWO_BY_SQRT3 * h->in.i_b[i];
+
+      h->st.i_alpha[i] = alpha;
+      h->st.i_beta[i]  = beta;
+
+      /* Park transform */
+
+      h->st.i_d[i] = alpha * h->st.cos[i] + beta * h->st.sin[i];
+      h->st.i_q[i] = beta * h->st.cos[i] - alpha * h->st.sin[i];
+    }
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_control
+ *
+ * Description:
+ *   Run DQ current PI controllers and get the DQ voltage for all axes.
+ *   Axes in voltage mode take the DQ reference as the voltage directly.
+ *   The integral part is reset for axes not in current mode.
+ *
+ ****************************************************************************/
+
+static void foc_multiaxis_control(FAR foc_multiaxis_f32_t *h)
+{
+  float current;
+  float mag_max;
+  float err;
+  float integ;
+  float vd;
+  float vq;
+  float mag;
+  float scale;
+  int   i;
+
+  for (i = 0; i < h->naxes; i += 1)
+    {
+      current = (h->in.mode[i] == FOC_HANDLER_MODE_CURRENT) ? 1.0f : 0.0f;
+      mag_max = h->st.mag_max[i];
+
+      /* D axis PI controller with integral clamping */
+
+      err   = h->in.ref_d[i] - h->st.i_d[i];
+      integ = h->st.id_int[i] + h->st.id_ki[i] * err;
+      integ = foc_multiaxis_clamp(integ, -mag_max, mag_max) * current;
+
+      h->st.id_int[i] = integ;
+
+      vd = foc_multiaxis_clamp(h->st.id_kp[i] * err + integ,
+                               -mag_max, mag_max) - h->in.comp_d[i];
+
+      /* Q axis PI controller with integral clamping */
+
+      err   = h->in.ref_q[i] - h->st.i_q[i];
+      integ = h->st.iq_int[i] + h->st.iq_ki[i] * err;
+      integ = foc_multiaxis_clamp(integ, -mag_max, mag_max) * current;
+
+      h->st.iq_int[i] = integ;
+
+      vq = foc_multiaxis_clamp(h->st.iq_kp[i] * err + integ,
+                               -mag_max, mag_max) - h->in.comp_q[i];
+
+      /* Select voltage reference according to mode */
+
+      vd = (current > 0.0f) ? vd : h->in.ref_d[i];
+      vq = (current > 0.0f) ? vq : h->in.ref_q[i];
+
+      /* Saturate DQ voltage vector */
+
+      mag   = sqrtf(vd * vd + vq * vq);
+      scale = (mag > mag_max) ? mag_max / mag : 1.0f;
+
+      h->st.v_d[i] = vd * scale;
+      h->st.v_q[i] = vq * scale;
+    }
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_modulation
+ *
+ * Description:
+ *   Inverse Park transformation and 3-phase space vector modulation for
+ *   all axes.  SVM3 is done with min-max zero sequence injection which
+ *   gives the same duty cycles as the sector based svm3() without the
+ *   per-sector branches.
+ *
+ ****************************************************************************/
+
+static void foc_multiaxis_modulation(FAR foc_multiaxis_f32_t *h)
+{
+  float active;
+  float alpha;
+  float beta;
+  float u;
+  float v;
+  float w;
+  float off;
+  float max;
+  int   i;
+
+  for (i = 0; i < h->naxes; i += 1)
+    {
+      active = (h->in.mode[i] >= FOC_HANDLER_MODE_VOLTAGE) ? 1.0f : 0.0f;
+      max    = h->st.duty_max[i];
+
+      /* Inverse Park transform */
+
+      alpha = h->st.v_d[i] * h->st.cos[i] - h->st.v_q[i] * h->st.sin[i];
+      beta  = h->st.v_d[i] * h->st.sin[i] + h->st.v_q[i] * h->st.cos[i];
+
+      h->st.v_alpha[i] = alpha;
+      h->st.v_beta[i]  = beta;
+
+      /* Scale to modulation voltage */
+
+      alpha *= h->st.mod_scale[i];
+      beta  *= h->st.mod_scale[i];
+
+      /* Inverse Clarke transform */
+
+      u = alpha;
+      v = -0.5f * alpha + FOC_MA_SQRT3_BY_TWO * beta;
+      w = -0.5f * alpha - FOC_MA_SQRT3_BY_TWO * beta;
+
+      /* Zero sequence injection */
+
+      off = -0.5f * (fmaxf(u, fmaxf(v, w)) + fminf(u, fminf(v, w)));
+
+      /* Duty cycle, zero for axes in idle mode */
+
+      u = 0.5f + (u + off) * FOC_MA_ONE_BY_SQRT3;
+      v = 0.5f + (v + off) * FOC_MA_ONE_BY_SQRT3;
+      w = 0.5f + (w + off) * FOC_MA_ONE_BY_SQRT3;
+
+      h->out.duty_u[i] = foc_multiaxis_clamp(u, 0.0f, max) * active;
+      h->out.duty_v[i] = foc_multiaxis_clamp(v, 0.0f, max) * active;
+      h->out.duty_w[i] = foc_multiaxis_clamp(w, 0.0f, max) * active;
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: foc_multiaxis_init_f32
+ *
+ * Description:
+ *   Initialize the multi-axis FOC handler (float32)
+ *
+ * Input Parameter:
+ *   h     - pointer to multi-axis FOC handler
+ *   naxes - number of axes
+ *
+ ****************************************************************************/
+
+int foc_multiaxis_init_f32(FAR foc_multiaxis_f32_t *h, int naxes)
+{
+  DEBUGASSERT(h);
+
+  if (naxes <= 0 || naxes > FOC_MULTIAXIS_MAX)
+    {
+      return -EINVAL;
+    }
+
+  memset(h, 0, sizeof(foc_multiaxis_f32_t));
+
+  h->naxes = naxes;
+
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  /* Reset execution time statistics */
+
+  foc_perf_init(&h->perf);
+#endif
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_cfg_f32
+ *
+ * Description:
+ *   Configure one axis of the multi-axis FOC handler (float32)
+ *
+ * Input Parameter:
+ *   h        - pointer to multi-axis FOC handler
+ *   axis     - axis index
+ *   ctrl_cfg - pointer to PI controller configuration data
+ *   mod_cfg  - pointer to modulation configuration data
+ *
+ ****************************************************************************/
+
+int foc_multiaxis_cfg_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                          FAR struct foc_initdata_f32_s *ctrl_cfg,
+                          FAR struct foc_mod_cfg_f32_s *mod_cfg)
+{
+  DEBUGASSERT(h);
+  DEBUGASSERT(ctrl_cfg);
+  DEBUGASSERT(mod_cfg);
+
+  if (axis < 0 || axis >= h->naxes)
+    {
+      return -EINVAL;
+    }
+
+  h->st.id_kp[axis]    = ctrl_cfg->id_kp;
+  h->st.id_ki[axis]    = ctrl_cfg->id_ki;
+  h->st.iq_kp[axis]    = ctrl_cfg->iq_kp;
+  h->st.iq_ki[axis]    = ctrl_cfg->iq_ki;
+  h->st.duty_max[axis] = mod_cfg->pwm_duty_max;
+
+  /* Reset controller state */
+
+  h->st.id_int[axis] = 0.0f;
+  h->st.iq_int[axis] = 0.0f;
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_input_f32
+ *
+ * Description:
+ *   Copy the single-axis handler input to one axis (float32)
+ *
+ * Input Parameter:
+ *   h    - pointer to multi-axis FOC handler
+ *   axis - axis index
+ *   in   - pointer to FOC handler input data
+ *
+ ****************************************************************************/
+
+void foc_multiaxis_input_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                             FAR struct foc_handler_input_f32_s *in)
+{
+  DEBUGASSERT(h);
+  DEBUGASSERT(in);
+  DEBUGASSERT(axis >= 0 && axis < h->naxes);
+
+  h->in.i_a[axis]   = in->current[0];
+  h->in.i_b[axis]   = in->current[1];
+  h->in.i_c[axis]   = in->current[2];
+  h->in.angle[axis] = in->angle;
+  h->in.vbus[axis]  = in->vbus;
+  h->in.mode[axis]  = in->mode;
+
+  if (in->dq_ref)
+    {
+      h->in.ref_d[axis] = in->dq_ref->d;
+      h->in.ref_q[axis] = in->dq_ref->q;
+    }
+
+  if (in->vdq_comp)
+    {
+      h->in.comp_d[axis] = in->vdq_comp->d;
+      h->in.comp_q[axis] = in->vdq_comp->q;
+    }
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_run_f32
+ *
+ * Description:
+ *   Run one control step for all axes (float32).
+ *
+ *   Each stage processes all axes before the next stage starts.  The
+ *   stage loops have no data dependent branches and work on separate
+ *   arrays, so the compiler can vectorize them.
+ *
+ * Input Parameter:
+ *   h - pointer to multi-axis FOC handler
+ *
+ ****************************************************************************/
+
+void foc_multiaxis_run_f32(FAR foc_multiaxis_f32_t *h)
+{
+  DEBUGASSERT(h);
+
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_start(&h->perf);
+#endif
+
+  /* Correct current samples according to the last modulation */
+
+#ifdef FOC_CORRECT_CURRENT_SAMPLES
+  foc_multiaxis_current_correct(h);
+#endif
+
+  /* Phase angle and base voltage */
+
+  foc_multiaxis_angle(h);
+
+  /* Clarke and Park transform */
+
+  foc_multiaxis_transform(h);
+
+  /* Current/voltage control */
+
+  foc_multiaxis_control(h);
+
+  /* Inverse Park transform and SVM3 */
+
+  foc_multiaxis_modulation(h);
+
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_end(&h->perf);
+#endif
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_output_f32
+ *
+ * Description:
+ *   Get the duty cycle of one axis (float32)
+ *
+ * Input Parameter:
+ *   h    - pointer to multi-axis FOC handler
+ *   axis - axis index
+ *   out  - (out) pointer to FOC handler output data
+ *
+ ****************************************************************************/
+
+void foc_multiaxis_output_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                              FAR struct foc_handler_output_f32_s *out)
+{
+  DEBUGASSERT(h);
+  DEBUGASSERT(out);
+  DEBUGASSERT(axis >= 0 && axis < h->naxes);
+
+  out->duty[0] = h->out.duty_u[axis];
+  out->duty[1] = h->out.duty_v[axis];
+  out->duty[2] = h->out.duty_w[axis];
+}
+
+/****************************************************************************
+ * Name: foc_multiaxis_state_f32
+ *
+ * Description:
+ *   Get the controller state of one axis (float32)
+ *
+ * Input Parameter:
+ *   h     - pointer to multi-axis FOC handler
+ *   axis  - axis index
+ *   state - (out) pointer to FOC state data
+ *
+ ****************************************************************************/
+
+void foc_multiaxis_state_f32(FAR foc_multiaxis_f32_t *h, int axis,
+                             FAR struct foc_state_f32_s *state)
+{
+  float alpha;
+  float beta;
+
+  DEBUGASSERT(h);
+  DEBUGASSERT(state);
+  DEBUGASSERT(axis >= 0 && axis < h->naxes);
+
+  alpha = h->st.v_alpha[axis];
+  beta  = h->st.v_beta[axis];
+
+  state->curr[0]   = h->in.i_a[axis];
+  state->curr[1]   = h->in.i_b[axis];
+  state->curr[2]   = h->in.i_c[axis];
+  state->volt[0]   = alpha;
+  state->volt[1]   = -0.5f * alpha + FOC_MA_SQRT3_BY_TWO * beta;
+  state->volt[2]   = -0.5f * alpha - FOC_MA_SQRT3_BY_TWO * beta;
+  state->iab.a     = h->st.i_alpha[axis];
+  state->iab.b     = h->st.i_beta[axis];
+  state->vab.a     = alpha;
+  state->vab.b     = beta;
+  state->idq.d     = h->st.i_d[axis];
+  state->idq.q     = h->st.i_q[axis];
+  state->vdq.d     = h->st.v_d[axis];
+  state->vdq.q     = h->st.v_q[axis];
+  state->mod_scale = h->st.mod_scale[axis];
+}
@@ -66,6 +66,12 @@ int foc_velocity_init_f32(FAR foc_velocity_f32_t *h,
 
   memset(h, 0, sizeof(foc_velocity_f32_t));
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  /* Reset execution time statistics */
+
+  foc_perf_init(&h->perf);
+#endif
+
   /* Connect ops */
 
   h->ops = ops;
@@ -185,11 +191,23 @@ int foc_velocity_run_f32(FAR foc_velocity_f32_t *h,
                          FAR struct foc_velocity_in_f32_s *in,
                          FAR struct foc_velocity_out_f32_s *out)
 {
+  int ret = OK;
+
   DEBUGASSERT(h);
   DEBUGASSERT(in);
   DEBUGASSERT(out);
 
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_start(&h->perf);
+#endif
+
   /* Run velocity handler */
 
-  return h->ops->run(h, in, out);
+  ret = h->ops->run(h, in, out);
+
+#ifdef CONFIG_INDUSTRY_FOC_PERF
+  foc_perf_end(&h->perf);
+#endif
+
+  return ret;
 }
@@ -0,0 +1,235 @@
+/****************************************************************************
+ * apps/industry/foc/foc_perf.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <nuttx/arch.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include "industry/foc/foc_log.h"
+#include "industry/foc/foc_perf.h"
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: foc_perf_init
+ *
+ * Description:
+ *   Initialize (or reset) the execution time statistics
+ *
+ * Input Parameter:
+ *   perf - pointer to statistics data
+ *
+ ****************************************************************************/
+
+void foc_perf_init(FAR struct foc_perf_s *perf)
+{
+  uint64_t bin = 0;
+
+  DEBUGASSERT(perf);
+
+  memset(perf, 0, sizeof(struct foc_perf_s));
+
+  perf->freq       = up_perf_getfreq();
+  perf->exec_min   = UINT32_MAX;
+  perf->period_min = UINT32_MAX;
+
+  /* Get the histogram bin width in perf counter ticks */
+
+  bin = (uint64_t)CONFIG_INDUSTRY_FOC_PERF_HIST_WIDTH * perf->freq;
+  bin = bin / 1000000000;
+
+  perf->bin = (bin > 0) ? (uint32_t)bin : 1;
+}
+
+/****************************************************************************
+ * Name: foc_perf_start
+ *
+ * Description:
+ *   Mark the start of the measured stage.  The time from the previous
+ *   start is recorded as the stage period.
+ *
+ * Input Parameter:
+ *   perf - pointer to statistics data
+ *
+ ****************************************************************************/
+
+void foc_perf_start(FAR struct foc_perf_s *perf)
+{
+  uint32_t now = (uint32_t)up_perf_gettime();
+
+  if (perf->count > 0)
+    {
+      perf->period = now - perf->start;
+
+      if (perf->period < perf->period_min)
+        {
+          perf->period_min = perf->period;
+        }
+
+      if (perf->period > perf->period_max)
+        {
+          perf->period_max = perf->period;
+        }
+    }
+
+  perf->start = now;
+}
+
+/****************************************************************************
+ * Name: foc_perf_end
+ *
+ * Description:
+ *   Mark the end of the measured stage and update statistics
+ *
+ * Input Parameter:
+ *   perf - pointer to statistics data
+ *
+ ****************************************************************************/
+
+void foc_perf_end(FAR struct foc_perf_s *perf)
+{
+  uint32_t bin = 0;
+
+  perf->exec = (uint32_t)up_perf_gettime() - perf->start;
+
+  if (perf->exec < perf->exec_min)
+    {
+      perf->exec_min = perf->exec;
+    }
+
+  if (perf->exec > perf->exec_max)
+    {
+      perf->exec_max = perf->exec;
+    }
+
+  perf->exec_sum += perf->exec;
+  perf->count    += 1;
+
+  /* Update histogram */
+
+  bin = perf->exec / perf->bin;
+  if (bin >= FOC_PERF_HIST_BINS)
+    {
+      bin = FOC_PERF_HIST_BINS - 1;
+    }
+
+  perf->hist[bin] += 1;
+}
+
+/****************************************************************************
+ * Name: foc_perf_ns
+ *
+ * Description:
+ *   Convert perf counter ticks to nanoseconds
+ *
+ * Input Parameter:
+ *   perf  - pointer to statistics data
+ *   ticks - perf counter ticks
+ *
+ ****************************************************************************/
+
+uint32_t foc_perf_ns(FAR struct foc_perf_s *perf, uint32_t ticks)
+{
+  DEBUGASSERT(perf);
+
+  if (perf->freq == 0)
+    {
+      return 0;
+    }
+
+  return (uint32_t)((uint64_t)ticks * 1000000000 / perf->freq);
+}
+
+/****************************************************************************
+ * Name: foc_perf_print
+ *
+ * Description:
+ *   Print the execution time statistics summary
+ *
+ * Input Parameter:
+ *   perf - pointer to statistics data
+ *   name - stage name
+ *
+ ****************************************************************************/
+
+void foc_perf_print(FAR struct foc_perf_s *perf, FAR const char *name)
+{
+  uint32_t avg = 0;
+  int      i   = 0;
+
+  DEBUGASSERT(perf);
+  DEBUGASSERT(name);
+
+  if (perf->count == 0)
+    {
+      FOCLIBLOG("%s: no samples\n", name);
+      return;
+    }
+
+  avg = (uint32_t)(perf->exec_sum / perf->count);
+
+  FOCLIBLOG("%s: samples %" PRIu32 "\n", name, perf->count);
+  FOCLIBLOG("  exec [ns]:   min %" PRIu32 " avg %" PRIu32
+            " max %" PRIu32 "\n",
+            foc_perf_ns(perf, perf->exec_min),
+            foc_perf_ns(perf, avg),
+            foc_perf_ns(perf, perf->exec_max));
+
+  if (perf->count > 1)
+    {
+      FOCLIBLOG("  period [ns]: min %" PRIu32 " max %" PRIu32
+                " jitter %" PRIu32 "\n",
+                foc_perf_ns(perf, perf->period_min),
+                foc_perf_ns(perf, perf->period_max),
+                foc_perf_ns(perf, perf->period_max - perf->period_min));
+    }
+
+  FOCLIBLOG("  histogram [ns]:\n");
+
+  for (i = 0; i < FOC_PERF_HIST_BINS; i += 1)
+    {
+      if (perf->hist[i] == 0)
+        {
+          continue;
+        }
+
+      if (i < FOC_PERF_HIST_BINS - 1)
+        {
+          FOCLIBLOG("    < %8" PRIu32 ": %" PRIu32 "\n",
+                    foc_perf_ns(perf, perf->bin * (i + 1)),
+                    perf->hist[i]);
+        }
+      else
+        {
+          FOCLIBLOG("    >=%8" PRIu32 ": %" PRIu32 "\n",
+                    foc_perf_ns(perf, perf->bin * i),
+                    perf->hist[i]);
+        }
+    }
+}
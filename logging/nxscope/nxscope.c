@@ -30,6 +30,10 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+#  include <lzf.h>
+#endif
+
 #include <logging/nxscope/nxscope.h>
 
 #include "nxscope_internals.h"
@@ -205,7 +209,7 @@ static int nxscope_enable_req(FAR struct nxscope_s *s,
               goto errout;
             }
 
-          if (set->chan > s->cmninfo.chmax)
+          if (set->chan >= s->cmninfo.chmax)
             {
               ret = -EINVAL;
               goto errout;
@@ -331,7 +335,7 @@ static int nxscope_div_req(FAR struct nxscope_s *s,
               goto errout;
             }
 
-          if (set->chan > s->cmninfo.chmax)
+          if (set->chan >= s->cmninfo.chmax)
             {
               ret = -EINVAL;
               goto errout;
@@ -401,6 +405,94 @@ errout:
 }
 #endif
 
+/****************************************************************************
+ * Name: nxscope_stream_reset
+ *
+ * NOTE: This function assumes that we have exclusive access to the nxscope
+ *       instance
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+static void nxscope_stream_reset(FAR struct nxscope_s *s, int idx)
+{
+  FAR struct nxscope_dbuf_s *db = &s->dbuf[idx];
+
+  DEBUGASSERT(s);
+
+  /* Offset for hdr + 1 byte for flags */
+
+  db->buf[s->proto_stream->hdrlen] = 0;
+  atomic_store(&db->flags, 0);
+  atomic_store(&db->i, s->proto_stream->hdrlen + 1);
+}
+#else
+static void nxscope_stream_reset(FAR struct nxscope_s *s)
+{
+  DEBUGASSERT(s);
+
+  /* Offset for hdr + 1 byte for flags */
+
+  s->stream_i = s->proto_stream->hdrlen + 1;
+
+  /* Reset flags */
+
+  s->streambuf[s->proto_stream->hdrlen] = 0;
+
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  /* Deltas start over in each frame */
+
+  if (s->encode & NXSCOPE_STREAM_FLAGS_DELTA)
+    {
+      s->streambuf[s->proto_stream->hdrlen] = NXSCOPE_STREAM_FLAGS_DELTA;
+      memset(s->delta_sync, 0, s->cmninfo.chmax);
+    }
+#endif
+}
+#endif
+
+#ifdef NXSCOPE_HAVE_ENCODE
+/****************************************************************************
+ * Name: nxscope_encode_set
+ *
+ * NOTE: This function assumes that we have exclusive access to the nxscope
+ *       instance
+ *
+ ****************************************************************************/
+
+static void nxscope_encode_set(FAR struct nxscope_s *s, uint8_t flags)
+{
+  uint8_t encode = 0;
+
+  DEBUGASSERT(s);
+
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  if (flags & NXSCOPE_START_FLAGS_DELTA)
+    {
+      encode |= NXSCOPE_STREAM_FLAGS_DELTA;
+    }
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+  if (flags & NXSCOPE_START_FLAGS_LZF)
+    {
+      encode |= NXSCOPE_STREAM_FLAGS_LZF;
+    }
+#endif
+
+  if (encode != s->encode)
+    {
+      s->encode = encode;
+
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+      /* Samples already buffered were encoded the old way */
+
+      nxscope_stream_reset(s);
+#endif
+    }
+}
+#endif
+
 /****************************************************************************
  * Name: nxscope_start_set
  *
@@ -445,57 +537,95 @@ static int nxscope_start_req(FAR struct nxscope_s *s,
   DEBUGASSERT(s);
   DEBUGASSERT(data);
 
-  if (data->start == 0 || data->start == 1)
+  if ((data->start & ~NXSCOPE_START_FLAGS_ALL) == 0)
     {
       _info("data->start=%d\n", data->start);
-      ret = nxscope_start_set(s, data->start);
+
+#ifdef NXSCOPE_HAVE_ENCODE
+      /* Encoding bits not reported in cmninfo are ignored */
+
+      nxscope_encode_set(s, data->start);
+#endif
+
+      ret = nxscope_start_set(s, data->start & NXSCOPE_START_FLAGS_START);
     }
 
   return ret;
 }
 
 /****************************************************************************
- * Name: nxscope_stream_reset
+ * Name: nxscope_stream_empty
  *
  * NOTE: This function assumes that we have exclusive access to the nxscope
  *       instance
  *
  ****************************************************************************/
 
-static void nxscope_stream_reset(FAR struct nxscope_s *s)
+static bool nxscope_stream_empty(FAR struct nxscope_s *s)
 {
-  DEBUGASSERT(s);
-
-  /* Offset for hdr + 1 byte for flags */
-
-  s->stream_i = s->proto_stream->hdrlen + 1;
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  FAR struct nxscope_dbuf_s *db = NULL;
+#endif
 
-  /* Reset flags */
+  DEBUGASSERT(s);
 
-  s->streambuf[s->proto_stream->hdrlen] = 0;
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  db = &s->dbuf[atomic_load(&s->dbuf_active)];
+  if (atomic_load(&db->i) > s->proto_stream->hdrlen + 1)
+#else
+  if (s->stream_i > s->proto_stream->hdrlen + 1)
+#endif
+    {
+      return false;
+    }
+  else
+    {
+      return true;
+    }
 }
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
 /****************************************************************************
- * Name: nxscope_stream_empty
+ * Name: nxscope_stream_swap
+ *
+ * Description:
+ *   Make the other stream buffer active and prepare the retired one to be
+ *   sent.  Producers that still write to the retired buffer are waited
+ *   for here, in the sender context, so the put interfaces never block.
  *
  * NOTE: This function assumes that we have exclusive access to the nxscope
  *       instance
  *
  ****************************************************************************/
 
-static bool nxscope_stream_empty(FAR struct nxscope_s *s)
+static void nxscope_stream_swap(FAR struct nxscope_s *s)
 {
+  FAR struct nxscope_dbuf_s *db  = NULL;
+  unsigned int               idx = 0;
+
   DEBUGASSERT(s);
 
-  if (s->stream_i > s->proto_stream->hdrlen + 1)
-    {
-      return false;
-    }
-  else
+  /* The other buffer was reset when it was sent */
+
+  idx = atomic_fetch_xor(&s->dbuf_active, 1);
+  db  = &s->dbuf[idx];
+
+  /* Let the producers that started before the swap finish their samples.
+   * Block rather than poll, so that a producer with a lower priority than
+   * the sender gets to run.
+   */
+
+  while (atomic_load(&db->writers) > 0)
     {
-      return true;
+      sem_wait(&s->dbuf_done);
     }
+
+  db->buf[s->proto_stream->hdrlen] = atomic_load(&db->flags);
+
+  s->dbuf_send  = idx;
+  s->dbuf_sendi = atomic_load(&db->i);
 }
+#endif
 
 #ifdef CONFIG_LOGGING_NXSCOPE_ACKFRAMES
 /****************************************************************************
@@ -768,6 +898,18 @@ int nxscope_init(FAR struct nxscope_s *s, FAR struct nxscope_cfg_s *cfg)
 
   DEBUGASSERT(cfg->streambuf_len > 0);
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  for (i = 0; i < 2; i++)
+    {
+      s->dbuf[i].buf = zalloc(cfg->streambuf_len);
+      if (s->dbuf[i].buf == NULL)
+        {
+          ret = -errno;
+          _err("ERROR: dbuf zalloc failed %d\n", ret);
+          goto errout;
+        }
+    }
+#else
   s->streambuf = zalloc(cfg->streambuf_len);
   if (s->streambuf == NULL)
     {
@@ -775,6 +917,7 @@ int nxscope_init(FAR struct nxscope_s *s, FAR struct nxscope_cfg_s *cfg)
       _err("ERROR: streambuf zalloc failed %d\n", ret);
       goto errout;
     }
+#endif
 
   s->streambuf_len = cfg->streambuf_len;
 
@@ -831,6 +974,32 @@ int nxscope_init(FAR struct nxscope_s *s, FAR struct nxscope_cfg_s *cfg)
       goto errout;
     }
 
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  /* Allocate memory for delta encoding history */
+
+  s->delta_prev = zalloc(cfg->channels * sizeof(FAR int64_t *));
+  s->delta_sync = zalloc(cfg->channels);
+  if (s->delta_prev == NULL || s->delta_sync == NULL)
+    {
+      ret = -ENOMEM;
+      _err("ERROR: delta zalloc failed %d\n", ret);
+      goto errout;
+    }
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+  /* Allocate memory for LZF compression */
+
+  s->lzfbuf   = zalloc(LZF_MAX_HDR_SIZE + cfg->streambuf_len);
+  s->lzfstate = zalloc(sizeof(lzf_state_t));
+  if (s->lzfbuf == NULL || s->lzfstate == NULL)
+    {
+      ret = -ENOMEM;
+      _err("ERROR: lzf zalloc failed %d\n", ret);
+      goto errout;
+    }
+#endif
+
 #ifdef CONFIG_LOGGING_NXSCOPE_CRICHANNELS
   /* Allocate memory for critical channels buffer */
 
@@ -855,7 +1024,16 @@ int nxscope_init(FAR struct nxscope_s *s, FAR struct nxscope_cfg_s *cfg)
 
   /* Reset stream buffer */
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  nxscope_stream_reset(s, 0);
+  nxscope_stream_reset(s, 1);
+  atomic_store(&s->dbuf_active, 0);
+
+  sem_init(&s->dbuf_done, 0, 0);
+  sem_setprotocol(&s->dbuf_done, SEM_PRIO_NONE);
+#else
   nxscope_stream_reset(s);
+#endif
 
   /* Initialize info data */
 
@@ -868,6 +1046,12 @@ int nxscope_init(FAR struct nxscope_s *s, FAR struct nxscope_cfg_s *cfg)
 #ifdef CONFIG_LOGGING_NXSCOPE_ACKFRAMES
   s->cmninfo.flags |= NXSCOPE_FLAGS_ACK_SUPPORT;
 #endif
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  s->cmninfo.flags |= NXSCOPE_FLAGS_DELTA_SUPPORT;
+#endif
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+  s->cmninfo.flags |= NXSCOPE_FLAGS_LZF_SUPPORT;
+#endif
 
   s->cmninfo.rx_padding = cfg->rx_padding;
 
@@ -882,10 +1066,20 @@ int nxscope_init(FAR struct nxscope_s *s, FAR struct nxscope_cfg_s *cfg)
 
 errout:
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  for (i = 0; i < 2; i++)
+    {
+      if (s->dbuf[i].buf != NULL)
+        {
+          free(s->dbuf[i].buf);
+        }
+    }
+#else
   if (s->streambuf != NULL)
     {
       free(s->streambuf);
     }
+#endif
 
   if (s->chinfo != NULL)
     {
@@ -909,6 +1103,30 @@ errout:
       free(s->txbuf);
     }
 
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  if (s->delta_prev != NULL)
+    {
+      free(s->delta_prev);
+    }
+
+  if (s->delta_sync != NULL)
+    {
+      free(s->delta_sync);
+    }
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+  if (s->lzfbuf != NULL)
+    {
+      free(s->lzfbuf);
+    }
+
+  if (s->lzfstate != NULL)
+    {
+      free(s->lzfstate);
+    }
+#endif
+
 #ifdef CONFIG_LOGGING_NXSCOPE_CRICHANNELS
   if (s->cribuf != NULL)
     {
@@ -932,6 +1150,10 @@ errout:
 
 void nxscope_deinit(FAR struct nxscope_s *s)
 {
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  int i = 0;
+#endif
+
   DEBUGASSERT(s);
 
   /* Free mutex */
@@ -940,10 +1162,24 @@ void nxscope_deinit(FAR struct nxscope_s *s)
 
   /* Free allocated memory */
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  sem_destroy(&s->dbuf_done);
+
+  if (s->dbuf[0].buf != NULL)
+    {
+      free(s->dbuf[0].buf);
+    }
+
+  if (s->dbuf[1].buf != NULL)
+    {
+      free(s->dbuf[1].buf);
+    }
+#else
   if (s->streambuf != NULL)
     {
       free(s->streambuf);
     }
+#endif
 
   if (s->chinfo != NULL)
     {
@@ -968,6 +1204,35 @@ void nxscope_deinit(FAR struct nxscope_s *s)
     {
       free(s->txbuf);
     }
+
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  if (s->delta_prev != NULL)
+    {
+      for (i = 0; i < s->cmninfo.chmax; i++)
+        {
+          free(s->delta_prev[i]);
+        }
+
+      free(s->delta_prev);
+    }
+
+  if (s->delta_sync != NULL)
+    {
+      free(s->delta_sync);
+    }
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+  if (s->lzfbuf != NULL)
+    {
+      free(s->lzfbuf);
+    }
+
+  if (s->lzfstate != NULL)
+    {
+      free(s->lzfstate);
+    }
+#endif
 }
 
 /****************************************************************************
@@ -1035,6 +1300,36 @@ int nxscope_stream(FAR struct nxscope_s *s)
       goto errout;
     }
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  /* A retired buffer that failed to send is retried first */
+
+  if (!s->stream_retry)
+    {
+      /* Do nothing if no data */
+
+      if (nxscope_stream_empty(s))
+        {
+          goto errout;
+        }
+
+      /* Retire the active buffer */
+
+      nxscope_stream_swap(s);
+    }
+
+  /* Send stream data */
+
+  ret = nxscope_stream_send(s, s->dbuf[s->dbuf_send].buf, &s->dbuf_sendi);
+  if (ret < 0)
+    {
+      _err("ERROR: nxscope_stream_send failed %d\n", ret);
+      goto errout;
+    }
+
+  /* Reset stream buffer */
+
+  nxscope_stream_reset(s, s->dbuf_send);
+#else
   /* Do nothing if no data */
 
   if (nxscope_stream_empty(s))
@@ -1054,6 +1349,7 @@ int nxscope_stream(FAR struct nxscope_s *s)
   /* Reset stream buffer */
 
   nxscope_stream_reset(s);
+#endif
 
 errout:
   nxscope_unlock(s);
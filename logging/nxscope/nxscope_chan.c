@@ -93,12 +93,107 @@ int g_type_size[] =
  *
  ****************************************************************************/
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+static void nxscope_stream_overflow(FAR struct nxscope_dbuf_s *db)
+{
+  DEBUGASSERT(db);
+
+  atomic_fetch_or(&db->flags, NXSCOPE_STREAM_FLAGS_OVERFLOW);
+}
+#else
 static void nxscope_stream_overflow(FAR struct nxscope_s *s)
 {
   DEBUGASSERT(s);
 
   s->streambuf[s->proto_stream->hdrlen] |= NXSCOPE_STREAM_FLAGS_OVERFLOW;
 }
+#endif
+
+/****************************************************************************
+ * Name: nxscope_sample_len
+ ****************************************************************************/
+
+static size_t nxscope_sample_len(uint8_t type, uint8_t d, uint8_t mlen,
+                                 bool delta)
+{
+  union nxscope_chinfo_type_u utype;
+  size_t                      type_size = 0;
+
+  /* Get utype */
+
+  utype.u8 = type;
+
+#ifdef CONFIG_LOGGING_NXSCOPE_USERTYPES
+  if (type >= NXSCOPE_TYPE_USER)
+    {
+      type_size = 1;
+    }
+  else
+#endif
+    {
+      type_size = g_type_size[utype.s.dtype];
+    }
+
+  /* A varint needs up to one byte more per 7 bits of data */
+
+  if (delta)
+    {
+      type_size = (type_size * 8 + 6) / 7;
+    }
+
+  /* Channel id + vector data + metadata */
+
+  return 1 + type_size * d + mlen;
+}
+
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+/****************************************************************************
+ * Name: nxscope_delta_en
+ *
+ * Description:
+ *   Check if samples of a given type are delta-encoded.  Only integer and
+ *   fixed-point data of buffered channels is.
+ *
+ ****************************************************************************/
+
+static bool nxscope_delta_en(FAR struct nxscope_s *s, uint8_t type)
+{
+  if (!(s->encode & NXSCOPE_STREAM_FLAGS_DELTA))
+    {
+      return false;
+    }
+
+  switch (type)
+    {
+      case NXSCOPE_TYPE_UINT8:
+      case NXSCOPE_TYPE_INT8:
+      case NXSCOPE_TYPE_UINT16:
+      case NXSCOPE_TYPE_INT16:
+      case NXSCOPE_TYPE_B8:
+      case NXSCOPE_TYPE_UB8:
+      case NXSCOPE_TYPE_UINT32:
+      case NXSCOPE_TYPE_INT32:
+      case NXSCOPE_TYPE_B16:
+      case NXSCOPE_TYPE_UB16:
+#ifdef CONFIG_HAVE_LONG_LONG
+      case NXSCOPE_TYPE_UINT64:
+      case NXSCOPE_TYPE_INT64:
+      case NXSCOPE_TYPE_B32:
+      case NXSCOPE_TYPE_UB32:
+#endif
+        {
+          return true;
+        }
+
+      default:
+        {
+          return false;
+        }
+    }
+}
+#else
+#  define nxscope_delta_en(s, type) (false)
+#endif
 
 /****************************************************************************
  * Name: nxscope_ch_validate
@@ -107,10 +202,8 @@ static void nxscope_stream_overflow(FAR struct nxscope_s *s)
 static int nxscope_ch_validate(FAR struct nxscope_s *s, uint8_t ch,
                                uint8_t type, uint8_t d, uint8_t mlen)
 {
-  union nxscope_chinfo_type_u utype;
-  size_t                      next_i    = 0;
-  int                         ret       = OK;
-  size_t                      type_size = 0;
+  size_t next_i = 0;
+  int    ret    = OK;
 
   DEBUGASSERT(s);
 
@@ -135,7 +228,7 @@ static int nxscope_ch_validate(FAR struct nxscope_s *s, uint8_t ch,
 #ifdef CONFIG_DEBUG_FEATURES
   /* Validate channel */
 
-  if (ch > s->cmninfo.chmax)
+  if (ch >= s->cmninfo.chmax)
     {
       _err("ERROR: invalid channel %d\n", ch);
       ret = -EINVAL;
@@ -182,28 +275,14 @@ static int nxscope_ch_validate(FAR struct nxscope_s *s, uint8_t ch,
     }
 #endif
 
-  /* Get utype */
-
-  utype.u8 = type;
-
   /* Check buffer size */
 
-#ifdef CONFIG_LOGGING_NXSCOPE_USERTYPES
-  if (type >= NXSCOPE_TYPE_USER)
-    {
-      type_size = 1;
-    }
-  else
-#endif
-    {
-      type_size = g_type_size[utype.s.dtype];
-    }
-
 #ifdef CONFIG_LOGGING_NXSCOPE_CRICHANNELS
-  if (utype.s.cri)
+  if (NXSCOPE_IS_CRICHAN(type))
     {
 #  ifdef CONFIG_DEBUG_FEATURES
-      next_i = (s->proto_stream->hdrlen + 1 + type_size * d + mlen +
+      next_i = (s->proto_stream->hdrlen +
+                nxscope_sample_len(type, d, mlen, false) +
                 s->proto_stream->footlen);
 
       /* Verify the size of the critical channels buffer  */
@@ -226,7 +305,11 @@ static int nxscope_ch_validate(FAR struct nxscope_s *s, uint8_t ch,
     }
 #endif
 
-  next_i = (s->stream_i + 1 + type_size * d + mlen +
+#ifndef CONFIG_LOGGING_NXSCOPE_STREAMDB
+  /* In the double-buffered mode space is reserved by nxscope_put_dbuf() */
+
+  next_i = (s->stream_i +
+            nxscope_sample_len(type, d, mlen, nxscope_delta_en(s, type)) +
             s->proto_stream->footlen);
 
   if (next_i > s->streambuf_len)
@@ -236,6 +319,9 @@ static int nxscope_ch_validate(FAR struct nxscope_s *s, uint8_t ch,
       ret = -ENOBUFS;
       goto errout;
     }
+#else
+  UNUSED(next_i);
+#endif
 
 errout:
   return ret;
@@ -439,6 +525,213 @@ static void nxscope_put_sample(FAR uint8_t *buff, FAR size_t *buff_i,
   *buff_i += i;
 }
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+/****************************************************************************
+ * Name: nxscope_dbuf_release
+ *
+ * Description:
+ *   Leave a stream buffer.  The last producer to leave a retired buffer
+ *   wakes up nxscope_stream(), which waits for it to complete.
+ *
+ ****************************************************************************/
+
+static void nxscope_dbuf_release(FAR struct nxscope_s *s, unsigned int idx)
+{
+  if (atomic_fetch_sub(&s->dbuf[idx].writers, 1) == 1 &&
+      atomic_load(&s->dbuf_active) != idx)
+    {
+      sem_post(&s->dbuf_done);
+    }
+}
+
+/****************************************************************************
+ * Name: nxscope_put_dbuf
+ *
+ * Description:
+ *   Put a sample on the active stream buffer without taking the nxscope
+ *   lock.  Space is reserved with an atomic update of the buffer cursor,
+ *   so concurrent producers never overwrite each other.  The writers
+ *   counter tells nxscope_stream() when a retired buffer is complete.
+ *
+ ****************************************************************************/
+
+static int nxscope_put_dbuf(FAR struct nxscope_s *s, uint8_t type,
+                            uint8_t ch, FAR void *val, uint8_t d,
+                            FAR uint8_t *meta, uint8_t mlen)
+{
+  FAR struct nxscope_dbuf_s *db   = NULL;
+  unsigned int               idx  = 0;
+  size_t                     len  = 0;
+  size_t                     i    = 0;
+  int                        ret  = OK;
+
+  DEBUGASSERT(s);
+
+  /* Validate data */
+
+  ret = nxscope_ch_validate(s, ch, type, d, mlen);
+  if (ret != OK)
+    {
+      return ret;
+    }
+
+  /* Register as a writer of the active buffer.  If the buffers were
+   * swapped in the meantime, try again with the new active buffer.
+   */
+
+  for (; ; )
+    {
+      idx = atomic_load(&s->dbuf_active);
+      db  = &s->dbuf[idx];
+
+      atomic_fetch_add(&db->writers, 1);
+      if (atomic_load(&s->dbuf_active) == idx)
+        {
+          break;
+        }
+
+      nxscope_dbuf_release(s, idx);
+    }
+
+  /* Reserve space for the sample */
+
+  len = nxscope_sample_len(type, d, mlen, false);
+  i   = atomic_load(&db->i);
+
+  do
+    {
+      if (i + len + s->proto_stream->footlen > s->streambuf_len)
+        {
+          _err("ERROR: no space for data %zu\n", i);
+          nxscope_stream_overflow(db);
+          ret = -ENOBUFS;
+          goto errout;
+        }
+    }
+  while (!atomic_compare_exchange_weak(&db->i, &i, i + len));
+
+  /* Put sample on the reserved space */
+
+  nxscope_put_sample(db->buf, &i, type, ch, val, d, meta, mlen);
+
+errout:
+  nxscope_dbuf_release(s, idx);
+
+  return ret;
+}
+#endif
+
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+/****************************************************************************
+ * Name: nxscope_delta_get
+ ****************************************************************************/
+
+static int64_t nxscope_delta_get(uint8_t type, FAR void *val, int i)
+{
+  switch (type)
+    {
+      case NXSCOPE_TYPE_UINT8:
+        {
+          return ((FAR uint8_t *)val)[i];
+        }
+
+      case NXSCOPE_TYPE_INT8:
+        {
+          return ((FAR int8_t *)val)[i];
+        }
+
+      case NXSCOPE_TYPE_UINT16:
+      case NXSCOPE_TYPE_UB8:
+        {
+          return ((FAR uint16_t *)val)[i];
+        }
+
+      case NXSCOPE_TYPE_INT16:
+      case NXSCOPE_TYPE_B8:
+        {
+          return ((FAR int16_t *)val)[i];
+        }
+
+      case NXSCOPE_TYPE_UINT32:
+      case NXSCOPE_TYPE_UB16:
+        {
+          return ((FAR uint32_t *)val)[i];
+        }
+
+      case NXSCOPE_TYPE_INT32:
+      case NXSCOPE_TYPE_B16:
+        {
+          return ((FAR int32_t *)val)[i];
+        }
+
+      default:
+        {
+          /* 64-bit data, the host wraps the sum the same way */
+
+          return ((FAR int64_t *)val)[i];
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: nxscope_put_delta_sample
+ *
+ * NOTE: This function assumes that we have exclusive access to the nxscope
+ *       stream buffer
+ *
+ ****************************************************************************/
+
+static void nxscope_put_delta_sample(FAR struct nxscope_s *s,
+                                     FAR uint8_t *buff, FAR size_t *buff_i,
+                                     uint8_t type, uint8_t ch, FAR void *val,
+                                     uint8_t d, FAR uint8_t *meta,
+                                     uint8_t mlen)
+{
+  FAR int64_t *prev = s->delta_prev[ch];
+  uint64_t     diff = 0;
+  uint64_t     zz   = 0;
+  int64_t      v    = 0;
+  int          i    = 0;
+
+  DEBUGASSERT(prev != NULL || d == 0);
+  DEBUGASSERT(val);
+
+  /* Channel ID */
+
+  buff[(*buff_i)++] = ch;
+
+  /* Zig-zag varint of the difference to the previous sample */
+
+  for (i = 0; i < d; i++)
+    {
+      v    = nxscope_delta_get(type, val, i);
+      diff = (uint64_t)v;
+
+      if (s->delta_sync[ch])
+        {
+          diff -= (uint64_t)prev[i];
+        }
+
+      prev[i] = v;
+
+      zz = (diff << 1) ^ (uint64_t)((int64_t)diff >> 63);
+      while (zz >= 0x80)
+        {
+          buff[(*buff_i)++] = (zz & 0x7f) | 0x80;
+          zz >>= 7;
+        }
+
+      buff[(*buff_i)++] = zz;
+    }
+
+  s->delta_sync[ch] = 1;
+
+  /* Meta data */
+
+  *buff_i += nxscope_put_meta(&buff[*buff_i], meta, mlen);
+}
+#endif
+
 /****************************************************************************
  * Name: nxscope_put_common_m
  ****************************************************************************/
@@ -457,6 +750,17 @@ static int nxscope_put_common_m(FAR struct nxscope_s *s, uint8_t type,
 
   DEBUGASSERT(s);
 
+#ifdef CONFIG_LOGGING_NXSCOPE_STREAMDB
+#  ifdef CONFIG_LOGGING_NXSCOPE_CRICHANNELS
+  if (!NXSCOPE_IS_CRICHAN(type))
+#  endif
+    {
+      /* Buffered samples never wait for the stream interface */
+
+      return nxscope_put_dbuf(s, type, ch, val, d, meta, mlen);
+    }
+#endif
+
 #ifndef CONFIG_LOGGING_NXSCOPE_DISABLE_PUTLOCK
   nxscope_lock(s);
 #endif
@@ -491,7 +795,17 @@ static int nxscope_put_common_m(FAR struct nxscope_s *s, uint8_t type,
 
   /* Put sample on buffer */
 
-  nxscope_put_sample(buff, buff_i, type, ch, val, d, meta, mlen);
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  if (buff == s->streambuf && nxscope_delta_en(s, type))
+    {
+      nxscope_put_delta_sample(s, buff, buff_i, type, ch, val, d,
+                               meta, mlen);
+    }
+  else
+#endif
+    {
+      nxscope_put_sample(buff, buff_i, type, ch, val, d, meta, mlen);
+    }
 
 #ifdef CONFIG_LOGGING_NXSCOPE_CRICHANNELS
   if (utype.s.cri)
@@ -543,7 +857,7 @@ int nxscope_chan_init(FAR struct nxscope_s *s, uint8_t ch, FAR char *name,
   DEBUGASSERT(s);
   DEBUGASSERT(name);
 
-  if (ch > s->cmninfo.chmax)
+  if (ch >= s->cmninfo.chmax)
     {
       _err("ERROR: invalid channel %d\n", ch);
       ret = -EINVAL;
@@ -561,6 +875,27 @@ int nxscope_chan_init(FAR struct nxscope_s *s, uint8_t ch, FAR char *name,
     }
 #endif
 
+#ifdef CONFIG_LOGGING_NXSCOPE_DELTA
+  /* Allocate delta encoding history for the new vector dimension */
+
+  free(s->delta_prev[ch]);
+  s->delta_prev[ch] = NULL;
+  s->delta_sync[ch] = 0;
+
+  if (vdim > 0)
+    {
+      s->delta_prev[ch] = zalloc(vdim * sizeof(int64_t));
+    }
+
+  if (vdim > 0 && s->delta_prev[ch] == NULL)
+    {
+      _err("ERROR: delta_prev zalloc failed ch=%d\n", ch);
+      ret = -ENOMEM;
+      nxscope_unlock(s);
+      goto errout;
+    }
+#endif
+
   /* Reset channel data */
 
   memset(&s->chinfo[ch], 0, sizeof(struct nxscope_chinfo_s));
@@ -599,7 +934,7 @@ int nxscope_chan_en(FAR struct nxscope_s *s, uint8_t ch, bool en)
 
   nxscope_lock(s);
 
-  if (ch > s->cmninfo.chmax)
+  if (ch >= s->cmninfo.chmax)
     {
       _err("ERROR: invalid channel %d\n", ch);
       ret = -EINVAL;
@@ -647,7 +982,7 @@ int nxscope_chan_div(FAR struct nxscope_s *s, uint8_t ch, uint8_t div)
 
   nxscope_lock(s);
 
-  if (ch > s->cmninfo.chmax)
+  if (ch >= s->cmninfo.chmax)
     {
       _err("ERROR: invalid channel %d\n", ch);
       ret = -EINVAL;
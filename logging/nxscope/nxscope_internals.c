@@ -28,11 +28,78 @@
 #include <debug.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+#  include <lzf.h>
+#endif
 
 #include <logging/nxscope/nxscope.h>
 
 #include "nxscope_internals.h"
 
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Smaller stream payloads are not worth compressing */
+
+#define NXSCOPE_LZF_MINLEN (32)
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+/****************************************************************************
+ * Name: nxscope_stream_lzf
+ *
+ * Description:
+ *   Replace the samples data of a stream frame with a single LZF block.
+ *   The samples are copied to the scratch buffer first, so the compressed
+ *   block with its header can be written in place.  If the data does not
+ *   shrink, the frame is restored and sent uncompressed.
+ *
+ ****************************************************************************/
+
+static void nxscope_stream_lzf(FAR struct nxscope_s *s, FAR uint8_t *buff,
+                               FAR size_t *buff_i)
+{
+  FAR struct lzf_header_s *hdr   = NULL;
+  FAR uint8_t             *in    = NULL;
+  size_t                   start = 0;
+  size_t                   len   = 0;
+  size_t                   ret   = 0;
+
+  start = s->proto_stream->hdrlen + 1;
+  len   = *buff_i - start;
+
+  if (len < NXSCOPE_LZF_MINLEN)
+    {
+      return;
+    }
+
+  /* Leave room for an uncompressed block header in front of the input */
+
+  in = &s->lzfbuf[LZF_MAX_HDR_SIZE];
+  memcpy(in, &buff[start], len);
+
+  ret = lzf_compress(in, len, &buff[start + LZF_TYPE1_HDR_SIZE],
+                     len - LZF_TYPE1_HDR_SIZE - 1,
+                     *(FAR lzf_state_t *)s->lzfstate, &hdr);
+
+  if (ret > 0 && (FAR uint8_t *)hdr == &buff[start])
+    {
+      *buff_i = start + ret;
+      buff[start - 1] |= NXSCOPE_STREAM_FLAGS_LZF;
+    }
+  else
+    {
+      memcpy(&buff[start], in, len);
+    }
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -63,6 +130,13 @@ int nxscope_stream_send(FAR struct nxscope_s *s, FAR uint8_t *buff,
 
   if (!s->stream_retry)
     {
+#ifdef CONFIG_LOGGING_NXSCOPE_LZF
+      if (s->encode & NXSCOPE_STREAM_FLAGS_LZF)
+        {
+          nxscope_stream_lzf(s, buff, buff_i);
+        }
+
+#endif
       ret = PROTO_FRAME_FINAL(s, s->proto_stream,
                               NXSCOPE_HDRID_STREAM, buff, buff_i);
       if (ret < 0)
@@ -0,0 +1,423 @@
+/****************************************************************************
+ * apps/logging/nxscope/nxscope_ishm.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/mman.h>
+
+#include <assert.h>
+#include <debug.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <logging/nxscope/nxscope.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Rings start at a word aligned offset */
+
+#define NXSCOPE_SHM_ALIGN(x)  (((x) + 3) & ~3)
+
+/* Smallest ring size */
+
+#define NXSCOPE_SHM_MINSIZE   4
+
+/****************************************************************************
+ * Private Type Definition
+ ****************************************************************************/
+
+struct nxscope_intf_shm_s
+{
+  FAR struct nxscope_shm_cfg_s *cfg;
+  FAR struct nxscope_shm_hdr_s *hdr;
+  int                           fd;
+};
+
+/****************************************************************************
+ * Private Function Protototypes
+ ****************************************************************************/
+
+static int nxscope_shm_send(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len);
+static int nxscope_shm_recv(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct nxscope_intf_ops_s g_nxscope_shm_ops =
+{
+  nxscope_shm_send,
+  nxscope_shm_recv
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nxscope_shm_data
+ ****************************************************************************/
+
+static FAR uint8_t *nxscope_shm_data(FAR struct nxscope_shm_hdr_s *hdr,
+                                     FAR struct nxscope_shm_ring_s *ring)
+{
+  return (FAR uint8_t *)hdr + ring->off;
+}
+
+/****************************************************************************
+ * Name: nxscope_shm_pow2
+ *
+ * Description:
+ *   Return the largest power of two not greater than val.  Ring sizes are
+ *   powers of two so that the free-running head and tail counters stay
+ *   consistent with the data index when they wrap at 2^32.
+ *
+ ****************************************************************************/
+
+static uint32_t nxscope_shm_pow2(size_t val)
+{
+  uint32_t ret = NXSCOPE_SHM_MINSIZE;
+
+  while (ret <= val / 2 && ret < UINT32_MAX / 2 + 1)
+    {
+      ret <<= 1;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: nxscope_shm_send
+ *
+ * NOTE: the frame is written as a whole or not at all, so the consumer
+ *       never sees a partial frame.
+ *
+ ****************************************************************************/
+
+static int nxscope_shm_send(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len)
+{
+  FAR struct nxscope_intf_shm_s *priv  = NULL;
+  FAR struct nxscope_shm_ring_s *ring  = NULL;
+  FAR uint8_t                   *data  = NULL;
+  uint32_t                       head  = 0;
+  uint32_t                       tail  = 0;
+  uint32_t                       pos   = 0;
+  uint32_t                       chunk = 0;
+
+  DEBUGASSERT(intf);
+  DEBUGASSERT(intf->priv);
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_shm_s *)intf->priv;
+  ring = &priv->hdr->tx;
+  data = nxscope_shm_data(priv->hdr, ring);
+
+  /* Only the producer writes head */
+
+  head = ring->head;
+  tail = ring->tail;
+  atomic_thread_fence(memory_order_acquire);
+
+  if ((uint32_t)len > ring->size - (head - tail))
+    {
+      return -EAGAIN;
+    }
+
+  /* Copy data with wrap-around */
+
+  pos   = head & (ring->size - 1);
+  chunk = ring->size - pos;
+  if (chunk > (uint32_t)len)
+    {
+      chunk = len;
+    }
+
+  memcpy(&data[pos], buff, chunk);
+  memcpy(data, &buff[chunk], len - chunk);
+
+  /* Publish data before the new head */
+
+  atomic_thread_fence(memory_order_release);
+  ring->head = head + len;
+
+  return len;
+}
+
+/****************************************************************************
+ * Name: nxscope_shm_recv
+ ****************************************************************************/
+
+static int nxscope_shm_recv(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len)
+{
+  FAR struct nxscope_intf_shm_s *priv  = NULL;
+  FAR struct nxscope_shm_ring_s *ring  = NULL;
+  FAR uint8_t                   *data  = NULL;
+  uint32_t                       head  = 0;
+  uint32_t                       tail  = 0;
+  uint32_t                       pos   = 0;
+  uint32_t                       chunk = 0;
+  uint32_t                       avail = 0;
+
+  DEBUGASSERT(intf);
+  DEBUGASSERT(intf->priv);
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_shm_s *)intf->priv;
+  ring = &priv->hdr->rx;
+  data = nxscope_shm_data(priv->hdr, ring);
+
+  if (ring->size == 0)
+    {
+      return 0;
+    }
+
+  /* Only the consumer of the rx ring writes tail */
+
+  tail = ring->tail;
+  head = ring->head;
+  atomic_thread_fence(memory_order_acquire);
+
+  avail = head - tail;
+  if (avail > (uint32_t)len)
+    {
+      avail = len;
+    }
+
+  /* Copy data with wrap-around */
+
+  pos   = tail & (ring->size - 1);
+  chunk = ring->size - pos;
+  if (chunk > avail)
+    {
+      chunk = avail;
+    }
+
+  memcpy(buff, &data[pos], chunk);
+  memcpy(&buff[chunk], data, avail - chunk);
+
+  /* Release space after the data was read */
+
+  atomic_thread_fence(memory_order_release);
+  ring->tail = tail + avail;
+
+  return avail;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nxscope_shm_init
+ ****************************************************************************/
+
+int nxscope_shm_init(FAR struct nxscope_intf_s *intf,
+                     FAR struct nxscope_shm_cfg_s *cfg)
+{
+  FAR struct nxscope_intf_shm_s *priv = NULL;
+  FAR struct nxscope_shm_hdr_s  *hdr  = NULL;
+  FAR void                      *mem  = NULL;
+  size_t                         off  = 0;
+  uint32_t                       rxsz = 0;
+  int                            ret  = OK;
+
+  DEBUGASSERT(intf);
+  DEBUGASSERT(cfg);
+
+  /* The rx ring is rounded up to a power of two, the tx ring gets the
+   * largest power of two that fits in the rest of the region.
+   */
+
+  off  = NXSCOPE_SHM_ALIGN(sizeof(struct nxscope_shm_hdr_s));
+  rxsz = nxscope_shm_pow2(cfg->rxlen);
+  if (rxsz < cfg->rxlen)
+    {
+      rxsz <<= 1;
+    }
+
+  if (cfg->size < off + rxsz + NXSCOPE_SHM_MINSIZE)
+    {
+      _err("ERROR: invalid shm size %zu\n", cfg->size);
+      ret = -EINVAL;
+      goto errout;
+    }
+
+  /* Allocate priv data */
+
+  intf->priv = zalloc(sizeof(struct nxscope_intf_shm_s));
+  if (intf->priv == NULL)
+    {
+      _err("ERROR: intf->priv alloc failed %d\n", errno);
+      ret = -errno;
+      goto errout;
+    }
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_shm_s *)intf->priv;
+
+  /* Connect configuration */
+
+  priv->cfg = cfg;
+  priv->fd  = -1;
+
+  /* Connect ops */
+
+  intf->ops = &g_nxscope_shm_ops;
+
+  /* Get memory region */
+
+  mem = cfg->mem;
+  if (mem == NULL)
+    {
+#ifdef CONFIG_FS_SHMFS
+      DEBUGASSERT(cfg->name);
+
+      priv->fd = shm_open(cfg->name, O_RDWR | O_CREAT, 0666);
+      if (priv->fd < 0)
+        {
+          _err("ERROR: shm_open %s failed %d\n", cfg->name, errno);
+          ret = -errno;
+          goto errout;
+        }
+
+      ret = ftruncate(priv->fd, cfg->size);
+      if (ret < 0)
+        {
+          _err("ERROR: ftruncate failed %d\n", errno);
+          ret = -errno;
+          goto errout;
+        }
+
+      mem = mmap(NULL, cfg->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 priv->fd, 0);
+      if (mem == MAP_FAILED)
+        {
+          _err("ERROR: mmap failed %d\n", errno);
+          ret = -errno;
+          goto errout;
+        }
+#else
+      _err("ERROR: no shm region and no CONFIG_FS_SHMFS\n");
+      ret = -ENOSYS;
+      goto errout;
+#endif
+    }
+
+  priv->hdr = (FAR struct nxscope_shm_hdr_s *)mem;
+  hdr       = priv->hdr;
+
+  /* Initialize rings.  The rx ring is at the end of the region. */
+
+  hdr->magic   = 0;
+  hdr->rx.head = 0;
+  hdr->rx.tail = 0;
+  hdr->rx.size = rxsz;
+  hdr->rx.off  = cfg->size - rxsz;
+  hdr->tx.head = 0;
+  hdr->tx.tail = 0;
+  hdr->tx.size = nxscope_shm_pow2(hdr->rx.off - off);
+  hdr->tx.off  = off;
+
+  /* Rings are ready for the consumer */
+
+  atomic_thread_fence(memory_order_release);
+  hdr->magic = NXSCOPE_SHM_MAGIC;
+
+  /* Initialized */
+
+  intf->initialized = true;
+
+  return OK;
+
+errout:
+  if (priv != NULL)
+    {
+#ifdef CONFIG_FS_SHMFS
+      /* Remove the object created by shm_open() */
+
+      if (priv->fd >= 0)
+        {
+          close(priv->fd);
+          shm_unlink(cfg->name);
+        }
+#endif
+
+      free(priv);
+      intf->priv = NULL;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: nxscope_shm_deinit
+ ****************************************************************************/
+
+void nxscope_shm_deinit(FAR struct nxscope_intf_s *intf)
+{
+  FAR struct nxscope_intf_shm_s *priv = NULL;
+
+  DEBUGASSERT(intf);
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_shm_s *)intf->priv;
+
+  if (priv != NULL)
+    {
+      /* Mark region as not ready */
+
+      priv->hdr->magic = 0;
+
+#ifdef CONFIG_FS_SHMFS
+      /* Unmap and remove the object if we created it */
+
+      if (priv->fd >= 0)
+        {
+          munmap(priv->hdr, priv->cfg->size);
+          close(priv->fd);
+          shm_unlink(priv->cfg->name);
+        }
+#endif
+
+      free(priv);
+    }
+
+  /* Reset structure */
+
+  memset(intf, 0, sizeof(struct nxscope_intf_s));
+}
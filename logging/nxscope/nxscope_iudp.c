@@ -0,0 +1,286 @@
+/****************************************************************************
+ * apps/logging/nxscope/nxscope_iudp.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/socket.h>
+
+#include <assert.h>
+#include <debug.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+
+#include <logging/nxscope/nxscope.h>
+
+/****************************************************************************
+ * Private Type Definition
+ ****************************************************************************/
+
+struct nxscope_intf_udp_s
+{
+  FAR struct nxscope_udp_cfg_s *cfg;
+  int                           fd;
+  uint16_t                      mtu;
+  bool                          connected;
+  struct sockaddr_in            peer;
+};
+
+/****************************************************************************
+ * Private Function Protototypes
+ ****************************************************************************/
+
+static int nxscope_udp_send(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len);
+static int nxscope_udp_recv(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct nxscope_intf_ops_s g_nxscope_udp_ops =
+{
+  nxscope_udp_send,
+  nxscope_udp_recv
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nxscope_udp_send
+ ****************************************************************************/
+
+static int nxscope_udp_send(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len)
+{
+  FAR struct nxscope_intf_udp_s *priv = NULL;
+  int                            ret  = OK;
+
+  DEBUGASSERT(intf);
+  DEBUGASSERT(intf->priv);
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_udp_s *)intf->priv;
+
+  /* Drop data until a client sends a request */
+
+  if (!priv->connected)
+    {
+      return len;
+    }
+
+  /* Each call carries one complete nxscope frame and each frame goes in
+   * its own datagram, so a lost datagram never corrupts the next frame.
+   */
+
+  if (len > priv->mtu)
+    {
+      _err("ERROR: frame %d larger than mtu %d\n", len, priv->mtu);
+      return -EMSGSIZE;
+    }
+
+  ret = sendto(priv->fd, buff, len, 0, (FAR struct sockaddr *)&priv->peer,
+               sizeof(struct sockaddr_in));
+  if (ret < 0)
+    {
+      return -errno;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: nxscope_udp_recv
+ ****************************************************************************/
+
+static int nxscope_udp_recv(FAR struct nxscope_intf_s *intf,
+                            FAR uint8_t *buff, int len)
+{
+  FAR struct nxscope_intf_udp_s *priv    = NULL;
+  struct sockaddr_in             from;
+  socklen_t                      fromlen = sizeof(from);
+  int                            ret     = OK;
+
+  DEBUGASSERT(intf);
+  DEBUGASSERT(intf->priv);
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_udp_s *)intf->priv;
+
+  /* Read data */
+
+  ret = recvfrom(priv->fd, buff, len, 0, (FAR struct sockaddr *)&from,
+                 &fromlen);
+  if (ret < 0)
+    {
+      if (priv->cfg->nonblock && errno == EAGAIN)
+        {
+          return 0;
+        }
+
+      return -errno;
+    }
+
+  /* Answer the last client that sent a request */
+
+  if (!priv->connected ||
+      priv->peer.sin_addr.s_addr != from.sin_addr.s_addr ||
+      priv->peer.sin_port != from.sin_port)
+    {
+      _info("new client %08" PRIx32 ":%d\n",
+            (uint32_t)ntohl(from.sin_addr.s_addr), ntohs(from.sin_port));
+
+      memcpy(&priv->peer, &from, sizeof(struct sockaddr_in));
+      priv->connected = true;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nxscope_udp_init
+ ****************************************************************************/
+
+int nxscope_udp_init(FAR struct nxscope_intf_s *intf,
+                     FAR struct nxscope_udp_cfg_s *cfg)
+{
+  FAR struct nxscope_intf_udp_s *priv  = NULL;
+  struct sockaddr_in             addr;
+  int                            ret   = OK;
+  int                            flags = 0;
+
+  DEBUGASSERT(intf);
+  DEBUGASSERT(cfg);
+
+  /* Allocate priv data */
+
+  intf->priv = zalloc(sizeof(struct nxscope_intf_udp_s));
+  if (intf->priv == NULL)
+    {
+      _err("ERROR: intf->priv alloc failed %d\n", errno);
+      ret = -errno;
+      goto errout;
+    }
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_udp_s *)intf->priv;
+
+  /* Connect configuration */
+
+  priv->cfg = cfg;
+  priv->mtu = cfg->mtu > 0 ? cfg->mtu : CONFIG_LOGGING_NXSCOPE_INTF_UDP_MTU;
+
+  /* Connect ops */
+
+  intf->ops = &g_nxscope_udp_ops;
+
+  /* Create socket */
+
+  flags = SOCK_DGRAM;
+
+  if (priv->cfg->nonblock)
+    {
+      flags |= SOCK_NONBLOCK;
+    }
+
+  priv->fd = socket(AF_INET, flags, 0);
+  if (priv->fd < 0)
+    {
+      _err("ERROR: failed to create socket %d\n", errno);
+      ret = -errno;
+      goto errout;
+    }
+
+  /* Bind to the local port */
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(priv->cfg->port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  ret = bind(priv->fd, (FAR struct sockaddr *)&addr, sizeof(addr));
+  if (ret < 0)
+    {
+      _err("ERROR: failed to bind port %d %d\n", priv->cfg->port, errno);
+      ret = -errno;
+      close(priv->fd);
+      goto errout;
+    }
+
+  /* Initialized */
+
+  intf->initialized = true;
+
+  return OK;
+
+errout:
+  if (priv != NULL)
+    {
+      free(priv);
+      intf->priv = NULL;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: nxscope_udp_deinit
+ ****************************************************************************/
+
+void nxscope_udp_deinit(FAR struct nxscope_intf_s *intf)
+{
+  FAR struct nxscope_intf_udp_s *priv = NULL;
+
+  DEBUGASSERT(intf);
+
+  /* Get priv data */
+
+  priv = (FAR struct nxscope_intf_udp_s *)intf->priv;
+
+  if (priv != NULL)
+    {
+      /* Close socket */
+
+      close(priv->fd);
+      free(priv);
+    }
+
+  /* Reset structure */
+
+  memset(intf, 0, sizeof(struct nxscope_intf_s));
+}
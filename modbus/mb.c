@@ -36,8 +36,11 @@
 #include <nuttx/config.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
 
 #include "port.h"
+#include "mbinst.h"
 
 #include "modbus/mb.h"
 #include "modbus/mbframe.h"
@@ -62,37 +65,26 @@
  * Private Data
  ****************************************************************************/
 
-static uint8_t  ucMBAddress;
-static eMBMode  eMBCurrentMode;
-
-static enum
-{
-  STATE_ENABLED,
-  STATE_DISABLED,
-  STATE_NOT_INITIALIZED
-} eMBState = STATE_NOT_INITIALIZED;
-
-/* Functions pointer which are initialized in eMBInit(). Depending on the
- * mode (RTU or ASCII) the are set to the correct implementations.
+/* The instance driven by eMBInit(), eMBPoll() and the other functions
+ * without an instance handle.
  */
 
-static peMBFrameSend peMBFrameSendCur;
-static pvMBFrameStart pvMBFrameStartCur;
-static pvMBFrameStop pvMBFrameStopCur;
-static peMBFrameReceive peMBFrameReceiveCur;
-static pvMBFrameClose pvMBFrameCloseCur;
+static struct xMBInstance xMBInstDefault =
+{
+  .eMBState          = STATE_NOT_INITIALIZED,
+  .xSerial.iSerialFd = -1,
+  .xSerial.ulWaitUs  = MB_INST_SER_WAIT_US,
+};
 
-/* Callback functions required by the porting layer. They are called when
- * an external event has happened which includes a timeout or the reception
- * or transmission of a character.
+#ifdef CONFIG_MB_MULTI_INSTANCE
+/* The instances handed out by eMBInitInst() and their RTU frame buffers.
+ * The default instance shares its frame buffer with the ASCII layer.
  */
 
-bool(*pxMBFrameCBByteReceived)(void);
-bool(*pxMBFrameCBTransmitterEmpty)(void);
-bool(*pxMBPortCBTimerExpired)(void);
-
-bool(*pxMBFrameCBReceiveFSMCur)(void);
-bool(*pxMBFrameCBTransmitFSMCur)(void);
+static struct xMBInstance xMBInstPool[CONFIG_MB_MULTI_INSTANCE_MAX];
+static volatile uint8_t
+  ucMBInstRTUBuf[CONFIG_MB_MULTI_INSTANCE_MAX][MB_INST_RTU_BUF_SIZE];
+#endif
 
 /* An array of Modbus functions handlers which associates Modbus function
  * codes with implementing functions.
@@ -132,6 +124,40 @@ static xMBFunctionHandler xFuncHandlers[CONFIG_MB_FUNC_HANDLERS_MAX] =
 #endif
 };
 
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* The instance all layers of the stack work on */
+
+struct xMBInstance *pxMBInstCur = &xMBInstDefault;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_MB_MULTI_INSTANCE
+static eMBErrorCode prveMBInstCall(xMBHandle xHandle,
+                                   eMBErrorCode (*peFunc)(void))
+{
+  struct xMBInstance *pxPrev = pxMBInstCur;
+  eMBErrorCode        eStatus;
+
+  if ((xHandle == NULL) || !xHandle->bInUse)
+    {
+      return MB_EINVAL;
+    }
+
+  /* Let the stack work on the instance for the duration of the call. */
+
+  pxMBInstCur = xHandle;
+  eStatus = peFunc();
+  pxMBInstCur = pxPrev;
+
+  return eStatus;
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -139,7 +165,8 @@ static xMBFunctionHandler xFuncHandlers[CONFIG_MB_FUNC_HANDLERS_MAX] =
 eMBErrorCode eMBInit(eMBMode eMode, uint8_t ucSlaveAddress, uint8_t ucPort,
                      speed_t ulBaudRate, eMBParity eParity)
 {
-  eMBErrorCode eStatus = MB_ENOERR;
+  struct xMBInstance *pxInst = pxMBInstCur;
+  eMBErrorCode        eStatus = MB_ENOERR;
 
   /* check preconditions */
 
@@ -150,36 +177,38 @@ eMBErrorCode eMBInit(eMBMode eMode, uint8_t ucSlaveAddress, uint8_t ucPort,
     }
   else
     {
-      ucMBAddress = ucSlaveAddress;
+      pxInst->ucMBAddress = ucSlaveAddress;
 
       switch (eMode)
         {
 #ifdef CONFIG_MB_RTU_ENABLED
         case MB_RTU:
-          pvMBFrameStartCur = eMBRTUStart;
-          pvMBFrameStopCur = eMBRTUStop;
-          peMBFrameSendCur = eMBRTUSend;
-          peMBFrameReceiveCur = eMBRTUReceive;
-          pvMBFrameCloseCur = vMBPortClose;
-          pxMBFrameCBByteReceived = xMBRTUReceiveFSM;
-          pxMBFrameCBTransmitterEmpty = xMBRTUTransmitFSM;
-          pxMBPortCBTimerExpired = xMBRTUTimerT35Expired;
-
-          eStatus = eMBRTUInit(ucMBAddress, ucPort, ulBaudRate, eParity);
+          pxInst->pvMBFrameStartCur = eMBRTUStart;
+          pxInst->pvMBFrameStopCur = eMBRTUStop;
+          pxInst->peMBFrameSendCur = eMBRTUSend;
+          pxInst->peMBFrameReceiveCur = eMBRTUReceive;
+          pxInst->pvMBFrameCloseCur = vMBPortClose;
+          pxInst->pxMBFrameCBByteReceived = xMBRTUReceiveFSM;
+          pxInst->pxMBFrameCBTransmitterEmpty = xMBRTUTransmitFSM;
+          pxInst->pxMBPortCBTimerExpired = xMBRTUTimerT35Expired;
+
+          eStatus = eMBRTUInit(pxInst->ucMBAddress, ucPort, ulBaudRate,
+                               eParity);
           break;
 #endif
 #ifdef CONFIG_MB_ASCII_ENABLED
         case MB_ASCII:
-          pvMBFrameStartCur = eMBASCIIStart;
-          pvMBFrameStopCur = eMBASCIIStop;
-          peMBFrameSendCur = eMBASCIISend;
-          peMBFrameReceiveCur = eMBASCIIReceive;
-          pvMBFrameCloseCur = vMBPortClose;
-          pxMBFrameCBByteReceived = xMBASCIIReceiveFSM;
-          pxMBFrameCBTransmitterEmpty = xMBASCIITransmitFSM;
-          pxMBPortCBTimerExpired = xMBASCIITimerT1SExpired;
-
-          eStatus = eMBASCIIInit(ucMBAddress, ucPort, ulBaudRate, eParity);
+          pxInst->pvMBFrameStartCur = eMBASCIIStart;
+          pxInst->pvMBFrameStopCur = eMBASCIIStop;
+          pxInst->peMBFrameSendCur = eMBASCIISend;
+          pxInst->peMBFrameReceiveCur = eMBASCIIReceive;
+          pxInst->pvMBFrameCloseCur = vMBPortClose;
+          pxInst->pxMBFrameCBByteReceived = xMBASCIIReceiveFSM;
+          pxInst->pxMBFrameCBTransmitterEmpty = xMBASCIITransmitFSM;
+          pxInst->pxMBPortCBTimerExpired = xMBASCIITimerT1SExpired;
+
+          eStatus = eMBASCIIInit(pxInst->ucMBAddress, ucPort, ulBaudRate,
+                                 eParity);
           break;
 #endif
         default:
@@ -196,8 +225,8 @@ eMBErrorCode eMBInit(eMBMode eMode, uint8_t ucSlaveAddress, uint8_t ucPort,
             }
           else
             {
-              eMBCurrentMode = eMode;
-              eMBState = STATE_DISABLED;
+              pxInst->eMBCurrentMode = eMode;
+              pxInst->eMBState = STATE_DISABLED;
             }
         }
     }
@@ -208,11 +237,12 @@ eMBErrorCode eMBInit(eMBMode eMode, uint8_t ucSlaveAddress, uint8_t ucPort,
 #ifdef CONFIG_MB_TCP_ENABLED
 eMBErrorCode eMBTCPInit(uint16_t ucTCPPort)
 {
-  eMBErrorCode eStatus = MB_ENOERR;
+  struct xMBInstance *pxInst = pxMBInstCur;
+  eMBErrorCode        eStatus = MB_ENOERR;
 
   if ((eStatus = eMBTCPDoInit(ucTCPPort)) != MB_ENOERR)
     {
-      eMBState = STATE_DISABLED;
+      pxInst->eMBState = STATE_DISABLED;
     }
   else if (!xMBPortEventInit())
     {
@@ -222,18 +252,18 @@ eMBErrorCode eMBTCPInit(uint16_t ucTCPPort)
     }
   else
     {
-      pvMBFrameStartCur = eMBTCPStart;
-      pvMBFrameStopCur = eMBTCPStop;
-      peMBFrameReceiveCur = eMBTCPReceive;
-      peMBFrameSendCur = eMBTCPSend;
+      pxInst->pvMBFrameStartCur = eMBTCPStart;
+      pxInst->pvMBFrameStopCur = eMBTCPStop;
+      pxInst->peMBFrameReceiveCur = eMBTCPReceive;
+      pxInst->peMBFrameSendCur = eMBTCPSend;
 #ifdef CONFIG_MB_HAVE_CLOSE
-      pvMBFrameCloseCur = vMBTCPPortClose;
+      pxInst->pvMBFrameCloseCur = vMBTCPPortClose;
 #else
-      pvMBFrameCloseCur = NULL;
+      pxInst->pvMBFrameCloseCur = NULL;
 #endif
-      ucMBAddress = MB_TCP_PSEUDO_ADDRESS;
-      eMBCurrentMode = MB_TCP;
-      eMBState = STATE_DISABLED;
+      pxInst->ucMBAddress = MB_TCP_PSEUDO_ADDRESS;
+      pxInst->eMBCurrentMode = MB_TCP;
+      pxInst->eMBState = STATE_DISABLED;
     }
 
   return eStatus;
@@ -291,13 +321,14 @@ eMBErrorCode eMBRegisterCB(uint8_t ucFunctionCode, pxMBFunctionHandler pxHandler
 
 eMBErrorCode eMBClose(void)
 {
-  eMBErrorCode eStatus = MB_ENOERR;
+  struct xMBInstance *pxInst = pxMBInstCur;
+  eMBErrorCode        eStatus = MB_ENOERR;
 
-  if (eMBState == STATE_DISABLED)
+  if (pxInst->eMBState == STATE_DISABLED)
     {
-      if (pvMBFrameCloseCur != NULL)
+      if (pxInst->pvMBFrameCloseCur != NULL)
         {
-          pvMBFrameCloseCur();
+          pxInst->pvMBFrameCloseCur();
         }
     }
   else
@@ -310,14 +341,15 @@ eMBErrorCode eMBClose(void)
 
 eMBErrorCode eMBEnable(void)
 {
-  eMBErrorCode eStatus = MB_ENOERR;
+  struct xMBInstance *pxInst = pxMBInstCur;
+  eMBErrorCode        eStatus = MB_ENOERR;
 
-  if (eMBState == STATE_DISABLED)
+  if (pxInst->eMBState == STATE_DISABLED)
     {
       /* Activate the protocol stack. */
 
-      pvMBFrameStartCur();
-      eMBState = STATE_ENABLED;
+      pxInst->pvMBFrameStartCur();
+      pxInst->eMBState = STATE_ENABLED;
     }
   else
     {
@@ -329,15 +361,16 @@ eMBErrorCode eMBEnable(void)
 
 eMBErrorCode eMBDisable(void)
 {
-  eMBErrorCode  eStatus;
+  struct xMBInstance *pxInst = pxMBInstCur;
+  eMBErrorCode        eStatus;
 
-  if (eMBState == STATE_ENABLED)
+  if (pxInst->eMBState == STATE_ENABLED)
     {
-      pvMBFrameStopCur();
-      eMBState = STATE_DISABLED;
+      pxInst->pvMBFrameStopCur();
+      pxInst->eMBState = STATE_DISABLED;
       eStatus = MB_ENOERR;
     }
-  else if (eMBState == STATE_DISABLED)
+  else if (pxInst->eMBState == STATE_DISABLED)
     {
       eStatus = MB_ENOERR;
     }
@@ -351,19 +384,14 @@ eMBErrorCode eMBDisable(void)
 
 eMBErrorCode eMBPoll(void)
 {
-  static uint8_t     *ucMBFrame;
-  static uint8_t      ucRcvAddress;
-  static uint8_t      ucFunctionCode;
-  static uint16_t     usLength;
-  static eMBException eException;
-
-  int             i;
-  eMBErrorCode    eStatus = MB_ENOERR;
-  eMBEventType    eEvent;
+  struct xMBInstance *pxInst = pxMBInstCur;
+  int                 i;
+  eMBErrorCode        eStatus = MB_ENOERR;
+  eMBEventType        eEvent;
 
   /* Check if the protocol stack is ready. */
 
-  if (eMBState != STATE_ENABLED)
+  if (pxInst->eMBState != STATE_ENABLED)
     {
       return MB_EILLSTATE;
     }
@@ -380,12 +408,15 @@ eMBErrorCode eMBPoll(void)
           break;
 
         case EV_FRAME_RECEIVED:
-          eStatus = peMBFrameReceiveCur(&ucRcvAddress, &ucMBFrame, &usLength);
+          eStatus = pxInst->peMBFrameReceiveCur(&pxInst->ucRcvAddress,
+                                                &pxInst->pucMBFrame,
+                                                &pxInst->usLength);
           if (eStatus == MB_ENOERR)
             {
               /* Check if the frame is for us. If not ignore the frame. */
 
-              if ((ucRcvAddress == ucMBAddress) || (ucRcvAddress == MB_ADDRESS_BROADCAST))
+              if ((pxInst->ucRcvAddress == pxInst->ucMBAddress) ||
+                  (pxInst->ucRcvAddress == MB_ADDRESS_BROADCAST))
                 {
                   xMBPortEventPost(EV_EXECUTE);
                 }
@@ -393,8 +424,8 @@ eMBErrorCode eMBPoll(void)
             break;
 
         case EV_EXECUTE:
-          ucFunctionCode = ucMBFrame[MB_PDU_FUNC_OFF];
-          eException = MB_EX_ILLEGAL_FUNCTION;
+          pxInst->ucFunctionCode = pxInst->pucMBFrame[MB_PDU_FUNC_OFF];
+          pxInst->eException = MB_EX_ILLEGAL_FUNCTION;
           for( i = 0; i < CONFIG_MB_FUNC_HANDLERS_MAX; i++)
             {
               /* No more function handlers registered. Abort. */
@@ -403,9 +434,12 @@ eMBErrorCode eMBPoll(void)
                 {
                   break;
                 }
-              else if (xFuncHandlers[i].ucFunctionCode == ucFunctionCode)
+              else if (xFuncHandlers[i].ucFunctionCode ==
+                       pxInst->ucFunctionCode)
                 {
-                  eException = xFuncHandlers[i].pxHandler(ucMBFrame, &usLength);
+                  pxInst->eException =
+                    xFuncHandlers[i].pxHandler(pxInst->pucMBFrame,
+                                               &pxInst->usLength);
                   break;
                 }
             }
@@ -414,24 +448,30 @@ eMBErrorCode eMBPoll(void)
            * return a reply.
            */
 
-          if (ucRcvAddress != MB_ADDRESS_BROADCAST)
+          if (pxInst->ucRcvAddress != MB_ADDRESS_BROADCAST)
             {
-              if (eException != MB_EX_NONE)
+              if (pxInst->eException != MB_EX_NONE)
                 {
                   /* An exception occurred. Build an error frame. */
 
-                  usLength = 0;
-                  ucMBFrame[usLength++] = (uint8_t)(ucFunctionCode | MB_FUNC_ERROR);
-                  ucMBFrame[usLength++] = eException;
+                  pxInst->usLength = 0;
+                  pxInst->pucMBFrame[pxInst->usLength++] =
+                    (uint8_t)(pxInst->ucFunctionCode | MB_FUNC_ERROR);
+                  pxInst->pucMBFrame[pxInst->usLength++] =
+                    pxInst->eException;
                 }
 
 #ifdef CONFIG_MB_ASCII_ENABLED
-              if ((eMBCurrentMode == MB_ASCII) && CONFIG_MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS)
+              if ((pxInst->eMBCurrentMode == MB_ASCII) &&
+                  CONFIG_MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS)
                 {
-                  vMBPortTimersDelay(CONFIG_MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS);
+                  vMBPortTimersDelay(
+                    CONFIG_MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS);
                 }
 #endif
-              peMBFrameSendCur(ucMBAddress, ucMBFrame, usLength);
+              pxInst->peMBFrameSendCur(pxInst->ucMBAddress,
+                                       pxInst->pucMBFrame,
+                                       pxInst->usLength);
             }
             break;
 
@@ -442,3 +482,163 @@ eMBErrorCode eMBPoll(void)
 
   return MB_ENOERR;
 }
+
+#ifdef CONFIG_MB_MULTI_INSTANCE
+eMBErrorCode eMBInitInst(xMBHandle *pxHandle, eMBMode eMode,
+                         uint8_t ucSlaveAddress, uint8_t ucPort,
+                         speed_t ulBaudRate, eMBParity eParity)
+{
+  struct xMBInstance *pxPrev = pxMBInstCur;
+  struct xMBInstance *pxInst = NULL;
+  eMBErrorCode        eStatus;
+  int                 i;
+
+  /* Only the RTU layer keeps its state in the instance. */
+
+  if ((pxHandle == NULL) || (eMode != MB_RTU))
+    {
+      return MB_EINVAL;
+    }
+
+  ENTER_CRITICAL_SECTION();
+  for (i = 0; i < CONFIG_MB_MULTI_INSTANCE_MAX; i++)
+    {
+      if (!xMBInstPool[i].bInUse)
+        {
+          pxInst = &xMBInstPool[i];
+          memset(pxInst, 0, sizeof(*pxInst));
+          pxInst->bInUse = true;
+          break;
+        }
+    }
+
+  EXIT_CRITICAL_SECTION();
+
+  if (pxInst == NULL)
+    {
+      return MB_ENORES;
+    }
+
+  pxInst->eMBState = STATE_NOT_INITIALIZED;
+  pxInst->xRTU.pucRTUBuf = ucMBInstRTUBuf[i];
+  pxInst->xSerial.iSerialFd = -1;
+
+  pxMBInstCur = pxInst;
+  eStatus = eMBInit(eMode, ucSlaveAddress, ucPort, ulBaudRate, eParity);
+  if (eStatus != MB_ENOERR)
+    {
+      vMBPortClose();
+      pxInst->bInUse = false;
+    }
+
+  pxMBInstCur = pxPrev;
+
+  if (eStatus == MB_ENOERR)
+    {
+      *pxHandle = pxInst;
+    }
+
+  return eStatus;
+}
+
+eMBErrorCode eMBCloseInst(xMBHandle xHandle)
+{
+  eMBErrorCode eStatus = prveMBInstCall(xHandle, eMBClose);
+
+  if (eStatus == MB_ENOERR)
+    {
+      xHandle->bInUse = false;
+    }
+
+  return eStatus;
+}
+
+eMBErrorCode eMBEnableInst(xMBHandle xHandle)
+{
+  return prveMBInstCall(xHandle, eMBEnable);
+}
+
+eMBErrorCode eMBDisableInst(xMBHandle xHandle)
+{
+  return prveMBInstCall(xHandle, eMBDisable);
+}
+
+eMBErrorCode eMBPollInst(xMBHandle xHandle)
+{
+  return prveMBInstCall(xHandle, eMBPoll);
+}
+
+eMBErrorCode eMBPollInstances(const xMBHandle *pxHandles, int iCount,
+                              int iTimeoutMs)
+{
+  struct pollfd       xFds[CONFIG_MB_MULTI_INSTANCE_MAX];
+  struct xMBInstance *pxInst;
+  int                 iWaitMs = iTimeoutMs;
+  int                 i;
+
+  if ((pxHandles == NULL) || (iCount < 0) ||
+      (iCount > CONFIG_MB_MULTI_INSTANCE_MAX))
+    {
+      return MB_EINVAL;
+    }
+
+  /* Wait for a character on any of the buses.  Do not wait at all if an
+   * instance has an event or a response pending, and not longer than the
+   * shortest running t3.5 timer.
+   */
+
+  for (i = 0; i < iCount; i++)
+    {
+      pxInst = pxHandles[i];
+      if ((pxInst == NULL) || !pxInst->bInUse)
+        {
+          return MB_EINVAL;
+        }
+
+      xFds[i].fd      = pxInst->xSerial.bRxEnabled ?
+                        pxInst->xSerial.iSerialFd : -1;
+      xFds[i].events  = POLLIN;
+      xFds[i].revents = 0;
+
+      if (pxInst->eMBState != STATE_ENABLED)
+        {
+          continue;
+        }
+
+      if (pxInst->xEvent.xEventInQueue || pxInst->xSerial.bTxEnabled)
+        {
+          iWaitMs = 0;
+        }
+      else if (pxInst->xTimer.bTimeoutEnable &&
+               (iWaitMs < 0 || (int)pxInst->xTimer.ulTimeOut < iWaitMs))
+        {
+          iWaitMs = pxInst->xTimer.ulTimeOut;
+        }
+    }
+
+  if (poll(xFds, iCount, iWaitMs) < 0 && errno != EINTR)
+    {
+      vMBPortLog(MB_LOG_ERROR, "INST", "poll failed: %d\n", errno);
+      return MB_EIO;
+    }
+
+  /* Every instance reads what has arrived, checks its timer and handles
+   * at most one event.
+   */
+
+  for (i = 0; i < iCount; i++)
+    {
+      if (pxHandles[i]->eMBState == STATE_ENABLED)
+        {
+          eMBPollInst(pxHandles[i]);
+        }
+    }
+
+  return MB_ENOERR;
+}
+
+xMBHandle xMBGetInst(void)
+{
+  return pxMBInstCur != &xMBInstDefault ? pxMBInstCur : NULL;
+}
+#endif
@@ -211,6 +211,78 @@ eMBErrorCode eMBMasterInit(eMBMode eMode, uint8_t ucPort,
   return eStatus;
 }
 
+eMBErrorCode eMBMasterRegisterCB(uint8_t ucFunctionCode,
+                                 pxMBFunctionHandler pxHandler)
+{
+  eMBErrorCode eStatus;
+  int i;
+
+  if ((0 < ucFunctionCode) && (ucFunctionCode <= 127))
+    {
+      vMBMasterPortEnterCritical();
+      if (pxHandler != NULL)
+        {
+          /* A handler already registered for the function code is
+           * replaced in place, the table is never left without one.
+           * Otherwise the first free slot is taken, so one handler may
+           * serve several function codes.
+           */
+
+          for (i = 0; i < CONFIG_MB_FUNC_HANDLERS_MAX; i++)
+            {
+              if (xMasterFuncHandlers[i].ucFunctionCode == ucFunctionCode)
+                {
+                  break;
+                }
+            }
+
+          if (i == CONFIG_MB_FUNC_HANDLERS_MAX)
+            {
+              for (i = 0; i < CONFIG_MB_FUNC_HANDLERS_MAX; i++)
+                {
+                  if (xMasterFuncHandlers[i].pxHandler == NULL)
+                    {
+                      break;
+                    }
+                }
+            }
+
+          if (i != CONFIG_MB_FUNC_HANDLERS_MAX)
+            {
+              xMasterFuncHandlers[i].ucFunctionCode = ucFunctionCode;
+              xMasterFuncHandlers[i].pxHandler = pxHandler;
+            }
+
+          eStatus = (i != CONFIG_MB_FUNC_HANDLERS_MAX) ? MB_ENOERR :
+                                                         MB_ENORES;
+        }
+      else
+        {
+          for (i = 0; i < CONFIG_MB_FUNC_HANDLERS_MAX; i++)
+            {
+              if (xMasterFuncHandlers[i].ucFunctionCode == ucFunctionCode)
+                {
+                  xMasterFuncHandlers[i].ucFunctionCode = 0;
+                  xMasterFuncHandlers[i].pxHandler = NULL;
+                  break;
+                }
+            }
+
+          /* Remove can't fail. */
+
+          eStatus = MB_ENOERR;
+        }
+
+      vMBMasterPortExitCritical();
+    }
+  else
+    {
+      eStatus = MB_EINVAL;
+    }
+
+  return eStatus;
+}
+
 eMBErrorCode eMBMasterClose(void)
 {
   eMBErrorCode eStatus = MB_ENOERR;
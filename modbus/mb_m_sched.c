@@ -0,0 +1,680 @@
+/****************************************************************************
+ * apps/modbus/mb_m_sched.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "port.h"
+
+#include "modbus/mb.h"
+#include "modbus/mb_m.h"
+#include "modbus/mbframe.h"
+#include "modbus/mbproto.h"
+#include "modbus/mbutils.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define MB_SCHED_REG_MAX        125   /* Registers per read request */
+#define MB_SCHED_BIT_MAX        2000  /* Coils or inputs per read request */
+#define MB_SCHED_WAIT_MAX_MS    100   /* Longest sleep in eMBMasterSchedRun */
+
+#define MB_SCHED_VALUES_OFF     (MB_PDU_DATA_OFF + 1)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct xMBSchedEntry
+{
+  const xMBMasterPollEntry *pxCfg;
+  uint32_t                  ulNextMs;
+  bool                      bSelected;
+  xMBMasterPollStatus       xStatus;
+};
+
+struct xMBSched
+{
+  struct xMBSchedEntry xEntries[CONFIG_MB_MASTER_SCHED_NENTRIES];
+  int16_t              sSorted[CONFIG_MB_MASTER_SCHED_NENTRIES];
+  int                  iCount;
+  uint32_t             ulBackoffMs[CONFIG_MB_MASTER_TOTAL_SLAVE_NUM + 1];
+  bool                 bBackoff[CONFIG_MB_MASTER_TOTAL_SLAVE_NUM + 1];
+  uint8_t              ucLastSlave;
+  volatile bool        bRunning;
+
+  /* The request in progress */
+
+  volatile bool        bActive;
+  uint8_t              ucSlave;
+  uint8_t              ucFunction;
+  uint16_t             usStart;
+  uint16_t             usCount;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct xMBSched xSched;
+static pthread_mutex_t xSchedLock = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static uint32_t prvulMBSchedNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static bool prvbMBSchedIsBits(uint8_t ucFunction)
+{
+  return ucFunction == MB_FUNC_READ_COILS ||
+         ucFunction == MB_FUNC_READ_DISCRETE_INPUTS;
+}
+
+static uint16_t prvusMBSchedMax(uint8_t ucFunction)
+{
+  return prvbMBSchedIsBits(ucFunction) ? MB_SCHED_BIT_MAX :
+                                         MB_SCHED_REG_MAX;
+}
+
+/* The handlers of the stack that the scheduler replaces while it is
+ * installed.  They still process responses to requests of the application.
+ */
+
+static eMBException prveMBSchedOrig(uint8_t *pucFrame, uint16_t *usLen)
+{
+  switch (pucFrame[MB_PDU_FUNC_OFF])
+    {
+#ifdef CONFIG_MB_MASTER_FUNC_READ_HOLDING_ENABLED
+      case MB_FUNC_READ_HOLDING_REGISTER:
+        return eMBMasterFuncReadHoldingRegister(pucFrame, usLen);
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_INPUT_ENABLED
+      case MB_FUNC_READ_INPUT_REGISTER:
+        return eMBMasterFuncReadInputRegister(pucFrame, usLen);
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_COILS_ENABLED
+      case MB_FUNC_READ_COILS:
+        return eMBMasterFuncReadCoils(pucFrame, usLen);
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_DISCRETE_INPUTS_ENABLED
+      case MB_FUNC_READ_DISCRETE_INPUTS:
+        return eMBMasterFuncReadDiscreteInputs(pucFrame, usLen);
+#endif
+      default:
+        return MB_EX_ILLEGAL_FUNCTION;
+    }
+}
+
+static void prvvMBSchedScatter(struct xMBSchedEntry *pxEntry,
+                               uint8_t *pucValues)
+{
+  const xMBMasterPollEntry *pxCfg = pxEntry->pxCfg;
+  uint16_t usOff = pxCfg->usAddress - xSched.usStart;
+  uint16_t *pusImage;
+  uint8_t  *pucImage;
+  uint8_t   ucBits;
+  int       i;
+
+  if (prvbMBSchedIsBits(pxCfg->ucFunction))
+    {
+      pucImage = pxCfg->pvImage;
+      for (i = 0; i < pxCfg->usCount; i += 8)
+        {
+          ucBits = pxCfg->usCount - i < 8 ? pxCfg->usCount - i : 8;
+          xMBUtilSetBits(pucImage, i, ucBits,
+                         xMBUtilGetBits(pucValues, usOff + i, ucBits));
+        }
+    }
+  else
+    {
+      pusImage = pxCfg->pvImage;
+      pucValues += 2 * usOff;
+      for (i = 0; i < pxCfg->usCount; i++)
+        {
+          pusImage[i] = (uint16_t)(pucValues[2 * i] << 8) |
+                        pucValues[2 * i + 1];
+        }
+    }
+}
+
+static eMBException prveMBSchedFunc(uint8_t *pucFrame, uint16_t *usLen)
+{
+  uint8_t *pucReq;
+  uint16_t usBytes;
+  int      i;
+
+  /* Hand responses to requests of the application to the stack. */
+
+  vMBMasterGetPDUSndBuf(&pucReq);
+  if (!xSched.bActive || xMBMasterRequestIsBroadcast() ||
+      ucMBMasterGetDestAddress() != xSched.ucSlave ||
+      pucReq[MB_PDU_FUNC_OFF] != xSched.ucFunction ||
+      pucReq[MB_PDU_DATA_OFF] != (uint8_t)(xSched.usStart >> 8) ||
+      pucReq[MB_PDU_DATA_OFF + 1] != (uint8_t)xSched.usStart ||
+      pucReq[MB_PDU_DATA_OFF + 2] != (uint8_t)(xSched.usCount >> 8) ||
+      pucReq[MB_PDU_DATA_OFF + 3] != (uint8_t)xSched.usCount)
+    {
+      return prveMBSchedOrig(pucFrame, usLen);
+    }
+
+  if (prvbMBSchedIsBits(xSched.ucFunction))
+    {
+      usBytes = (xSched.usCount + 7) / 8;
+    }
+  else
+    {
+      usBytes = 2 * xSched.usCount;
+    }
+
+  if (*usLen < MB_SCHED_VALUES_OFF + usBytes ||
+      pucFrame[MB_PDU_DATA_OFF] != usBytes)
+    {
+      return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+
+  pthread_mutex_lock(&xSchedLock);
+  for (i = 0; i < xSched.iCount; i++)
+    {
+      if (xSched.xEntries[i].bSelected)
+        {
+          prvvMBSchedScatter(&xSched.xEntries[i],
+                             &pucFrame[MB_SCHED_VALUES_OFF]);
+        }
+    }
+
+  pthread_mutex_unlock(&xSchedLock);
+  return MB_EX_NONE;
+}
+
+static const struct
+{
+  uint8_t             ucFunction;
+  pxMBFunctionHandler pxSched;
+  pxMBFunctionHandler pxOrig;
+} xSchedHandlers[] =
+{
+#ifdef CONFIG_MB_MASTER_FUNC_READ_HOLDING_ENABLED
+  {
+    MB_FUNC_READ_HOLDING_REGISTER, prveMBSchedFunc,
+    eMBMasterFuncReadHoldingRegister
+  },
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_INPUT_ENABLED
+  {
+    MB_FUNC_READ_INPUT_REGISTER, prveMBSchedFunc,
+    eMBMasterFuncReadInputRegister
+  },
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_COILS_ENABLED
+  {
+    MB_FUNC_READ_COILS, prveMBSchedFunc,
+    eMBMasterFuncReadCoils
+  },
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_DISCRETE_INPUTS_ENABLED
+  {
+    MB_FUNC_READ_DISCRETE_INPUTS, prveMBSchedFunc,
+    eMBMasterFuncReadDiscreteInputs
+  },
+#endif
+};
+
+#define MB_SCHED_NHANDLERS \
+  (sizeof(xSchedHandlers) / sizeof(xSchedHandlers[0]))
+
+static eMBErrorCode prveMBSchedInstall(bool bInstall)
+{
+  eMBErrorCode eStatus;
+  unsigned int i;
+
+  for (i = 0; i < MB_SCHED_NHANDLERS; i++)
+    {
+      /* The handler is replaced in place, so that a response arriving
+       * meanwhile is still dispatched.
+       */
+
+      eStatus = eMBMasterRegisterCB(xSchedHandlers[i].ucFunction,
+                                    bInstall ? xSchedHandlers[i].pxSched :
+                                               xSchedHandlers[i].pxOrig);
+      if (eStatus != MB_ENOERR)
+        {
+          /* Put back the handlers that were already swapped. */
+
+          while (bInstall && i-- > 0)
+            {
+              eMBMasterRegisterCB(xSchedHandlers[i].ucFunction,
+                                  xSchedHandlers[i].pxOrig);
+            }
+
+          return eStatus;
+        }
+    }
+
+  return MB_ENOERR;
+}
+
+static bool prvbMBSchedValid(const xMBMasterPollEntry *pxCfg)
+{
+  unsigned int i;
+
+  if (pxCfg->ucSlave < 1 ||
+      pxCfg->ucSlave > CONFIG_MB_MASTER_TOTAL_SLAVE_NUM ||
+      pxCfg->usCount < 1 ||
+      pxCfg->usCount > prvusMBSchedMax(pxCfg->ucFunction) ||
+      (uint32_t)pxCfg->usAddress + pxCfg->usCount > 0x10000 ||
+      pxCfg->ulPeriodMs == 0 || pxCfg->pvImage == NULL)
+    {
+      return false;
+    }
+
+  for (i = 0; i < MB_SCHED_NHANDLERS; i++)
+    {
+      if (xSchedHandlers[i].ucFunction == pxCfg->ucFunction)
+        {
+          return true;
+        }
+    }
+
+  return false;
+}
+
+/* Order of the entries in sSorted: slave, function, address. */
+
+static int prviMBSchedCompare(const xMBMasterPollEntry *a,
+                              const xMBMasterPollEntry *b)
+{
+  if (a->ucSlave != b->ucSlave)
+    {
+      return a->ucSlave - b->ucSlave;
+    }
+
+  if (a->ucFunction != b->ucFunction)
+    {
+      return a->ucFunction - b->ucFunction;
+    }
+
+  return (int)a->usAddress - (int)b->usAddress;
+}
+
+static bool prvbMBSchedSameGroup(int iA, int iB)
+{
+  const xMBMasterPollEntry *a = xSched.xEntries[iA].pxCfg;
+  const xMBMasterPollEntry *b = xSched.xEntries[iB].pxCfg;
+
+  return a->ucSlave == b->ucSlave && a->ucFunction == b->ucFunction;
+}
+
+/* An entry is read along with a request if it is due within half of its
+ * period.  It is then read a little early instead of on its own later.
+ */
+
+static bool prvbMBSchedJoins(struct xMBSchedEntry *pxEntry, uint32_t ulNow)
+{
+  return !pxEntry->bSelected &&
+         (int32_t)(pxEntry->ulNextMs - ulNow) <=
+         (int32_t)(pxEntry->pxCfg->ulPeriodMs / 2);
+}
+
+/* Extend the request around the entry at sorted position iPos with the
+ * neighbouring entries of the same slave and function.
+ */
+
+static void prvvMBSchedCoalesce(int iPos, uint32_t ulNow)
+{
+  struct xMBSchedEntry     *pxEntry;
+  const xMBMasterPollEntry *pxCfg;
+  uint32_t                  ulStart;
+  uint32_t                  ulEnd;
+  uint32_t                  ulMax;
+  uint32_t                  ulNewStart;
+  uint32_t                  ulNewEnd;
+  int                       i;
+
+  pxEntry = &xSched.xEntries[xSched.sSorted[iPos]];
+  pxEntry->bSelected = true;
+  ulStart = pxEntry->pxCfg->usAddress;
+  ulEnd   = ulStart + pxEntry->pxCfg->usCount;
+  ulMax   = prvusMBSchedMax(pxEntry->pxCfg->ucFunction);
+
+  for (i = iPos + 1; i < xSched.iCount &&
+       prvbMBSchedSameGroup(xSched.sSorted[i], xSched.sSorted[iPos]); i++)
+    {
+      pxEntry = &xSched.xEntries[xSched.sSorted[i]];
+      pxCfg   = pxEntry->pxCfg;
+
+      if (pxCfg->usAddress > ulEnd + CONFIG_MB_MASTER_SCHED_MAXGAP)
+        {
+          break;
+        }
+
+      ulNewEnd = pxCfg->usAddress + pxCfg->usCount;
+      ulNewEnd = ulNewEnd > ulEnd ? ulNewEnd : ulEnd;
+      if (ulNewEnd - ulStart <= ulMax && prvbMBSchedJoins(pxEntry, ulNow))
+        {
+          pxEntry->bSelected = true;
+          ulEnd = ulNewEnd;
+        }
+    }
+
+  for (i = iPos - 1; i >= 0 &&
+       prvbMBSchedSameGroup(xSched.sSorted[i], xSched.sSorted[iPos]); i--)
+    {
+      pxEntry = &xSched.xEntries[xSched.sSorted[i]];
+      pxCfg   = pxEntry->pxCfg;
+
+      ulNewStart = pxCfg->usAddress;
+      ulNewEnd   = pxCfg->usAddress + pxCfg->usCount;
+      if (ulNewEnd + CONFIG_MB_MASTER_SCHED_MAXGAP < ulStart)
+        {
+          continue;
+        }
+
+      ulNewEnd = ulNewEnd > ulEnd ? ulNewEnd : ulEnd;
+      if (ulNewEnd - ulNewStart <= ulMax && prvbMBSchedJoins(pxEntry, ulNow))
+        {
+          pxEntry->bSelected = true;
+          ulStart = ulNewStart;
+          ulEnd = ulNewEnd;
+        }
+    }
+
+  xSched.usStart = (uint16_t)ulStart;
+  xSched.usCount = (uint16_t)(ulEnd - ulStart);
+}
+
+static eMBMasterReqErrCode prveMBSchedRequest(void)
+{
+  uint32_t ulTake = CONFIG_MB_MASTER_TIMEOUT_MS_RESPOND;
+
+  switch (xSched.ucFunction)
+    {
+#ifdef CONFIG_MB_MASTER_FUNC_READ_HOLDING_ENABLED
+      case MB_FUNC_READ_HOLDING_REGISTER:
+        return eMBMasterReqReadHoldingRegister(xSched.ucSlave,
+                                               xSched.usStart,
+                                               xSched.usCount, ulTake);
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_INPUT_ENABLED
+      case MB_FUNC_READ_INPUT_REGISTER:
+        return eMBMasterReqReadInputRegister(xSched.ucSlave,
+                                             xSched.usStart,
+                                             xSched.usCount, ulTake);
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_COILS_ENABLED
+      case MB_FUNC_READ_COILS:
+        return eMBMasterReqReadCoils(xSched.ucSlave, xSched.usStart,
+                                     xSched.usCount, ulTake);
+#endif
+#ifdef CONFIG_MB_MASTER_FUNC_READ_DISCRETE_INPUTS_ENABLED
+      case MB_FUNC_READ_DISCRETE_INPUTS:
+        return eMBMasterReqReadDiscreteInputs(xSched.ucSlave,
+                                              xSched.usStart,
+                                              xSched.usCount, ulTake);
+#endif
+      default:
+        return MB_MRE_ILL_ARG;
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+eMBErrorCode eMBMasterSchedInit(const xMBMasterPollEntry *pxEntries,
+                                int iCount)
+{
+  eMBErrorCode eStatus;
+  uint32_t     ulNow = prvulMBSchedNow();
+  int16_t      sTmp;
+  int          i;
+  int          j;
+
+  if (pxEntries == NULL || iCount < 1 ||
+      iCount > CONFIG_MB_MASTER_SCHED_NENTRIES || xSched.iCount > 0)
+    {
+      return MB_EINVAL;
+    }
+
+  for (i = 0; i < iCount; i++)
+    {
+      if (!prvbMBSchedValid(&pxEntries[i]))
+        {
+          return MB_EINVAL;
+        }
+    }
+
+  memset(&xSched, 0, sizeof(xSched));
+  for (i = 0; i < iCount; i++)
+    {
+      xSched.xEntries[i].pxCfg    = &pxEntries[i];
+      xSched.xEntries[i].ulNextMs = ulNow;
+      xSched.sSorted[i]           = i;
+
+      /* Insertion sort by slave, function and address */
+
+      for (j = i; j > 0 && prviMBSchedCompare(
+             xSched.xEntries[xSched.sSorted[j - 1]].pxCfg,
+             xSched.xEntries[xSched.sSorted[j]].pxCfg) > 0; j--)
+        {
+          sTmp                  = xSched.sSorted[j];
+          xSched.sSorted[j]     = xSched.sSorted[j - 1];
+          xSched.sSorted[j - 1] = sTmp;
+        }
+    }
+
+  eStatus = prveMBSchedInstall(true);
+  if (eStatus != MB_ENOERR)
+    {
+      return eStatus;
+    }
+
+  xSched.iCount = iCount;
+  return MB_ENOERR;
+}
+
+void vMBMasterSchedDeinit(void)
+{
+  if (xSched.iCount > 0)
+    {
+      xSched.bRunning = false;
+      prveMBSchedInstall(false);
+      xSched.iCount = 0;
+    }
+}
+
+uint32_t ulMBMasterSchedRunOnce(void)
+{
+  struct xMBSchedEntry *pxEntry;
+  struct xMBSchedEntry *pxBest = NULL;
+  eMBMasterReqErrCode   eErr;
+  uint32_t              ulNow = prvulMBSchedNow();
+  uint32_t              ulWait = MB_SCHED_WAIT_MAX_MS;
+  uint32_t              ulDue;
+  uint8_t               ucSlave;
+  uint8_t               ucRank;
+  uint8_t               ucBestRank = 0;
+  int                   iBestPos = -1;
+  int                   i;
+
+  /* Pick the due entry of the slave that comes next after the one served
+   * last, the most overdue one of that slave.
+   */
+
+  for (i = 0; i < xSched.iCount; i++)
+    {
+      pxEntry = &xSched.xEntries[xSched.sSorted[i]];
+      ulDue   = pxEntry->ulNextMs;
+      ucSlave = pxEntry->pxCfg->ucSlave;
+
+      if (xSched.bBackoff[ucSlave])
+        {
+          if ((int32_t)(xSched.ulBackoffMs[ucSlave] - ulNow) <= 0)
+            {
+              xSched.bBackoff[ucSlave] = false;
+            }
+          else if ((int32_t)(xSched.ulBackoffMs[ucSlave] - ulDue) > 0)
+            {
+              ulDue = xSched.ulBackoffMs[ucSlave];
+            }
+        }
+
+      if ((int32_t)(ulDue - ulNow) > 0)
+        {
+          if (ulDue - ulNow < ulWait)
+            {
+              ulWait = ulDue - ulNow;
+            }
+
+          continue;
+        }
+
+      ucRank = (uint8_t)(ucSlave - xSched.ucLastSlave - 1);
+      if (pxBest == NULL || ucRank < ucBestRank ||
+          (ucRank == ucBestRank &&
+           (int32_t)(pxEntry->ulNextMs - pxBest->ulNextMs) < 0))
+        {
+          pxBest     = pxEntry;
+          ucBestRank = ucRank;
+          iBestPos   = i;
+        }
+    }
+
+  if (pxBest == NULL)
+    {
+      return ulWait;
+    }
+
+  xSched.ucSlave    = pxBest->pxCfg->ucSlave;
+  xSched.ucFunction = pxBest->pxCfg->ucFunction;
+  prvvMBSchedCoalesce(iBestPos, ulNow);
+
+  xSched.bActive = true;
+  eErr = prveMBSchedRequest();
+  xSched.bActive = false;
+
+  ulNow = prvulMBSchedNow();
+  xSched.ucLastSlave = xSched.ucSlave;
+  if (eErr == MB_MRE_TIMEDOUT)
+    {
+      xSched.ulBackoffMs[xSched.ucSlave] =
+        ulNow + CONFIG_MB_MASTER_SCHED_BACKOFF_MS;
+      xSched.bBackoff[xSched.ucSlave] = true;
+    }
+
+  pthread_mutex_lock(&xSchedLock);
+  for (i = 0; i < xSched.iCount; i++)
+    {
+      pxEntry = &xSched.xEntries[i];
+      if (!pxEntry->bSelected)
+        {
+          continue;
+        }
+
+      pxEntry->bSelected = false;
+      pxEntry->xStatus.eLastError = eErr;
+      if (eErr == MB_MRE_NO_ERR)
+        {
+          pxEntry->xStatus.ulUpdates++;
+          pxEntry->xStatus.ulLastUpdateMs = ulNow;
+        }
+      else
+        {
+          pxEntry->xStatus.ulErrors++;
+        }
+
+      /* Keep the phase; drop the missed periods after a long stall. */
+
+      pxEntry->ulNextMs += pxEntry->pxCfg->ulPeriodMs;
+      if ((int32_t)(pxEntry->ulNextMs - ulNow) < 0)
+        {
+          pxEntry->ulNextMs = ulNow;
+        }
+    }
+
+  pthread_mutex_unlock(&xSchedLock);
+  return 0;
+}
+
+eMBErrorCode eMBMasterSchedRun(void)
+{
+  uint32_t ulWait;
+
+  if (xSched.iCount == 0)
+    {
+      return MB_EILLSTATE;
+    }
+
+  xSched.bRunning = true;
+  while (xSched.bRunning)
+    {
+      ulWait = ulMBMasterSchedRunOnce();
+      if (ulWait > 0)
+        {
+          usleep(ulWait * 1000);
+        }
+    }
+
+  return MB_ENOERR;
+}
+
+void vMBMasterSchedStop(void)
+{
+  xSched.bRunning = false;
+}
+
+eMBErrorCode eMBMasterSchedGetStatus(int iEntry,
+                                     xMBMasterPollStatus *pxStatus)
+{
+  if (iEntry < 0 || iEntry >= xSched.iCount || pxStatus == NULL)
+    {
+      return MB_EINVAL;
+    }
+
+  pthread_mutex_lock(&xSchedLock);
+  *pxStatus = xSched.xEntries[iEntry].xStatus;
+  pthread_mutex_unlock(&xSchedLock);
+  return MB_ENOERR;
+}
+
+void vMBMasterSchedLock(void)
+{
+  pthread_mutex_lock(&xSchedLock);
+}
+
+void vMBMasterSchedUnlock(void)
+{
+  pthread_mutex_unlock(&xSchedLock);
+}
@@ -0,0 +1,188 @@
+/****************************************************************************
+ * apps/modbus/nuttx/mbinst.h
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_MODBUS_NUTTX_MBINST_H
+#define __APPS_MODBUS_NUTTX_MBINST_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <termios.h>
+
+#include "modbus/mb.h"
+#include "modbus/mbframe.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Size of the RTU frame buffer and of the serial port buffer.  The serial
+ * buffer must hold a complete ASCII frame if ASCII support is enabled.
+ */
+
+#define MB_INST_RTU_BUF_SIZE    256
+
+#ifdef CONFIG_MB_ASCII_ENABLED
+#  define MB_INST_SER_BUF_SIZE  513
+#else
+#  define MB_INST_SER_BUF_SIZE  256
+#endif
+
+/* The serial layer of the default instance waits this long for the first
+ * character in each poll.  Instances created with eMBInitInst() never
+ * block; eMBPollInstances() waits for all of them at once instead.
+ */
+
+#define MB_INST_SER_WAIT_US     50000
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+typedef enum
+{
+  STATE_ENABLED,
+  STATE_DISABLED,
+  STATE_NOT_INITIALIZED
+} eMBInstState;
+
+/* State of the RTU framing layer (rtu/mbrtu.c) */
+
+typedef enum
+{
+  STATE_RX_INIT,                /* Receiver is in initial state. */
+  STATE_RX_IDLE,                /* Receiver is in idle state. */
+  STATE_RX_RCV,                 /* Frame is being received. */
+  STATE_RX_ERROR                /* If the frame is invalid. */
+} eMBRcvState;
+
+typedef enum
+{
+  STATE_TX_IDLE,                /* Transmitter is in idle state. */
+  STATE_TX_XMIT                 /* Transmitter is in transfer state. */
+} eMBSndState;
+
+struct xMBRTUState
+{
+  volatile eMBSndState  eSndState;
+  volatile eMBRcvState  eRcvState;
+  volatile uint8_t     *pucRTUBuf;
+  volatile uint8_t     *pucSndBufferCur;
+  volatile uint16_t     usSndBufferCount;
+  volatile uint16_t     usRcvBufferPos;
+};
+
+/* State of the serial port (nuttx/portserial.c) */
+
+struct xMBSerialState
+{
+  int            iSerialFd;
+  bool           bRxEnabled;
+  bool           bTxEnabled;
+  uint32_t       ulWaitUs;
+  uint32_t       ulTimeoutMs;
+  uint8_t        ucBuffer[MB_INST_SER_BUF_SIZE];
+  int            uiRxBufferPos;
+  int            uiTxBufferPos;
+  struct termios xOldTIO;
+};
+
+/* State of the timer (nuttx/porttimer.c) */
+
+struct xMBTimerState
+{
+  uint32_t       ulTimeOut;
+  bool           bTimeoutEnable;
+  struct timeval xTimeLast;
+};
+
+/* State of the event queue (nuttx/portevent.c) */
+
+struct xMBEventState
+{
+  eMBEventType   eQueuedEvent;
+  bool           xEventInQueue;
+};
+
+/* One Modbus slave: the protocol state of mb.c and the state of every
+ * layer below it.  All layers work on the instance pxMBInstCur points to.
+ * It is the default instance used by eMBInit() and friends, except while
+ * one of the eMB*Inst() functions runs on behalf of another instance.
+ */
+
+struct xMBInstance
+{
+  bool                  bInUse;
+  uint8_t               ucMBAddress;
+  eMBMode               eMBCurrentMode;
+  eMBInstState          eMBState;
+
+  /* Set in eMBInit() to the implementation of the selected mode */
+
+  peMBFrameSend         peMBFrameSendCur;
+  pvMBFrameStart        pvMBFrameStartCur;
+  pvMBFrameStop         pvMBFrameStopCur;
+  peMBFrameReceive      peMBFrameReceiveCur;
+  pvMBFrameClose        pvMBFrameCloseCur;
+
+  /* Called by the porting layer when a character was received, the
+   * transmitter is empty or the timer expired.
+   */
+
+  bool                (*pxMBFrameCBByteReceived)(void);
+  bool                (*pxMBFrameCBTransmitterEmpty)(void);
+  bool                (*pxMBPortCBTimerExpired)(void);
+
+  /* The request in progress in eMBPoll() */
+
+  uint8_t              *pucMBFrame;
+  uint8_t               ucRcvAddress;
+  uint8_t               ucFunctionCode;
+  uint16_t              usLength;
+  eMBException          eException;
+
+  struct xMBRTUState    xRTU;
+  struct xMBSerialState xSerial;
+  struct xMBTimerState  xTimer;
+  struct xMBEventState  xEvent;
+};
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+extern struct xMBInstance *pxMBInstCur;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __APPS_MODBUS_NUTTX_MBINST_H */
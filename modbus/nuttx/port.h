@@ -85,6 +85,9 @@ void vMBPortLog(eMBPortLogLevel eLevel, const char *szModule,
 void vMBPortTimerPoll(void);
 bool xMBPortSerialPoll(void);
 bool xMBPortSerialSetTimeout(uint32_t dwTimeoutMs);
+#if defined(CONFIG_MB_TCP_ENABLED) && defined(CONFIG_NET_TCP)
+bool xMBPortTCPPoll(void);
+#endif
 
 #if defined(CONFIG_MB_RTU_MASTER) || defined(CONFIG_MB_ASCII_MASTER)
   void vMBMasterPortEnterCritical(void);
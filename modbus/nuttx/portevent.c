@@ -33,17 +33,13 @@
  * Included Files
  ****************************************************************************/
 
+#include <nuttx/config.h>
+
 #include "modbus/mb.h"
 #include "modbus/mbport.h"
 
 #include "port.h"
-
-/****************************************************************************
- * Private Data
- ****************************************************************************/
-
-static eMBEventType eQueuedEvent;
-static bool xEventInQueue;
+#include "mbinst.h"
 
 /****************************************************************************
  * Public Functions
@@ -51,25 +47,28 @@ static bool xEventInQueue;
 
 bool xMBPortEventInit(void)
 {
-  xEventInQueue = false;
+  pxMBInstCur->xEvent.xEventInQueue = false;
   return true;
 }
 
 bool xMBPortEventPost(eMBEventType eEvent)
 {
-  xEventInQueue = true;
-  eQueuedEvent = eEvent;
+  struct xMBEventState *pxEv = &pxMBInstCur->xEvent;
+
+  pxEv->xEventInQueue = true;
+  pxEv->eQueuedEvent = eEvent;
   return true;
 }
 
 bool xMBPortEventGet(eMBEventType * eEvent)
 {
+  struct xMBEventState *pxEv = &pxMBInstCur->xEvent;
   bool xEventHappened = false;
 
-  if (xEventInQueue)
+  if (pxEv->xEventInQueue)
     {
-      *eEvent = eQueuedEvent;
-      xEventInQueue = false;
+      *eEvent = pxEv->eQueuedEvent;
+      pxEv->xEventInQueue = false;
       xEventHappened = true;
     }
   else
@@ -83,6 +82,17 @@ bool xMBPortEventGet(eMBEventType * eEvent)
 
       xMBPortSerialPoll();
 
+#if defined(CONFIG_MB_TCP_ENABLED) && defined(CONFIG_NET_TCP)
+      /* Accept, read and split the requests of the TCP clients.  The TCP
+       * port serves only the instance initialized with eMBTCPInit().
+       */
+
+      if (pxMBInstCur->eMBCurrentMode == MB_TCP)
+        {
+          xMBPortTCPPoll();
+        }
+#endif
+
       /* Check if any of the timers have expired. */
 
       vMBPortTimerPoll();
@@ -48,35 +48,11 @@
 #include <termios.h>
 
 #include "port.h"
+#include "mbinst.h"
 
 #include "modbus/mb.h"
 #include "modbus/mbport.h"
 
-/****************************************************************************
- * Pre-processor Definitions
- ****************************************************************************/
-
-#ifdef CONFIG_MB_ASCII_ENABLED
-#define BUF_SIZE    513         /* must hold a complete ASCII frame. */
-#else
-#define BUF_SIZE    256         /* must hold a complete RTU frame. */
-#endif
-
-/****************************************************************************
- * Private Data
- ****************************************************************************/
-
-static int      iSerialFd = -1;
-static bool     bRxEnabled;
-static bool     bTxEnabled;
-
-static uint32_t ulTimeoutMs;
-static uint8_t  ucBuffer[BUF_SIZE];
-static int      uiRxBufferPos;
-static int      uiTxBufferPos;
-
-static struct termios xOldTIO;
-
 /****************************************************************************
  * Private Function Prototypes
  ****************************************************************************/
@@ -92,15 +68,16 @@ static bool prvbMBPortSerialWrite(uint8_t *pucBuffer, uint16_t usNBytes);
 static bool prvbMBPortSerialRead(uint8_t *pucBuffer, uint16_t usNBytes,
                                  uint16_t *usNBytesRead)
 {
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
   bool            bResult = true;
   ssize_t         res;
   fd_set          rfds;
   struct timeval  tv;
 
   tv.tv_sec = 0;
-  tv.tv_usec = 50000;
+  tv.tv_usec = pxSer->ulWaitUs;
   FD_ZERO(&rfds);
-  FD_SET(iSerialFd, &rfds);
+  FD_SET(pxSer->iSerialFd, &rfds);
 
   /* Wait until character received or timeout. Recover in case of an
    * interrupted read system call.
@@ -108,16 +85,16 @@ static bool prvbMBPortSerialRead(uint8_t *pucBuffer, uint16_t usNBytes,
 
   do
     {
-      if (select(iSerialFd + 1, &rfds, NULL, NULL, &tv) == -1)
+      if (select(pxSer->iSerialFd + 1, &rfds, NULL, NULL, &tv) == -1)
         {
           if (errno != EINTR)
             {
               bResult = false;
             }
         }
-      else if (FD_ISSET(iSerialFd, &rfds))
+      else if (FD_ISSET(pxSer->iSerialFd, &rfds))
         {
-          if ((res = read(iSerialFd, pucBuffer, usNBytes)) == -1)
+          if ((res = read(pxSer->iSerialFd, pucBuffer, usNBytes)) == -1)
             {
               bResult = false;
             }
@@ -140,13 +117,14 @@ static bool prvbMBPortSerialRead(uint8_t *pucBuffer, uint16_t usNBytes,
 
 static bool prvbMBPortSerialWrite(uint8_t *pucBuffer, uint16_t usNBytes)
 {
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
   ssize_t res;
   size_t  left = (size_t) usNBytes;
   size_t  done = 0;
 
   while (left > 0)
     {
-      if ((res = write(iSerialFd, pucBuffer + done, left)) == -1)
+      if ((res = write(pxSer->iSerialFd, pucBuffer + done, left)) == -1)
         {
           if (errno != EINTR)
             {
@@ -171,48 +149,51 @@ static bool prvbMBPortSerialWrite(uint8_t *pucBuffer, uint16_t usNBytes)
 
 void vMBPortSerialEnable(bool bEnableRx, bool bEnableTx)
 {
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
+
   /* it is not allowed that both receiver and transmitter are enabled. */
 
   DEBUGASSERT(!bEnableRx || !bEnableTx);
 
   if (bEnableRx)
     {
-      tcflush(iSerialFd, TCIFLUSH);
-      uiRxBufferPos = 0;
-      bRxEnabled = true;
+      tcflush(pxSer->iSerialFd, TCIFLUSH);
+      pxSer->uiRxBufferPos = 0;
+      pxSer->bRxEnabled = true;
     }
   else
     {
-      bRxEnabled = false;
+      pxSer->bRxEnabled = false;
     }
 
   if (bEnableTx)
     {
-      bTxEnabled = true;
-      uiTxBufferPos = 0;
+      pxSer->bTxEnabled = true;
+      pxSer->uiTxBufferPos = 0;
     }
   else
     {
-      bTxEnabled = false;
+      pxSer->bTxEnabled = false;
     }
 }
 
 bool xMBPortSerialInit(uint8_t ucPort, speed_t ulBaudRate,
                        uint8_t ucDataBits, eMBParity eParity)
 {
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
   char szDevice[16];
   bool bStatus = true;
   struct termios xNewTIO;
 
   snprintf(szDevice, 16, "/dev/ttyS%d", ucPort);
 
-  if ((iSerialFd = open(szDevice, O_RDWR | O_NOCTTY)) < 0)
+  if ((pxSer->iSerialFd = open(szDevice, O_RDWR | O_NOCTTY)) < 0)
     {
       vMBPortLog(MB_LOG_ERROR, "SER-INIT", "Can't open serial port %s: %d\n",
                  szDevice, errno);
       bStatus = false;
     }
-  else if (tcgetattr(iSerialFd, &xOldTIO) != 0)
+  else if (tcgetattr(pxSer->iSerialFd, &pxSer->xOldTIO) != 0)
     {
       vMBPortLog(MB_LOG_ERROR,
                  "SER-INIT", "Can't get settings from port %s: %d\n",
@@ -276,7 +257,7 @@ bool xMBPortSerialInit(uint8_t ucPort, speed_t ulBaudRate,
                          "Can't set baud rate %ld for port %s: %d\n",
                          ulBaudRate, szDevice, errno);
             }
-          else if (tcsetattr(iSerialFd, TCSANOW, &xNewTIO) != 0)
+          else if (tcsetattr(pxSer->iSerialFd, TCSANOW, &xNewTIO) != 0)
             {
               vMBPortLog(MB_LOG_ERROR,
                          "SER-INIT", "Can't set settings for port %s: %d\n",
@@ -295,13 +276,15 @@ bool xMBPortSerialInit(uint8_t ucPort, speed_t ulBaudRate,
 
 bool xMBPortSerialSetTimeout(uint32_t ulNewTimeoutMs)
 {
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
+
   if (ulNewTimeoutMs > 0)
     {
-      ulTimeoutMs = ulNewTimeoutMs;
+      pxSer->ulTimeoutMs = ulNewTimeoutMs;
     }
   else
     {
-      ulTimeoutMs = 1;
+      pxSer->ulTimeoutMs = 1;
     }
 
   return true;
@@ -309,23 +292,27 @@ bool xMBPortSerialSetTimeout(uint32_t ulNewTimeoutMs)
 
 void vMBPortClose(void)
 {
-  if (iSerialFd != -1)
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
+
+  if (pxSer->iSerialFd != -1)
     {
-      tcsetattr(iSerialFd, TCSANOW, &xOldTIO);
-      close(iSerialFd);
-      iSerialFd = -1;
+      tcsetattr(pxSer->iSerialFd, TCSANOW, &pxSer->xOldTIO);
+      close(pxSer->iSerialFd);
+      pxSer->iSerialFd = -1;
     }
 }
 
 bool xMBPortSerialPoll(void)
 {
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
   bool     bStatus = true;
   uint16_t usBytesRead;
   int      i;
 
-  while (bRxEnabled)
+  while (pxSer->bRxEnabled)
     {
-      if (prvbMBPortSerialRead(&ucBuffer[0], BUF_SIZE, &usBytesRead))
+      if (prvbMBPortSerialRead(&pxSer->ucBuffer[0], MB_INST_SER_BUF_SIZE,
+                               &usBytesRead))
         {
           if (usBytesRead == 0)
             {
@@ -339,10 +326,10 @@ bool xMBPortSerialPoll(void)
                 {
                   /* Call the modbus stack and let him fill the buffers. */
 
-                  pxMBFrameCBByteReceived();
+                  pxMBInstCur->pxMBFrameCBByteReceived();
                 }
 
-              uiRxBufferPos = 0;
+              pxSer->uiRxBufferPos = 0;
             }
         }
       else
@@ -354,16 +341,17 @@ bool xMBPortSerialPoll(void)
         }
     }
 
-  if (bTxEnabled)
+  if (pxSer->bTxEnabled)
     {
-      while (bTxEnabled)
+      while (pxSer->bTxEnabled)
         {
-          pxMBFrameCBTransmitterEmpty();
+          pxMBInstCur->pxMBFrameCBTransmitterEmpty();
 
           /* Call the modbus stack to let him fill the buffer. */
         }
 
-      if (!prvbMBPortSerialWrite(&ucBuffer[0], uiTxBufferPos))
+      if (!prvbMBPortSerialWrite(&pxSer->ucBuffer[0],
+                                 pxSer->uiTxBufferPos))
         {
           vMBPortLog(MB_LOG_ERROR,
                      "SER-POLL", "write failed on serial device: %d\n",
@@ -377,16 +365,20 @@ bool xMBPortSerialPoll(void)
 
 bool xMBPortSerialPutByte(int8_t ucByte)
 {
-  DEBUGASSERT(uiTxBufferPos < BUF_SIZE);
-  ucBuffer[uiTxBufferPos] = ucByte;
-  uiTxBufferPos++;
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
+
+  DEBUGASSERT(pxSer->uiTxBufferPos < MB_INST_SER_BUF_SIZE);
+  pxSer->ucBuffer[pxSer->uiTxBufferPos] = ucByte;
+  pxSer->uiTxBufferPos++;
   return true;
 }
 
 bool xMBPortSerialGetByte(int8_t *pucByte)
 {
-  DEBUGASSERT(uiRxBufferPos < BUF_SIZE);
-  *pucByte = ucBuffer[uiRxBufferPos];
-  uiRxBufferPos++;
+  struct xMBSerialState *pxSer = &pxMBInstCur->xSerial;
+
+  DEBUGASSERT(pxSer->uiRxBufferPos < MB_INST_SER_BUF_SIZE);
+  *pucByte = pxSer->ucBuffer[pxSer->uiRxBufferPos];
+  pxSer->uiRxBufferPos++;
   return true;
 }
@@ -0,0 +1,439 @@
+/****************************************************************************
+ * apps/modbus/nuttx/porttcp.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "port.h"
+
+#include "modbus/mb.h"
+#include "modbus/mbport.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define MB_TCP_DEFAULT_PORT 502     /* TCP listening port. */
+#define MB_TCP_POLL_TIMEOUT 50      /* Poll timeout in ms. */
+#define MB_TCP_SEND_TIMEOUT 1000    /* Response send timeout in ms. */
+
+#define MB_TCP_LEN          4       /* Offset of the MBAP length field. */
+#define MB_TCP_FUNC         7       /* Offset of the Modbus PDU. */
+#define MB_TCP_BUF_SIZE     (256 + 7) /* Must hold a complete ADU. */
+
+#if CONFIG_MB_TCP_CLIENT_BUFSIZE < MB_TCP_BUF_SIZE
+#  error CONFIG_MB_TCP_CLIENT_BUFSIZE must hold a complete request
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* A client connection.  Requests are appended to aucRxBuf as they arrive
+ * and handed to the protocol stack one at a time.  A client that has shut
+ * down its side is kept until its buffered requests have been answered.
+ */
+
+typedef struct
+{
+  int      iSocket;
+  bool     bClosing;
+  uint16_t usRxPos;
+  uint8_t  aucRxBuf[CONFIG_MB_TCP_CLIENT_BUFSIZE];
+} xMBTCPClient;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static int          iListenSocket = -1;
+static xMBTCPClient xClients[CONFIG_MB_TCP_NCLIENTS];
+static struct pollfd xPollFds[CONFIG_MB_TCP_NCLIENTS + 1];
+
+/* The request being executed, the response is built in place. */
+
+static uint8_t      aucTCPBuf[MB_TCP_BUF_SIZE];
+static uint16_t     usTCPBufPos;
+static int          iCurrentClient = -1;
+
+/* The client whose request is taken next, so that all clients are served
+ * in turn even if one of them sends requests back to back.
+ */
+
+static int          iNextClient;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void prvvMBTCPClientClose(int iClient)
+{
+  if (xClients[iClient].iSocket != -1)
+    {
+      close(xClients[iClient].iSocket);
+      xClients[iClient].iSocket  = -1;
+      xClients[iClient].bClosing = false;
+      xClients[iClient].usRxPos  = 0;
+    }
+
+  if (iCurrentClient == iClient)
+    {
+      iCurrentClient = -1;
+    }
+}
+
+static void prvvMBTCPAccept(void)
+{
+  int iSocket;
+  int i;
+
+  iSocket = accept(iListenSocket, NULL, NULL);
+  if (iSocket < 0)
+    {
+      return;
+    }
+
+  for (i = 0; i < CONFIG_MB_TCP_NCLIENTS; i++)
+    {
+      if (xClients[i].iSocket == -1)
+        {
+          fcntl(iSocket, F_SETFL, fcntl(iSocket, F_GETFL) | O_NONBLOCK);
+          xClients[i].iSocket  = iSocket;
+          xClients[i].bClosing = false;
+          xClients[i].usRxPos  = 0;
+          vMBPortLog(MB_LOG_DEBUG, "TCP-ACCEPT", "client %d connected\n", i);
+          return;
+        }
+    }
+
+  /* Cannot happen, the listen socket is only polled with a free slot. */
+
+  close(iSocket);
+}
+
+static void prvvMBTCPRead(int iClient)
+{
+  xMBTCPClient *pxClient = &xClients[iClient];
+  ssize_t       res;
+
+  if (pxClient->usRxPos == CONFIG_MB_TCP_CLIENT_BUFSIZE)
+    {
+      return;
+    }
+
+  res = read(pxClient->iSocket, &pxClient->aucRxBuf[pxClient->usRxPos],
+             CONFIG_MB_TCP_CLIENT_BUFSIZE - pxClient->usRxPos);
+  if (res > 0)
+    {
+      pxClient->usRxPos += res;
+    }
+  else if (res == 0)
+    {
+      /* Answer the requests sent before the end of the stream first. */
+
+      vMBPortLog(MB_LOG_DEBUG, "TCP-READ", "client %d closed\n", iClient);
+      pxClient->bClosing = true;
+    }
+  else if (errno != EAGAIN && errno != EINTR)
+    {
+      vMBPortLog(MB_LOG_DEBUG, "TCP-READ", "client %d failed: %d\n",
+                 iClient, errno);
+      prvvMBTCPClientClose(iClient);
+    }
+}
+
+/* Move the first complete request of a client to aucTCPBuf.
+ *
+ * Returned Value:
+ *   true if a request was taken.
+ */
+
+static bool prvbMBTCPTakeRequest(int iClient)
+{
+  xMBTCPClient *pxClient = &xClients[iClient];
+  uint16_t      usLength;
+
+  if (pxClient->iSocket == -1)
+    {
+      return false;
+    }
+
+  usLength = MB_TCP_BUF_SIZE + 1;
+  if (pxClient->usRxPos >= MB_TCP_FUNC)
+    {
+      /* The MBAP length counts the unit identifier and the PDU. */
+
+      usLength = pxClient->aucRxBuf[MB_TCP_LEN] << 8U;
+      usLength |= pxClient->aucRxBuf[MB_TCP_LEN + 1];
+      usLength += MB_TCP_FUNC - 1;
+
+      if (usLength <= MB_TCP_FUNC || usLength > MB_TCP_BUF_SIZE)
+        {
+          /* The stream cannot be resynchronized. */
+
+          vMBPortLog(MB_LOG_WARN, "TCP-RECV", "client %d bad length %u\n",
+                     iClient, usLength);
+          prvvMBTCPClientClose(iClient);
+          return false;
+        }
+    }
+
+  if (pxClient->usRxPos < usLength)
+    {
+      /* A closed client has nothing more to send. */
+
+      if (pxClient->bClosing && iCurrentClient != iClient)
+        {
+          prvvMBTCPClientClose(iClient);
+        }
+
+      return false;
+    }
+
+  memcpy(aucTCPBuf, pxClient->aucRxBuf, usLength);
+  usTCPBufPos = usLength;
+
+  pxClient->usRxPos -= usLength;
+  memmove(pxClient->aucRxBuf, &pxClient->aucRxBuf[usLength],
+          pxClient->usRxPos);
+
+  iCurrentClient = iClient;
+  return true;
+}
+
+/* Hand the next buffered request to the protocol stack. */
+
+static bool prvbMBTCPNextRequest(void)
+{
+  int i;
+  int iClient;
+
+  for (i = 0; i < CONFIG_MB_TCP_NCLIENTS; i++)
+    {
+      iClient = (iNextClient + i) % CONFIG_MB_TCP_NCLIENTS;
+      if (prvbMBTCPTakeRequest(iClient))
+        {
+          iNextClient = (iClient + 1) % CONFIG_MB_TCP_NCLIENTS;
+          xMBPortEventPost(EV_FRAME_RECEIVED);
+          return true;
+        }
+    }
+
+  return false;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+bool xMBTCPPortInit(uint16_t usTCPPort)
+{
+  struct sockaddr_in xAddr;
+  int                iOpt = 1;
+  int                i;
+
+  for (i = 0; i < CONFIG_MB_TCP_NCLIENTS; i++)
+    {
+      xClients[i].iSocket  = -1;
+      xClients[i].bClosing = false;
+      xClients[i].usRxPos  = 0;
+    }
+
+  iCurrentClient = -1;
+  iNextClient = 0;
+
+  iListenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (iListenSocket < 0)
+    {
+      vMBPortLog(MB_LOG_ERROR, "TCP-INIT", "Can't create socket: %d\n",
+                 errno);
+      return false;
+    }
+
+  setsockopt(iListenSocket, SOL_SOCKET, SO_REUSEADDR, &iOpt, sizeof(iOpt));
+
+  memset(&xAddr, 0, sizeof(xAddr));
+  xAddr.sin_family      = AF_INET;
+  xAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  xAddr.sin_port        = htons(usTCPPort == MB_TCP_PORT_USE_DEFAULT ?
+                                MB_TCP_DEFAULT_PORT : usTCPPort);
+
+  if (bind(iListenSocket, (struct sockaddr *)&xAddr, sizeof(xAddr)) < 0 ||
+      listen(iListenSocket, CONFIG_MB_TCP_NCLIENTS) < 0)
+    {
+      vMBPortLog(MB_LOG_ERROR, "TCP-INIT", "Can't listen on port %u: %d\n",
+                 usTCPPort, errno);
+      close(iListenSocket);
+      iListenSocket = -1;
+      return false;
+    }
+
+  return true;
+}
+
+#ifdef CONFIG_MB_HAVE_CLOSE
+void vMBTCPPortClose(void)
+{
+  vMBTCPPortDisable();
+
+  if (iListenSocket != -1)
+    {
+      close(iListenSocket);
+      iListenSocket = -1;
+    }
+}
+#endif
+
+void vMBTCPPortDisable(void)
+{
+  int i;
+
+  for (i = 0; i < CONFIG_MB_TCP_NCLIENTS; i++)
+    {
+      prvvMBTCPClientClose(i);
+    }
+}
+
+bool xMBPortTCPPoll(void)
+{
+  bool bFree = false;
+  int  iReady;
+  int  i;
+
+  if (iListenSocket == -1)
+    {
+      return false;
+    }
+
+  /* Pipelined requests are served before waiting for new data. */
+
+  if (prvbMBTCPNextRequest())
+    {
+      return true;
+    }
+
+  /* Wait for connections and data.  A client with a full buffer is not
+   * polled until its requests have been answered, otherwise a hangup
+   * would be reported again and again without anything to read.
+   */
+
+  for (i = 0; i < CONFIG_MB_TCP_NCLIENTS; i++)
+    {
+      xPollFds[i].fd      = xClients[i].iSocket;
+      xPollFds[i].events  = POLLIN;
+      xPollFds[i].revents = 0;
+
+      if (xClients[i].iSocket == -1)
+        {
+          bFree = true;
+        }
+      else if (xClients[i].bClosing ||
+               xClients[i].usRxPos == CONFIG_MB_TCP_CLIENT_BUFSIZE)
+        {
+          xPollFds[i].fd = -1;
+        }
+    }
+
+  xPollFds[i].fd      = bFree ? iListenSocket : -1;
+  xPollFds[i].events  = POLLIN;
+  xPollFds[i].revents = 0;
+
+  iReady = poll(xPollFds, CONFIG_MB_TCP_NCLIENTS + 1, MB_TCP_POLL_TIMEOUT);
+  if (iReady <= 0)
+    {
+      return iReady == 0 || errno == EINTR;
+    }
+
+  for (i = 0; i < CONFIG_MB_TCP_NCLIENTS; i++)
+    {
+      if (xPollFds[i].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+          prvvMBTCPRead(i);
+        }
+    }
+
+  if (xPollFds[i].revents & POLLIN)
+    {
+      prvvMBTCPAccept();
+    }
+
+  prvbMBTCPNextRequest();
+  return true;
+}
+
+bool xMBTCPPortGetRequest(uint8_t **ppucMBTCPFrame, uint16_t *usTCPLength)
+{
+  *ppucMBTCPFrame = aucTCPBuf;
+  *usTCPLength = usTCPBufPos;
+
+  return true;
+}
+
+bool xMBTCPPortSendResponse(const uint8_t *pucMBTCPFrame,
+                            uint16_t usTCPLength)
+{
+  struct pollfd xPollFd;
+  ssize_t       res;
+  size_t        done = 0;
+
+  if (iCurrentClient == -1)
+    {
+      /* The client disconnected while its request was executed. */
+
+      return false;
+    }
+
+  xPollFd.fd     = xClients[iCurrentClient].iSocket;
+  xPollFd.events = POLLOUT;
+
+  while (done < usTCPLength)
+    {
+      res = write(xPollFd.fd, pucMBTCPFrame + done, usTCPLength - done);
+      if (res >= 0)
+        {
+          done += res;
+        }
+      else if (errno == EINTR)
+        {
+          continue;
+        }
+      else if (errno != EAGAIN ||
+               poll(&xPollFd, 1, MB_TCP_SEND_TIMEOUT) <= 0)
+        {
+          vMBPortLog(MB_LOG_WARN, "TCP-SEND", "client %d send failed: %d\n",
+                     iCurrentClient, errno);
+          prvvMBTCPClientClose(iCurrentClient);
+          return false;
+        }
+    }
+
+  iCurrentClient = -1;
+  return true;
+}
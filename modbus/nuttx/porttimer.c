@@ -40,32 +40,26 @@
 #include <assert.h>
 
 #include "port.h"
+#include "mbinst.h"
 
 #include "modbus/mb.h"
 #include "modbus/mbport.h"
 
-/****************************************************************************
- * Public Data
- ****************************************************************************/
-
-uint32_t ulTimeOut;
-bool     bTimeoutEnable;
-
-static struct timeval xTimeLast;
-
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
 
 bool xMBPortTimersInit(uint16_t usTim1Timerout50us)
 {
-  ulTimeOut = usTim1Timerout50us / 20U;
-  if (ulTimeOut == 0)
+  struct xMBTimerState *pxTim = &pxMBInstCur->xTimer;
+
+  pxTim->ulTimeOut = usTim1Timerout50us / 20U;
+  if (pxTim->ulTimeOut == 0)
     {
-      ulTimeOut = 1;
+      pxTim->ulTimeOut = 1;
     }
 
-  return xMBPortSerialSetTimeout(ulTimeOut);
+  return xMBPortSerialSetTimeout(pxTim->ulTimeOut);
 }
 
 void xMBPortTimersClose()
@@ -75,6 +69,7 @@ void xMBPortTimersClose()
 
 void vMBPortTimerPoll()
 {
+  struct xMBTimerState *pxTim = &pxMBInstCur->xTimer;
   uint32_t       ulDeltaMS;
   struct timeval xTimeCur;
 
@@ -82,7 +77,7 @@ void vMBPortTimerPoll()
    * res timer in Win32.
    */
 
-  if (bTimeoutEnable)
+  if (pxTim->bTimeoutEnable)
     {
       if (gettimeofday(&xTimeCur, NULL) != 0)
         {
@@ -90,12 +85,12 @@ void vMBPortTimerPoll()
         }
       else
         {
-          ulDeltaMS = (xTimeCur.tv_sec - xTimeLast.tv_sec) * 1000L +
-                      (xTimeCur.tv_usec - xTimeLast.tv_usec) * 1000L;
-          if (ulDeltaMS > ulTimeOut)
+          ulDeltaMS = (xTimeCur.tv_sec - pxTim->xTimeLast.tv_sec) * 1000L +
+                      (xTimeCur.tv_usec - pxTim->xTimeLast.tv_usec) / 1000L;
+          if (ulDeltaMS > pxTim->ulTimeOut)
             {
-              bTimeoutEnable = false;
-              pxMBPortCBTimerExpired();
+              pxTim->bTimeoutEnable = false;
+              pxMBInstCur->pxMBPortCBTimerExpired();
             }
         }
     }
@@ -103,13 +98,14 @@ void vMBPortTimerPoll()
 
 void vMBPortTimersEnable()
 {
-  int res = gettimeofday(&xTimeLast, NULL);
+  struct xMBTimerState *pxTim = &pxMBInstCur->xTimer;
+  int res = gettimeofday(&pxTim->xTimeLast, NULL);
 
   DEBUGASSERT(res == 0);
-  bTimeoutEnable = true;
+  pxTim->bTimeoutEnable = true;
 }
 
 void vMBPortTimersDisable()
 {
-  bTimeoutEnable = false;
+  pxMBInstCur->xTimer.bTimeoutEnable = false;
 }
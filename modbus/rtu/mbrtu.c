@@ -44,6 +44,7 @@
 #include "modbus/mbframe.h"
 #include "modbus/mbport.h"
 
+#include "mbinst.h"
 #include "mbrtu.h"
 #include "mbcrc.h"
 
@@ -58,37 +59,13 @@
 #define MB_SER_PDU_PDU_OFF      1    /* Offset of Modbus-PDU in Ser-PDU. */
 
 /****************************************************************************
- * Private Type Definitions
+ * Public Data
  ****************************************************************************/
 
-typedef enum
-{
-  STATE_RX_INIT,                /* Receiver is in initial state. */
-  STATE_RX_IDLE,                /* Receiver is in idle state. */
-  STATE_RX_RCV,                 /* Frame is being received. */
-  STATE_RX_ERROR                /* If the frame is invalid. */
-} eMBRcvState;
-
-typedef enum
-{
-  STATE_TX_IDLE,                /* Transmitter is in idle state. */
-  STATE_TX_XMIT                 /* Transmitter is in transfer state. */
-} eMBSndState;
-
-/****************************************************************************
- * Private Data
- ****************************************************************************/
-
-static volatile eMBSndState eSndState;
-static volatile eMBRcvState eRcvState;
+/* Frame buffer of the default instance, shared with the ASCII layer */
 
 volatile uint8_t  ucRTUBuf[MB_SER_PDU_SIZE_MAX];
 
-static volatile uint8_t *pucSndBufferCur;
-static volatile uint16_t usSndBufferCount;
-
-static volatile uint16_t usRcvBufferPos;
-
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -96,11 +73,19 @@ static volatile uint16_t usRcvBufferPos;
 eMBErrorCode eMBRTUInit(uint8_t ucSlaveAddress, uint8_t ucPort,
                         speed_t ulBaudRate, eMBParity eParity)
 {
+  struct xMBRTUState *pxRTU = &pxMBInstCur->xRTU;
   eMBErrorCode eStatus = MB_ENOERR;
   uint32_t usTimerT35_50us;
 
   ENTER_CRITICAL_SECTION();
 
+  /* Instances other than the default one bring their own frame buffer. */
+
+  if (pxRTU->pucRTUBuf == NULL)
+    {
+      pxRTU->pucRTUBuf = ucRTUBuf;
+    }
+
   /* Modbus RTU uses 8 Databits. */
 
   if (xMBPortSerialInit(ucPort, ulBaudRate, 8, eParity) != true)
@@ -143,6 +128,8 @@ eMBErrorCode eMBRTUInit(uint8_t ucSlaveAddress, uint8_t ucPort,
 
 void eMBRTUStart(void)
 {
+  struct xMBRTUState *pxRTU = &pxMBInstCur->xRTU;
+
   ENTER_CRITICAL_SECTION();
 
   /* Initially the receiver is in the state STATE_RX_INIT. we start
@@ -151,7 +138,7 @@ void eMBRTUStart(void)
    * modbus protocol stack until the bus is free.
    */
 
-  eRcvState = STATE_RX_INIT;
+  pxRTU->eRcvState = STATE_RX_INIT;
   vMBPortSerialEnable(true, false);
   vMBPortTimersEnable();
 
@@ -169,31 +156,33 @@ void eMBRTUStop(void)
 eMBErrorCode eMBRTUReceive(uint8_t *pucRcvAddress, uint8_t **pucFrame,
                            uint16_t *pusLength)
 {
+  struct xMBRTUState *pxRTU = &pxMBInstCur->xRTU;
   eMBErrorCode eStatus = MB_ENOERR;
 
   ENTER_CRITICAL_SECTION();
-  DEBUGASSERT(usRcvBufferPos < MB_SER_PDU_SIZE_MAX);
+  DEBUGASSERT(pxRTU->usRcvBufferPos < MB_SER_PDU_SIZE_MAX);
 
   /* Length and CRC check */
 
-  if ((usRcvBufferPos >= MB_SER_PDU_SIZE_MIN) &&
-      (usMBCRC16((uint8_t *) ucRTUBuf, usRcvBufferPos) == 0))
+  if ((pxRTU->usRcvBufferPos >= MB_SER_PDU_SIZE_MIN) &&
+      (usMBCRC16((uint8_t *)pxRTU->pucRTUBuf, pxRTU->usRcvBufferPos) == 0))
     {
       /* Save the address field. All frames are passed to the upper laid
        * and the decision if a frame is used is done there.
        */
 
-      *pucRcvAddress = ucRTUBuf[MB_SER_PDU_ADDR_OFF];
+      *pucRcvAddress = pxRTU->pucRTUBuf[MB_SER_PDU_ADDR_OFF];
 
       /* Total length of Modbus-PDU is Modbus-Serial-Line-PDU minus
        * size of address field and CRC checksum.
        */
 
-      *pusLength = (uint16_t)(usRcvBufferPos - MB_SER_PDU_PDU_OFF - MB_SER_PDU_SIZE_CRC);
+      *pusLength = (uint16_t)(pxRTU->usRcvBufferPos - MB_SER_PDU_PDU_OFF -
+                              MB_SER_PDU_SIZE_CRC);
 
       /* Return the start of the Modbus PDU to the caller. */
 
-      *pucFrame = (uint8_t *) & ucRTUBuf[MB_SER_PDU_PDU_OFF];
+      *pucFrame = (uint8_t *) &pxRTU->pucRTUBuf[MB_SER_PDU_PDU_OFF];
     }
   else
     {
@@ -206,6 +195,7 @@ eMBErrorCode eMBRTUReceive(uint8_t *pucRcvAddress, uint8_t **pucFrame,
 
 eMBErrorCode eMBRTUSend(uint8_t ucSlaveAddress, const uint8_t *pucFrame, uint16_t usLength)
 {
+  struct xMBRTUState *pxRTU = &pxMBInstCur->xRTU;
   eMBErrorCode eStatus = MB_ENOERR;
   uint16_t usCRC16;
 
@@ -216,27 +206,29 @@ eMBErrorCode eMBRTUSend(uint8_t ucSlaveAddress, const uint8_t *pucFrame, uint16_
    * frame on the network. We have to abort sending the frame.
    */
 
-  if (eRcvState == STATE_RX_IDLE)
+  if (pxRTU->eRcvState == STATE_RX_IDLE)
     {
       /* First byte before the Modbus-PDU is the slave address. */
 
-      pucSndBufferCur = (uint8_t *) pucFrame - 1;
-      usSndBufferCount = 1;
+      pxRTU->pucSndBufferCur = (uint8_t *) pucFrame - 1;
+      pxRTU->usSndBufferCount = 1;
 
       /* Now copy the Modbus-PDU into the Modbus-Serial-Line-PDU. */
 
-      pucSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
-      usSndBufferCount += usLength;
+      pxRTU->pucSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
+      pxRTU->usSndBufferCount += usLength;
 
       /* Calculate CRC16 checksum for Modbus-Serial-Line-PDU. */
 
-      usCRC16 = usMBCRC16((uint8_t *) pucSndBufferCur, usSndBufferCount);
-      ucRTUBuf[usSndBufferCount++] = (uint8_t)(usCRC16 & 0xFF);
-      ucRTUBuf[usSndBufferCount++] = (uint8_t)(usCRC16 >> 8);
+      usCRC16 = usMBCRC16((uint8_t *) pxRTU->pucSndBufferCur,
+                          pxRTU->usSndBufferCount);
+      pxRTU->pucRTUBuf[pxRTU->usSndBufferCount++] =
+        (uint8_t)(usCRC16 & 0xFF);
+      pxRTU->pucRTUBuf[pxRTU->usSndBufferCount++] = (uint8_t)(usCRC16 >> 8);
 
       /* Activate the transmitter. */
 
-      eSndState = STATE_TX_XMIT;
+      pxRTU->eSndState = STATE_TX_XMIT;
       vMBPortSerialEnable(false, true);
     }
   else
@@ -250,16 +242,17 @@ eMBErrorCode eMBRTUSend(uint8_t ucSlaveAddress, const uint8_t *pucFrame, uint16_
 
 bool xMBRTUReceiveFSM(void)
 {
+  struct xMBRTUState *pxRTU = &pxMBInstCur->xRTU;
   bool xTaskNeedSwitch = false;
   uint8_t ucByte;
 
-  DEBUGASSERT(eSndState == STATE_TX_IDLE);
+  DEBUGASSERT(pxRTU->eSndState == STATE_TX_IDLE);
 
   /* Always read the character. */
 
   xMBPortSerialGetByte((int8_t *) & ucByte);
 
-  switch (eRcvState)
+  switch (pxRTU->eRcvState)
     {
       /* If we have received a character in the init state we have to
        * wait until the frame is finished.
@@ -283,9 +276,9 @@ bool xMBRTUReceiveFSM(void)
        */
 
       case STATE_RX_IDLE:
-        usRcvBufferPos = 0;
-        ucRTUBuf[usRcvBufferPos++] = ucByte;
-        eRcvState = STATE_RX_RCV;
+        pxRTU->usRcvBufferPos = 0;
+        pxRTU->pucRTUBuf[pxRTU->usRcvBufferPos++] = ucByte;
+        pxRTU->eRcvState = STATE_RX_RCV;
 
         /* Enable t3.5 timers. */
 
@@ -299,13 +292,13 @@ bool xMBRTUReceiveFSM(void)
        */
 
       case STATE_RX_RCV:
-        if (usRcvBufferPos < MB_SER_PDU_SIZE_MAX)
+        if (pxRTU->usRcvBufferPos < MB_SER_PDU_SIZE_MAX)
           {
-            ucRTUBuf[usRcvBufferPos++] = ucByte;
+            pxRTU->pucRTUBuf[pxRTU->usRcvBufferPos++] = ucByte;
           }
         else
           {
-            eRcvState = STATE_RX_ERROR;
+            pxRTU->eRcvState = STATE_RX_ERROR;
           }
 
         vMBPortTimersEnable();
@@ -317,11 +310,12 @@ bool xMBRTUReceiveFSM(void)
 
 bool xMBRTUTransmitFSM(void)
 {
+  struct xMBRTUState *pxRTU = &pxMBInstCur->xRTU;
   bool xNeedPoll = false;
 
-  DEBUGASSERT(eRcvState == STATE_RX_IDLE);
+  DEBUGASSERT(pxRTU->eRcvState == STATE_RX_IDLE);
 
-  switch (eSndState)
+  switch (pxRTU->eSndState)
     {
       /* We should not get a transmitter event if the transmitter is in
        * idle state.
@@ -336,11 +330,11 @@ bool xMBRTUTransmitFSM(void)
     case STATE_TX_XMIT:
       /* check if we are finished. */
 
-      if (usSndBufferCount != 0)
+      if (pxRTU->usSndBufferCount != 0)
         {
-          xMBPortSerialPutByte((int8_t)*pucSndBufferCur);
-          pucSndBufferCur++;  /* next byte in sendbuffer. */
-          usSndBufferCount--;
+          xMBPortSerialPutByte((int8_t)*pxRTU->pucSndBufferCur);
+          pxRTU->pucSndBufferCur++;  /* next byte in sendbuffer. */
+          pxRTU->usSndBufferCount--;
         }
       else
         {
@@ -351,7 +345,7 @@ bool xMBRTUTransmitFSM(void)
            */
 
           vMBPortSerialEnable(true, false);
-          eSndState = STATE_TX_IDLE;
+          pxRTU->eSndState = STATE_TX_IDLE;
         }
       break;
     }
@@ -361,9 +355,10 @@ bool xMBRTUTransmitFSM(void)
 
 bool xMBRTUTimerT35Expired(void)
 {
+  struct xMBRTUState *pxRTU = &pxMBInstCur->xRTU;
   bool xNeedPoll = false;
 
-  switch (eRcvState)
+  switch (pxRTU->eRcvState)
     {
       /* Timer t35 expired. Start-up phase is finished. */
 
@@ -387,13 +382,13 @@ bool xMBRTUTimerT35Expired(void)
       /* Function called in an illegal state. */
 
       default:
-        DEBUGASSERT((eRcvState == STATE_RX_INIT) ||
-               (eRcvState == STATE_RX_RCV) ||
-               (eRcvState == STATE_RX_ERROR));
+        DEBUGASSERT((pxRTU->eRcvState == STATE_RX_INIT) ||
+               (pxRTU->eRcvState == STATE_RX_RCV) ||
+               (pxRTU->eRcvState == STATE_RX_ERROR));
     }
 
   vMBPortTimersDisable();
-  eRcvState = STATE_RX_IDLE;
+  pxRTU->eRcvState = STATE_RX_IDLE;
 
   return xNeedPoll;
 }
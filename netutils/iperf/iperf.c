@@ -24,6 +24,8 @@
 
 #include <arpa/inet.h>
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <netpacket/rpmsg.h>
@@ -34,6 +36,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "iperf.h"
@@ -48,6 +51,8 @@
 #define IPERF_REPORT_TASK_NAME       "iperf_report"
 #define IPERF_REPORT_TASK_PRIORITY   100
 #define IPERF_REPORT_TASK_STACK      4096
+#define IPERF_STREAM_TASK_NAME       "iperf_stream"
+#define IPERF_DUAL_TASK_NAME         "iperf_dual"
 
 #define IPERF_UDP_TX_LEN             (1472)
 #define IPERF_UDP_RX_LEN             (16 << 10)
@@ -57,19 +62,101 @@
 #define IPERF_MAX_DELAY              64
 #define IPERF_SOCKET_RX_TIMEOUT      10
 
+/* Period in seconds to check the finish flag while waiting for
+ * connections or datagrams
+ */
+
+#define IPERF_SOCKET_POLL_TIMEOUT    1
+
+/* UDP client waits for the server report after the last datagram */
+
+#define IPERF_UDP_FIN_RETRY          10
+#define IPERF_UDP_FIN_TIMEOUT        250000
+
+/* Default reverse test time if the peer did not request a time */
+
+#define IPERF_DUAL_DEFAULT_TIME      10
+
+/* After its own streams, a dual test client waits for the reverse streams
+ * until nothing was received for this long in seconds.  It checks them
+ * every IPERF_DUAL_POLL microseconds.
+ */
+
+#define IPERF_DUAL_GRACE             5
+#define IPERF_DUAL_POLL              100000
+
+/* A dual test or several clients may use both directions */
+
+#define IPERF_STREAMS_MAX            (2 * IPERF_MAX_STREAMS)
+
+/* iperf 2 header flags */
+
+#define IPERF_HDR_VERSION1           0x80000000
+#define IPERF_HDR_RUN_NOW            0x00000001
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
 
+union iperf_sockaddr_u
+{
+  struct sockaddr       sa;
+  struct sockaddr_in    in;
+  struct sockaddr_un    un;
+  struct sockaddr_rpmsg rp;
+};
+
+struct iperf_ctrl_t;
+
+struct iperf_stream_t
+{
+  FAR struct iperf_ctrl_t *ctrl;
+  pthread_t thread;
+  bool has_thread;
+  bool tx;
+  bool send_hdr;              /* Send the iperf 2 dual test header */
+  bool udp_rx;                /* UDP receive statistics are valid */
+  bool done;
+  int id;
+  int sockfd;
+  FAR uint8_t *buffer;
+  uint32_t buffer_len;
+  uintmax_t total_len;
+  union iperf_sockaddr_u local;
+  union iperf_sockaddr_u remote;
+  socklen_t remotelen;
+  struct timespec start;
+  struct timespec end;        /* Stop time, zero if stopped by ctrl */
+
+  /* UDP receive statistics */
+
+  int32_t udp_last_id;
+  uint32_t udp_cnt;
+  uint32_t udp_lost;
+  uint32_t udp_ooo;
+  double udp_transit;
+  double udp_jitter;
+
+  /* Values at the last interval report */
+
+  uintmax_t rep_len;
+  uint32_t rep_cnt;
+  uint32_t rep_lost;
+  uint32_t rep_ooo;
+};
+
 struct iperf_ctrl_t
 {
   FAR struct iperf_ctrl_t *flink;
   struct iperf_cfg_t cfg;
   bool finish;
-  uintmax_t total_len;
-  uint32_t buffer_len;
-  FAR uint8_t *buffer;
-  uint32_t sockfd;
+  pthread_mutex_t lock;
+  pthread_t report;
+  bool report_started;
+  bool dual_started;
+  int nactive;
+  int nstreams;
+  struct iperf_stream_t streams[IPERF_STREAMS_MAX];
 };
 
 struct iperf_udp_pkt_t
@@ -79,13 +166,56 @@ struct iperf_udp_pkt_t
   uint32_t usec;
 };
 
+/* iperf 2 client header, sent by a dual test client */
+
+struct iperf_client_hdr_t
+{
+  int32_t flags;
+  int32_t num_threads;
+  int32_t port;
+  int32_t buffer_len;
+  int32_t win_band;
+  int32_t amount;
+};
+
+/* iperf 2 server report, sent back to a UDP client after the test */
+
+struct iperf_server_hdr_t
+{
+  int32_t flags;
+  int32_t total_len1;
+  int32_t total_len2;
+  int32_t stop_sec;
+  int32_t stop_usec;
+  int32_t error_cnt;
+  int32_t outorder_cnt;
+  int32_t datagrams;
+  int32_t jitter1;
+  int32_t jitter2;
+};
+
+/* One line of the interval report */
+
+struct iperf_report_t
+{
+  int id;                     /* Stream ID, -1 for the sum */
+  FAR struct iperf_stream_t *stream;
+  double start;
+  double end;
+  uintmax_t bytes;
+  bool udp;
+  double jitter;
+  uint32_t cnt;
+  uint32_t lost;
+  uint32_t ooo;
+};
+
 typedef CODE int (*iperf_client_func_t)(FAR struct iperf_ctrl_t *ctrl,
                                         FAR struct sockaddr *addr,
                                         socklen_t addrlen);
 typedef CODE int (*iperf_server_func_t)(FAR struct iperf_ctrl_t *ctrl,
                                         FAR struct sockaddr *addr,
-                                        socklen_t addrlen,
-                                        FAR struct sockaddr *remote_addr);
+                                        socklen_t addrlen);
 
 /****************************************************************************
  * Private Data
@@ -110,8 +240,12 @@ static int iperf_run_tcp_server(FAR struct iperf_ctrl_t *ctrl);
 static int iperf_run_udp_server(FAR struct iperf_ctrl_t *ctrl);
 static int iperf_run_udp_client(FAR struct iperf_ctrl_t *ctrl);
 static int iperf_run_tcp_client(FAR struct iperf_ctrl_t *ctrl);
+static void iperf_tcp_tx_stream(FAR void *arg);
+static void iperf_tcp_rx_stream(FAR void *arg);
+static void iperf_udp_tx_stream(FAR void *arg);
 static void iperf_task_traffic(FAR void *arg);
-static uint32_t iperf_get_buffer_len(FAR struct iperf_ctrl_t *ctrl);
+static uint32_t iperf_get_buffer_len(FAR struct iperf_ctrl_t *ctrl,
+                                     bool tx);
 
 /****************************************************************************
  * Private Functions
@@ -173,6 +307,19 @@ inline static bool iperf_is_tcp_server(FAR struct iperf_ctrl_t *ctrl)
          && (ctrl->cfg.flag & IPERF_FLAG_TCP));
 }
 
+/****************************************************************************
+ * Name: iperf_is_text_report
+ *
+ * Description:
+ *   Check if the informational messages may be mixed with the report
+ *
+ ****************************************************************************/
+
+inline static bool iperf_is_text_report(FAR struct iperf_ctrl_t *ctrl)
+{
+  return ctrl->cfg.report == IPERF_REPORT_TEXT;
+}
+
 /****************************************************************************
  * Name: iperf_get_socket_error_code
  *
@@ -206,6 +353,19 @@ static int iperf_show_socket_error_reason(FAR const char *str, int sockfd)
   return err;
 }
 
+/****************************************************************************
+ * Name: iperf_is_timeout
+ *
+ * Description:
+ *   Check if the last socket error was a receive timeout
+ *
+ ****************************************************************************/
+
+static bool iperf_is_timeout(void)
+{
+  return errno == EAGAIN || errno == ETIMEDOUT || errno == EINTR;
+}
+
 /****************************************************************************
  * Name: iperf_print_addr
  *
@@ -247,6 +407,37 @@ static void iperf_print_addr(FAR const char *str, FAR struct sockaddr *addr)
     }
 }
 
+/****************************************************************************
+ * Name: iperf_format_addr
+ *
+ * Description:
+ *   Format addr for the machine readable reports
+ *
+ ****************************************************************************/
+
+static FAR const char *iperf_format_addr(FAR union iperf_sockaddr_u *addr,
+                                         FAR char *buf, size_t len,
+                                         FAR int *port)
+{
+  *port = 0;
+
+  switch (addr->sa.sa_family)
+    {
+      case AF_INET:
+        *port = ntohs(addr->in.sin_port);
+        return inet_ntop(AF_INET, &addr->in.sin_addr, buf, len);
+
+      case AF_LOCAL:
+        return addr->un.sun_path;
+
+      case AF_RPMSG:
+        return addr->rp.rp_name;
+
+      default:
+        return "0.0.0.0";
+    }
+}
+
 /****************************************************************************
  * Name: ts_sec
  *
@@ -274,300 +465,896 @@ static double ts_diff(const struct timespec *a, const struct timespec *b)
 }
 
 /****************************************************************************
- * Name: iperf_report_task
+ * Name: iperf_create_thread
  *
  * Description:
- *   Start iperf report task
+ *   Create a joinable iperf thread
  *
  ****************************************************************************/
 
-static void iperf_report_task(FAR void *arg)
+static int iperf_create_thread(FAR pthread_t *thread, int priority,
+                               size_t stacksize, FAR void *entry,
+                               FAR void *arg)
 {
-  FAR struct iperf_ctrl_t *ctrl = arg;
-  uint32_t interval = ctrl->cfg.interval;
-  uint32_t time = ctrl->cfg.time;
-  struct timespec now;
-  struct timespec start;
-  uintmax_t now_len;
+  struct sched_param param;
+  pthread_attr_t attr;
   int ret;
 
-  prctl(PR_SET_NAME, IPERF_REPORT_TASK_NAME);
+  pthread_attr_init(&attr);
+  param.sched_priority = priority;
+  pthread_attr_setschedparam(&attr, &param);
+  pthread_attr_setstacksize(&attr, stacksize);
 
-  now_len = ctrl->total_len;
-  ret = clock_gettime(CLOCK_MONOTONIC, &now);
-  if (ret != 0)
+  ret = pthread_create(thread, &attr, entry, arg);
+  pthread_attr_destroy(&attr);
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: iperf_stream_alloc
+ *
+ * Description:
+ *   Allocate a new stream with its data buffer.  The stream is active
+ *   until iperf_stream_done() is called.
+ *
+ ****************************************************************************/
+
+static FAR struct iperf_stream_t *
+iperf_stream_alloc(FAR struct iperf_ctrl_t *ctrl, bool tx)
+{
+  FAR struct iperf_stream_t *stream = NULL;
+  uint32_t buffer_len;
+  FAR uint8_t *buffer;
+
+  buffer_len = iperf_get_buffer_len(ctrl, tx);
+  buffer = (FAR uint8_t *)malloc(buffer_len);
+  if (buffer == NULL)
     {
-      fprintf(stderr, "clock_gettime failed\n");
-      exit(EXIT_FAILURE);
+      printf("create buffer: not enough memory\n");
+      return NULL;
     }
 
-  start = now;
-  printf("\n%19s %16s %18s\n", "Interval", "Transfer", "Bandwidth\n");
-  while (!ctrl->finish)
+  memset(buffer, 0, buffer_len);
+
+  pthread_mutex_lock(&ctrl->lock);
+
+  if (ctrl->nstreams < IPERF_STREAMS_MAX)
     {
-      uintmax_t last_len;
-      struct timespec last;
+      stream = &ctrl->streams[ctrl->nstreams];
+
+      memset(stream, 0, sizeof(*stream));
+      stream->ctrl = ctrl;
+      stream->id = ctrl->nstreams + 1;
+      stream->tx = tx;
+      stream->sockfd = -1;
+      stream->buffer = buffer;
+      stream->buffer_len = buffer_len;
+      clock_gettime(CLOCK_MONOTONIC, &stream->start);
+
+      ctrl->nstreams++;
+      ctrl->nactive++;
+    }
 
-      sleep(interval);
-      last_len = now_len;
-      last = now;
-      now_len = ctrl->total_len;
-      ret = clock_gettime(CLOCK_MONOTONIC, &now);
-      if (ret != 0)
-        {
-          fprintf(stderr, "clock_gettime failed\n");
-          exit(EXIT_FAILURE);
-        }
+  pthread_mutex_unlock(&ctrl->lock);
+
+  if (stream == NULL)
+    {
+      printf("too many streams, max %d\n", IPERF_STREAMS_MAX);
+      free(buffer);
+    }
+
+  return stream;
+}
+
+/****************************************************************************
+ * Name: iperf_stream_done
+ *
+ * Description:
+ *   Mark the stream as finished.  A server finishes after its last stream.
+ *
+ *   Note: unlike the original iperf, this implementation exits after
+ *   finishing the connections of a single test.
+ *
+ ****************************************************************************/
+
+static void iperf_stream_done(FAR struct iperf_stream_t *stream)
+{
+  FAR struct iperf_ctrl_t *ctrl = stream->ctrl;
+
+  pthread_mutex_lock(&ctrl->lock);
 
-      printf("%7.2lf-%7.2lf sec %10ju Bytes %7.2f Mbits/sec\n",
-             ts_diff(&last, &start),
-             ts_diff(&now, &start),
-             now_len -last_len,
-             (((now_len - last_len) * 8) / 1000000.0) /
-             ts_diff(&now, &last)
-             );
-      if (time != 0 && ts_diff(&now, &start) >= time)
+  if (!stream->done)
+    {
+      stream->done = true;
+      ctrl->nactive--;
+
+      if (ctrl->nactive == 0 && (ctrl->cfg.flag & IPERF_FLAG_SERVER))
         {
-          break;
+          ctrl->finish = true;
         }
     }
 
-  if (ts_diff(&now, &start) > 0)
+  pthread_mutex_unlock(&ctrl->lock);
+}
+
+/****************************************************************************
+ * Name: iperf_stream_close
+ *
+ * Description:
+ *   Release the stream resources at the end of a stream thread
+ *
+ ****************************************************************************/
+
+static void iperf_stream_close(FAR struct iperf_stream_t *stream)
+{
+  if (stream->sockfd >= 0)
     {
-      printf("%7.2lf-%7.2lf sec %10ju Bytes %7.2f Mbits/sec\n",
-             ts_diff(&start, &start),
-             ts_diff(&now, &start),
-             now_len,
-             ((now_len * 8) / 1000000.0) /
-             ts_diff(&now, &start)
-             );
+      close(stream->sockfd);
+      stream->sockfd = -1;
     }
 
-  ctrl->finish = true;
+  free(stream->buffer);
+  stream->buffer = NULL;
 
-  pthread_exit(NULL);
+  iperf_stream_done(stream);
 }
 
 /****************************************************************************
- * Name: iperf_start_report
+ * Name: iperf_stream_start
  *
  * Description:
- *   Start iperf report
+ *   Run the stream in its own thread
  *
  ****************************************************************************/
 
-static int iperf_start_report(FAR struct iperf_ctrl_t *ctrl)
+static int iperf_stream_start(FAR struct iperf_stream_t *stream,
+                              FAR void *entry)
 {
-  struct sched_param param;
-  pthread_attr_t attr;
-  pthread_t thread;
+  FAR struct iperf_ctrl_t *ctrl = stream->ctrl;
   int ret;
 
-  pthread_attr_init(&attr);
-  param.sched_priority = IPERF_REPORT_TASK_PRIORITY;
-  pthread_attr_setschedparam(&attr, &param);
-  pthread_attr_setstacksize(&attr, IPERF_REPORT_TASK_STACK);
+  /* iperf_stream_join() may look at the stream from another thread */
+
+  pthread_mutex_lock(&ctrl->lock);
+  ret = iperf_create_thread(&stream->thread, IPERF_TRAFFIC_TASK_PRIORITY,
+                            IPERF_TRAFFIC_TASK_STACK, entry, stream);
+  stream->has_thread = ret == 0;
+  pthread_mutex_unlock(&ctrl->lock);
 
-  ret = pthread_create(&thread, &attr, (FAR void *)iperf_report_task,
-                       ctrl);
   if (ret != 0)
     {
-      printf("iperf_thread: pthread_create failed: %d, %s\n",
-             ret, IPERF_REPORT_TASK_NAME);
+      printf("iperf_stream: pthread_create failed: %d\n", ret);
+      free(stream->buffer);
+      stream->buffer = NULL;
+      iperf_stream_done(stream);
       return -1;
     }
 
-  pthread_detach(thread);
-
   return 0;
 }
 
 /****************************************************************************
- * Name: iperf_run_server
+ * Name: iperf_stream_join
  *
  * Description:
- *   Start a server
+ *   Wait for the thread of a stream, if it has one that was not joined yet
  *
  ****************************************************************************/
 
-static int iperf_run_server(FAR struct iperf_ctrl_t *ctrl,
-                            iperf_server_func_t server_func)
+static void iperf_stream_join(FAR struct iperf_stream_t *stream)
 {
-  if (ctrl->cfg.flag & IPERF_FLAG_LOCAL)
-    {
-      struct sockaddr_un addr;
-      struct sockaddr_un remote_addr;
-
-      addr.sun_family = AF_LOCAL;
-      strlcpy(addr.sun_path, ctrl->cfg.path, sizeof(addr.sun_path));
-
-      return server_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr),
-                               (FAR struct sockaddr *)&remote_addr);
-    }
-  else if (ctrl->cfg.flag & IPERF_FLAG_RPMSG)
-    {
-      struct sockaddr_rpmsg addr;
-      struct sockaddr_rpmsg remote_addr;
+  FAR struct iperf_ctrl_t *ctrl = stream->ctrl;
+  FAR void *retval;
+  pthread_t thread;
+  bool joinable;
 
-      addr.rp_family = AF_RPMSG;
-      strlcpy(addr.rp_cpu, ctrl->cfg.host, sizeof(addr.rp_cpu));
-      strlcpy(addr.rp_name, ctrl->cfg.path, sizeof(addr.rp_name));
+  pthread_mutex_lock(&ctrl->lock);
+  joinable = stream->has_thread;
+  thread = stream->thread;
+  stream->has_thread = false;
+  pthread_mutex_unlock(&ctrl->lock);
 
-      return server_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr),
-                               (FAR struct sockaddr *)&remote_addr);
-    }
-  else
+  if (joinable)
     {
-      struct sockaddr_in addr;
-      struct sockaddr_in remote_addr;
-
-      addr.sin_family = AF_INET;
-      addr.sin_port = htons(ctrl->cfg.sport);
-      addr.sin_addr.s_addr = ctrl->cfg.sip;
-
-      return server_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr),
-                               (FAR struct sockaddr *)&remote_addr);
+      pthread_join(thread, &retval);
     }
 }
 
 /****************************************************************************
- * Name: iperf_run_client
+ * Name: iperf_stream_expired
  *
  * Description:
- *   Start a client
+ *   Check if the stream reached its own stop time
  *
  ****************************************************************************/
 
-static int iperf_run_client(FAR struct iperf_ctrl_t *ctrl,
-                            iperf_client_func_t client_func)
+static bool iperf_stream_expired(FAR struct iperf_stream_t *stream)
 {
-  if (ctrl->cfg.flag & IPERF_FLAG_LOCAL)
+  struct timespec now;
+
+  if (stream->end.tv_sec == 0)
     {
-      struct sockaddr_un addr;
+      return false;
+    }
 
-      addr.sun_family = AF_LOCAL;
-      strlcpy(addr.sun_path, ctrl->cfg.path, sizeof(addr.sun_path));
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ts_diff(&now, &stream->end) >= 0;
+}
 
-      return client_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
-    }
-  else if (ctrl->cfg.flag & IPERF_FLAG_RPMSG)
-    {
-      struct sockaddr_rpmsg addr;
+/****************************************************************************
+ * Name: iperf_streams_join
+ *
+ * Description:
+ *   Wait for all stream threads.  Streams started while waiting (reverse
+ *   streams of a dual test) are waited for as well.
+ *
+ ****************************************************************************/
 
-      addr.rp_family = AF_RPMSG;
-      strlcpy(addr.rp_cpu, ctrl->cfg.host, sizeof(addr.rp_cpu));
-      strlcpy(addr.rp_name, ctrl->cfg.path, sizeof(addr.rp_name));
+static void iperf_streams_join(FAR struct iperf_ctrl_t *ctrl)
+{
+  FAR struct iperf_stream_t *stream;
+  int i;
 
-      return client_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
-    }
-  else
+  for (i = 0; ; i++)
     {
-      struct sockaddr_in addr;
+      pthread_mutex_lock(&ctrl->lock);
+      stream = i < ctrl->nstreams ? &ctrl->streams[i] : NULL;
+      pthread_mutex_unlock(&ctrl->lock);
 
-      addr.sin_family = AF_INET;
-      addr.sin_port = htons(ctrl->cfg.dport);
-      addr.sin_addr.s_addr = ctrl->cfg.dip;
+      if (stream == NULL)
+        {
+          break;
+        }
 
-      return client_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+      iperf_stream_join(stream);
     }
 }
 
 /****************************************************************************
- * Name: iperf_tcp_server
+ * Name: iperf_report_print
  *
  * Description:
- *   The main tcp server logic
+ *   Print one report line in the configured style
  *
  ****************************************************************************/
 
-static int iperf_tcp_server(FAR struct iperf_ctrl_t *ctrl,
-                            FAR struct sockaddr *addr, socklen_t addrlen,
-                            FAR struct sockaddr *remote_addr)
+static void iperf_report_print(FAR struct iperf_ctrl_t *ctrl,
+                               FAR struct iperf_report_t *rep, bool multi)
 {
-  int actual_recv = 0;
-  int want_recv = 0;
-  FAR uint8_t *buffer;
-  int listen_socket;
-  struct timeval t;
-  int sockfd;
-  int opt;
-
-  listen_socket = socket(addr->sa_family, SOCK_STREAM, IPPROTO_TCP);
-  if (listen_socket < 0)
+  char lbuf[INET_ADDRSTRLEN];
+  char rbuf[INET_ADDRSTRLEN];
+  FAR const char *laddr;
+  FAR const char *raddr;
+  char stamp[16];
+  struct tm tm;
+  uint32_t total;
+  double lost_pct = 0.0;
+  double bps = 0.0;
+  time_t now;
+  int lport;
+  int rport;
+
+  if (rep->end > rep->start)
     {
-      iperf_show_socket_error_reason("tcp server create", listen_socket);
-      return -1;
+      bps = (rep->bytes * 8) / (rep->end - rep->start);
     }
 
-  setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-  if (bind(listen_socket, addr, addrlen) != 0)
+  total = rep->cnt + rep->lost;
+  if (total > 0)
     {
-      iperf_show_socket_error_reason("tcp server bind", listen_socket);
-      close(listen_socket);
-      return -1;
+      lost_pct = (rep->lost * 100.0) / total;
     }
 
-  if (listen(listen_socket, 5) < 0)
+  if (ctrl->cfg.report == IPERF_REPORT_TEXT)
     {
-      iperf_show_socket_error_reason("tcp server listen", listen_socket);
-      close(listen_socket);
-      return -1;
+      if (multi && rep->id < 0)
+        {
+          printf("[SUM] ");
+        }
+      else if (multi)
+        {
+          printf("[%3d] ", rep->id);
+        }
+
+      printf("%7.2lf-%7.2lf sec %10ju Bytes %7.2f Mbits/sec",
+             rep->start, rep->end, rep->bytes, bps / 1000000.0);
+
+      if (rep->udp)
+        {
+          printf(" %6.3f ms %4" PRIu32 "/%5" PRIu32 " (%.2g%%)",
+                 rep->jitter * 1000.0, rep->lost, total, lost_pct);
+        }
+
+      printf("\n");
+      return;
+    }
+
+  now = time(NULL);
+  localtime_r(&now, &tm);
+  strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &tm);
+
+  if (ctrl->cfg.report == IPERF_REPORT_CSV)
+    {
+      /* iperf 2 -y C: timestamp,local address,local port,remote address,
+       * remote port,id,interval,bytes,bits/sec and for UDP also jitter,
+       * lost,total,lost percent,out of order
+       */
+
+      laddr = iperf_format_addr(&rep->stream->local, lbuf, sizeof(lbuf),
+                                &lport);
+      raddr = iperf_format_addr(&rep->stream->remote, rbuf, sizeof(rbuf),
+                                &rport);
+
+      printf("%s,%s,%d,%s,%d,%d,%.1f-%.1f,%ju,%.0f",
+             stamp, laddr, lport, raddr, rport, rep->id,
+             rep->start, rep->end, rep->bytes, bps);
+
+      if (rep->udp)
+        {
+          printf(",%.3f,%" PRIu32 ",%" PRIu32 ",%.3f,%" PRIu32,
+                 rep->jitter * 1000.0, rep->lost, total, lost_pct,
+                 rep->ooo);
+        }
+
+      printf("\n");
+    }
+  else
+    {
+      printf("{\"timestamp\":\"%s\",\"stream\":%d,\"start\":%.3f,"
+             "\"end\":%.3f,\"bytes\":%ju,\"bits_per_second\":%.0f",
+             stamp, rep->id, rep->start, rep->end, rep->bytes, bps);
+
+      if (rep->udp)
+        {
+          printf(",\"jitter_ms\":%.3f,\"lost\":%" PRIu32 ","
+                 "\"packets\":%" PRIu32 ",\"lost_percent\":%.3f,"
+                 "\"out_of_order\":%" PRIu32,
+                 rep->jitter * 1000.0, rep->lost, total, lost_pct,
+                 rep->ooo);
+        }
+
+      printf("}\n");
+    }
+}
+
+/****************************************************************************
+ * Name: iperf_report_interval
+ *
+ * Description:
+ *   Report all streams and their sum for the given interval.  The final
+ *   report covers the whole test.
+ *
+ ****************************************************************************/
+
+static void iperf_report_interval(FAR struct iperf_ctrl_t *ctrl,
+                                  double start, double end, bool final)
+{
+  FAR struct iperf_stream_t *stream;
+  struct iperf_report_t sum;
+  struct iperf_report_t rep;
+  uintmax_t total_len;
+  uint32_t cnt;
+  uint32_t lost;
+  uint32_t ooo;
+  int nudp = 0;
+  int n;
+  int i;
+
+  pthread_mutex_lock(&ctrl->lock);
+  n = ctrl->nstreams;
+  pthread_mutex_unlock(&ctrl->lock);
+
+  if (n == 0)
+    {
+      return;
+    }
+
+  memset(&sum, 0, sizeof(sum));
+  sum.id = -1;
+  sum.stream = &ctrl->streams[0];
+  sum.start = start;
+  sum.end = end;
+
+  for (i = 0; i < n; i++)
+    {
+      stream = &ctrl->streams[i];
+
+      total_len = stream->total_len;
+      cnt = stream->udp_cnt;
+      lost = stream->udp_lost;
+      ooo = stream->udp_ooo;
+
+      memset(&rep, 0, sizeof(rep));
+      rep.id = stream->id;
+      rep.stream = stream;
+      rep.start = start;
+      rep.end = end;
+      rep.udp = stream->udp_rx;
+      rep.jitter = stream->udp_jitter;
+
+      if (final)
+        {
+          rep.bytes = total_len;
+          rep.cnt = cnt;
+          rep.lost = lost;
+          rep.ooo = ooo;
+        }
+      else
+        {
+          rep.bytes = total_len - stream->rep_len;
+          rep.cnt = cnt - stream->rep_cnt;
+          rep.lost = lost - stream->rep_lost;
+          rep.ooo = ooo - stream->rep_ooo;
+
+          stream->rep_len = total_len;
+          stream->rep_cnt = cnt;
+          stream->rep_lost = lost;
+          stream->rep_ooo = ooo;
+        }
+
+      if (n > 1)
+        {
+          iperf_report_print(ctrl, &rep, true);
+        }
+
+      sum.bytes += rep.bytes;
+
+      if (rep.udp)
+        {
+          sum.udp = true;
+          sum.jitter += rep.jitter;
+          sum.cnt += rep.cnt;
+          sum.lost += rep.lost;
+          sum.ooo += rep.ooo;
+          nudp++;
+        }
+    }
+
+  if (n == 1)
+    {
+      iperf_report_print(ctrl, &rep, false);
+      return;
+    }
+
+  if (nudp > 0)
+    {
+      sum.jitter /= nudp;
+    }
+
+  iperf_report_print(ctrl, &sum, true);
+}
+
+/****************************************************************************
+ * Name: iperf_report_task
+ *
+ * Description:
+ *   Start iperf report task
+ *
+ ****************************************************************************/
+
+static void iperf_report_task(FAR void *arg)
+{
+  FAR struct iperf_ctrl_t *ctrl = arg;
+  uint32_t interval = ctrl->cfg.interval;
+  uint32_t time = ctrl->cfg.time;
+  struct timespec now;
+  struct timespec start;
+  int ret;
+
+  prctl(PR_SET_NAME, IPERF_REPORT_TASK_NAME);
+
+  ret = clock_gettime(CLOCK_MONOTONIC, &now);
+  if (ret != 0)
+    {
+      fprintf(stderr, "clock_gettime failed\n");
+      exit(EXIT_FAILURE);
+    }
+
+  start = now;
+
+  if (iperf_is_text_report(ctrl))
+    {
+      printf("\n%19s %16s %18s\n", "Interval", "Transfer", "Bandwidth\n");
     }
 
-  buffer = ctrl->buffer;
-  want_recv = ctrl->buffer_len;
   while (!ctrl->finish)
     {
-      /* TODO need to change to non-block mode */
+      struct timespec last;
 
-      sockfd = accept(listen_socket, remote_addr, &addrlen);
-      if (sockfd < 0)
+      sleep(interval);
+      last = now;
+      ret = clock_gettime(CLOCK_MONOTONIC, &now);
+      if (ret != 0)
+        {
+          fprintf(stderr, "clock_gettime failed\n");
+          exit(EXIT_FAILURE);
+        }
+
+      iperf_report_interval(ctrl, ts_diff(&last, &start),
+                            ts_diff(&now, &start), false);
+
+      /* A dual test client stops its own streams at their end time and
+       * keeps reporting until the reverse streams are done
+       */
+
+      if (time != 0 && ts_diff(&now, &start) >= time &&
+          !(ctrl->cfg.flag & IPERF_FLAG_DUAL))
         {
-          iperf_show_socket_error_reason("tcp server listen", listen_socket);
-          close(listen_socket);
-          return -1;
+          break;
+        }
+    }
+
+  if (ts_diff(&now, &start) > 0)
+    {
+      iperf_report_interval(ctrl, 0, ts_diff(&now, &start), true);
+    }
+
+  ctrl->finish = true;
+
+  pthread_exit(NULL);
+}
+
+/****************************************************************************
+ * Name: iperf_start_report
+ *
+ * Description:
+ *   Start iperf report, once for all streams
+ *
+ ****************************************************************************/
+
+static int iperf_start_report(FAR struct iperf_ctrl_t *ctrl)
+{
+  int ret = 0;
+
+  pthread_mutex_lock(&ctrl->lock);
+
+  if (!ctrl->report_started)
+    {
+      ret = iperf_create_thread(&ctrl->report, IPERF_REPORT_TASK_PRIORITY,
+                                IPERF_REPORT_TASK_STACK,
+                                (FAR void *)iperf_report_task, ctrl);
+      if (ret != 0)
+        {
+          printf("iperf_thread: pthread_create failed: %d, %s\n",
+                 ret, IPERF_REPORT_TASK_NAME);
+          ret = -1;
         }
       else
         {
-          iperf_print_addr("accept", remote_addr);
-          iperf_start_report(ctrl);
+          ctrl->report_started = true;
+        }
+    }
+
+  pthread_mutex_unlock(&ctrl->lock);
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: iperf_client_hdr_init
+ *
+ * Description:
+ *   Fill the iperf 2 header that asks the server to run the reverse test
+ *   at the same time (dual test)
+ *
+ ****************************************************************************/
+
+static void iperf_client_hdr_init(FAR struct iperf_ctrl_t *ctrl,
+                                  FAR struct iperf_client_hdr_t *hdr)
+{
+  hdr->flags       = htonl(IPERF_HDR_VERSION1 | IPERF_HDR_RUN_NOW);
+  hdr->num_threads = htonl(ctrl->cfg.nstreams);
+  hdr->port        = htonl(ctrl->cfg.sport);
+  hdr->buffer_len  = 0;
+  hdr->win_band    = 0;
+
+  /* A negative amount is the test time in 1/100 sec */
+
+  hdr->amount      = htonl(-(int32_t)(ctrl->cfg.time * 100));
+}
+
+/****************************************************************************
+ * Name: iperf_dual_start
+ *
+ * Description:
+ *   Start the reverse streams if the client asked for a dual test
+ *
+ ****************************************************************************/
+
+static void iperf_dual_start(FAR struct iperf_stream_t *stream,
+                             FAR const struct iperf_client_hdr_t *hdr)
+{
+  FAR struct iperf_ctrl_t *ctrl = stream->ctrl;
+  FAR struct iperf_stream_t *tx;
+  FAR void *entry;
+  uint32_t flags;
+  int32_t amount;
+  int32_t time;
+  int nthreads;
+  int i;
+
+  flags = ntohl(hdr->flags);
+  if (!(ctrl->cfg.flag & IPERF_FLAG_SERVER) ||
+      !(flags & IPERF_HDR_VERSION1) || !(flags & IPERF_HDR_RUN_NOW) ||
+      stream->remote.sa.sa_family != AF_INET)
+    {
+      return;
+    }
+
+  /* Only the first stream of a test starts the reverse streams */
+
+  pthread_mutex_lock(&ctrl->lock);
+  if (ctrl->dual_started)
+    {
+      pthread_mutex_unlock(&ctrl->lock);
+      return;
+    }
+
+  ctrl->dual_started = true;
+  pthread_mutex_unlock(&ctrl->lock);
+
+  nthreads = (int32_t)ntohl(hdr->num_threads);
+  if (nthreads < 1 || nthreads > IPERF_MAX_STREAMS)
+    {
+      nthreads = 1;
+    }
+
+  amount = (int32_t)ntohl(hdr->amount);
+  time = amount < 0 ? -amount / 100 : IPERF_DUAL_DEFAULT_TIME;
+  entry = (ctrl->cfg.flag & IPERF_FLAG_UDP) ?
+          (FAR void *)iperf_udp_tx_stream : (FAR void *)iperf_tcp_tx_stream;
 
-          t.tv_sec = IPERF_SOCKET_RX_TIMEOUT;
-          t.tv_usec = 0;
-          setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+  for (i = 0; i < nthreads; i++)
+    {
+      tx = iperf_stream_alloc(ctrl, true);
+      if (tx == NULL)
+        {
+          break;
         }
 
-      while (!ctrl->finish)
+      tx->remote = stream->remote;
+      tx->remotelen = sizeof(struct sockaddr_in);
+      tx->remote.in.sin_port = htons((uint16_t)ntohl(hdr->port));
+      tx->end = tx->start;
+      tx->end.tv_sec += time;
+
+      if (i == 0 && iperf_is_text_report(ctrl))
         {
-          actual_recv = recv(sockfd, buffer, want_recv, 0);
-          if (actual_recv == 0)
-            {
-              iperf_print_addr("closed by the peer", remote_addr);
+          iperf_print_addr("dual test: connect back", &tx->remote.sa);
+        }
 
-              /* Note: unlike the original iperf, this implementation
-               * exits after finishing a single connection.
-               */
+      iperf_stream_start(tx, entry);
+    }
+}
 
-              ctrl->finish = true;
-              break;
-            }
-          else if (actual_recv < 0)
+/****************************************************************************
+ * Name: iperf_run_server
+ *
+ * Description:
+ *   Start a server
+ *
+ ****************************************************************************/
+
+static int iperf_run_server(FAR struct iperf_ctrl_t *ctrl,
+                            iperf_server_func_t server_func)
+{
+  if (ctrl->cfg.flag & IPERF_FLAG_LOCAL)
+    {
+      struct sockaddr_un addr;
+
+      addr.sun_family = AF_LOCAL;
+      strlcpy(addr.sun_path, ctrl->cfg.path, sizeof(addr.sun_path));
+
+      return server_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+  else if (ctrl->cfg.flag & IPERF_FLAG_RPMSG)
+    {
+      struct sockaddr_rpmsg addr;
+
+      addr.rp_family = AF_RPMSG;
+      strlcpy(addr.rp_cpu, ctrl->cfg.host, sizeof(addr.rp_cpu));
+      strlcpy(addr.rp_name, ctrl->cfg.path, sizeof(addr.rp_name));
+
+      return server_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+  else
+    {
+      struct sockaddr_in addr;
+
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(ctrl->cfg.sport);
+      addr.sin_addr.s_addr = ctrl->cfg.sip;
+
+      return server_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+}
+
+/****************************************************************************
+ * Name: iperf_run_client
+ *
+ * Description:
+ *   Start a client
+ *
+ ****************************************************************************/
+
+static int iperf_run_client(FAR struct iperf_ctrl_t *ctrl,
+                            iperf_client_func_t client_func)
+{
+  if (ctrl->cfg.flag & IPERF_FLAG_LOCAL)
+    {
+      struct sockaddr_un addr;
+
+      addr.sun_family = AF_LOCAL;
+      strlcpy(addr.sun_path, ctrl->cfg.path, sizeof(addr.sun_path));
+
+      return client_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+  else if (ctrl->cfg.flag & IPERF_FLAG_RPMSG)
+    {
+      struct sockaddr_rpmsg addr;
+
+      addr.rp_family = AF_RPMSG;
+      strlcpy(addr.rp_cpu, ctrl->cfg.host, sizeof(addr.rp_cpu));
+      strlcpy(addr.rp_name, ctrl->cfg.path, sizeof(addr.rp_name));
+
+      return client_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+  else
+    {
+      struct sockaddr_in addr;
+
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(ctrl->cfg.dport);
+      addr.sin_addr.s_addr = ctrl->cfg.dip;
+
+      return client_func(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+}
+
+/****************************************************************************
+ * Name: iperf_tcp_rx_stream
+ *
+ * Description:
+ *   Receive one accepted tcp connection
+ *
+ ****************************************************************************/
+
+static void iperf_tcp_rx_stream(FAR void *arg)
+{
+  FAR struct iperf_stream_t *stream = arg;
+  FAR struct iperf_ctrl_t *ctrl = stream->ctrl;
+  int actual_recv = 0;
+  bool first = true;
+
+  prctl(PR_SET_NAME, IPERF_STREAM_TASK_NAME);
+
+  while (!ctrl->finish)
+    {
+      actual_recv = recv(stream->sockfd, stream->buffer,
+                         stream->buffer_len, 0);
+      if (actual_recv == 0)
+        {
+          if (iperf_is_text_report(ctrl))
             {
-              iperf_show_socket_error_reason("tcp server recv",
-                                             listen_socket);
-              ctrl->finish = true;
-              break;
+              iperf_print_addr("closed by the peer", &stream->remote.sa);
             }
-          else
+
+          break;
+        }
+      else if (actual_recv < 0)
+        {
+          iperf_show_socket_error_reason("tcp server recv",
+                                         stream->sockfd);
+          break;
+        }
+
+      /* A dual test client starts the stream with the iperf 2 header */
+
+      if (first && actual_recv >= sizeof(struct iperf_client_hdr_t))
+        {
+          iperf_dual_start(stream, (FAR struct iperf_client_hdr_t *)
+                                   stream->buffer);
+        }
+
+      first = false;
+      stream->total_len += actual_recv;
+    }
+
+  iperf_stream_close(stream);
+
+  pthread_exit(NULL);
+}
+
+/****************************************************************************
+ * Name: iperf_tcp_server
+ *
+ * Description:
+ *   The main tcp server logic
+ *
+ ****************************************************************************/
+
+static int iperf_tcp_server(FAR struct iperf_ctrl_t *ctrl,
+                            FAR struct sockaddr *addr, socklen_t addrlen)
+{
+  FAR struct iperf_stream_t *stream;
+  union iperf_sockaddr_u remote;
+  socklen_t remotelen;
+  int listen_socket;
+  struct timeval t;
+  int sockfd;
+  int opt = 1;
+
+  listen_socket = socket(addr->sa_family, SOCK_STREAM, IPPROTO_TCP);
+  if (listen_socket < 0)
+    {
+      iperf_show_socket_error_reason("tcp server create", listen_socket);
+      return -1;
+    }
+
+  setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  if (bind(listen_socket, addr, addrlen) != 0)
+    {
+      iperf_show_socket_error_reason("tcp server bind", listen_socket);
+      close(listen_socket);
+      return -1;
+    }
+
+  if (listen(listen_socket, 5) < 0)
+    {
+      iperf_show_socket_error_reason("tcp server listen", listen_socket);
+      close(listen_socket);
+      return -1;
+    }
+
+  /* Do not block in accept() forever, so that the finish flag is seen */
+
+  t.tv_sec = IPERF_SOCKET_POLL_TIMEOUT;
+  t.tv_usec = 0;
+  setsockopt(listen_socket, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+
+  while (!ctrl->finish)
+    {
+      remotelen = sizeof(remote);
+      sockfd = accept(listen_socket, &remote.sa, &remotelen);
+      if (sockfd < 0)
+        {
+          if (iperf_is_timeout())
             {
-              ctrl->total_len += actual_recv;
+              continue;
             }
+
+          iperf_show_socket_error_reason("tcp server accept",
+                                         listen_socket);
+          break;
         }
 
-      close(sockfd);
+      if (iperf_is_text_report(ctrl))
+        {
+          iperf_print_addr("accept", &remote.sa);
+        }
+
+      stream = iperf_stream_alloc(ctrl, false);
+      if (stream == NULL)
+        {
+          close(sockfd);
+          continue;
+        }
+
+      stream->sockfd = sockfd;
+      stream->remote = remote;
+      stream->remotelen = remotelen;
+      remotelen = sizeof(stream->local);
+      getsockname(sockfd, &stream->local.sa, &remotelen);
+
+      t.tv_sec = IPERF_SOCKET_RX_TIMEOUT;
+      t.tv_usec = 0;
+      setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+
+      iperf_start_report(ctrl);
+      iperf_stream_start(stream, (FAR void *)iperf_tcp_rx_stream);
     }
 
-  ctrl->finish = true;
   close(listen_socket);
 
   return 0;
@@ -586,6 +1373,251 @@ static int iperf_run_tcp_server(FAR struct iperf_ctrl_t *ctrl)
   return iperf_run_server(ctrl, iperf_tcp_server);
 }
 
+/****************************************************************************
+ * Name: iperf_udp_stream_find
+ *
+ * Description:
+ *   Find the receive stream of the datagram sender
+ *
+ ****************************************************************************/
+
+static FAR struct iperf_stream_t *
+iperf_udp_stream_find(FAR struct iperf_ctrl_t *ctrl,
+                      FAR union iperf_sockaddr_u *remote,
+                      socklen_t remotelen)
+{
+  FAR struct iperf_stream_t *stream;
+  int i;
+
+  for (i = 0; i < ctrl->nstreams; i++)
+    {
+      stream = &ctrl->streams[i];
+      if (!stream->udp_rx)
+        {
+          continue;
+        }
+
+      if (remote->sa.sa_family == AF_INET)
+        {
+          if (stream->remote.in.sin_port == remote->in.sin_port &&
+              stream->remote.in.sin_addr.s_addr ==
+              remote->in.sin_addr.s_addr)
+            {
+              return stream;
+            }
+        }
+      else if (stream->remotelen == remotelen &&
+               memcmp(&stream->remote, remote, remotelen) == 0)
+        {
+          return stream;
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: iperf_udp_stream_get
+ *
+ * Description:
+ *   Find the receive stream of the datagram sender or start a new one
+ *
+ ****************************************************************************/
+
+static FAR struct iperf_stream_t *
+iperf_udp_stream_get(FAR struct iperf_ctrl_t *ctrl,
+                     FAR union iperf_sockaddr_u *remote,
+                     socklen_t remotelen, FAR bool *created)
+{
+  FAR struct iperf_stream_t *stream;
+
+  *created = false;
+
+  stream = iperf_udp_stream_find(ctrl, remote, remotelen);
+  if (stream != NULL)
+    {
+      return stream;
+    }
+
+  stream = iperf_stream_alloc(ctrl, false);
+  if (stream != NULL)
+    {
+      /* The server thread receives all datagrams, the stream only keeps
+       * the statistics
+       */
+
+      free(stream->buffer);
+      stream->buffer = NULL;
+      stream->udp_rx = true;
+      stream->remote = *remote;
+      stream->remotelen = remotelen;
+      *created = true;
+    }
+
+  return stream;
+}
+
+/****************************************************************************
+ * Name: iperf_udp_stats
+ *
+ * Description:
+ *   Update the jitter and loss statistics with a received datagram.
+ *   Returns true if it is the last datagram of the client.
+ *
+ ****************************************************************************/
+
+static bool iperf_udp_stats(FAR struct iperf_stream_t *stream,
+                            FAR struct iperf_udp_pkt_t *udp)
+{
+  int32_t id = (int32_t)ntohl(udp->id);
+  struct timespec now;
+  double transit;
+  double d;
+
+  /* The client negates the id of the last datagram */
+
+  if (id < 0)
+    {
+      return true;
+    }
+
+  /* Jitter as in RFC 1889, the clock offset of the hosts cancels out */
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  transit = ts_sec(&now) - ((double)ntohl(udp->sec) +
+                            (double)ntohl(udp->usec) / 1e6);
+
+  if (stream->udp_cnt > 0)
+    {
+      d = transit - stream->udp_transit;
+      if (d < 0)
+        {
+          d = -d;
+        }
+
+      stream->udp_jitter += (d - stream->udp_jitter) / 16.0;
+    }
+
+  stream->udp_transit = transit;
+
+  /* Loss and out of order datagrams */
+
+  if (stream->udp_cnt > 0 && id != stream->udp_last_id + 1)
+    {
+      if (id < stream->udp_last_id + 1)
+        {
+          /* Counted as lost when the gap was seen, like iperf 2 */
+
+          stream->udp_ooo++;
+          if (stream->udp_lost > 0)
+            {
+              stream->udp_lost--;
+            }
+        }
+      else
+        {
+          stream->udp_lost += id - stream->udp_last_id - 1;
+        }
+    }
+
+  if (stream->udp_cnt == 0 || id > stream->udp_last_id)
+    {
+      stream->udp_last_id = id;
+    }
+
+  stream->udp_cnt++;
+
+  return false;
+}
+
+/****************************************************************************
+ * Name: iperf_udp_fin_reply
+ *
+ * Description:
+ *   Send the iperf 2 server report back to the client after its last
+ *   datagram
+ *
+ ****************************************************************************/
+
+static void iperf_udp_fin_reply(FAR struct iperf_stream_t *stream,
+                                int sockfd, FAR uint8_t *buffer)
+{
+  FAR struct iperf_server_hdr_t *hdr;
+  struct timespec now;
+  double elapsed;
+
+  hdr = (FAR struct iperf_server_hdr_t *)
+        (buffer + sizeof(struct iperf_udp_pkt_t));
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsed = ts_diff(&now, &stream->start);
+
+  hdr->flags        = htonl(IPERF_HDR_VERSION1);
+  hdr->total_len1   = htonl((uint32_t)(stream->total_len >> 32));
+  hdr->total_len2   = htonl((uint32_t)stream->total_len);
+  hdr->stop_sec     = htonl((int32_t)elapsed);
+  hdr->stop_usec    = htonl((int32_t)((elapsed - (int32_t)elapsed) * 1e6));
+  hdr->error_cnt    = htonl(stream->udp_lost);
+  hdr->outorder_cnt = htonl(stream->udp_ooo);
+  hdr->datagrams    = htonl(stream->udp_last_id);
+  hdr->jitter1      = htonl((int32_t)stream->udp_jitter);
+  hdr->jitter2      = htonl((int32_t)((stream->udp_jitter -
+                                       (int32_t)stream->udp_jitter) * 1e6));
+
+  sendto(sockfd, buffer, sizeof(struct iperf_udp_pkt_t) + sizeof(*hdr), 0,
+         &stream->remote.sa, stream->remotelen);
+}
+
+/****************************************************************************
+ * Name: iperf_udp_linger
+ *
+ * Description:
+ *   The server report may be lost, so the client resends its last
+ *   datagram.  Keep answering these retries for as long as the client
+ *   sends them after the last stream has finished.
+ *
+ ****************************************************************************/
+
+static void iperf_udp_linger(FAR struct iperf_ctrl_t *ctrl, int sockfd,
+                             FAR uint8_t *buffer)
+{
+  FAR struct iperf_stream_t *stream;
+  FAR struct iperf_udp_pkt_t *udp;
+  union iperf_sockaddr_u remote;
+  struct timespec start;
+  struct timespec now;
+  socklen_t remotelen;
+  struct timeval t;
+  int actual_recv;
+
+  udp = (FAR struct iperf_udp_pkt_t *)buffer;
+
+  t.tv_sec = 0;
+  t.tv_usec = IPERF_UDP_FIN_TIMEOUT;
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  do
+    {
+      remotelen = sizeof(remote);
+      actual_recv = recvfrom(sockfd, buffer, IPERF_UDP_RX_LEN, 0,
+                             &remote.sa, &remotelen);
+      if (actual_recv >= (int)sizeof(*udp) && (int32_t)ntohl(udp->id) < 0)
+        {
+          stream = iperf_udp_stream_find(ctrl, &remote, remotelen);
+          if (stream != NULL)
+            {
+              iperf_udp_fin_reply(stream, sockfd, buffer);
+            }
+        }
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+  while (ts_diff(&now, &start) <
+         IPERF_UDP_FIN_RETRY * IPERF_UDP_FIN_TIMEOUT / 1e6);
+}
+
 /****************************************************************************
  * Name: iperf_udp_server
  *
@@ -595,16 +1627,20 @@ static int iperf_run_tcp_server(FAR struct iperf_ctrl_t *ctrl)
  ****************************************************************************/
 
 static int iperf_udp_server(FAR struct iperf_ctrl_t *ctrl,
-                            FAR struct sockaddr *addr, socklen_t addrlen,
-                            FAR struct sockaddr *remote_addr)
+                            FAR struct sockaddr *addr, socklen_t addrlen)
 {
+  FAR struct iperf_stream_t *stream;
+  union iperf_sockaddr_u remote;
+  union iperf_sockaddr_u local;
+  socklen_t remotelen;
   int actual_recv = 0;
   struct timeval t;
   int want_recv = 0;
   FAR uint8_t *buffer;
+  bool created;
+  bool linger;
   int sockfd;
-  int opt;
-  bool udp_recv_start = true;
+  int opt = 1;
 
   sockfd = socket(addr->sa_family, SOCK_DGRAM, IPPROTO_UDP);
   if (sockfd < 0)
@@ -618,39 +1654,107 @@ static int iperf_udp_server(FAR struct iperf_ctrl_t *ctrl,
   if (bind(sockfd, addr, addrlen) != 0)
     {
       iperf_show_socket_error_reason("udp server bind", sockfd);
+      close(sockfd);
       return -1;
     }
 
-  buffer = ctrl->buffer;
-  want_recv = ctrl->buffer_len;
-  printf("want recv=%d\n", want_recv);
+  remotelen = sizeof(local);
+  getsockname(sockfd, &local.sa, &remotelen);
 
-  t.tv_sec = IPERF_SOCKET_RX_TIMEOUT;
+  want_recv = IPERF_UDP_RX_LEN;
+  buffer = (FAR uint8_t *)malloc(want_recv);
+  if (buffer == NULL)
+    {
+      printf("create buffer: not enough memory\n");
+      close(sockfd);
+      return -1;
+    }
+
+  if (iperf_is_text_report(ctrl))
+    {
+      printf("want recv=%d\n", want_recv);
+    }
+
+  /* Do not block forever, so that the finish flag is seen */
+
+  t.tv_sec = IPERF_SOCKET_POLL_TIMEOUT;
   t.tv_usec = 0;
   setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
 
   while (!ctrl->finish)
     {
+      remotelen = sizeof(remote);
       actual_recv = recvfrom(sockfd, buffer, want_recv, 0,
-                             remote_addr, &addrlen);
+                             &remote.sa, &remotelen);
       if (actual_recv < 0)
         {
-          iperf_show_socket_error_reason("udp server recv", sockfd);
+          if (!iperf_is_timeout())
+            {
+              iperf_show_socket_error_reason("udp server recv", sockfd);
+            }
+
+          continue;
+        }
+
+      stream = iperf_udp_stream_get(ctrl, &remote, remotelen, &created);
+      if (stream == NULL)
+        {
+          continue;
+        }
+
+      if (created)
+        {
+          stream->local = local;
+          if (iperf_is_text_report(ctrl))
+            {
+              iperf_print_addr("accept", &remote.sa);
+            }
+
+          iperf_start_report(ctrl);
+
+          /* A dual test client sends the iperf 2 header after the
+           * datagram header
+           */
+
+          if (actual_recv >= sizeof(struct iperf_udp_pkt_t) +
+                             sizeof(struct iperf_client_hdr_t))
+            {
+              iperf_dual_start(stream, (FAR struct iperf_client_hdr_t *)
+                               (buffer + sizeof(struct iperf_udp_pkt_t)));
+            }
+        }
+
+      if (actual_recv < sizeof(struct iperf_udp_pkt_t))
+        {
+          stream->total_len += actual_recv;
+          continue;
         }
-      else
+
+      if (iperf_udp_stats(stream, (FAR struct iperf_udp_pkt_t *)buffer))
         {
-          if (udp_recv_start == true)
-            {
-              iperf_print_addr("accept", remote_addr);
-              iperf_start_report(ctrl);
-              udp_recv_start = false;
-            }
+          /* Answer every retry of the last datagram */
 
-          ctrl->total_len += actual_recv;
+          iperf_udp_fin_reply(stream, sockfd, buffer);
+          iperf_stream_done(stream);
+        }
+      else if (!stream->done)
+        {
+          stream->total_len += actual_recv;
         }
     }
 
-  ctrl->finish = true;
+  /* Not after a stop, the streams are still active then */
+
+  pthread_mutex_lock(&ctrl->lock);
+  linger = ctrl->nactive == 0;
+  pthread_mutex_unlock(&ctrl->lock);
+
+  if (linger)
+    {
+      iperf_udp_linger(ctrl, sockfd, buffer);
+    }
+
+  free(buffer);
   close(sockfd);
 
   return 0;
@@ -670,43 +1774,134 @@ static int iperf_run_udp_server(FAR struct iperf_ctrl_t *ctrl)
 }
 
 /****************************************************************************
- * Name: iperf_udp_client
+ * Name: iperf_udp_fin
  *
  * Description:
- *   The main udp client logic
+ *   Send the last datagram and wait for the server report
  *
  ****************************************************************************/
 
-static int iperf_udp_client(FAR struct iperf_ctrl_t *ctrl,
-                            FAR struct sockaddr *addr, socklen_t addrlen)
+static void iperf_udp_fin(FAR struct iperf_stream_t *stream, int32_t id)
+{
+  FAR struct iperf_udp_pkt_t *udp;
+  FAR struct iperf_server_hdr_t *hdr;
+  struct timeval t;
+  int actual_recv;
+  int i;
+
+  udp = (FAR struct iperf_udp_pkt_t *)stream->buffer;
+  hdr = (FAR struct iperf_server_hdr_t *)(udp + 1);
+
+  t.tv_sec = 0;
+  t.tv_usec = IPERF_UDP_FIN_TIMEOUT;
+  setsockopt(stream->sockfd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+
+  for (i = 0; i < IPERF_UDP_FIN_RETRY; i++)
+    {
+      udp->id = htonl(-id);
+      gettimeofday(&t, NULL);
+      udp->sec = htonl(t.tv_sec);
+      udp->usec = htonl(t.tv_usec);
+
+      sendto(stream->sockfd, stream->buffer, stream->buffer_len, 0,
+             &stream->remote.sa, stream->remotelen);
+
+      actual_recv = recv(stream->sockfd, stream->buffer,
+                         stream->buffer_len, 0);
+      if (actual_recv < 0)
+        {
+          continue;
+        }
+
+      if (actual_recv >= sizeof(*udp) + sizeof(*hdr) &&
+          (ntohl(hdr->flags) & IPERF_HDR_VERSION1) &&
+          iperf_is_text_report(stream->ctrl))
+        {
+          printf("[%3d] Server Report: %10" PRIu32 " Bytes %6.3f ms"
+                 " %4" PRId32 "/%5" PRId32 " %" PRId32 " ooo\n",
+                 stream->id, (uint32_t)ntohl(hdr->total_len2),
+                 (int32_t)ntohl(hdr->jitter1) * 1000.0 +
+                 (int32_t)ntohl(hdr->jitter2) / 1000.0,
+                 (int32_t)ntohl(hdr->error_cnt),
+                 (int32_t)ntohl(hdr->datagrams),
+                 (int32_t)ntohl(hdr->outorder_cnt));
+        }
+
+      return;
+    }
+
+  printf("[%3d] no server report after the last datagram\n", stream->id);
+}
+
+/****************************************************************************
+ * Name: iperf_udp_tx_stream
+ *
+ * Description:
+ *   The main udp client logic of one stream
+ *
+ ****************************************************************************/
+
+static void iperf_udp_tx_stream(FAR void *arg)
 {
+  FAR struct iperf_stream_t *stream = arg;
+  FAR struct iperf_ctrl_t *ctrl = stream->ctrl;
   FAR struct iperf_udp_pkt_t *udp;
+  socklen_t addrlen;
   int actual_send = 0;
   bool retry = false;
   uint32_t delay = 1;
+  struct timeval tv;
   int want_send = 0;
   uint8_t *buffer;
   int sockfd;
-  int opt;
+  int opt = 1;
   int err;
   int id;
 
-  sockfd = socket(addr->sa_family, SOCK_DGRAM, IPPROTO_UDP);
+  prctl(PR_SET_NAME, IPERF_STREAM_TASK_NAME);
+
+  sockfd = socket(stream->remote.sa.sa_family, SOCK_DGRAM, IPPROTO_UDP);
   if (sockfd < 0)
     {
       iperf_show_socket_error_reason("udp client create", sockfd);
-      return -1;
+      goto out;
     }
 
+  stream->sockfd = sockfd;
   setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
+  /* The server tells the streams apart by their address and sends the
+   * report back to it, an unbound local socket has none.
+   */
+
+  if (stream->remote.sa.sa_family == AF_LOCAL)
+    {
+      stream->local.un.sun_family = AF_LOCAL;
+      snprintf(stream->local.un.sun_path, sizeof(stream->local.un.sun_path),
+               "%s.%d.%d", ctrl->cfg.path, getpid(), stream->id);
+      unlink(stream->local.un.sun_path);
+
+      if (bind(sockfd, &stream->local.sa, sizeof(stream->local.un)) < 0)
+        {
+          iperf_show_socket_error_reason("udp client bind", sockfd);
+          stream->local.un.sun_path[0] = '\0';
+          goto out;
+        }
+    }
+
   iperf_start_report(ctrl);
-  buffer = ctrl->buffer;
+  buffer = stream->buffer;
   udp = (FAR struct iperf_udp_pkt_t *)buffer;
-  want_send = ctrl->buffer_len;
+  want_send = stream->buffer_len;
   id = 0;
 
-  while (!ctrl->finish)
+  if (stream->send_hdr)
+    {
+      iperf_client_hdr_init(ctrl, (FAR struct iperf_client_hdr_t *)
+                                  (buffer + sizeof(*udp)));
+    }
+
+  while (!ctrl->finish && !iperf_stream_expired(stream))
     {
       if (false == retry)
         {
@@ -715,8 +1910,15 @@ static int iperf_udp_client(FAR struct iperf_ctrl_t *ctrl,
           delay = 1;
         }
 
+      /* Send time for the jitter measurement on the server */
+
+      gettimeofday(&tv, NULL);
+      udp->sec = htonl(tv.tv_sec);
+      udp->usec = htonl(tv.tv_usec);
+
       retry = false;
-      actual_send = sendto(sockfd, buffer, want_send, 0, addr, addrlen);
+      actual_send = sendto(sockfd, buffer, want_send, 0,
+                           &stream->remote.sa, stream->remotelen);
 
       if (actual_send != want_send)
         {
@@ -740,63 +1942,75 @@ static int iperf_udp_client(FAR struct iperf_ctrl_t *ctrl,
         }
       else
         {
-          ctrl->total_len += actual_send;
+          stream->total_len += actual_send;
         }
     }
 
-  ctrl->finish = true;
-  close(sockfd);
+  addrlen = sizeof(stream->local);
+  getsockname(sockfd, &stream->local.sa, &addrlen);
 
-  return 0;
-}
+  iperf_udp_fin(stream, id);
 
-/****************************************************************************
- * Name: iperf_run_udp_client
- *
- * Description:
- *   Start udp client
- *
- ****************************************************************************/
+out:
+  if (stream->remote.sa.sa_family == AF_LOCAL &&
+      stream->local.un.sun_path[0] != '\0')
+    {
+      unlink(stream->local.un.sun_path);
+    }
 
-static int iperf_run_udp_client(FAR struct iperf_ctrl_t *ctrl)
-{
-  return iperf_run_client(ctrl, iperf_udp_client);
+  iperf_stream_close(stream);
+
+  pthread_exit(NULL);
 }
 
 /****************************************************************************
- * Name: iperf_tcp_client
+ * Name: iperf_tcp_tx_stream
  *
  * Description:
- *   The main tcp client logic
+ *   The main tcp client logic of one stream
  *
  ****************************************************************************/
 
-static int iperf_tcp_client(FAR struct iperf_ctrl_t *ctrl,
-                            FAR struct sockaddr *addr, socklen_t addrlen)
+static void iperf_tcp_tx_stream(FAR void *arg)
 {
+  FAR struct iperf_stream_t *stream = arg;
+  FAR struct iperf_ctrl_t *ctrl = stream->ctrl;
   FAR uint8_t *buffer;
+  socklen_t addrlen;
   int actual_send = 0;
   int want_send = 0;
   int sockfd;
 
-  sockfd = socket(addr->sa_family, SOCK_STREAM, IPPROTO_TCP);
+  prctl(PR_SET_NAME, IPERF_STREAM_TASK_NAME);
+
+  sockfd = socket(stream->remote.sa.sa_family, SOCK_STREAM, IPPROTO_TCP);
   if (sockfd < 0)
     {
       iperf_show_socket_error_reason("tcp client create", sockfd);
-      return -1;
+      goto out;
     }
 
-  if (connect(sockfd, addr, addrlen) < 0)
+  stream->sockfd = sockfd;
+
+  if (connect(sockfd, &stream->remote.sa, stream->remotelen) < 0)
     {
       iperf_show_socket_error_reason("tcp client connect", sockfd);
-      return -1;
+      goto out;
     }
 
+  addrlen = sizeof(stream->local);
+  getsockname(sockfd, &stream->local.sa, &addrlen);
+
   iperf_start_report(ctrl);
-  buffer = ctrl->buffer;
-  want_send = ctrl->buffer_len;
+  buffer = stream->buffer;
+  want_send = stream->buffer_len;
 
-  while (!ctrl->finish)
+  if (stream->send_hdr)
+    {
+      iperf_client_hdr_init(ctrl, (FAR struct iperf_client_hdr_t *)buffer);
+    }
+
+  while (!ctrl->finish && !iperf_stream_expired(stream))
     {
       actual_send = send(sockfd, buffer, want_send, 0);
       if (actual_send <= 0)
@@ -806,16 +2020,235 @@ static int iperf_tcp_client(FAR struct iperf_ctrl_t *ctrl,
         }
       else
         {
-          ctrl->total_len += actual_send;
+          stream->total_len += actual_send;
+        }
+    }
+
+out:
+  iperf_stream_close(stream);
+
+  pthread_exit(NULL);
+}
+
+/****************************************************************************
+ * Name: iperf_dual_task
+ *
+ * Description:
+ *   Receive the reverse streams of a dual test on the client side
+ *
+ ****************************************************************************/
+
+static void iperf_dual_task(FAR void *arg)
+{
+  FAR struct iperf_ctrl_t *ctrl = arg;
+  struct sockaddr_in addr;
+
+  prctl(PR_SET_NAME, IPERF_DUAL_TASK_NAME);
+
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(ctrl->cfg.sport);
+  addr.sin_addr.s_addr = ctrl->cfg.sip;
+
+  if (ctrl->cfg.flag & IPERF_FLAG_UDP)
+    {
+      iperf_udp_server(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+  else
+    {
+      iperf_tcp_server(ctrl, (FAR struct sockaddr *)&addr, sizeof(addr));
+    }
+
+  pthread_exit(NULL);
+}
+
+/****************************************************************************
+ * Name: iperf_dual_wait
+ *
+ * Description:
+ *   The reverse streams of a dual test start after ours.  Wait until they
+ *   have finished, or nothing was received for the grace time, before the
+ *   receiving side is stopped.
+ *
+ ****************************************************************************/
+
+static void iperf_dual_wait(FAR struct iperf_ctrl_t *ctrl)
+{
+  FAR struct iperf_stream_t *stream;
+  struct timespec start;
+  struct timespec now;
+  uintmax_t last = 0;
+  uintmax_t total;
+  bool seen;
+  bool active;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (!ctrl->finish)
+    {
+      seen = false;
+      active = false;
+      total = 0;
+
+      pthread_mutex_lock(&ctrl->lock);
+      for (i = 0; i < ctrl->nstreams; i++)
+        {
+          stream = &ctrl->streams[i];
+          if (!stream->tx)
+            {
+              seen = true;
+              active |= !stream->done;
+              total += stream->total_len;
+            }
+        }
+
+      pthread_mutex_unlock(&ctrl->lock);
+
+      if (seen && !active)
+        {
+          break;
+        }
+
+      /* The grace time restarts while data is still being received */
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if (total != last)
+        {
+          last = total;
+          start = now;
+        }
+      else if (ts_diff(&now, &start) >= IPERF_DUAL_GRACE)
+        {
+          break;
+        }
+
+      usleep(IPERF_DUAL_POLL);
+    }
+}
+
+/****************************************************************************
+ * Name: iperf_client
+ *
+ * Description:
+ *   Run the parallel client streams and wait for them
+ *
+ ****************************************************************************/
+
+static int iperf_client(FAR struct iperf_ctrl_t *ctrl,
+                        FAR struct sockaddr *addr, socklen_t addrlen,
+                        FAR void *entry)
+{
+  FAR struct iperf_stream_t *streams[IPERF_MAX_STREAMS];
+  FAR struct iperf_stream_t *stream;
+  FAR void *retval;
+  pthread_t dual;
+  bool has_dual = false;
+  int n = 0;
+  int i;
+
+  /* The reverse streams of a dual test connect to our server port */
+
+  if (ctrl->cfg.flag & IPERF_FLAG_DUAL)
+    {
+      if (iperf_create_thread(&dual, IPERF_TRAFFIC_TASK_PRIORITY,
+                              IPERF_TRAFFIC_TASK_STACK,
+                              (FAR void *)iperf_dual_task, ctrl) == 0)
+        {
+          has_dual = true;
+        }
+      else
+        {
+          printf("iperf_dual: create task failed\n");
+        }
+    }
+
+  for (i = 0; i < ctrl->cfg.nstreams; i++)
+    {
+      stream = iperf_stream_alloc(ctrl, true);
+      if (stream == NULL)
+        {
+          break;
+        }
+
+      memcpy(&stream->remote, addr, addrlen);
+      stream->remotelen = addrlen;
+      stream->send_hdr = has_dual;
+
+      if (has_dual && ctrl->cfg.time != 0)
+        {
+          stream->end = stream->start;
+          stream->end.tv_sec += ctrl->cfg.time;
+        }
+
+      if (iperf_stream_start(stream, entry) == 0)
+        {
+          streams[n++] = stream;
         }
     }
 
+  for (i = 0; i < n; i++)
+    {
+      iperf_stream_join(streams[i]);
+    }
+
+  if (has_dual)
+    {
+      iperf_dual_wait(ctrl);
+    }
+
   ctrl->finish = true;
-  close(sockfd);
+
+  if (has_dual)
+    {
+      pthread_join(dual, &retval);
+    }
 
   return 0;
 }
 
+/****************************************************************************
+ * Name: iperf_udp_client
+ *
+ * Description:
+ *   The main udp client logic
+ *
+ ****************************************************************************/
+
+static int iperf_udp_client(FAR struct iperf_ctrl_t *ctrl,
+                            FAR struct sockaddr *addr, socklen_t addrlen)
+{
+  return iperf_client(ctrl, addr, addrlen,
+                      (FAR void *)iperf_udp_tx_stream);
+}
+
+/****************************************************************************
+ * Name: iperf_run_udp_client
+ *
+ * Description:
+ *   Start udp client
+ *
+ ****************************************************************************/
+
+static int iperf_run_udp_client(FAR struct iperf_ctrl_t *ctrl)
+{
+  return iperf_run_client(ctrl, iperf_udp_client);
+}
+
+/****************************************************************************
+ * Name: iperf_tcp_client
+ *
+ * Description:
+ *   The main tcp client logic
+ *
+ ****************************************************************************/
+
+static int iperf_tcp_client(FAR struct iperf_ctrl_t *ctrl,
+                            FAR struct sockaddr *addr, socklen_t addrlen)
+{
+  return iperf_client(ctrl, addr, addrlen,
+                      (FAR void *)iperf_tcp_tx_stream);
+}
+
 /****************************************************************************
  * Name: iperf_run_tcp_client
  *
@@ -840,6 +2273,7 @@ static int iperf_run_tcp_client(FAR struct iperf_ctrl_t *ctrl)
 static void iperf_task_traffic(FAR void *arg)
 {
   FAR struct iperf_ctrl_t *ctrl = arg;
+  FAR void *retval;
 
   prctl(PR_SET_NAME, IPERF_TRAFFIC_TASK_NAME);
 
@@ -866,37 +2300,35 @@ static void iperf_task_traffic(FAR void *arg)
       assert(false);
     }
 
-  if (ctrl->buffer)
+  /* Wait for the remaining streams and the final report */
+
+  ctrl->finish = true;
+  iperf_streams_join(ctrl);
+
+  if (ctrl->report_started)
     {
-      free(ctrl->buffer);
-      ctrl->buffer = NULL;
+      pthread_join(ctrl->report, &retval);
     }
 
-  printf("iperf exit\n");
+  if (iperf_is_text_report(ctrl))
+    {
+      printf("iperf exit\n");
+    }
 
   pthread_exit(NULL);
 }
 
-static uint32_t iperf_get_buffer_len(FAR struct iperf_ctrl_t *ctrl)
+static uint32_t iperf_get_buffer_len(FAR struct iperf_ctrl_t *ctrl,
+                                     bool tx)
 {
-  if (iperf_is_udp_client(ctrl))
-    {
-      return IPERF_UDP_TX_LEN;
-    }
-  else if (iperf_is_udp_server(ctrl))
+  if (ctrl->cfg.flag & IPERF_FLAG_UDP)
     {
-      return IPERF_UDP_RX_LEN;
-    }
-  else if (iperf_is_tcp_client(ctrl))
-    {
-      return IPERF_TCP_TX_LEN;
+      return tx ? IPERF_UDP_TX_LEN : IPERF_UDP_RX_LEN;
     }
   else
     {
-      return IPERF_TCP_RX_LEN;
+      return tx ? IPERF_TCP_TX_LEN : IPERF_TCP_RX_LEN;
     }
-
-  return 0;
 }
 
 /****************************************************************************
@@ -913,9 +2345,7 @@ static uint32_t iperf_get_buffer_len(FAR struct iperf_ctrl_t *ctrl)
 
 int iperf_start(FAR struct iperf_cfg_t *cfg)
 {
-  struct iperf_ctrl_t ctrl;
-  struct sched_param param;
-  pthread_attr_t attr;
+  FAR struct iperf_ctrl_t *ctrl;
   pthread_t thread;
   FAR void *retval;
   int ret;
@@ -925,43 +2355,48 @@ int iperf_start(FAR struct iperf_cfg_t *cfg)
       return -1;
     }
 
-  memset(&ctrl, 0, sizeof(ctrl));
-  memcpy(&ctrl.cfg, cfg, sizeof(*cfg));
-  ctrl.finish = false;
-  ctrl.buffer_len = iperf_get_buffer_len(&ctrl);
-  ctrl.buffer = (FAR uint8_t *)malloc(ctrl.buffer_len);
-  if (ctrl.buffer == NULL)
+  /* The stream table is too large for the caller stack */
+
+  ctrl = (FAR struct iperf_ctrl_t *)calloc(1, sizeof(*ctrl));
+  if (ctrl == NULL)
     {
-      printf("create buffer: not enough memory\n");
+      printf("create ctrl: not enough memory\n");
       return -1;
     }
 
-  memset(ctrl.buffer, 0, ctrl.buffer_len);
-  pthread_attr_init(&attr);
-  param.sched_priority = IPERF_TRAFFIC_TASK_PRIORITY;
-  pthread_attr_setschedparam(&attr, &param);
-  pthread_attr_setstacksize(&attr, IPERF_TRAFFIC_TASK_STACK);
-  ret = pthread_create(&thread, &attr, (FAR void *)iperf_task_traffic,
-                       &ctrl);
+  memcpy(&ctrl->cfg, cfg, sizeof(*cfg));
+  ctrl->finish = false;
+  if (ctrl->cfg.nstreams < 1 || ctrl->cfg.nstreams > IPERF_MAX_STREAMS)
+    {
+      ctrl->cfg.nstreams = 1;
+    }
 
+  pthread_mutex_init(&ctrl->lock, NULL);
+
+  ret = iperf_create_thread(&thread, IPERF_TRAFFIC_TASK_PRIORITY,
+                            IPERF_TRAFFIC_TASK_STACK,
+                            (FAR void *)iperf_task_traffic, ctrl);
   if (ret != 0)
     {
       printf("iperf_task_traffic: create task failed: %d\n", ret);
-      free(ctrl.buffer);
-      ctrl.buffer = NULL;
+      pthread_mutex_destroy(&ctrl->lock);
+      free(ctrl);
       return -1;
     }
 
   pthread_mutex_lock(&g_iperf_ctrl_mutex);
-  sq_addlast((FAR sq_entry_t *)&ctrl, &g_iperf_ctrl_list);
+  sq_addlast((FAR sq_entry_t *)ctrl, &g_iperf_ctrl_list);
   pthread_mutex_unlock(&g_iperf_ctrl_mutex);
 
   pthread_join(thread, &retval);
 
   pthread_mutex_lock(&g_iperf_ctrl_mutex);
-  sq_rem((FAR sq_entry_t *)&ctrl, &g_iperf_ctrl_list);
+  sq_rem((FAR sq_entry_t *)ctrl, &g_iperf_ctrl_list);
   pthread_mutex_unlock(&g_iperf_ctrl_mutex);
 
+  pthread_mutex_destroy(&ctrl->lock);
+  free(ctrl);
+
   return 0;
 }
 
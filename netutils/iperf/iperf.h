@@ -50,6 +50,17 @@ extern "C"
 #define IPERF_FLAG_UDP    (1 << 3)
 #define IPERF_FLAG_LOCAL  (1 << 4)
 #define IPERF_FLAG_RPMSG  (1 << 5)
+#define IPERF_FLAG_DUAL   (1 << 6)
+
+/* Report styles */
+
+#define IPERF_REPORT_TEXT 0  /* Human readable text */
+#define IPERF_REPORT_CSV  1  /* iperf 2 compatible CSV (-y C) */
+#define IPERF_REPORT_JSON 2  /* One JSON object per line */
+
+/* Maximum number of parallel streams in one direction */
+
+#define IPERF_MAX_STREAMS CONFIG_NETUTILS_IPERF_MAX_STREAMS
 
 /****************************************************************************
  * Public Types
@@ -64,6 +75,8 @@ struct iperf_cfg_t
   uint16_t sport;
   uint32_t interval;
   uint32_t time;
+  uint16_t nstreams;    /* number of parallel client streams */
+  uint8_t report;       /* report style */
   FAR const char *host; /* host name (dip) or rpmsg cpu */
   FAR const char *path; /* local path or rpmsg name */
 };
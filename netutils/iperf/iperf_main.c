@@ -27,6 +27,7 @@
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <strings.h>
+#include <sys/param.h>
 #include <sys/time.h>
 
 #include "argtable3.h"
@@ -61,6 +62,9 @@ struct wifi_iperf_t
   FAR struct arg_int *port;
   FAR struct arg_int *interval;
   FAR struct arg_int *time;
+  FAR struct arg_int *parallel;
+  FAR struct arg_lit *dual;
+  FAR struct arg_str *report;
   FAR struct arg_lit *abort;
   FAR struct arg_end *end;
 };
@@ -80,8 +84,9 @@ struct wifi_iperf_t
 static void iperf_showusage(FAR const char *progname,
                             FAR struct wifi_iperf_t *args, int exitcode)
 {
-  printf("USAGE: %s [-sua] [-c <ip|cpu>] [-p <port>] [-i <interval>] "
-         "[-t <time>] [--local <path>] [--rpmsg <name>]\n", progname);
+  printf("USAGE: %s [-suda] [-c <ip|cpu>] [-p <port>] [-i <interval>] "
+         "[-t <time>] [-P <num>] [-y <C|J>] [--local <path>] "
+         "[--rpmsg <name>]\n", progname);
   printf("iperf command:\n");
   arg_print_glossary(stdout, (FAR void **)args, NULL);
 
@@ -123,8 +128,9 @@ static void iperf_printcfg(FAR struct iperf_cfg_t *cfg)
              (cfg->dip >> 16) & 0xff, (cfg->dip >> 24) & 0xff, cfg->dport);
     }
 
-  printf("interval=%" PRId32 ", time=%" PRId32 "\n",
-         cfg->interval, cfg->time);
+  printf("interval=%" PRId32 ", time=%" PRId32 ", streams=%u%s\n",
+         cfg->interval, cfg->time, cfg->nstreams,
+         cfg->flag & IPERF_FLAG_DUAL ? ", dual" : "");
 }
 
 /****************************************************************************
@@ -154,6 +160,12 @@ int main(int argc, FAR char *argv[])
                             "seconds between periodic bandwidth reports");
   iperf_args.time = arg_int0("t", "time", "<time>",
                         "time in seconds to transmit for (default 10 secs)");
+  iperf_args.parallel = arg_int0("P", "parallel", "<num>",
+                                 "number of parallel client streams");
+  iperf_args.dual = arg_lit0("d", "dualtest",
+                             "do a bidirectional test simultaneously");
+  iperf_args.report = arg_str0("y", "reportstyle", "<C|J>",
+                               "report as CSV or line delimited JSON");
   iperf_args.abort = arg_lit0("a", "abort", "abort running iperf");
   iperf_args.end = arg_end(1);
 
@@ -194,6 +206,28 @@ int main(int argc, FAR char *argv[])
       cfg.flag |= IPERF_FLAG_CLIENT;
     }
 
+  cfg.report = IPERF_REPORT_TEXT;
+  if (iperf_args.report->count != 0)
+    {
+      switch (iperf_args.report->sval[0][0])
+        {
+          case 'c':
+          case 'C':
+            cfg.report = IPERF_REPORT_CSV;
+            break;
+
+          case 'j':
+          case 'J':
+            cfg.report = IPERF_REPORT_JSON;
+            break;
+
+          default:
+            printf("ERROR: unknown report style %s\n",
+                   iperf_args.report->sval[0]);
+            iperf_showusage(argv[0], &iperf_args, 0);
+        }
+    }
+
   if (iperf_args.local->count > 0)
     {
       cfg.flag |= IPERF_FLAG_LOCAL;
@@ -229,7 +263,11 @@ int main(int argc, FAR char *argv[])
           goto out;
         }
 
-      printf("     IP: %s\n", inet_ntoa_r(addr, inetaddr, sizeof(inetaddr)));
+      if (cfg.report == IPERF_REPORT_TEXT)
+        {
+          printf("     IP: %s\n",
+                 inet_ntoa_r(addr, inetaddr, sizeof(inetaddr)));
+        }
 
       cfg.sip = addr.s_addr;
     }
@@ -297,7 +335,37 @@ int main(int argc, FAR char *argv[])
         }
     }
 
-  iperf_printcfg(&cfg);
+  cfg.nstreams = 1;
+  if (iperf_args.parallel->count != 0)
+    {
+      if (iperf_args.parallel->ival[0] < 1)
+        {
+          printf("ERROR: invalid number of parallel streams\n");
+          iperf_showusage(argv[0], &iperf_args, 0);
+        }
+
+      cfg.nstreams = MIN(iperf_args.parallel->ival[0], IPERF_MAX_STREAMS);
+    }
+
+  if (iperf_args.dual->count != 0)
+    {
+      /* The server connects back to the client over IPv4 */
+
+      if (iperf_args.server->count != 0 ||
+          (cfg.flag & (IPERF_FLAG_LOCAL | IPERF_FLAG_RPMSG)))
+        {
+          printf("ERROR: dual test is only supported by inet clients\n");
+          iperf_showusage(argv[0], &iperf_args, 0);
+        }
+
+      cfg.flag |= IPERF_FLAG_DUAL;
+    }
+
+  if (cfg.report == IPERF_REPORT_TEXT)
+    {
+      iperf_printcfg(&cfg);
+    }
+
   iperf_start(&cfg);
 
 out:
@@ -0,0 +1,126 @@
+/****************************************************************************
+ * apps/netutils/netlib/netlib_acceptgzip.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+
+#include "netutils/netlib.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: netlib_acceptq
+ *
+ * Description:
+ *   Return whether the parameters of one Accept-Encoding element, up to
+ *   the next ',', give it a non-zero quality.  A missing q parameter
+ *   means q=1.
+ *
+ ****************************************************************************/
+
+static bool netlib_acceptq(FAR const char *param, size_t len)
+{
+  FAR const char *end = param + len;
+
+  while (param < end)
+    {
+      param += strspn(param, " \t;");
+      if (end - param >= 2 && strncasecmp(param, "q=", 2) == 0)
+        {
+          for (param += 2; param < end; param++)
+            {
+              if (*param >= '1' && *param <= '9')
+                {
+                  return true;
+                }
+              else if (*param != '0' && *param != '.')
+                {
+                  break;
+                }
+            }
+
+          return false;
+        }
+
+      param += strcspn(param, ";,");
+    }
+
+  return true;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: netlib_acceptgzip
+ *
+ * Description:
+ *   Check whether the value of an Accept-Encoding header accepts the
+ *   gzip content coding.  "gzip" and "x-gzip" are matched explicitly, "*"
+ *   applies only when neither is listed, and a q=0 turns a coding down.
+ *
+ * Input Parameters:
+ *   accept - The header value, without the field name
+ *
+ * Returned Value:
+ *   true if a gzip encoded response is acceptable
+ *
+ ****************************************************************************/
+
+bool netlib_acceptgzip(FAR const char *accept)
+{
+  bool listed = false;
+  bool gzip = false;
+  bool any = false;
+  size_t len;
+  size_t plen;
+
+  while (*accept != '\0')
+    {
+      accept += strspn(accept, " \t,");
+      len     = strcspn(accept, " \t,;");
+      plen    = strcspn(accept + len, ",");
+
+      if ((len == 4 && strncasecmp(accept, "gzip", 4) == 0) ||
+          (len == 6 && strncasecmp(accept, "x-gzip", 6) == 0))
+        {
+          listed = true;
+          gzip  |= netlib_acceptq(accept + len, plen);
+        }
+      else if (len == 1 && *accept == '*')
+        {
+          any = netlib_acceptq(accept + len, plen);
+        }
+
+      accept += len + plen;
+    }
+
+  return listed ? gzip : any;
+}
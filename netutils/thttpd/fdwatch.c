@@ -201,9 +201,10 @@ void fdwatch_uninitialize(struct fdwatch_s *fw)
 
 /* Add a descriptor to the watch list. rw is either FDW_READ or FDW_WRITE. */
 
-void fdwatch_add_fd(struct fdwatch_s *fw, int fd, void *client_data)
+void fdwatch_add_fd(struct fdwatch_s *fw, int fd, void *client_data,
+                    int rw)
 {
-  fwinfo("fd: %d client_data: %p\n", fd, client_data);
+  fwinfo("fd: %d client_data: %p rw: %d\n", fd, client_data, rw);
   fdwatch_dump("Before adding:", fw);
 
   if (fw->nwatched >= fw->nfds)
@@ -214,9 +215,10 @@ void fdwatch_add_fd(struct fdwatch_s *fw, int fd, void *client_data)
 
   /* Save the new fd at the end of the list */
 
-  fw->pollfds[fw->nwatched].fd     = fd;
-  fw->pollfds[fw->nwatched].events = POLLIN;
-  fw->client[fw->nwatched]         = client_data;
+  fw->pollfds[fw->nwatched].fd      = fd;
+  fw->pollfds[fw->nwatched].events  = rw == FDW_WRITE ? POLLOUT : POLLIN;
+  fw->pollfds[fw->nwatched].revents = 0;
+  fw->client[fw->nwatched]          = client_data;
 
   /* Increment the count of watched descriptors */
 
@@ -289,7 +291,7 @@ int fdwatch(struct fdwatch_s *fw, long timeout_msecs)
           /* Is there activity on this descriptor? */
 
           if (fw->pollfds[i].revents &
-              (POLLIN | POLLERR | POLLHUP | POLLNVAL))
+              (POLLIN | POLLOUT | POLLERR | POLLHUP | POLLNVAL))
             {
               /* Yes... save it in a shorter list */
 
@@ -328,7 +330,8 @@ int fdwatch_check_fd(struct fdwatch_s *fw, int fd)
   pollndx = fdwatch_pollndx(fw, fd);
   if (pollndx >= 0 && (fw->pollfds[pollndx].revents & POLLERR) == 0)
     {
-      return fw->pollfds[pollndx].revents & (POLLIN | POLLHUP | POLLNVAL);
+      return fw->pollfds[pollndx].revents &
+             (POLLIN | POLLOUT | POLLHUP | POLLNVAL);
     }
 
   fwinfo("POLLERR fd: %d\n", fd);
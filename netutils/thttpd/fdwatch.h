@@ -55,6 +55,11 @@
 #  define INFTIM -1
 #endif
 
+/* Values for the rw argument of fdwatch_add_fd() */
+
+#define FDW_READ  0
+#define FDW_WRITE 1
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -82,9 +87,12 @@ extern struct fdwatch_s *fdwatch_initialize(int nfds);
 
 extern void fdwatch_uninitialize(struct fdwatch_s *fw);
 
-/* Add a descriptor to the watch list */
+/* Add a descriptor to the watch list.  rw is either FDW_READ or
+ * FDW_WRITE.
+ */
 
-extern void fdwatch_add_fd(struct fdwatch_s *fw, int fd, void *client_data);
+extern void fdwatch_add_fd(struct fdwatch_s *fw, int fd, void *client_data,
+                           int rw);
 
 /* Delete a descriptor from the watch list. */
 
@@ -61,6 +61,7 @@
 #include <debug.h>
 #include <fnmatch.h>
 
+#include "netutils/netlib.h"
 #include "netutils/thttpd.h"
 
 #include "config.h"
@@ -108,6 +109,12 @@ extern CODE char *crypt(const char *key, const char *setting);
 
 #define rfc1123fmtstring ("%a, %d %b %Y %H:%M:%S GMT")
 
+/* Extra header sent with every file that has a precompressed variant */
+
+#ifdef CONFIG_THTTPD_GZIP
+#  define GZIP_VARY "Vary: Accept-Encoding\r\n"
+#endif
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
@@ -152,6 +159,9 @@ static char *bufgets(httpd_conn *hc);
 static void de_dotdot(char *file);
 static void init_mime(void);
 static void figure_mime(httpd_conn *hc);
+#ifdef CONFIG_THTTPD_GZIP
+static const char *figure_gzip(httpd_conn *hc);
+#endif
 #ifdef CONFIG_THTTPD_GENERATE_INDICES
 static void ls_child(int argc, char **argv);
 static int  ls(httpd_conn *hc);
@@ -1576,6 +1586,51 @@ done:
     }
 }
 
+#ifdef CONFIG_THTTPD_GZIP
+/* If a fresh "<file>.gz" sibling exists, note that the response varies
+ * with Accept-Encoding and, when the client accepts gzip, switch the
+ * request over to the sibling.  figure_mime() then takes the type from
+ * the original extension and sets the "gzip" encoding.
+ */
+
+static const char *figure_gzip(httpd_conn *hc)
+{
+  struct stat sb;
+  size_t len;
+
+  len = strlen(hc->expnfilename);
+  if (len >= 3 && strcasecmp(&hc->expnfilename[len - 3], ".gz") == 0)
+    {
+      return "";
+    }
+
+  httpd_realloc_str(&hc->expnfilename, &hc->maxexpnfilename, len + 3);
+  strlcat(hc->expnfilename, ".gz", hc->maxexpnfilename + 1);
+
+  /* The sibling must be a world-readable regular file that is not older
+   * than the original, otherwise stale content could be served.
+   */
+
+  if (stat(hc->expnfilename, &sb) < 0 || !S_ISREG(sb.st_mode) ||
+      !(sb.st_mode & S_IROTH) || (sb.st_mode & S_IXOTH) != 0 ||
+      sb.st_mtime < hc->sb.st_mtime)
+    {
+      hc->expnfilename[len] = '\0';
+      return "";
+    }
+
+  if (!netlib_acceptgzip(hc->accepte))
+    {
+      hc->expnfilename[len] = '\0';
+      return GZIP_VARY;
+    }
+
+  ninfo("Serving precompressed \"%s\"\n", hc->expnfilename);
+  hc->sb = sb;
+  return GZIP_VARY;
+}
+#endif /* CONFIG_THTTPD_GZIP */
+
 /* qsort comparison routine. */
 
 #ifdef CONFIG_THTTPD_GENERATE_INDICES
@@ -3211,6 +3266,7 @@ int httpd_start_request(httpd_conn *hc, struct timeval *nowp)
   static char *dirname;
   static size_t maxdirname = 0;
 #endif /* CONFIG_THTTPD_AUTH_FILE */
+  const char *extraheads = "";
   size_t expnlen;
   size_t indxlen;
   char *cp;
@@ -3495,6 +3551,15 @@ int httpd_start_request(httpd_conn *hc, struct timeval *nowp)
       return -1;
     }
 
+  /* Serve a precompressed sibling instead, if the client accepts it.
+   * This must come before range_end is filled in because ranges then
+   * apply to the compressed bytes.
+   */
+
+#ifdef CONFIG_THTTPD_GZIP
+  extraheads = figure_gzip(hc);
+#endif
+
   /* Fill in range_end, if necessary. */
 
   if (hc->got_range &&
@@ -3507,13 +3572,13 @@ int httpd_start_request(httpd_conn *hc, struct timeval *nowp)
 
   if (hc->method == METHOD_HEAD)
     {
-      send_mime(hc, 200, ok200title, hc->encodings, "", hc->type,
+      send_mime(hc, 200, ok200title, hc->encodings, extraheads, hc->type,
                 hc->sb.st_size, hc->sb.st_mtime);
     }
   else if (hc->if_modified_since != (time_t) - 1 &&
            hc->if_modified_since >= hc->sb.st_mtime)
     {
-      send_mime(hc, 304, err304title, hc->encodings, "",
+      send_mime(hc, 304, err304title, hc->encodings, extraheads,
                 hc->type, (off_t) - 1, hc->sb.st_mtime);
     }
   else
@@ -3527,7 +3592,7 @@ int httpd_start_request(httpd_conn *hc, struct timeval *nowp)
           return -1;
         }
 
-      send_mime(hc, 200, ok200title, hc->encodings, "", hc->type,
+      send_mime(hc, 200, ok200title, hc->encodings, extraheads, hc->type,
                 hc->sb.st_size, hc->sb.st_mtime);
     }
 
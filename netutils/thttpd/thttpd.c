@@ -42,6 +42,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#ifdef CONFIG_THTTPD_SENDFILE
+#  include <sys/sendfile.h>
+#endif
+#ifdef CONFIG_THTTPD_MMAP
+#  include <sys/mman.h>
+#endif
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -102,6 +108,10 @@ struct connect_s
   off_t end_offset;            /* The final offset+1 of the file to send */
   off_t offset;                /* The current offset into the file to send */
   bool eof;                    /* Set true when length==0 read from file */
+#ifdef CONFIG_THTTPD_MMAP
+  FAR const uint8_t *map;      /* In-place mapping of an XIP file, or NULL */
+  size_t maplen;               /* The length of the mapping */
+#endif
 };
 
 /****************************************************************************
@@ -147,6 +157,14 @@ static void shut_down(void)
       if (connects[cnum].conn_state != CNST_FREE)
         {
           httpd_close_conn(connects[cnum].hc);
+#ifdef CONFIG_THTTPD_MMAP
+          if (connects[cnum].map != NULL)
+            {
+              munmap((FAR void *)connects[cnum].map,
+                     connects[cnum].maplen);
+              connects[cnum].map = NULL;
+            }
+#endif
         }
 
       if (connects[cnum].hc != NULL)
@@ -249,11 +267,15 @@ static int handle_newconnect(FAR struct timeval *tv, int listen_fd)
       conn->wakeup_timer      = NULL;
       conn->linger_timer      = NULL;
       conn->offset            = 0;
+#ifdef CONFIG_THTTPD_MMAP
+      conn->map               = NULL;
+      conn->maplen            = 0;
+#endif
 
       /* Set the connection file descriptor to no-delay mode */
 
       httpd_set_ndelay(conn->hc->conn_fd);
-      fdwatch_add_fd(fw, conn->hc->conn_fd, conn);
+      fdwatch_add_fd(fw, conn->hc->conn_fd, conn, FDW_READ);
     }
 }
 
@@ -384,10 +406,32 @@ static void handle_read(struct connect_s *conn, struct timeval *tv)
        goto errout_with_400;
     }
 
+#ifdef CONFIG_THTTPD_MMAP
+  /* Content on an XIP file system (e.g. ROMFS in flash) can be sent in
+   * place.  Otherwise fall back to sendfile().
+   */
+
+  conn->map = mmap(NULL, hc->sb.st_size, PROT_READ, MAP_SHARED | MAP_FILE,
+                   hc->file_fd, 0);
+  if (conn->map == MAP_FAILED)
+    {
+      conn->map = NULL;
+    }
+  else
+    {
+      conn->maplen = hc->sb.st_size;
+    }
+#endif
+
   /* We have a valid connection and a file to send to it */
 
   conn->conn_state = CNST_SENDING;
   fdwatch_del_fd(fw, hc->conn_fd);
+#ifdef CONFIG_THTTPD_NONBLOCKING_SEND
+  /* The file is sent one chunk at a time as the socket becomes writable */
+
+  fdwatch_add_fd(fw, hc->conn_fd, conn, FDW_WRITE);
+#endif
   return;
 
 errout_with_400:
@@ -398,6 +442,260 @@ errout_with_connection:
   finish_connection(conn, tv);
 }
 
+#ifdef CONFIG_THTTPD_SENDFILE
+static ssize_t send_file_data(struct connect_s *conn, size_t nbytes)
+{
+  httpd_conn *hc = conn->hc;
+#ifdef CONFIG_THTTPD_MMAP
+  ssize_t nsent;
+
+  if (conn->map != NULL)
+    {
+      /* XIP content is handed to the network stack straight from the
+       * mapping.
+       */
+
+      nsent = write(hc->conn_fd, &conn->map[conn->offset], nbytes);
+      if (nsent > 0)
+        {
+          conn->offset += nsent;
+        }
+
+      return nsent;
+    }
+#endif
+
+  /* sendfile() advances conn->offset by the number of bytes sent */
+
+  return sendfile(hc->conn_fd, hc->file_fd, &conn->offset, nbytes);
+}
+
+static void handle_send(struct connect_s *conn, struct timeval *tv)
+{
+  httpd_conn *hc = conn->hc;
+  ssize_t nwritten;
+  off_t nbytes;
+
+  ninfo("offset: %jd end_offset: %jd bytes_sent: %jd\n",
+        (intmax_t)conn->offset,
+        (intmax_t)conn->end_offset,
+        (intmax_t)hc->bytes_sent);
+
+  /* The response header is still queued in the I/O buffer.  It must go out
+   * before any of the file data.
+   */
+
+  if (hc->buflen > 0)
+    {
+#ifdef CONFIG_THTTPD_NONBLOCKING_SEND
+      nwritten = write(hc->conn_fd, hc->buffer, hc->buflen);
+      if (nwritten < 0)
+        {
+          if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+              return;
+            }
+
+          nerr("ERROR: Error sending %s: %d\n", hc->encodedurl, errno);
+          goto errout_clear_connection;
+        }
+
+      hc->buflen -= nwritten;
+      if (hc->buflen > 0)
+        {
+          memmove(hc->buffer, &hc->buffer[nwritten], hc->buflen);
+        }
+#else
+      nwritten = httpd_write(hc->conn_fd, hc->buffer, hc->buflen);
+      if (nwritten < 0)
+        {
+          nerr("ERROR: Error sending %s: %d\n", hc->encodedurl, errno);
+          goto errout_clear_connection;
+        }
+
+      hc->buflen = 0;
+#endif
+
+      conn->active_at  = tv->tv_sec;
+      hc->bytes_sent  += nwritten;
+
+#ifdef CONFIG_THTTPD_NONBLOCKING_SEND
+      if (hc->buflen > 0)
+        {
+          return;
+        }
+#endif
+    }
+
+  /* Then send the file data without copying it through the I/O buffer */
+
+  while (conn->offset < conn->end_offset)
+    {
+      nbytes = conn->end_offset - conn->offset;
+#ifdef CONFIG_THTTPD_NONBLOCKING_SEND
+      if (nbytes > CONFIG_THTTPD_SENDFILE_CHUNKSIZE)
+        {
+          nbytes = CONFIG_THTTPD_SENDFILE_CHUNKSIZE;
+        }
+#endif
+
+      nwritten = send_file_data(conn, nbytes);
+      if (nwritten < 0)
+        {
+          if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+#ifdef CONFIG_THTTPD_NONBLOCKING_SEND
+              /* Try again on the next writable event */
+
+              return;
+#else
+              if (errno == EINTR)
+                {
+                  continue;
+                }
+
+              /* Wait for the socket to become writable again instead of
+               * spinning here, the other connections are served meanwhile.
+               */
+
+              fdwatch_del_fd(fw, hc->conn_fd);
+              fdwatch_add_fd(fw, hc->conn_fd, conn, FDW_WRITE);
+              return;
+#endif
+            }
+
+          nerr("ERROR: Error sending %s: %d\n", hc->encodedurl, errno);
+          goto errout_clear_connection;
+        }
+      else if (nwritten == 0)
+        {
+          /* The file is shorter than expected */
+
+          conn->end_offset = conn->offset;
+          conn->eof        = true;
+          break;
+        }
+
+      conn->active_at  = tv->tv_sec;
+      hc->bytes_sent  += nwritten;
+      ninfo("Sent %zd bytes\n", nwritten);
+
+#ifdef CONFIG_THTTPD_NONBLOCKING_SEND
+      /* Return to fdwatch() between chunks */
+
+      if (conn->offset < conn->end_offset)
+        {
+          return;
+        }
+#endif
+    }
+
+  /* The file transfer is complete -- finish the connection */
+
+  ninfo("Finish connection\n");
+  finish_connection(conn, tv);
+  return;
+
+errout_clear_connection:
+  ninfo("Clear connection\n");
+  clear_connection(conn, tv);
+}
+#elif defined(CONFIG_THTTPD_NONBLOCKING_SEND)
+static void handle_send(struct connect_s *conn, struct timeval *tv)
+{
+  httpd_conn *hc = conn->hc;
+  ssize_t nwritten;
+  ssize_t nread;
+  off_t nbytes;
+
+  ninfo("offset: %jd end_offset: %jd bytes_sent: %jd\n",
+        (intmax_t)conn->offset,
+        (intmax_t)conn->end_offset,
+        (intmax_t)hc->bytes_sent);
+
+  /* Top up the response buffer with at most one buffer of file data.  The
+   * response header may still be queued at the beginning of the buffer.
+   */
+
+  nbytes = conn->end_offset - conn->offset;
+  if (nbytes > CONFIG_THTTPD_IOBUFFERSIZE - hc->buflen)
+    {
+      nbytes = CONFIG_THTTPD_IOBUFFERSIZE - hc->buflen;
+    }
+
+  if (nbytes > 0 && !conn->eof)
+    {
+      nread = read(hc->file_fd, &hc->buffer[hc->buflen], nbytes);
+      if (nread < 0)
+        {
+          nerr("ERROR: File read error: %d\n", errno);
+          goto errout_clear_connection;
+        }
+      else if (nread == 0)
+        {
+          /* Reading zero bytes means we are at the end of file */
+
+          conn->end_offset = conn->offset;
+          conn->eof        = true;
+        }
+      else
+        {
+          hc->buflen      += nread;
+          conn->offset    += nread;
+        }
+
+      ninfo("Read %zd bytes, buflen %d\n", nread, hc->buflen);
+    }
+
+  /* Send whatever the socket will accept without blocking */
+
+  if (hc->buflen > 0)
+    {
+      nwritten = write(hc->conn_fd, hc->buffer, hc->buflen);
+      if (nwritten < 0)
+        {
+          if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+              /* Try again on the next writable event */
+
+              return;
+            }
+
+          nerr("ERROR: Error sending %s: %d\n", hc->encodedurl, errno);
+          goto errout_clear_connection;
+        }
+
+      /* Keep any unsent tail at the beginning of the buffer */
+
+      hc->buflen -= nwritten;
+      if (hc->buflen > 0)
+        {
+          memmove(hc->buffer, &hc->buffer[nwritten], hc->buflen);
+        }
+
+      conn->active_at  = tv->tv_sec;
+      hc->bytes_sent  += nwritten;
+      ninfo("Wrote %zd bytes\n", nwritten);
+    }
+
+  /* Return to fdwatch() until the whole file has been sent */
+
+  if (conn->offset < conn->end_offset || hc->buflen > 0)
+    {
+      return;
+    }
+
+  /* The file transfer is complete -- finish the connection */
+
+  ninfo("Finish connection\n");
+  finish_connection(conn, tv);
+  return;
+
+errout_clear_connection:
+  ninfo("Clear connection\n");
+  clear_connection(conn, tv);
+}
+#else
 static inline int read_buffer(struct connect_s *conn)
 {
   httpd_conn *hc = conn->hc;
@@ -490,6 +788,7 @@ errout_clear_connection:
   ninfo("Clear connection\n");
   clear_connection(conn, tv);
 }
+#endif /* CONFIG_THTTPD_SENDFILE */
 
 static void handle_linger(struct connect_s *conn, struct timeval *tv)
 {
@@ -557,7 +856,7 @@ static void clear_connection(struct connect_s *conn, struct timeval *tv)
     {
       fdwatch_del_fd(fw, conn->hc->conn_fd);
       conn->conn_state = CNST_LINGERING;
-      fdwatch_add_fd(fw, conn->hc->conn_fd, conn);
+      fdwatch_add_fd(fw, conn->hc->conn_fd, conn, FDW_READ);
       client_data.p = conn;
 
       conn->linger_timer = tmr_create(tv, linger_clear_connection,
@@ -582,6 +881,13 @@ static void really_clear_connection(struct connect_s *conn)
 {
   fdwatch_del_fd(fw, conn->hc->conn_fd);
   httpd_close_conn(conn->hc);
+#ifdef CONFIG_THTTPD_MMAP
+  if (conn->map != NULL)
+    {
+      munmap((FAR void *)conn->map, conn->maplen);
+      conn->map = NULL;
+    }
+#endif
   if (conn->linger_timer != NULL)
     {
       tmr_cancel(conn->linger_timer);
@@ -757,6 +1063,10 @@ int thttpd_main(int argc, char **argv)
       connects[cnum].conn_state  = CNST_FREE;
       connects[cnum].next        = &connects[cnum + 1];
       connects[cnum].hc          = NULL;
+#ifdef CONFIG_THTTPD_MMAP
+      connects[cnum].map         = NULL;
+      connects[cnum].maplen      = 0;
+#endif
     }
 
   connects[AVAILABLE_FDS - 1].next = NULL;      /* End of link list */
@@ -766,7 +1076,7 @@ int thttpd_main(int argc, char **argv)
     {
       if (hs->listen_fd != -1)
         {
-          fdwatch_add_fd(fw, hs->listen_fd, NULL);
+          fdwatch_add_fd(fw, hs->listen_fd, NULL, FDW_READ);
         }
     }
 
@@ -847,10 +1157,17 @@ int thttpd_main(int argc, char **argv)
 
                       case CNST_SENDING:
                         {
+#ifdef CONFIG_THTTPD_NONBLOCKING_SEND
+                          /* Send the next chunk of the file.  The
+                           * connection stays in the watch list until the
+                           * whole file has been sent.
+                           */
+#else
                           /* Send a file -- this really should be performed
                            * on a separate thread to keep the serve from
                            * locking up during the write.
                            */
+#endif
 
                           handle_send(conn, &tv);
                         }
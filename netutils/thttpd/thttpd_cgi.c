@@ -913,8 +913,8 @@ static int cgi_child(int argc, char **argv)
 
   /* Add the read descriptors to the watch */
 
-  fdwatch_add_fd(fw, cc->connfd, NULL);
-  fdwatch_add_fd(fw, cc->rdfd, NULL);
+  fdwatch_add_fd(fw, cc->connfd, NULL, FDW_READ);
+  fdwatch_add_fd(fw, cc->rdfd, NULL, FDW_READ);
 
   /* Send any data that is already buffer to the CGI task */
 
@@ -64,6 +64,12 @@
 #  include <pthread.h>
 #endif
 
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <time.h>
+#endif
+
 #include <arpa/inet.h>
 
 #include "netutils/netlib.h"
@@ -120,6 +126,26 @@
 #  endif
 #endif
 
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+/* How long synchronous output waits for room in the socket */
+
+#  if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+#    define HTTPD_SEND_TIMEOUT (CONFIG_NETUTILS_HTTPD_TIMEOUT * 1000)
+#  else
+#    define HTTPD_SEND_TIMEOUT (-1)
+#  endif
+
+/* A connection has output left to send */
+
+#  define HTTPD_BUSY(p) ((p)->ht_sending || (p)->ht_txlen > 0)
+
+/* Connections are non-blocking, synchronous output waits for room */
+
+#  define httpd_send(s,b,l) httpd_send_wait(s,b,l)
+#else
+#  define httpd_send(s,b,l) send(s,b,l,0)
+#endif
+
 #ifdef CONFIG_NETUTILS_HTTPD_CLASSIC
 #  ifndef CONFIG_NETUTILS_HTTPD_INDEX
 #    ifndef CONFIG_NETUTILS_HTTPD_SCRIPT_DISABLE
@@ -130,6 +156,31 @@
 #  endif
 #endif
 
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* httpd_parse() states */
+
+enum httpd_parse_e
+{
+  STATE_METHOD = 0,
+  STATE_HEADER,
+  STATE_BODY
+};
+
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+/* A connection slot owned by a worker */
+
+struct httpd_conn_s
+{
+  struct httpd_state hc_state;  /* Request state, free if ht_sockfd < 0 */
+#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+  time_t hc_active;             /* Time of the last activity */
+#endif
+};
+#endif
+
 /****************************************************************************
  * Private Data
  ****************************************************************************/
@@ -180,6 +231,27 @@ static int httpd_openindex(struct httpd_state *pstate)
   return ret;
 }
 
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+static int httpd_opengzip(struct httpd_state *pstate)
+{
+  char name[HTTPD_MAX_FILENAME + 3];
+  size_t z;
+
+  /* Do not look for "foo.gz.gz" */
+
+  z = strcspn(pstate->ht_filename, "?");
+  if (z >= 3 && strncmp(&pstate->ht_filename[z - 3], ".gz", 3) == 0)
+    {
+      return ERROR;
+    }
+
+  memcpy(name, pstate->ht_filename, z);
+  strlcpy(name + z, ".gz", sizeof(name) - z);
+
+  return httpd_open(name, &pstate->ht_file);
+}
+#endif
+
 static int httpd_close(struct httpd_fs_file *file)
 {
 #if defined(CONFIG_NETUTILS_HTTPD_CLASSIC)
@@ -350,8 +422,208 @@ static int handle_script(struct httpd_state *pstate)
 }
 #endif
 
+static int httpd_format_headers(FAR char *header, int status,
+                                FAR const char *connection,
+                                FAR const char *mime,
+                                FAR const char *contentlen,
+                                FAR const char *etag,
+                                FAR const char *encoding)
+{
+  /* Construct the header.
+   *
+   * REVISIT:  Wouldn't asprintf be a better option than a large stack
+   * array?
+   */
+
+  return snprintf(header, HTTPD_MAX_HEADERLEN,
+                  "HTTP/1.0 %d %s\r\n"
+#ifndef CONFIG_NETUTILS_HTTPD_SERVERHEADER_DISABLE
+                  "Server: uIP/NuttX http://nuttx.org/\r\n"
+#endif
+                  "Connection: %s\r\n"
+                  "Content-type: %s\r\n"
+                  "%s"
+                  "%s%s%s"
+                  "%s%s%s"
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+                  "Vary: Accept-Encoding\r\n"
+#endif
+                  "\r\n",
+                  status,
+                  status >= 400 ? "Error" : "OK",
+                  connection,
+                  mime,
+                  contentlen,
+                  etag != NULL ? "ETag: " : "",
+                  etag != NULL ? etag : "",
+                  etag != NULL ? "\r\n" : "",
+                  encoding != NULL ? "Content-Encoding: " : "",
+                  encoding != NULL ? encoding : "",
+                  encoding != NULL ? "\r\n" : "");
+}
+
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+/****************************************************************************
+ * Name: httpd_send_wait
+ *
+ * Description:
+ *   Send a whole buffer on a non-blocking connection, waiting for room in
+ *   the socket.  This is only used for output that is generated
+ *   synchronously (scripts, CGI), so a stalled client holds up the worker
+ *   for at most CONFIG_NETUTILS_HTTPD_TIMEOUT seconds.
+ *
+ ****************************************************************************/
+
+static ssize_t httpd_send_wait(int sockfd, FAR const void *buf, size_t len)
+{
+  FAR const char *ptr = buf;
+  struct pollfd fds;
+  size_t sent = 0;
+  ssize_t ret;
+
+  while (sent < len)
+    {
+      ret = send(sockfd, ptr + sent, len - sent, MSG_DONTWAIT);
+      if (ret > 0)
+        {
+          sent += ret;
+          continue;
+        }
+
+      if (ret == 0 ||
+          (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+          return ERROR;
+        }
+
+      fds.fd      = sockfd;
+      fds.events  = POLLOUT;
+      fds.revents = 0;
+
+      ret = poll(&fds, 1, HTTPD_SEND_TIMEOUT);
+      if (ret == 0)
+        {
+          nwarn("WARNING: [%d] send timeout\n", sockfd);
+          errno = ETIMEDOUT;
+          return ERROR;
+        }
+      else if (ret < 0 && errno != EINTR)
+        {
+          return ERROR;
+        }
+    }
+
+  return sent;
+}
+
+/****************************************************************************
+ * Name: httpd_flush
+ *
+ * Description:
+ *   Wait until the queued output is sent, before output that bypasses the
+ *   queue.
+ *
+ ****************************************************************************/
+
+static int httpd_flush(struct httpd_state *pstate)
+{
+  ssize_t ret;
+
+  if (pstate->ht_txlen == 0)
+    {
+      return OK;
+    }
+
+  ret = httpd_send_wait(pstate->ht_sockfd, pstate->ht_txbuf,
+                        pstate->ht_txlen);
+  pstate->ht_txlen = 0;
+
+  return ret < 0 ? ERROR : OK;
+}
+
+/****************************************************************************
+ * Name: httpd_sendpending
+ *
+ * Description:
+ *   Send as much of the queued output as the socket takes now.
+ *
+ ****************************************************************************/
+
+static int httpd_sendpending(struct httpd_state *pstate)
+{
+  ssize_t ret;
+
+  ret = send(pstate->ht_sockfd, pstate->ht_txbuf, pstate->ht_txlen,
+             MSG_DONTWAIT);
+  if (ret < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+          return OK;
+        }
+
+      nerr("ERROR: [%d] send failed: %d\n", pstate->ht_sockfd, errno);
+      return ERROR;
+    }
+  else if (ret == 0)
+    {
+      return ERROR;
+    }
+
+  pstate->ht_txlen -= ret;
+  memmove(pstate->ht_txbuf, pstate->ht_txbuf + ret, pstate->ht_txlen);
+  return OK;
+}
+#endif
+
 static int send_chunk(struct httpd_state *pstate, const char *buf, int len)
 {
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+  ssize_t ret = 0;
+
+  httpd_dumpbuffer("Outgoing chunk", buf, len);
+
+  /* The connection is non-blocking.  What the socket does not take now is
+   * queued and sent by the worker on POLLOUT, ahead of any file body.
+   */
+
+  if (pstate->ht_txlen == 0)
+    {
+      ret = send(pstate->ht_sockfd, buf, len, MSG_DONTWAIT);
+      if (ret < 0)
+        {
+          if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+              return ERROR;
+            }
+
+          ret = 0;
+        }
+
+      buf += ret;
+      len -= ret;
+    }
+
+  if (len <= 0)
+    {
+      return OK;
+    }
+
+  if (len <= sizeof(pstate->ht_txbuf) - pstate->ht_txlen)
+    {
+      memcpy(pstate->ht_txbuf + pstate->ht_txlen, buf, len);
+      pstate->ht_txlen += len;
+      return OK;
+    }
+
+  if (httpd_flush(pstate) != OK ||
+      httpd_send_wait(pstate->ht_sockfd, buf, len) < 0)
+    {
+      return ERROR;
+    }
+
+  return OK;
+#else
   int ret;
 
   do
@@ -369,6 +641,7 @@ static int send_chunk(struct httpd_state *pstate, const char *buf, int len)
   while (len > 0);
 
   return OK;
+#endif
 }
 
 static int httpd_senderror(struct httpd_state *pstate, int status)
@@ -407,6 +680,19 @@ static int httpd_senderror(struct httpd_state *pstate, int status)
 
       ret = send_chunk(pstate, msg, sizeof msg - 1);
     }
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+#  ifdef CONFIG_NETUTILS_HTTPD_SENDFILE
+  else if (pstate->ht_file.fd != -1 && pstate->ht_file.len > 0)
+#  else
+  else if (pstate->ht_file.len > 0)
+#  endif
+    {
+      /* The worker sends the error page as the socket becomes writable */
+
+      pstate->ht_sndoff  = 0;
+      pstate->ht_sending = true;
+    }
+#endif
   else
     {
 #ifdef CONFIG_NETUTILS_HTTPD_CLASSIC
@@ -427,6 +713,9 @@ static int httpd_sendfile(struct httpd_state *pstate)
 {
 #ifndef CONFIG_NETUTILS_HTTPD_SCRIPT_DISABLE
   char *ptr;
+#endif
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  bool prebuilt;
 #endif
   int ret = ERROR;
 
@@ -451,6 +740,16 @@ static int httpd_sendfile(struct httpd_state *pstate)
     }
 #endif
 
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+  /* Prefer the precompressed variant if the client can decode it */
+
+  pstate->ht_gzipped = pstate->ht_gzip && httpd_opengzip(pstate) == OK;
+  if (pstate->ht_gzipped)
+    {
+      ninfo("[%d] sending gzip variant\n", pstate->ht_sockfd);
+    }
+  else
+#endif
   if (httpd_openindex(pstate) != OK)
     {
       nwarn("WARNING: [%d] '%s' not found\n",
@@ -460,6 +759,15 @@ static int httpd_sendfile(struct httpd_state *pstate)
 
 #ifndef CONFIG_NETUTILS_HTTPD_SCRIPT_DISABLE
   ptr = strchr(pstate->ht_filename, ISO_PERIOD);
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+  if (pstate->ht_gzipped)
+    {
+      /* Compressed scripts are sent as they are */
+
+      ptr = NULL;
+    }
+#endif
+
   if (ptr != NULL &&
       strncmp(ptr, ".shtml", strlen(".shtml")) == 0)
     {
@@ -471,16 +779,59 @@ static int httpd_sendfile(struct httpd_state *pstate)
           goto done;
         }
 
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+      /* The script output is sent directly on the socket */
+
+      if (httpd_flush(pstate) != OK)
+        {
+          goto done;
+        }
+#endif
+
       ret = handle_script(pstate);
       goto done;
     }
 #endif
 
-#ifdef CONFIG_NETUTILS_HTTPD_DIRLIST
+#if defined(CONFIG_NETUTILS_HTTPD_DIRLIST)
   if (httpd_send_headers(pstate, 200, -1) != OK)
     {
       goto done;
     }
+#elif defined(CONFIG_NETUTILS_HTTPD_FSINDEX)
+  if (pstate->ht_file.etag != NULL &&
+      strcmp(pstate->ht_etag, pstate->ht_file.etag) == 0)
+    {
+      /* The client's cached copy is still valid */
+
+      ret = httpd_send_headers(pstate, 304, pstate->ht_file.len);
+      goto done;
+    }
+
+  prebuilt = pstate->ht_file.hdr != NULL;
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+  prebuilt = prebuilt && !pstate->ht_gzipped;
+#endif
+#ifndef CONFIG_NETUTILS_HTTPD_KEEPALIVE_DISABLE
+  prebuilt = prebuilt && !pstate->ht_keepalive;
+#endif
+
+  if (prebuilt)
+    {
+      /* Send the header built when the file system was indexed */
+
+      if (send_chunk(pstate, pstate->ht_file.hdr,
+                     pstate->ht_file.hdrlen) != OK)
+        {
+          goto done;
+        }
+    }
+  else if (httpd_send_headers(pstate,
+                              pstate->ht_file.len == 0 ? 204 : 200,
+                              pstate->ht_file.len) != OK)
+    {
+      goto done;
+    }
 #else
   if (httpd_send_headers(pstate, pstate->ht_file.len == 0 ? 204 : 200,
                          pstate->ht_file.len) != OK)
@@ -489,6 +840,21 @@ static int httpd_sendfile(struct httpd_state *pstate)
     }
 #endif
 
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+#  ifdef CONFIG_NETUTILS_HTTPD_SENDFILE
+  if (pstate->ht_file.fd != -1 && pstate->ht_file.len > 0)
+#  else
+  if (pstate->ht_file.len > 0)
+#  endif
+    {
+      /* The worker sends the body as the socket becomes writable */
+
+      pstate->ht_sndoff  = 0;
+      pstate->ht_sending = true;
+      return OK;
+    }
+#endif
+
 #ifdef CONFIG_NETUTILS_HTTPD_CLASSIC
   ret = send_chunk(pstate, pstate->ht_file.data, pstate->ht_file.len);
 #else
@@ -502,168 +868,248 @@ done:
   return ret;
 }
 
-static inline int httpd_parse(struct httpd_state *pstate)
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+/****************************************************************************
+ * Name: httpd_sendbody
+ *
+ * Description:
+ *   Send the next piece of a file body that httpd_sendfile() left for the
+ *   worker.  pstate->ht_sending is cleared once the whole body is sent.
+ *
+ ****************************************************************************/
+
+static int httpd_sendbody(struct httpd_state *pstate)
 {
-  char *o;
+  ssize_t ret;
+  size_t len;
 
-  enum
+  len = pstate->ht_file.len - pstate->ht_sndoff;
+  if (len > HTTPD_IOBUFFER_SIZE)
     {
-      STATE_METHOD,
-      STATE_HEADER,
-      STATE_BODY
-    } state;
-
-  state = STATE_METHOD;
-  o = pstate->ht_buffer;
+      len = HTTPD_IOBUFFER_SIZE;
+    }
 
-  do
+#ifdef CONFIG_NETUTILS_HTTPD_SENDFILE
+  ret = httpd_sendfile_sendpart(pstate->ht_sockfd, &pstate->ht_file,
+                                &pstate->ht_sndoff, len);
+#else
+  httpd_dumpbuffer("Outgoing chunk",
+                   pstate->ht_file.data + pstate->ht_sndoff, len);
+  ret = send(pstate->ht_sockfd, pstate->ht_file.data + pstate->ht_sndoff,
+             len, MSG_DONTWAIT);
+  if (ret > 0)
     {
-      char *start;
-      char *end;
+      pstate->ht_sndoff += ret;
+    }
+#endif
 
-      if (o == pstate->ht_buffer + sizeof pstate->ht_buffer)
+  if (ret < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
         {
-          nerr("ERROR: ht_buffer overflow\n");
-          return 413;
+          return OK;
         }
 
-        {
-          ssize_t r;
+      nerr("ERROR: [%d] send failed: %d\n", pstate->ht_sockfd, errno);
+      return ERROR;
+    }
+  else if (ret == 0)
+    {
+      nerr("ERROR: [%d] '%s' truncated\n",
+           pstate->ht_sockfd, pstate->ht_filename);
+      return ERROR;
+    }
 
-          r = recv(pstate->ht_sockfd, o,
-            sizeof pstate->ht_buffer - (o - pstate->ht_buffer), 0);
-          if (r == 0)
-            {
-              nwarn("WARNING: [%d] connection lost\n", pstate->ht_sockfd);
-              return ERROR;
-            }
+  if (pstate->ht_sndoff >= pstate->ht_file.len)
+    {
+      pstate->ht_sending = false;
+      httpd_close(&pstate->ht_file);
+    }
 
-#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
-          if (r == -1 && errno == EWOULDBLOCK)
-            {
-              nwarn("WARNING: recv timeout\n");
-              return 408;
-            }
+  return OK;
+}
 #endif
 
-          if (r == -1)
-            {
-              nerr("ERROR: [%d] recv failed: %d\n",
-                   pstate->ht_sockfd, errno);
-              return 400;
-            }
+static int httpd_recv(struct httpd_state *pstate)
+{
+  ssize_t r;
 
-          o += r;
-        }
+  if (pstate->ht_buflen == sizeof pstate->ht_buffer)
+    {
+      nerr("ERROR: ht_buffer overflow\n");
+      return 413;
+    }
 
-      /* Here o marks the end of the total block currently awaiting
-       * processing.  There may be multiple lines in a block; next we deal
-       * with each in turn.
-       */
+  r = recv(pstate->ht_sockfd, pstate->ht_buffer + pstate->ht_buflen,
+           sizeof pstate->ht_buffer - pstate->ht_buflen, 0);
+  if (r == 0)
+    {
+      nwarn("WARNING: [%d] connection lost\n", pstate->ht_sockfd);
+      return ERROR;
+    }
 
-      for (start = pstate->ht_buffer;
-           (end = memchr(start, '\r', o - start)), end != NULL;
-           start = end)
-        {
-          *end = '\0';
-          end++;
+#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+  if (r == -1 && errno == EWOULDBLOCK)
+    {
+      nwarn("WARNING: recv timeout\n");
+      return 408;
+    }
+#endif
 
-          /* Here start and end are a single line within the current block */
+  if (r == -1)
+    {
+      nerr("ERROR: [%d] recv failed: %d\n", pstate->ht_sockfd, errno);
+      return 400;
+    }
 
-          httpd_dumpbuffer("Incoming HTTP line", start, end - start);
+  pstate->ht_buflen += r;
+  return OK;
+}
 
-          if (*end != '\n')
-            {
-              nwarn("WARNING: expected CRLF\n");
-              return 400;
-            }
+/****************************************************************************
+ * Name: httpd_parse_lines
+ *
+ * Description:
+ *   Process the complete lines received so far.  The parser state is kept
+ *   in pstate so that a request may arrive in any number of pieces.
+ *
+ * Returned Value:
+ *   OK if more input is needed, 200 once the request headers are complete,
+ *   or the HTTP error status to be returned to the client.
+ *
+ ****************************************************************************/
 
-          end++;
+static int httpd_parse_lines(struct httpd_state *pstate)
+{
+  char *o = pstate->ht_buffer + pstate->ht_buflen;
+  char *start;
+  char *end;
+
+  /* Here o marks the end of the total block currently awaiting
+   * processing.  There may be multiple lines in a block; next we deal
+   * with each in turn.  Lines after the end of the headers belong to the
+   * next, pipelined request and are left in the buffer.
+   */
 
-          switch (state)
-          {
-          char *v;
-
-          case STATE_METHOD:
-            if (0 != strncmp(start, "GET ", 4))
-              {
-                nwarn("WARNING: method not supported\n");
-                return 501;
-              }
-
-            start += 4;
-            v = start + strcspn(start, " ");
-
-            if (0 != strcmp(v, " HTTP/1.0") && 0 != strcmp(v, " HTTP/1.1"))
-              {
-                nwarn("WARNING: HTTP version not supported\n");
-                return 505;
-              }
-
-            /* TODO: url decoding */
-
-            if (v - start >= sizeof pstate->ht_filename)
-              {
-                nerr("ERROR: ht_filename overflow\n");
-                return 414;
-              }
-
-            *v = '\0';
-            strlcpy(pstate->ht_filename, start, sizeof(pstate->ht_filename));
-            state = STATE_HEADER;
-            break;
+  for (start = pstate->ht_buffer;
+       pstate->ht_parse != STATE_BODY &&
+       (end = memchr(start, '\r', o - start)) != NULL;
+       start = end)
+    {
+      *end = '\0';
+      end++;
 
-          case STATE_HEADER:
-            if (*start == '\0')
-              {
-                state = STATE_BODY;
-                break;
-              }
-
-            v = start + strcspn(start, ":");
-            if (*v != '\0')
-              {
-                *v = '\0', v++;
-                v += strspn(v, ": ");
-              }
-
-            if (*start == '\0' || *v == '\0')
-              {
-                nwarn("WARNING: header parse error\n");
-                return 400;
-              }
-
-            ninfo("[%d] Request header %s: %s\n",
-                  pstate->ht_sockfd, start, v);
-
-            if (0 == strcasecmp(start, "Content-Length") && 0 != atoi(v))
-              {
-                nwarn("WARNING: non-zero request length\n");
-                return 413;
-              }
-#ifndef CONFIG_NETUTILS_HTTPD_KEEPALIVE_DISABLE
-            else if (0 == strcasecmp(start, "Connection") &&
-                     0 == strcasecmp(v, "keep-alive"))
-              {
-                pstate->ht_keepalive = true;
-              }
-#endif
-            break;
+      /* Here start and end are a single line within the current block */
+
+      httpd_dumpbuffer("Incoming HTTP line", start, end - start);
+
+      if (*end != '\n')
+        {
+          nwarn("WARNING: expected CRLF\n");
+          return 400;
+        }
+
+      end++;
+
+      switch (pstate->ht_parse)
+      {
+      char *v;
+
+      case STATE_METHOD:
+        if (0 != strncmp(start, "GET ", 4))
+          {
+            nwarn("WARNING: method not supported\n");
+            return 501;
+          }
+
+        start += 4;
+        v = start + strcspn(start, " ");
 
-          case STATE_BODY:
+        if (0 != strcmp(v, " HTTP/1.0") && 0 != strcmp(v, " HTTP/1.1"))
+          {
+            nwarn("WARNING: HTTP version not supported\n");
+            return 505;
+          }
+
+        /* TODO: url decoding */
+
+        if (v - start >= sizeof pstate->ht_filename)
+          {
+            nerr("ERROR: ht_filename overflow\n");
+            return 414;
+          }
 
-            /* Not implemented */
+        *v = '\0';
+        strlcpy(pstate->ht_filename, start, sizeof(pstate->ht_filename));
+        pstate->ht_parse = STATE_HEADER;
+        break;
 
+      case STATE_HEADER:
+        if (*start == '\0')
+          {
+            pstate->ht_parse = STATE_BODY;
             break;
           }
-       }
 
-      /* Shuffle down for the next block */
+        v = start + strcspn(start, ":");
+        if (*v != '\0')
+          {
+            *v = '\0', v++;
+            v += strspn(v, ": ");
+          }
+
+        if (*start == '\0' || *v == '\0')
+          {
+            nwarn("WARNING: header parse error\n");
+            return 400;
+          }
+
+        ninfo("[%d] Request header %s: %s\n",
+              pstate->ht_sockfd, start, v);
+
+        if (0 == strcasecmp(start, "Content-Length") && 0 != atoi(v))
+          {
+            nwarn("WARNING: non-zero request length\n");
+            return 413;
+          }
+#ifndef CONFIG_NETUTILS_HTTPD_KEEPALIVE_DISABLE
+        else if (0 == strcasecmp(start, "Connection") &&
+                 0 == strcasecmp(v, "keep-alive"))
+          {
+            pstate->ht_keepalive = true;
+          }
+#endif
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+        else if (0 == strcasecmp(start, "If-None-Match"))
+          {
+            strlcpy(pstate->ht_etag, v, sizeof(pstate->ht_etag));
+          }
+#endif
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+        else if (0 == strcasecmp(start, "Accept-Encoding"))
+          {
+            pstate->ht_gzip = netlib_acceptgzip(v);
+          }
+#endif
+        break;
+
+      case STATE_BODY:
+
+        /* Not implemented */
 
-      memmove(pstate->ht_buffer, start, o - start);
-      o -= (start - pstate->ht_buffer);
+        break;
+      }
+    }
+
+  /* Shuffle down for the next block */
+
+  memmove(pstate->ht_buffer, start, o - start);
+  pstate->ht_buflen = o - start;
+
+  if (pstate->ht_parse != STATE_BODY)
+    {
+      return OK;
     }
-  while (state != STATE_BODY);
 
 #ifdef CONFIG_NETUTILS_HTTPD_CLASSIC
   if (0 == strcmp(pstate->ht_filename, "/"))
@@ -678,6 +1124,37 @@ static inline int httpd_parse(struct httpd_state *pstate)
   return 200;
 }
 
+static inline int httpd_parse(struct httpd_state *pstate)
+{
+  int status;
+
+  pstate->ht_parse  = STATE_METHOD;
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  pstate->ht_etag[0] = '\0';
+#endif
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+  pstate->ht_gzip    = false;
+  pstate->ht_gzipped = false;
+#endif
+
+  /* A pipelined request may already be in the buffer */
+
+  status = httpd_parse_lines(pstate);
+  while (status == OK)
+    {
+      status = httpd_recv(pstate);
+      if (status != OK)
+        {
+          return status;
+        }
+
+      status = httpd_parse_lines(pstate);
+    }
+
+  return status;
+}
+
+#ifndef CONFIG_NETUTILS_HTTPD_WORKERPOOL
 /****************************************************************************
  * Name: httpd_handler
  *
@@ -740,6 +1217,7 @@ static void *httpd_handler(void *arg)
   close(sockfd);
   return NULL;
 }
+#endif
 
 #ifdef CONFIG_NETUTILS_HTTPD_SINGLECONNECT
 static void single_server(uint16_t portno, pthread_startroutine_t handler,
@@ -819,6 +1297,439 @@ static void single_server(uint16_t portno, pthread_startroutine_t handler,
 }
 #endif
 
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+static int httpd_conn_open(struct httpd_conn_s *pconn, int sockfd)
+{
+  struct httpd_state *pstate = &pconn->hc_state;
+#ifdef CONFIG_NET_SOLINGER
+  struct linger ling;
+#endif
+  int flags;
+
+  /* The connection is non-blocking, so that a client that does not read
+   * its response cannot stall the worker.  Output that does not fit in the
+   * socket is resumed on POLLOUT.
+   */
+
+  flags = fcntl(sockfd, F_GETFL, 0);
+  if (flags == -1 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+      nerr("ERROR: fcntl O_NONBLOCK failure: %d\n", errno);
+      close(sockfd);
+      return ERROR;
+    }
+
+  /* Configure to "linger" until all data is sent when the socket is
+   * closed.
+   */
+
+#ifdef CONFIG_NET_SOLINGER
+  ling.l_onoff  = 1;
+  ling.l_linger = 30;     /* timeout is seconds */
+  if (setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &ling,
+                 sizeof(struct linger)) < 0)
+    {
+      nerr("ERROR: setsockopt SO_LINGER failure: %d\n", errno);
+      close(sockfd);
+      return ERROR;
+    }
+#endif
+
+  memset(pstate, 0, sizeof(struct httpd_state));
+  pstate->ht_sockfd = sockfd;
+  pstate->ht_parse  = STATE_METHOD;
+#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+  pconn->hc_active  = time(NULL);
+#endif
+
+  ninfo("[%d] Started\n", sockfd);
+  return OK;
+}
+
+static void httpd_conn_close(struct httpd_conn_s *pconn)
+{
+  struct httpd_state *pstate = &pconn->hc_state;
+
+  ninfo("[%d] Exiting\n", pstate->ht_sockfd);
+
+  pstate->ht_txlen = 0;
+
+  if (pstate->ht_sending)
+    {
+      pstate->ht_sending = false;
+      httpd_close(&pstate->ht_file);
+    }
+
+  close(pstate->ht_sockfd);
+  pstate->ht_sockfd = -1;
+}
+
+static bool httpd_conn_done(struct httpd_conn_s *pconn)
+{
+#ifndef CONFIG_NETUTILS_HTTPD_KEEPALIVE_DISABLE
+  struct httpd_state *pstate = &pconn->hc_state;
+
+  if (pstate->ht_keepalive)
+    {
+      /* Wait for the next request on the same connection.  Bytes of a
+       * pipelined request stay in ht_buffer.
+       */
+
+      pstate->ht_keepalive = false;
+      pstate->ht_parse     = STATE_METHOD;
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+      pstate->ht_etag[0]   = '\0';
+#endif
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+      pstate->ht_gzip      = false;
+      pstate->ht_gzipped   = false;
+#endif
+      return true;
+    }
+#endif
+
+  httpd_conn_close(pconn);
+  return false;
+}
+
+/****************************************************************************
+ * Name: httpd_conn_process
+ *
+ * Description:
+ *   Serve the requests that are complete in the receive buffer, until a
+ *   response has to wait for the socket or more input is needed.
+ *
+ ****************************************************************************/
+
+static void httpd_conn_process(struct httpd_conn_s *pconn)
+{
+  struct httpd_state *pstate = &pconn->hc_state;
+  int status;
+
+  do
+    {
+      status = httpd_parse_lines(pstate);
+      if (status == OK)
+        {
+          /* The request is not complete yet */
+
+          return;
+        }
+
+      if (status >= 400)
+        {
+          status = httpd_senderror(pstate, status);
+        }
+      else
+        {
+          status = httpd_sendfile(pstate);
+        }
+
+      if (status != OK)
+        {
+          httpd_conn_close(pconn);
+          return;
+        }
+
+      if (HTTPD_BUSY(pstate))
+        {
+          return;
+        }
+    }
+  while (httpd_conn_done(pconn) && pstate->ht_buflen > 0);
+}
+
+static void httpd_conn_input(struct httpd_conn_s *pconn)
+{
+  int status;
+
+  /* poll() reported data, so this recv() does not block */
+
+  status = httpd_recv(&pconn->hc_state);
+  if (status == ERROR)
+    {
+      httpd_conn_close(pconn);
+    }
+  else if (status != OK)
+    {
+      if (httpd_senderror(&pconn->hc_state, status) != OK ||
+          !HTTPD_BUSY(&pconn->hc_state))
+        {
+          httpd_conn_close(pconn);
+        }
+    }
+  else
+    {
+      httpd_conn_process(pconn);
+    }
+}
+
+static void httpd_conn_output(struct httpd_conn_s *pconn)
+{
+  struct httpd_state *pstate = &pconn->hc_state;
+  int ret;
+
+  /* Queued headers go out before the body */
+
+  if (pstate->ht_txlen > 0)
+    {
+      ret = httpd_sendpending(pstate);
+    }
+  else
+    {
+      ret = httpd_sendbody(pstate);
+    }
+
+  if (ret != OK)
+    {
+      httpd_conn_close(pconn);
+    }
+  else if (!HTTPD_BUSY(pstate) && httpd_conn_done(pconn) &&
+           pstate->ht_buflen > 0)
+    {
+      httpd_conn_process(pconn);
+    }
+}
+
+/****************************************************************************
+ * Name: httpd_worker
+ *
+ * Description:
+ *   Each worker services up to CONFIG_NETUTILS_HTTPD_WORKER_NCONNS
+ *   connections with a single poll().  While it has a free slot it also
+ *   watches the shared listening socket; whichever idle worker wins the
+ *   race for accept() takes the new connection.
+ *
+ ****************************************************************************/
+
+static void *httpd_worker(void *arg)
+{
+  struct pollfd fds[CONFIG_NETUTILS_HTTPD_WORKER_NCONNS + 1];
+  uint8_t slot[CONFIG_NETUTILS_HTTPD_WORKER_NCONNS + 1];
+  struct httpd_conn_s *conns;
+  struct httpd_state *pstate;
+  int listensd = (intptr_t)arg;
+  int timeout;
+  int freeslot;
+  int nfds;
+  int ret;
+  int i;
+#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+  time_t now;
+#endif
+
+  conns = (struct httpd_conn_s *)
+    malloc(sizeof(struct httpd_conn_s) * CONFIG_NETUTILS_HTTPD_WORKER_NCONNS);
+  if (conns == NULL)
+    {
+      nerr("ERROR: Failed to allocate connections\n");
+      return NULL;
+    }
+
+  for (i = 0; i < CONFIG_NETUTILS_HTTPD_WORKER_NCONNS; i++)
+    {
+      conns[i].hc_state.ht_sockfd = -1;
+    }
+
+  for (; ; )
+    {
+      /* Build the poll set: one entry per connection waiting for input or
+       * for room to send, plus the listener if there is a free slot.
+       */
+
+      nfds     = 0;
+      freeslot = -1;
+      timeout  = -1;
+
+      for (i = 0; i < CONFIG_NETUTILS_HTTPD_WORKER_NCONNS; i++)
+        {
+          pstate = &conns[i].hc_state;
+          if (pstate->ht_sockfd < 0)
+            {
+              freeslot = i;
+              continue;
+            }
+
+          fds[nfds].fd      = pstate->ht_sockfd;
+          fds[nfds].events  = HTTPD_BUSY(pstate) ? POLLOUT : POLLIN;
+          fds[nfds].revents = 0;
+          slot[nfds]        = i;
+          nfds++;
+
+#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+          timeout = 1000;
+#endif
+        }
+
+      if (freeslot >= 0)
+        {
+          fds[nfds].fd      = listensd;
+          fds[nfds].events  = POLLIN;
+          fds[nfds].revents = 0;
+          slot[nfds]        = CONFIG_NETUTILS_HTTPD_WORKER_NCONNS;
+          nfds++;
+        }
+
+      ret = poll(fds, nfds, timeout);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+
+          nerr("ERROR: poll failure: %d\n", errno);
+          break;
+        }
+
+      for (i = 0; i < nfds && ret > 0; i++)
+        {
+          if (fds[i].revents == 0)
+            {
+              continue;
+            }
+
+          ret--;
+
+          if (slot[i] == CONFIG_NETUTILS_HTTPD_WORKER_NCONNS)
+            {
+              int acceptsd;
+
+              if ((fds[i].revents & (POLLERR | POLLNVAL)) != 0)
+                {
+                  nerr("ERROR: listener failure\n");
+                  goto errout;
+                }
+
+              /* Another worker may have taken the connection already */
+
+              acceptsd = accept(listensd, NULL, NULL);
+              if (acceptsd < 0)
+                {
+                  if (errno != EAGAIN && errno != EWOULDBLOCK &&
+                      errno != EINTR)
+                    {
+                      nerr("ERROR: accept failure: %d\n", errno);
+                    }
+
+                  continue;
+                }
+
+              httpd_conn_open(&conns[freeslot], acceptsd);
+              continue;
+            }
+
+          pstate = &conns[slot[i]].hc_state;
+
+#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+          conns[slot[i]].hc_active = time(NULL);
+#endif
+
+          if (HTTPD_BUSY(pstate))
+            {
+              if ((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+                {
+                  httpd_conn_close(&conns[slot[i]]);
+                }
+              else
+                {
+                  httpd_conn_output(&conns[slot[i]]);
+                }
+            }
+          else
+            {
+              /* A hang-up is reported by recv() returning zero */
+
+              httpd_conn_input(&conns[slot[i]]);
+            }
+        }
+
+#if CONFIG_NETUTILS_HTTPD_TIMEOUT > 0
+      /* Close connections that have been idle for too long */
+
+      now = time(NULL);
+      for (i = 0; i < CONFIG_NETUTILS_HTTPD_WORKER_NCONNS; i++)
+        {
+          pstate = &conns[i].hc_state;
+          if (pstate->ht_sockfd >= 0 &&
+              now - conns[i].hc_active >= CONFIG_NETUTILS_HTTPD_TIMEOUT)
+            {
+              nwarn("WARNING: [%d] timeout\n", pstate->ht_sockfd);
+              if (!HTTPD_BUSY(pstate) && pstate->ht_buflen > 0)
+                {
+                  httpd_senderror(pstate, 408);
+                }
+
+              httpd_conn_close(&conns[i]);
+            }
+        }
+#endif
+    }
+
+errout:
+  for (i = 0; i < CONFIG_NETUTILS_HTTPD_WORKER_NCONNS; i++)
+    {
+      if (conns[i].hc_state.ht_sockfd >= 0)
+        {
+          httpd_conn_close(&conns[i]);
+        }
+    }
+
+  free(conns);
+  return NULL;
+}
+
+static void pool_server(uint16_t portno, int stacksize)
+{
+  pthread_attr_t attr;
+  pthread_t child;
+  int listensd;
+  int flags;
+  int ret;
+  int i;
+
+  listensd = netlib_listenon(portno);
+  if (listensd < 0)
+    {
+      return;
+    }
+
+  flags = fcntl(listensd, F_GETFL, 0);
+  if (flags == -1 || fcntl(listensd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+      nerr("ERROR: fcntl failure: %d\n", errno);
+      close(listensd);
+      return;
+    }
+
+  /* Start the additional workers.  The calling thread becomes the first
+   * worker.
+   */
+
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, stacksize);
+
+  for (i = 1; i < CONFIG_NETUTILS_HTTPD_NWORKERS; i++)
+    {
+      ret = pthread_create(&child, &attr, httpd_worker,
+                           (pthread_addr_t)((uintptr_t)listensd));
+      if (ret != 0)
+        {
+          nerr("ERROR: pthread_create failed: %d\n", ret);
+          break;
+        }
+
+      pthread_detach(child);
+    }
+
+  httpd_worker((pthread_addr_t)((uintptr_t)listensd));
+
+  /* Closing the listener also stops the other workers */
+
+  close(listensd);
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -842,8 +1753,10 @@ int httpd_listen(void)
 {
   /* Execute httpd_handler on each connection to port 80 */
 
-#ifdef CONFIG_NETUTILS_HTTPD_SINGLECONNECT
+#if defined(CONFIG_NETUTILS_HTTPD_SINGLECONNECT)
   single_server(HTONS(80), httpd_handler, CONFIG_NETUTILS_HTTPDSTACKSIZE);
+#elif defined(CONFIG_NETUTILS_HTTPD_WORKERPOOL)
+  pool_server(HTONS(80), CONFIG_NETUTILS_HTTPDSTACKSIZE);
 #else
   netlib_server(HTONS(80), httpd_handler, CONFIG_NETUTILS_HTTPDSTACKSIZE);
 #endif
@@ -871,7 +1784,7 @@ int httpd_send_datachunk(int sockfd, void *data, int len, bool chunked)
     {
       int chunked_info_len = snprintf(chunked_info, HTTPD_MAX_CHUNKEDLEN,
            "%X\r\n", len);
-      ret = send(sockfd, chunked_info, chunked_info_len, 0);
+      ret = httpd_send(sockfd, chunked_info, chunked_info_len);
       DEBUGASSERT(ret == chunked_info_len);
     }
 #endif
@@ -887,7 +1800,7 @@ int httpd_send_datachunk(int sockfd, void *data, int len, bool chunked)
           data = &len;
         }
 
-      ret = send(sockfd, data, len, 0);
+      ret = httpd_send(sockfd, data, len);
       DEBUGASSERT(ret == len);
     }
 
@@ -898,7 +1811,7 @@ int httpd_send_datachunk(int sockfd, void *data, int len, bool chunked)
     {
       if (chunked)
         {
-          ret = send(sockfd, "\r\n", 2, 0);
+          ret = httpd_send(sockfd, "\r\n", 2);
           DEBUGASSERT(ret == 2);
         }
     }
@@ -908,20 +1821,13 @@ int httpd_send_datachunk(int sockfd, void *data, int len, bool chunked)
 }
 
 /****************************************************************************
- * Name: httpd_send_headers
+ * Name: httpd_mimetype
  ****************************************************************************/
 
-int httpd_send_headers(struct httpd_state *pstate, int status, int len)
+FAR const char *httpd_mimetype(FAR const char *filename)
 {
   const char *mime;
   const char *ptr;
-  char contentlen[HTTPD_MAX_CONTENTLEN] =
-    {
-      0
-    };
-
-  char header[HTTPD_MAX_HEADERLEN];
-  int hdrlen;
   int i;
 
   static const struct
@@ -979,7 +1885,7 @@ int httpd_send_headers(struct httpd_state *pstate, int status, int len)
     },
     };
 
-  ptr = strrchr(pstate->ht_filename, ISO_PERIOD);
+  ptr = strrchr(filename, ISO_PERIOD);
   if (ptr == NULL)
     {
       mime = "application/octet-stream";
@@ -999,7 +1905,7 @@ int httpd_send_headers(struct httpd_state *pstate, int status, int len)
     }
 
 #ifdef CONFIG_NETUTILS_HTTPD_DIRLIST
-  if (false == httpd_is_file(pstate->ht_filename))
+  if (false == httpd_is_file(filename))
     {
       /* we assume that it's a directory */
 
@@ -1007,6 +1913,44 @@ int httpd_send_headers(struct httpd_state *pstate, int status, int len)
     }
 #endif
 
+  return mime;
+}
+
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+/****************************************************************************
+ * Name: httpd_format_header
+ ****************************************************************************/
+
+int httpd_format_header(FAR char *header, FAR const char *filename,
+                        int len, FAR const char *etag)
+{
+  char contentlen[HTTPD_MAX_CONTENTLEN];
+
+  snprintf(contentlen, HTTPD_MAX_CONTENTLEN,
+           "Content-Length: %d\r\n", len);
+
+  return httpd_format_headers(header, 200, "close",
+                              httpd_mimetype(filename), contentlen, etag,
+                              NULL);
+}
+#endif
+
+/****************************************************************************
+ * Name: httpd_send_headers
+ ****************************************************************************/
+
+int httpd_send_headers(struct httpd_state *pstate, int status, int len)
+{
+  FAR const char *encoding = NULL;
+  FAR const char *etag = NULL;
+  char contentlen[HTTPD_MAX_CONTENTLEN] =
+    {
+      0
+    };
+
+  char header[HTTPD_MAX_HEADERLEN];
+  int hdrlen;
+
   if (len >= 0)
     {
       snprintf(contentlen, HTTPD_MAX_CONTENTLEN,
@@ -1033,31 +1977,28 @@ int httpd_send_headers(struct httpd_state *pstate, int status, int len)
       /* TODO: here we "SHOULD" include a Retry-After header */
     }
 
-  /* Construct the header.
-   *
-   * REVISIT:  Wouldn't asprintf be a better option than a large stack
-   * array?
-   */
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  if (status < 400)
+    {
+      etag = pstate->ht_file.etag;
+    }
+#endif
 
-  hdrlen = snprintf(header, HTTPD_MAX_HEADERLEN,
-                    "HTTP/1.0 %d %s\r\n"
-#ifndef CONFIG_NETUTILS_HTTPD_SERVERHEADER_DISABLE
-                    "Server: uIP/NuttX http://nuttx.org/\r\n"
-#endif
-                    "Connection: %s\r\n"
-                    "Content-type: %s\r\n"
-                    "%s"
-                    "\r\n",
-                    status,
-                    status >= 400 ? "Error" : "OK",
+#ifdef CONFIG_NETUTILS_HTTPD_GZIP
+  if (status < 400 && pstate->ht_gzipped)
+    {
+      encoding = "gzip";
+    }
+#endif
+
+  hdrlen = httpd_format_headers(header, status,
 #ifndef CONFIG_NETUTILS_HTTPD_KEEPALIVE_DISABLE
-                    pstate->ht_keepalive ? "keep-alive" : "close",
+                                pstate->ht_keepalive ? "keep-alive" : "close",
 #else
-                    "close",
+                                "close",
 #endif
-                    mime,
-                    contentlen
-                    );
+                                httpd_mimetype(pstate->ht_filename),
+                                contentlen, etag, encoding);
 
   return send_chunk(pstate, header, hdrlen);
 }
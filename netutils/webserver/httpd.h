@@ -63,6 +63,10 @@
 int httpd_sendfile_open(const char *name, struct httpd_fs_file *file);
 int httpd_sendfile_close(struct httpd_fs_file *file);
 int httpd_sendfile_send(int outfd, struct httpd_fs_file *file);
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+ssize_t httpd_sendfile_sendpart(int outfd, struct httpd_fs_file *file,
+                                off_t *offset, size_t count);
+#endif
 
 #elif defined(CONFIG_NETUTILS_HTTPD_MMAP)
 
@@ -76,4 +80,11 @@ void httpd_fs_init(void);
 
 #endif
 
+FAR const char *httpd_mimetype(FAR const char *filename);
+
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+int httpd_format_header(FAR char *header, FAR const char *filename,
+                        int len, FAR const char *etag);
+#endif
+
 #endif /* _NETUTILS_WEBSERVER_HTTPD_H */
@@ -43,6 +43,11 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+#  include <inttypes.h>
+#  include <stdio.h>
+#  include <string.h>
+#endif
 
 #include "netutils/httpd.h"
 
@@ -52,6 +57,25 @@
  * Pre-processor Definitions
  ****************************************************************************/
 
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+/* One entry of the name-sorted file index */
+
+struct httpd_fs_entry_s
+{
+  FAR const struct httpd_fsdata_file *fe_file; /* The ROM file */
+  FAR char *fe_header;                         /* Pre-built header or NULL */
+  int fe_hdrlen;                               /* Length of fe_header */
+  char fe_etag[HTTPD_MAX_ETAGLEN];             /* Quoted entity tag */
+#ifdef CONFIG_NETUTILS_HTTPDFSSTATS
+  uint16_t fe_count;                           /* Number of opens */
+#endif
+};
+#endif
+
 /****************************************************************************
  * Private Data
  ****************************************************************************/
@@ -60,6 +84,11 @@
 static uint16_t *count;
 #endif
 
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+static FAR struct httpd_fs_entry_s *g_fsindex;
+static int g_fsnindex;
+#endif
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
@@ -85,6 +114,136 @@ static uint8_t httpd_fs_strcmp(const char *str1, const char *str2)
     }
 }
 
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+static int httpd_fs_compare(FAR const void *a, FAR const void *b)
+{
+  FAR const struct httpd_fs_entry_s *ea = a;
+  FAR const struct httpd_fs_entry_s *eb = b;
+
+  return strcmp((FAR const char *)ea->fe_file->name,
+                (FAR const char *)eb->fe_file->name);
+}
+
+/* Find the entry whose name equals the request path.  The path ends at the
+ * first '?', CR or LF.
+ */
+
+static FAR struct httpd_fs_entry_s *httpd_fs_lookup(FAR const char *name)
+{
+  FAR const char *fname;
+  size_t keylen;
+  int lo;
+  int hi;
+  int mid;
+  int cmp;
+
+  keylen = strcspn(name, "?\r\n");
+  lo     = 0;
+  hi     = g_fsnindex - 1;
+
+  while (lo <= hi)
+    {
+      mid   = (lo + hi) / 2;
+      fname = (FAR const char *)g_fsindex[mid].fe_file->name;
+      cmp   = strncmp(name, fname, keylen);
+      if (cmp == 0 && fname[keylen] != '\0')
+        {
+          /* The request path is a prefix of this name */
+
+          cmp = -1;
+        }
+
+      if (cmp == 0)
+        {
+          return &g_fsindex[mid];
+        }
+      else if (cmp < 0)
+        {
+          hi = mid - 1;
+        }
+      else
+        {
+          lo = mid + 1;
+        }
+    }
+
+  return NULL;
+}
+
+/* The entity tag is a 32-bit FNV-1a hash of the file contents */
+
+static void httpd_fs_mketag(FAR struct httpd_fs_entry_s *entry)
+{
+  FAR const uint8_t *data = entry->fe_file->data;
+  uint32_t hash = 2166136261u;
+  int i;
+
+  for (i = 0; i < entry->fe_file->len; i++)
+    {
+      hash ^= data[i];
+      hash *= 16777619u;
+    }
+
+  snprintf(entry->fe_etag, sizeof(entry->fe_etag), "\"%08" PRIx32 "\"",
+           hash);
+}
+
+static void httpd_fs_mkindex(void)
+{
+  FAR const struct httpd_fsdata_file *f;
+  FAR struct httpd_fs_entry_s *entry;
+  char header[HTTPD_MAX_HEADERLEN];
+  int nfiles;
+  int i;
+
+  nfiles = 0;
+  for (f = g_httpdfs_root; f != NULL; f = f->next)
+    {
+      nfiles++;
+    }
+
+  g_fsindex = (FAR struct httpd_fs_entry_s *)
+    calloc(nfiles, sizeof(struct httpd_fs_entry_s));
+  if (g_fsindex == NULL)
+    {
+      /* httpd_fs_open() falls back to walking the list */
+
+      return;
+    }
+
+  for (i = 0, f = g_httpdfs_root; f != NULL; i++, f = f->next)
+    {
+      g_fsindex[i].fe_file = f;
+    }
+
+  g_fsnindex = nfiles;
+  qsort(g_fsindex, nfiles, sizeof(struct httpd_fs_entry_s),
+        httpd_fs_compare);
+
+  /* Compute the entity tag and build the response header of each file
+   * once, so that serving a file needs no formatting.
+   */
+
+  for (i = 0; i < nfiles; i++)
+    {
+      entry = &g_fsindex[i];
+      httpd_fs_mketag(entry);
+
+      if (entry->fe_file->len > 0)
+        {
+          entry->fe_hdrlen =
+            httpd_format_header(header,
+                                (FAR const char *)entry->fe_file->name,
+                                entry->fe_file->len, entry->fe_etag);
+          if (entry->fe_hdrlen < HTTPD_MAX_HEADERLEN)
+            {
+              entry->fe_header = strdup(header);
+            }
+        }
+    }
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -96,6 +255,32 @@ int httpd_fs_open(const char *name, struct httpd_fs_file *file)
 #endif
   struct httpd_fsdata_file_noconst *f;
 
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  FAR struct httpd_fs_entry_s *entry;
+
+  if (g_fsindex != NULL)
+    {
+      entry = httpd_fs_lookup(name);
+      if (entry == NULL)
+        {
+          return ERROR;
+        }
+
+      file->data   = (FAR char *)entry->fe_file->data;
+      file->len    = entry->fe_file->len;
+      file->hdr    = entry->fe_header;
+      file->hdrlen = entry->fe_header != NULL ? entry->fe_hdrlen : 0;
+      file->etag   = entry->fe_etag;
+#ifdef CONFIG_NETUTILS_HTTPDFSSTATS
+      ++entry->fe_count;
+#endif
+      return OK;
+    }
+
+  file->hdr  = NULL;
+  file->etag = NULL;
+#endif
+
   for (f = (struct httpd_fsdata_file_noconst *)g_httpdfs_root;
        f != NULL;
        f = (struct httpd_fsdata_file_noconst *)f->next)
@@ -129,6 +314,10 @@ void httpd_fs_init(void)
       count[i] = 0;
     }
 #endif
+
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  httpd_fs_mkindex();
+#endif
 }
 
 #ifdef CONFIG_NETUTILS_HTTPDFSSTATS
@@ -137,6 +326,16 @@ uint16_t httpd_fs_count(char *name)
   struct httpd_fsdata_file_noconst *f;
   uint16_t i;
 
+#ifdef CONFIG_NETUTILS_HTTPD_FSINDEX
+  FAR struct httpd_fs_entry_s *entry;
+
+  if (g_fsindex != NULL)
+    {
+      entry = httpd_fs_lookup(name);
+      return entry != NULL ? entry->fe_count : 0;
+    }
+#endif
+
   i = 0;
   for (f = (struct httpd_fsdata_file_noconst *)g_httpdfs_root;
       f != NULL;
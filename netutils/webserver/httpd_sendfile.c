@@ -146,3 +146,11 @@ int httpd_sendfile_send(int outfd, struct httpd_fs_file *file)
 
   return OK;
 }
+
+#ifdef CONFIG_NETUTILS_HTTPD_WORKERPOOL
+ssize_t httpd_sendfile_sendpart(int outfd, struct httpd_fs_file *file,
+                                off_t *offset, size_t count)
+{
+  return sendfile(outfd, file->fd, offset, count);
+}
+#endif
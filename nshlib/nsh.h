@@ -434,6 +434,12 @@
 #  define NSH_HAVE_VARS
 #endif
 
+#undef NSH_HAVE_SCRIPT_CACHE
+#if !defined(CONFIG_NSH_DISABLESCRIPT) && \
+    defined(CONFIG_NSH_SCRIPT_CACHESIZE) && CONFIG_NSH_SCRIPT_CACHESIZE > 0
+#  define NSH_HAVE_SCRIPT_CACHE
+#endif
+
 /* Stubs used when working directory is not supported */
 
 #ifdef CONFIG_DISABLE_ENVIRON
@@ -692,8 +698,13 @@ struct nsh_parser_s
 
 #ifndef CONFIG_NSH_DISABLESCRIPT
   int      np_fd;       /* Stream of current script */
+#ifdef NSH_HAVE_SCRIPT_CACHE
+  FAR char *np_script;  /* In-memory image of current script, or NULL */
+  size_t   np_slen;     /* Size of the image */
+  size_t   np_spos;     /* Offset of the next line in the image */
+#endif
 #ifndef CONFIG_NSH_DISABLE_LOOPS
-  long     np_foffs;    /* File offset to the beginning of a line */
+  long     np_foffs;    /* File or image offset to the beginning of a line */
 #ifndef NSH_DISABLE_SEMICOLON
   uint16_t np_loffs;    /* Byte offset to the beginning of a command */
   bool     np_jump;     /* "Jump" to the top of the loop */
@@ -882,6 +893,10 @@ int nsh_builtin(FAR struct nsh_vtbl_s *vtbl, FAR const char *cmd,
                 FAR char **argv, FAR const char *redirfile, int oflags);
 #endif
 
+#ifdef CONFIG_BUILTIN
+int nsh_builtin_index(FAR const char *appname);
+#endif
+
 #ifdef CONFIG_NSH_FILE_APPS
 int nsh_fileapp(FAR struct nsh_vtbl_s *vtbl, FAR const char *cmd,
                 FAR char **argv, FAR const char *redirfile, int oflags);
@@ -75,8 +75,19 @@ int nsh_builtin(FAR struct nsh_vtbl_s *vtbl, FAR const char *cmd,
   struct sigaction act;
   struct sigaction old;
 #endif
+  int index;
   int ret = OK;
 
+  /* Most names that reach here are NSH commands, give up on them before
+   * locking the scheduler.
+   */
+
+  index = nsh_builtin_index(cmd);
+  if (index < 0)
+    {
+      return ERROR;
+    }
+
   /* Lock the scheduler in an attempt to prevent the application from
    * running until waitpid() has been called.
    */
@@ -97,11 +108,9 @@ int nsh_builtin(FAR struct nsh_vtbl_s *vtbl, FAR const char *cmd,
 
 #endif /* CONFIG_NSH_DISABLEBG */
 
-  /* Try to find and execute the command within the list of builtin
-   * applications.
-   */
+  /* Execute the builtin application found above */
 
-  ret = exec_builtin(cmd, argv, redirfile, oflags);
+  ret = exec_builtin_index(index, argv, redirfile, oflags);
   if (ret >= 0)
     {
       /* The application was successfully started with pre-emption disabled.
@@ -24,10 +24,12 @@
 
 #include <nuttx/config.h>
 
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sched.h>
 
-#ifdef CONFIG_NSH_BUILTIN_APPS
+#ifdef CONFIG_BUILTIN
 #  include <nuttx/lib/builtin.h>
 #endif
 
@@ -48,6 +50,14 @@
 #define HELP_TABSIZE  4
 #define NUM_CMDS      ((sizeof(g_cmdmap)/sizeof(struct cmdmap_s)) - 1)
 
+/* The hash indexes have twice as many slots as names.  A slot holds the
+ * table index of a name plus one, or zero if it is empty.
+ */
+
+#ifdef CONFIG_NSH_HASHED_LOOKUP
+#  define NSH_CMDHASH_SIZE  (2 * NUM_CMDS + 1)
+#endif
+
 /* Help marco for nsh command */
 
 #ifdef CONFIG_NSH_DISABLE_HELP
@@ -634,10 +644,171 @@ static const struct cmdmap_s g_cmdmap[] =
   CMD_MAP(NULL,       NULL,         1, 1, NULL)
 };
 
+#ifdef CONFIG_NSH_HASHED_LOOKUP
+/* Hash index of g_cmdmap, built on first use */
+
+static uint16_t g_cmdhash[NSH_CMDHASH_SIZE];
+static bool g_cmdhash_ready;
+
+#ifdef CONFIG_BUILTIN
+/* Hash index of the builtin applications, built on first use */
+
+static FAR uint16_t *g_builtinhash;
+static unsigned int g_builtinhash_size;
+#endif
+#endif
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: nsh_strhash
+ *
+ * Description:
+ *   FNV-1a hash of a command name.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_NSH_HASHED_LOOKUP
+static uint32_t nsh_strhash(FAR const char *str)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*str != '\0')
+    {
+      hash ^= (uint8_t)*str++;
+      hash *= 16777619u;
+    }
+
+  return hash;
+}
+
+/****************************************************************************
+ * Name: nsh_hashinsert
+ *
+ * Description:
+ *   Insert a table index into a hash index with linear probing.  Inserting
+ *   an index that is already present does nothing, so two sessions that
+ *   build the same index at the same time produce the same result.
+ *
+ ****************************************************************************/
+
+static void nsh_hashinsert(FAR uint16_t *hashtab, unsigned int size,
+                           FAR const char *name, unsigned int index)
+{
+  unsigned int slot = nsh_strhash(name) % size;
+
+  while (hashtab[slot] != 0 && hashtab[slot] != index + 1)
+    {
+      slot = (slot + 1) % size;
+    }
+
+  hashtab[slot] = index + 1;
+}
+#endif
+
+/****************************************************************************
+ * Name: nsh_cmdlookup
+ *
+ * Description:
+ *   Find a command in the command table.
+ *
+ ****************************************************************************/
+
+static FAR const struct cmdmap_s *nsh_cmdlookup(FAR const char *cmd)
+{
+#ifdef CONFIG_NSH_HASHED_LOOKUP
+  unsigned int slot;
+  unsigned int i;
+
+  if (!g_cmdhash_ready)
+    {
+      /* Two sessions must not probe the same slot at the same time */
+
+      sched_lock();
+      if (!g_cmdhash_ready)
+        {
+          for (i = 0; i < NUM_CMDS; i++)
+            {
+              nsh_hashinsert(g_cmdhash, NSH_CMDHASH_SIZE, g_cmdmap[i].cmd,
+                             i);
+            }
+
+          g_cmdhash_ready = true;
+        }
+
+      sched_unlock();
+    }
+
+  for (slot = nsh_strhash(cmd) % NSH_CMDHASH_SIZE;
+       (i = g_cmdhash[slot]) != 0;
+       slot = (slot + 1) % NSH_CMDHASH_SIZE)
+    {
+      if (strcmp(g_cmdmap[i - 1].cmd, cmd) == 0)
+        {
+          return &g_cmdmap[i - 1];
+        }
+    }
+#else
+  FAR const struct cmdmap_s *cmdmap;
+
+  for (cmdmap = g_cmdmap; cmdmap->cmd; cmdmap++)
+    {
+      if (strcmp(cmdmap->cmd, cmd) == 0)
+        {
+          return cmdmap;
+        }
+    }
+#endif
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: nsh_builtinhash_initialize
+ ****************************************************************************/
+
+#if defined(CONFIG_NSH_HASHED_LOOKUP) && defined(CONFIG_BUILTIN)
+static void nsh_builtinhash_initialize(void)
+{
+  FAR const struct builtin_s *builtin;
+  FAR uint16_t *hashtab;
+  unsigned int size;
+  unsigned int i;
+
+  size = 1;
+  for (i = 0; builtin_for_index(i) != NULL; i++)
+    {
+      size += 2;
+    }
+
+  hashtab = zalloc(size * sizeof(uint16_t));
+  if (hashtab == NULL)
+    {
+      return;
+    }
+
+  for (i = 0; (builtin = builtin_for_index(i)) != NULL; i++)
+    {
+      nsh_hashinsert(hashtab, size, builtin->name, i);
+    }
+
+  /* Publish the index, unless another session did it meanwhile */
+
+  sched_lock();
+  if (g_builtinhash == NULL)
+    {
+      g_builtinhash_size = size;
+      g_builtinhash = hashtab;
+      hashtab = NULL;
+    }
+
+  sched_unlock();
+  free(hashtab);
+}
+#endif
+
 /****************************************************************************
  * Name: help_cmdlist
  ****************************************************************************/
@@ -792,18 +963,12 @@ static int help_cmd(FAR struct nsh_vtbl_s *vtbl, FAR const char *cmd)
 
   /* Find the command in the command table */
 
-  for (cmdmap = g_cmdmap; cmdmap->cmd; cmdmap++)
+  cmdmap = nsh_cmdlookup(cmd);
+  if (cmdmap != NULL)
     {
-      /* Is this the one we are looking for? */
-
-      if (strcmp(cmdmap->cmd, cmd) == 0)
-        {
-          /* Yes... show it */
-
-          nsh_output(vtbl, "%s usage:", cmd);
-          help_showcmd(vtbl, cmdmap);
-          return OK;
-        }
+      nsh_output(vtbl, "%s usage:", cmd);
+      help_showcmd(vtbl, cmdmap);
+      return OK;
     }
 
   nsh_error(vtbl, g_fmtcmdnotfound, cmd);
@@ -1116,45 +1281,87 @@ int nsh_command(FAR struct nsh_vtbl_s *vtbl, int argc, FAR char *argv[])
 
   /* See if the command is one that we understand */
 
-  for (cmdmap = g_cmdmap; cmdmap->cmd; cmdmap++)
+  cmdmap = nsh_cmdlookup(cmd);
+  if (cmdmap != NULL)
     {
-      if (strcmp(cmdmap->cmd, cmd) == 0)
+      /* Check if a valid number of arguments was provided.  We
+       * do this simple, imperfect checking here so that it does
+       * not have to be performed in each command.
+       */
+
+      if (argc < cmdmap->minargs)
         {
-          /* Check if a valid number of arguments was provided.  We
-           * do this simple, imperfect checking here so that it does
-           * not have to be performed in each command.
-           */
+          /* Fewer than the minimum number were provided */
 
-          if (argc < cmdmap->minargs)
-            {
-              /* Fewer than the minimum number were provided */
+          nsh_error(vtbl, g_fmtargrequired, cmd);
+          return ERROR;
+        }
+      else if (argc > cmdmap->maxargs)
+        {
+          /* More than the maximum number were provided */
 
-              nsh_error(vtbl, g_fmtargrequired, cmd);
-              return ERROR;
-            }
-          else if (argc > cmdmap->maxargs)
-            {
-              /* More than the maximum number were provided */
+          nsh_error(vtbl, g_fmttoomanyargs, cmd);
+          return ERROR;
+        }
 
-              nsh_error(vtbl, g_fmttoomanyargs, cmd);
-              return ERROR;
-            }
-          else
-            {
-              /* A valid number of arguments were provided (this does
-               * not mean they are right).
-               */
+      /* A valid number of arguments were provided (this does
+       * not mean they are right).
+       */
 
-              handler = cmdmap->handler;
-              break;
-            }
-        }
+      handler = cmdmap->handler;
     }
 
   ret = handler(vtbl, argc, argv);
   return ret;
 }
 
+/****************************************************************************
+ * Name: nsh_builtin_index
+ *
+ * Description:
+ *   Find a builtin application by name, like builtin_isavail() but with
+ *   a hash index instead of a scan of the whole list.
+ *
+ * Returned Value:
+ *   The index of the application, or a negated errno value if there is no
+ *   such application.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BUILTIN
+int nsh_builtin_index(FAR const char *appname)
+{
+#ifdef CONFIG_NSH_HASHED_LOOKUP
+  FAR const struct builtin_s *builtin;
+  unsigned int slot;
+  unsigned int i;
+
+  if (g_builtinhash == NULL)
+    {
+      nsh_builtinhash_initialize();
+    }
+
+  if (g_builtinhash != NULL)
+    {
+      for (slot = nsh_strhash(appname) % g_builtinhash_size;
+           (i = g_builtinhash[slot]) != 0;
+           slot = (slot + 1) % g_builtinhash_size)
+        {
+          builtin = builtin_for_index(i - 1);
+          if (strcmp(builtin->name, appname) == 0)
+            {
+              return i - 1;
+            }
+        }
+
+      return -ENOENT;
+    }
+#endif
+
+  return builtin_isavail(appname);
+}
+#endif
+
 /****************************************************************************
  * Name: nsh_extmatch_count
  *
@@ -127,7 +127,7 @@ int nsh_fileapp(FAR struct nsh_vtbl_s *vtbl, FAR const char *cmd,
   /* Check if a builtin application with this name exists */
 
   appname = basename((FAR char *)cmd);
-  index = builtin_isavail(appname);
+  index = nsh_builtin_index(appname);
   if (index >= 0)
     {
       FAR const struct builtin_s *builtin;
@@ -2118,13 +2118,22 @@ static int nsh_loop(FAR struct nsh_vtbl_s *vtbl, FAR char **ppcmd,
             {
               /* Set the new file position to the top of the loop offset */
 
-              ret = lseek(np->np_fd,
-                          np->np_lpstate[np->np_lpndx].lp_topoffs,
-                          SEEK_SET);
-              if (ret < 0)
+#ifdef NSH_HAVE_SCRIPT_CACHE
+              if (np->np_script != NULL)
                 {
-                  nsh_error(vtbl, g_fmtcmdfailed, "done", "lseek",
-                            NSH_ERRNO);
+                  np->np_spos = np->np_lpstate[np->np_lpndx].lp_topoffs;
+                }
+              else
+#endif
+                {
+                  ret = lseek(np->np_fd,
+                              np->np_lpstate[np->np_lpndx].lp_topoffs,
+                              SEEK_SET);
+                  if (ret < 0)
+                    {
+                      nsh_error(vtbl, g_fmtcmdfailed, "done", "lseek",
+                                NSH_ERRNO);
+                    }
                 }
 
 #ifndef NSH_DISABLE_SEMICOLON
@@ -24,9 +24,14 @@
 
 #include <nuttx/config.h>
 
+#include <ctype.h>
 #include <fcntl.h>
 #include <sched.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/param.h>
+#include <sys/stat.h>
 
 #include "nsh.h"
 #include "nsh_console.h"
@@ -39,6 +44,106 @@
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: nsh_script_load
+ *
+ * Description:
+ *   Load a small script into memory, with the control characters that
+ *   readline would drop already removed.
+ *
+ * Returned Value:
+ *   The image of the script, or NULL if it must be read from the file.
+ *
+ ****************************************************************************/
+
+#ifdef NSH_HAVE_SCRIPT_CACHE
+static FAR char *nsh_script_load(int fd, FAR size_t *len)
+{
+  struct stat buf;
+  FAR char *script;
+  ssize_t nread;
+  size_t total;
+  size_t i;
+  size_t j;
+
+  if (fstat(fd, &buf) < 0 || buf.st_size <= 0 ||
+      buf.st_size > CONFIG_NSH_SCRIPT_CACHESIZE)
+    {
+      return NULL;
+    }
+
+  script = malloc(buf.st_size);
+  if (script == NULL)
+    {
+      return NULL;
+    }
+
+  for (total = 0; total < buf.st_size; total += nread)
+    {
+      nread = read(fd, script + total, buf.st_size - total);
+      if (nread <= 0)
+        {
+          break;
+        }
+    }
+
+  /* On a short read, rewind and read the script from the file */
+
+  if (total < buf.st_size)
+    {
+      free(script);
+      lseek(fd, 0, SEEK_SET);
+      return NULL;
+    }
+
+  for (i = j = 0; i < total; i++)
+    {
+      if (script[i] == '\n' || !iscntrl(script[i] & 0xff))
+        {
+          script[j++] = script[i];
+        }
+    }
+
+  *len = j;
+  return script;
+}
+
+/****************************************************************************
+ * Name: nsh_script_getline
+ *
+ * Description:
+ *   Copy the next line of the script image into the line buffer, the
+ *   same way as readline_fd() would read it from the file.
+ *
+ ****************************************************************************/
+
+static ssize_t nsh_script_getline(FAR struct nsh_parser_s *np,
+                                  FAR char *buf, int buflen)
+{
+  FAR const char *line = np->np_script + np->np_spos;
+  FAR const char *eol;
+  size_t len;
+
+  if (np->np_spos >= np->np_slen)
+    {
+      return EOF;
+    }
+
+  len = MIN(np->np_slen - np->np_spos, buflen - 1);
+  eol = memchr(line, '\n', len);
+  if (eol != NULL)
+    {
+      len = eol - line + 1;
+    }
+
+  memcpy(buf, line, len);
+  buf[len] = '\0';
+  np->np_spos += len;
+
+  return len;
+}
+#endif
+
 #if defined(CONFIG_NSH_ROMFSETC) || defined(CONFIG_NSH_ROMFSRC)
 static int nsh_script_redirect(FAR struct nsh_vtbl_s *vtbl,
                                FAR const char *cmd,
@@ -89,6 +194,11 @@ int nsh_script(FAR struct nsh_vtbl_s *vtbl, FAR const FAR char *cmd,
 {
   FAR char *fullpath;
   int savestream;
+#ifdef NSH_HAVE_SCRIPT_CACHE
+  FAR char *savescript;
+  size_t saveslen;
+  size_t savespos;
+#endif
   FAR char *buffer;
   int ret = ERROR;
 
@@ -129,6 +239,20 @@ int nsh_script(FAR struct nsh_vtbl_s *vtbl, FAR const FAR char *cmd,
           return ERROR;
         }
 
+#ifdef NSH_HAVE_SCRIPT_CACHE
+      /* Run small scripts from memory, the parent script position is
+       * saved as well.
+       */
+
+      savescript = vtbl->np.np_script;
+      saveslen   = vtbl->np.np_slen;
+      savespos   = vtbl->np.np_spos;
+
+      vtbl->np.np_spos   = 0;
+      vtbl->np.np_script = nsh_script_load(vtbl->np.np_fd,
+                                           &vtbl->np.np_slen);
+#endif
+
       /* Loop, processing each command line in the script file (or
        * until an error occurs)
        */
@@ -142,7 +266,17 @@ int nsh_script(FAR struct nsh_vtbl_s *vtbl, FAR const FAR char *cmd,
            * script file.  Note that lseek will return -1 on failure.
            */
 
-          vtbl->np.np_foffs = lseek(vtbl->np.np_fd, 0, SEEK_CUR);
+#ifdef NSH_HAVE_SCRIPT_CACHE
+          if (vtbl->np.np_script != NULL)
+            {
+              vtbl->np.np_foffs = vtbl->np.np_spos;
+            }
+          else
+#endif
+            {
+              vtbl->np.np_foffs = lseek(vtbl->np.np_fd, 0, SEEK_CUR);
+            }
+
           vtbl->np.np_loffs = 0;
 
           if (vtbl->np.np_foffs < 0 && log)
@@ -153,7 +287,19 @@ int nsh_script(FAR struct nsh_vtbl_s *vtbl, FAR const FAR char *cmd,
 
           /* Now read the next line from the script file */
 
-          ret = readline_fd(buffer, CONFIG_NSH_LINELEN, vtbl->np.np_fd, -1);
+#ifdef NSH_HAVE_SCRIPT_CACHE
+          if (vtbl->np.np_script != NULL)
+            {
+              ret = nsh_script_getline(&vtbl->np, buffer,
+                                       CONFIG_NSH_LINELEN);
+            }
+          else
+#endif
+            {
+              ret = readline_fd(buffer, CONFIG_NSH_LINELEN,
+                                vtbl->np.np_fd, -1);
+            }
+
           if (ret >= 0)
             {
               /* Parse process the command.  NOTE:  this is recursive...
@@ -182,6 +328,15 @@ int nsh_script(FAR struct nsh_vtbl_s *vtbl, FAR const FAR char *cmd,
 
       close(vtbl->np.np_fd);
 
+#ifdef NSH_HAVE_SCRIPT_CACHE
+      /* Release the image and restore the parent script position */
+
+      free(vtbl->np.np_script);
+      vtbl->np.np_script = savescript;
+      vtbl->np.np_slen   = saveslen;
+      vtbl->np.np_spos   = savespos;
+#endif
+
       /* Restore the parent script stream */
 
       vtbl->np.np_fd = savestream;
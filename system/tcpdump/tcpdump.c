@@ -26,16 +26,24 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netpacket/packet.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <nuttx/net/netconfig.h>
 
 #include "argtable3.h"
+#include "tcpdump.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -50,6 +58,23 @@
 
 #define LINKTYPE_ETHERNET 1
 
+/* The ring buffer is written out in chunks of WRITESIZE bytes at
+ * WRITESIZE aligned file offsets, so no chunk may wrap around the end of
+ * the ring.
+ */
+
+#if CONFIG_SYSTEM_TCPDUMP_BUFSIZE % CONFIG_SYSTEM_TCPDUMP_WRITESIZE != 0
+#  error "CONFIG_SYSTEM_TCPDUMP_BUFSIZE must be a multiple of WRITESIZE"
+#endif
+
+/* Flush the buffered records if no packet arrives for this time */
+
+#define FLUSH_INTERVAL 1
+
+/* -C is given in units of 1,000,000 bytes, like the original tcpdump */
+
+#define FILESIZE_UNIT 1000000
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
@@ -78,6 +103,10 @@ struct tcpdump_args_s
   FAR struct arg_str *interface;
   FAR struct arg_str *file;
   FAR struct arg_int *snaplen;
+  FAR struct arg_int *filesize;
+  FAR struct arg_int *filecount;
+  FAR struct arg_lit *dump;
+  FAR struct arg_str *expr;
   FAR struct arg_end *end;
 };
 
@@ -86,6 +115,28 @@ struct tcpdump_cfgs_s
   int fd;
   int sd;
   uint32_t snaplen;
+
+  /* Output files */
+
+  FAR const char *file;
+  uint32_t filesize;       /* Rotate after this many bytes, 0: never */
+  uint32_t filecount;      /* Reuse the files after this many, 0: never */
+  uint32_t fileindex;
+
+  /* Compiled filter expression, len is 0 if there is no filter */
+
+  struct tcpdump_bpf_prog_s prog;
+
+  /* Ring buffer of pcap records, head and tail are file offsets */
+
+  FAR uint8_t *buf;
+  size_t head;             /* End of the buffered records */
+  size_t tail;             /* End of the data written to the file */
+
+  /* Statistics */
+
+  unsigned long captured;
+  unsigned long filtered;
 };
 
 /****************************************************************************
@@ -107,11 +158,115 @@ static void sigexit(int signo)
   g_exiting = true;
 }
 
+/****************************************************************************
+ * Name: ring_flush
+ *
+ * Description:
+ *   Write the buffered records to the file.  Only whole WRITESIZE chunks
+ *   are written unless force is set.
+ *
+ ****************************************************************************/
+
+static int ring_flush(FAR struct tcpdump_cfgs_s *cfgs, bool force)
+{
+  FAR const uint8_t *data;
+  ssize_t ret;
+  size_t n;
+
+  while (cfgs->head > cfgs->tail)
+    {
+      /* Up to the next aligned file offset, which is never behind the end
+       * of the ring.
+       */
+
+      n = CONFIG_SYSTEM_TCPDUMP_WRITESIZE -
+          cfgs->tail % CONFIG_SYSTEM_TCPDUMP_WRITESIZE;
+      if (cfgs->head - cfgs->tail < n)
+        {
+          if (!force)
+            {
+              break;
+            }
+
+          n = cfgs->head - cfgs->tail;
+        }
+
+      data = cfgs->buf + cfgs->tail % CONFIG_SYSTEM_TCPDUMP_BUFSIZE;
+      ret = write(cfgs->fd, data, n);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+
+          perror("ERROR: write() failed");
+          return -errno;
+        }
+      else if (ret == 0)
+        {
+          /* Nothing written would make the loop spin forever */
+
+          printf("ERROR: write() wrote nothing\n");
+          return -EIO;
+        }
+
+      cfgs->tail += ret;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ring_put
+ ****************************************************************************/
+
+static int ring_put(FAR struct tcpdump_cfgs_s *cfgs, FAR const void *data,
+                    size_t len)
+{
+  size_t off;
+  size_t n;
+  int ret;
+
+  if (cfgs->head + len - cfgs->tail > CONFIG_SYSTEM_TCPDUMP_BUFSIZE)
+    {
+      ret = ring_flush(cfgs, true);
+      if (ret < 0)
+        {
+          return ret;
+        }
+    }
+
+  /* A jumbo packet larger than the whole ring goes to the file directly */
+
+  if (len > CONFIG_SYSTEM_TCPDUMP_BUFSIZE)
+    {
+      if (write(cfgs->fd, data, len) != (ssize_t)len)
+        {
+          perror("ERROR: write() failed");
+          return -EIO;
+        }
+
+      cfgs->head += len;
+      cfgs->tail += len;
+      return OK;
+    }
+
+  off = cfgs->head % CONFIG_SYSTEM_TCPDUMP_BUFSIZE;
+  n = MIN(len, CONFIG_SYSTEM_TCPDUMP_BUFSIZE - off);
+
+  memcpy(cfgs->buf + off, data, n);
+  memcpy(cfgs->buf, (FAR const uint8_t *)data + n, len - n);
+  cfgs->head += len;
+
+  return OK;
+}
+
 /****************************************************************************
  * Name: write_filehdr
  ****************************************************************************/
 
-static int write_filehdr(int fd, uint32_t snaplen)
+static int write_filehdr(FAR struct tcpdump_cfgs_s *cfgs)
 {
   /* No need to change byte order of any field, reader will swap all fields
    * if magic number is in swapped order.
@@ -124,53 +279,138 @@ static int write_filehdr(int fd, uint32_t snaplen)
       TCPDUMP_VERSION_MINOR, /* version_minor */
       0,                     /* thiszone */
       0,                     /* sigfigs */
-      snaplen,               /* snaplen */
+      cfgs->snaplen,         /* snaplen */
       LINKTYPE_ETHERNET      /* linktype */
     };
 
-  /* Write hdr into file. */
+  /* Queue hdr for the file. */
+
+  return ring_put(cfgs, &hdr, sizeof(hdr));
+}
 
-  if (write(fd, &hdr, sizeof(hdr)) < 0)
+/****************************************************************************
+ * Name: file_open
+ *
+ * Description:
+ *   Open the next output file.  With -C the files are named like the
+ *   original tcpdump does: file, file1, file2... or file0..file<W-1>
+ *   with zero padding if -W is given too.
+ *
+ ****************************************************************************/
+
+static int file_open(FAR struct tcpdump_cfgs_s *cfgs)
+{
+  char path[PATH_MAX];
+  uint32_t n;
+  int width;
+
+  if (cfgs->filecount > 0)
+    {
+      for (n = cfgs->filecount - 1, width = 1; n >= 10; n /= 10)
+        {
+          width++;
+        }
+
+      snprintf(path, sizeof(path), "%s%0*" PRIu32, cfgs->file, width,
+               cfgs->fileindex);
+    }
+  else if (cfgs->fileindex > 0)
     {
-      perror("ERROR: write() failed");
+      snprintf(path, sizeof(path), "%s%" PRIu32, cfgs->file,
+               cfgs->fileindex);
+    }
+  else
+    {
+      strlcpy(path, cfgs->file, sizeof(path));
+    }
+
+  cfgs->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (cfgs->fd < 0)
+    {
+      perror("ERROR: open() failed");
       return -errno;
     }
 
-  return OK;
+  cfgs->head = 0;
+  cfgs->tail = 0;
+
+  return write_filehdr(cfgs);
+}
+
+/****************************************************************************
+ * Name: file_rotate
+ ****************************************************************************/
+
+static int file_rotate(FAR struct tcpdump_cfgs_s *cfgs)
+{
+  int ret;
+
+  ret = ring_flush(cfgs, true);
+  close(cfgs->fd);
+  cfgs->fd = -1;
+
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  cfgs->fileindex++;
+  if (cfgs->filecount > 0)
+    {
+      cfgs->fileindex %= cfgs->filecount;
+    }
+
+  return file_open(cfgs);
 }
 
 /****************************************************************************
  * Name: write_packet
  ****************************************************************************/
 
-static int write_packet(int fd, uint32_t snaplen, uint32_t pkt_len,
-                        FAR const void *buf, FAR const struct timespec *ts)
+static int write_packet(FAR struct tcpdump_cfgs_s *cfgs, uint32_t caplen,
+                        uint32_t pkt_len, FAR const void *buf,
+                        FAR const struct timespec *ts)
 {
   struct pcap_pkthdr_s hdr =
     {
       ts->tv_sec,            /* ts_sec */
       ts->tv_nsec,           /* ts_nsec */
-      MIN(snaplen, pkt_len), /* caplen */
+      caplen,                /* caplen */
       pkt_len                /* len */
     };
 
-  /* Write hdr into file. */
+  int ret;
 
-  if (write(fd, &hdr, sizeof(hdr)) < 0)
+  /* Start a new file if this record exceeds the file size, but keep at
+   * least one record in each file.
+   */
+
+  if (cfgs->filesize > 0 &&
+      cfgs->head > sizeof(struct pcap_filehdr_s) &&
+      cfgs->head + sizeof(hdr) + caplen > cfgs->filesize)
     {
-      perror("ERROR: write() failed");
-      return -errno;
+      ret = file_rotate(cfgs);
+      if (ret < 0)
+        {
+          return ret;
+        }
     }
 
-  /* Write pkt into file. */
+  /* Queue hdr and pkt for the file. */
 
-  if (write(fd, buf, hdr.caplen) < 0)
+  ret = ring_put(cfgs, &hdr, sizeof(hdr));
+  if (ret < 0)
     {
-      perror("ERROR: write() failed");
-      return -errno;
+      return ret;
     }
 
-  return OK;
+  ret = ring_put(cfgs, buf, caplen);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  return ring_flush(cfgs, false);
 }
 
 /****************************************************************************
@@ -181,6 +421,7 @@ static int socket_open(int ifindex)
 {
   int sd;
   struct sockaddr_ll addr;
+  struct timeval tv;
 
   sd = socket(PF_PACKET, SOCK_RAW, 0);
   if (sd < 0)
@@ -200,6 +441,12 @@ static int socket_open(int ifindex)
       return -errno;
     }
 
+  /* Wake up periodically to flush the buffered records */
+
+  tv.tv_sec  = FLUSH_INTERVAL;
+  tv.tv_usec = 0;
+  setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
   return sd;
 }
 
@@ -207,38 +454,65 @@ static int socket_open(int ifindex)
  * Name: do_capture
  ****************************************************************************/
 
-static void do_capture(FAR const struct tcpdump_cfgs_s *cfgs)
+static void do_capture(FAR struct tcpdump_cfgs_s *cfgs)
 {
   ssize_t len;
   uint8_t buf[MAX_NETDEV_PKTSIZE];
   struct timespec ts;
+  uint32_t caplen;
 
-  /* Write file header */
+  /* Dump packets */
 
-  if (write_filehdr(cfgs->fd, cfgs->snaplen) < 0)
+  while (!g_exiting)
     {
-      return;
-    }
+      len = read(cfgs->sd, buf, sizeof(buf));
+      if (len < 0)
+        {
+          if (errno != EAGAIN && errno != EINTR)
+            {
+              break;
+            }
 
-  /* Dump packets */
+          /* Nothing received for a while, write out what we have */
+
+          if (ring_flush(cfgs, true) < 0)
+            {
+              return;
+            }
+
+          continue;
+        }
 
-  while ((len = read(cfgs->sd, buf, sizeof(buf))) >= 0 && !g_exiting)
-    {
       if (len == 0)
         {
           continue;
         }
 
+      /* Run the filter before anything is copied */
+
+      caplen = MIN(cfgs->snaplen, (uint32_t)len);
+      if (cfgs->prog.len > 0)
+        {
+          caplen = MIN(caplen, tcpdump_filter_run(&cfgs->prog, buf, len));
+          if (caplen == 0)
+            {
+              cfgs->filtered++;
+              continue;
+            }
+        }
+
       if (clock_gettime(CLOCK_REALTIME, &ts) < 0)
         {
           perror("ERROR: clock_gettime() failed");
           return;
         }
 
-      if (write_packet(cfgs->fd, cfgs->snaplen, len, buf, &ts) < 0)
+      if (write_packet(cfgs, caplen, len, buf, &ts) < 0)
         {
           return;
         }
+
+      cfgs->captured++;
     }
 
   if (!g_exiting)
@@ -247,6 +521,45 @@ static void do_capture(FAR const struct tcpdump_cfgs_s *cfgs)
     }
 }
 
+/****************************************************************************
+ * Name: join_expr
+ *
+ * Description:
+ *   Join the filter expression arguments with spaces.
+ *
+ ****************************************************************************/
+
+static FAR char *join_expr(FAR struct arg_str *expr)
+{
+  FAR char *str;
+  size_t len = 1;
+  int i;
+
+  for (i = 0; i < expr->count; i++)
+    {
+      len += strlen(expr->sval[i]) + 1;
+    }
+
+  str = malloc(len);
+  if (str == NULL)
+    {
+      return NULL;
+    }
+
+  str[0] = '\0';
+  for (i = 0; i < expr->count; i++)
+    {
+      if (i > 0)
+        {
+          strlcat(str, " ", len);
+        }
+
+      strlcat(str, expr->sval[i], len);
+    }
+
+  return str;
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -255,20 +568,35 @@ int main(int argc, FAR char *argv[])
 {
   int ifindex;
   int nerrors;
+  FAR char *expr;
   struct tcpdump_cfgs_s cfgs;
   struct tcpdump_args_s args;
 
   g_exiting = false;
   signal(SIGINT, sigexit);
+  memset(&cfgs, 0, sizeof(cfgs));
+  cfgs.fd = -1;
 
-  args.interface = arg_str1("i", "interface", "interface", "Capture device");
-  args.file      = arg_str1("w", NULL, "file", "Path to dump file");
+  args.interface = arg_str0("i", "interface", "interface", "Capture device");
+  args.file      = arg_str0("w", NULL, "file", "Path to dump file");
   args.snaplen   = arg_int0("s", "snapshot-length", "snaplen",
                             "Max dump length of each packet");
+  args.filesize  = arg_int0("C", NULL, "file_size",
+                            "Start a new file after file_size MB");
+  args.filecount = arg_int0("W", NULL, "filecount",
+                            "Rotate among filecount files (with -C)");
+  args.dump      = arg_lit0("d", NULL,
+                            "Print the compiled filter and exit");
+  args.expr      = arg_strn(NULL, NULL, "expression", 0, 32,
+                            "Filter, e.g. \"tcp port 80 and host x.x.x.x\"");
   args.end       = arg_end(3);
 
   nerrors = arg_parse(argc, argv, (FAR void**)&args);
-  if (nerrors != 0)
+  /* -d only compiles the filter, capturing needs -i and -w */
+
+  if (nerrors != 0 || (args.dump->count == 0 &&
+                       (args.interface->count == 0 ||
+                        args.file->count == 0)))
     {
       arg_print_errors(stdout, args.end, argv[0]);
       printf("Usage:\n");
@@ -276,6 +604,57 @@ int main(int argc, FAR char *argv[])
       goto out;
     }
 
+  if (args.snaplen->count > 0)
+    {
+      cfgs.snaplen = *args.snaplen->ival;
+    }
+  else
+    {
+      cfgs.snaplen = DEFAULT_SNAPLEN;
+    }
+
+  if (args.expr->count > 0)
+    {
+      expr = join_expr(args.expr);
+      if (expr == NULL ||
+          tcpdump_filter_compile(expr, cfgs.snaplen, &cfgs.prog) < 0)
+        {
+          free(expr);
+          goto out;
+        }
+
+      free(expr);
+    }
+
+  if (args.dump->count > 0)
+    {
+      tcpdump_filter_dump(&cfgs.prog);
+      goto out;
+    }
+
+  if (args.filesize->count > 0)
+    {
+      if (*args.filesize->ival <= 0 ||
+          *args.filesize->ival > UINT32_MAX / FILESIZE_UNIT)
+        {
+          printf("Invalid file size %d\n", *args.filesize->ival);
+          goto out;
+        }
+
+      cfgs.filesize = *args.filesize->ival * FILESIZE_UNIT;
+    }
+
+  if (args.filecount->count > 0)
+    {
+      if (cfgs.filesize == 0 || *args.filecount->ival <= 0)
+        {
+          printf("-W needs -C and a positive file count\n");
+          goto out;
+        }
+
+      cfgs.filecount = *args.filecount->ival;
+    }
+
   ifindex = if_nametoindex(args.interface->sval[0]);
   if (ifindex == 0)
     {
@@ -283,35 +662,44 @@ int main(int argc, FAR char *argv[])
       goto out;
     }
 
-  cfgs.fd = open(args.file->sval[0], O_WRONLY | O_CREAT | O_TRUNC, 0644);
-  if (cfgs.fd < 0)
+  cfgs.buf = malloc(CONFIG_SYSTEM_TCPDUMP_BUFSIZE);
+  if (cfgs.buf == NULL)
     {
-      perror("ERROR: open() failed");
+      printf("Failed to allocate the capture buffer\n");
       goto out;
     }
 
-  cfgs.sd = socket_open(ifindex);
-  if (cfgs.sd < 0)
+  cfgs.file = args.file->sval[0];
+  if (file_open(&cfgs) < 0)
     {
-      close(cfgs.fd);
       goto out;
     }
 
-  if (args.snaplen->count > 0)
-    {
-      cfgs.snaplen = *args.snaplen->ival;
-    }
-  else
+  cfgs.sd = socket_open(ifindex);
+  if (cfgs.sd < 0)
     {
-      cfgs.snaplen = DEFAULT_SNAPLEN;
+      goto out;
     }
 
   do_capture(&cfgs);
 
   close(cfgs.sd);
-  close(cfgs.fd);
+
+  printf("%lu packets captured\n", cfgs.captured);
+  if (cfgs.prog.len > 0)
+    {
+      printf("%lu packets dropped by filter\n", cfgs.filtered);
+    }
 
 out:
+  if (cfgs.fd >= 0)
+    {
+      ring_flush(&cfgs, true);
+      close(cfgs.fd);
+    }
+
+  free(cfgs.buf);
+  tcpdump_filter_free(&cfgs.prog);
   arg_freetable((FAR void **)&args, sizeof(args) / sizeof(FAR void *));
   return 0;
 }
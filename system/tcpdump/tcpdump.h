@@ -0,0 +1,175 @@
+/****************************************************************************
+ * apps/system/tcpdump/tcpdump.h
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_SYSTEM_TCPDUMP_TCPDUMP_H
+#define __APPS_SYSTEM_TCPDUMP_TCPDUMP_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Classic BPF instruction classes */
+
+#define BPF_CLASS(code) ((code) & 0x07)
+#define BPF_LD          0x00
+#define BPF_LDX         0x01
+#define BPF_ST          0x02
+#define BPF_STX         0x03
+#define BPF_ALU         0x04
+#define BPF_JMP         0x05
+#define BPF_RET         0x06
+#define BPF_MISC        0x07
+
+/* ld/ldx fields */
+
+#define BPF_SIZE(code)  ((code) & 0x18)
+#define BPF_W           0x00
+#define BPF_H           0x08
+#define BPF_B           0x10
+#define BPF_MODE(code)  ((code) & 0xe0)
+#define BPF_IMM         0x00
+#define BPF_ABS         0x20
+#define BPF_IND         0x40
+#define BPF_MEM         0x60
+#define BPF_LEN         0x80
+#define BPF_MSH         0xa0
+
+/* alu/jmp fields */
+
+#define BPF_OP(code)    ((code) & 0xf0)
+#define BPF_ADD         0x00
+#define BPF_SUB         0x10
+#define BPF_MUL         0x20
+#define BPF_DIV         0x30
+#define BPF_OR          0x40
+#define BPF_AND         0x50
+#define BPF_LSH         0x60
+#define BPF_RSH         0x70
+#define BPF_NEG         0x80
+#define BPF_MOD         0x90
+#define BPF_XOR         0xa0
+
+#define BPF_JA          0x00
+#define BPF_JEQ         0x10
+#define BPF_JGT         0x20
+#define BPF_JGE         0x30
+#define BPF_JSET        0x40
+
+#define BPF_SRC(code)   ((code) & 0x08)
+#define BPF_K           0x00
+#define BPF_X           0x08
+
+/* ret fields */
+
+#define BPF_RVAL(code)  ((code) & 0x18)
+#define BPF_A           0x10
+
+/* misc fields */
+
+#define BPF_MISCOP(code) ((code) & 0xf8)
+#define BPF_TAX         0x00
+#define BPF_TXA         0x80
+
+#define BPF_MEMWORDS    16
+#define BPF_MAXINSNS    256
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Classic BPF instruction, the same layout as struct sock_filter */
+
+struct tcpdump_bpf_insn_s
+{
+  uint16_t code;
+  uint8_t  jt;
+  uint8_t  jf;
+  uint32_t k;
+};
+
+struct tcpdump_bpf_prog_s
+{
+  uint16_t len;
+  FAR struct tcpdump_bpf_insn_s *insns;
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: tcpdump_filter_compile
+ *
+ * Description:
+ *   Compile a filter expression (host/net/port/protocol primitives joined
+ *   by and/or/not) into a classic BPF program for Ethernet frames.  The
+ *   program returns snaplen for accepted packets and 0 otherwise.
+ *
+ * Returned Value:
+ *   OK on success, a negated errno value on failure.
+ *
+ ****************************************************************************/
+
+int tcpdump_filter_compile(FAR const char *expr, uint32_t snaplen,
+                           FAR struct tcpdump_bpf_prog_s *prog);
+
+/****************************************************************************
+ * Name: tcpdump_filter_free
+ *
+ * Description:
+ *   Release a program created by tcpdump_filter_compile().
+ *
+ ****************************************************************************/
+
+void tcpdump_filter_free(FAR struct tcpdump_bpf_prog_s *prog);
+
+/****************************************************************************
+ * Name: tcpdump_filter_run
+ *
+ * Description:
+ *   Run the program on a packet.
+ *
+ * Returned Value:
+ *   The number of bytes of the packet to keep, 0 to drop it.
+ *
+ ****************************************************************************/
+
+uint32_t tcpdump_filter_run(FAR const struct tcpdump_bpf_prog_s *prog,
+                            FAR const uint8_t *pkt, uint32_t len);
+
+/****************************************************************************
+ * Name: tcpdump_filter_dump
+ *
+ * Description:
+ *   Print the program in a human readable form, like tcpdump -d.
+ *
+ ****************************************************************************/
+
+void tcpdump_filter_dump(FAR const struct tcpdump_bpf_prog_s *prog);
+
+#endif /* __APPS_SYSTEM_TCPDUMP_TCPDUMP_H */
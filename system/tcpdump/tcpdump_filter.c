@@ -0,0 +1,1192 @@
+/****************************************************************************
+ * apps/system/tcpdump/tcpdump_filter.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "tcpdump.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define FILTER_MAX_NODES    64
+#define FILTER_MAX_LABELS   128
+#define FILTER_MAX_TOKEN    48
+
+#define FILTER_LABEL_NEXT   (-1)  /* Fall through to the next insn */
+
+#define FILTER_DIR_ANY      0
+#define FILTER_DIR_SRC      1
+#define FILTER_DIR_DST      2
+
+/* Ethernet/IP header offsets */
+
+#define ETH_TYPE_OFF        12
+#define ETH_HDRLEN          14
+#define IP4_FRAG_OFF        (ETH_HDRLEN + 6)
+#define IP4_PROTO_OFF       (ETH_HDRLEN + 9)
+#define IP4_SRC_OFF         (ETH_HDRLEN + 12)
+#define IP4_DST_OFF         (ETH_HDRLEN + 16)
+#define IP6_NEXT_OFF        (ETH_HDRLEN + 6)
+#define IP6_HDRLEN          40
+
+#define ETHTYPE_IP          0x0800
+#define ETHTYPE_ARP         0x0806
+#define ETHTYPE_IP6         0x86dd
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+enum filter_node_e
+{
+  FILTER_NODE_AND = 0,
+  FILTER_NODE_OR,
+  FILTER_NODE_NOT,
+  FILTER_NODE_ETHER,              /* k: ethernet type */
+  FILTER_NODE_PROTO,              /* v4/v6: IPv4 protocol/IPv6 next header */
+  FILTER_NODE_HOST,               /* k: IPv4 address, mask: netmask */
+  FILTER_NODE_PORT                /* k: TCP/UDP port */
+};
+
+struct filter_node_s
+{
+  uint8_t  type;
+  uint8_t  dir;
+  uint8_t  v4;
+  uint8_t  v6;
+  int16_t  left;
+  int16_t  right;
+  uint32_t k;
+  uint32_t mask;
+};
+
+struct filter_parser_s
+{
+  FAR const char *next;
+  char            tok[FILTER_MAX_TOKEN];
+  int             nnodes;
+  struct filter_node_s nodes[FILTER_MAX_NODES];
+};
+
+struct filter_gen_s
+{
+  uint16_t n;
+  uint16_t nlabels;
+  bool     overflow;
+  int16_t  labels[FILTER_MAX_LABELS];
+  int16_t  jt[BPF_MAXINSNS];
+  int16_t  jf[BPF_MAXINSNS];
+  struct tcpdump_bpf_insn_s insns[BPF_MAXINSNS];
+};
+
+/****************************************************************************
+ * Private Functions Prototypes
+ ****************************************************************************/
+
+static int filter_parse_or(FAR struct filter_parser_s *ps);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: filter_advance
+ *
+ * Description:
+ *   Load the next token of the expression into ps->tok.  Tokens are
+ *   words, parentheses and the !, && and || operators.
+ *
+ ****************************************************************************/
+
+static void filter_advance(FAR struct filter_parser_s *ps)
+{
+  FAR const char *p = ps->next;
+  size_t len = 0;
+
+  while (*p == ' ' || *p == '\t')
+    {
+      p++;
+    }
+
+  if (*p == '(' || *p == ')' || *p == '!')
+    {
+      len = 1;
+    }
+  else if ((p[0] == '&' && p[1] == '&') || (p[0] == '|' && p[1] == '|'))
+    {
+      len = 2;
+    }
+  else
+    {
+      while (p[len] != '\0' && p[len] != ' ' && p[len] != '\t' &&
+             strchr("()!&|", p[len]) == NULL)
+        {
+          len++;
+        }
+    }
+
+  len = MIN(len, sizeof(ps->tok) - 1);
+  memcpy(ps->tok, p, len);
+  ps->tok[len] = '\0';
+  ps->next = p + len;
+}
+
+/****************************************************************************
+ * Name: filter_accept
+ ****************************************************************************/
+
+static bool filter_accept(FAR struct filter_parser_s *ps,
+                          FAR const char *a, FAR const char *b)
+{
+  if (strcmp(ps->tok, a) == 0 || (b != NULL && strcmp(ps->tok, b) == 0))
+    {
+      filter_advance(ps);
+      return true;
+    }
+
+  return false;
+}
+
+/****************************************************************************
+ * Name: filter_node
+ ****************************************************************************/
+
+static int filter_node(FAR struct filter_parser_s *ps, uint8_t type,
+                       int left, int right)
+{
+  FAR struct filter_node_s *node;
+
+  if (ps->nnodes >= FILTER_MAX_NODES)
+    {
+      printf("ERROR: filter expression too long\n");
+      return -E2BIG;
+    }
+
+  node = &ps->nodes[ps->nnodes];
+  memset(node, 0, sizeof(*node));
+  node->type  = type;
+  node->left  = left;
+  node->right = right;
+  node->mask  = UINT32_MAX;
+
+  return ps->nnodes++;
+}
+
+/****************************************************************************
+ * Name: filter_parse_addr
+ *
+ * Description:
+ *   Parse an IPv4 address with an optional prefix length.
+ *
+ ****************************************************************************/
+
+static int filter_parse_addr(FAR struct filter_parser_s *ps, bool net,
+                             FAR uint32_t *addr, FAR uint32_t *mask)
+{
+  FAR char *slash;
+  struct in_addr in;
+  FAR char *end;
+  long prefix = 32;
+
+  slash = strchr(ps->tok, '/');
+  if (slash != NULL)
+    {
+      if (!net)
+        {
+          goto err;
+        }
+
+      *slash++ = '\0';
+      prefix = strtol(slash, &end, 10);
+      if (*end != '\0' || prefix < 0 || prefix > 32)
+        {
+          goto err;
+        }
+    }
+
+  if (inet_aton(ps->tok, &in) == 0)
+    {
+      goto err;
+    }
+
+  *mask = prefix == 0 ? 0 : UINT32_MAX << (32 - prefix);
+  *addr = ntohl(in.s_addr) & *mask;
+  filter_advance(ps);
+  return OK;
+
+err:
+  printf("ERROR: invalid address '%s'\n", ps->tok);
+  return -EINVAL;
+}
+
+/****************************************************************************
+ * Name: filter_parse_prim
+ *
+ * Description:
+ *   primitive := [src|dst] (host ADDR | net ADDR[/LEN] | port NUM)
+ *              | ip | ip6 | arp | (tcp|udp) [primitive] | icmp | icmp6
+ *
+ ****************************************************************************/
+
+static int filter_parse_prim(FAR struct filter_parser_s *ps)
+{
+  FAR struct filter_node_s *node;
+  uint8_t dir = FILTER_DIR_ANY;
+  FAR char *end;
+  bool net;
+  long port;
+  int proto;
+  int right;
+  int ret;
+
+  if (filter_accept(ps, "src", NULL))
+    {
+      dir = FILTER_DIR_SRC;
+    }
+  else if (filter_accept(ps, "dst", NULL))
+    {
+      dir = FILTER_DIR_DST;
+    }
+
+  if (strcmp(ps->tok, "host") == 0 || strcmp(ps->tok, "net") == 0)
+    {
+      net = ps->tok[0] == 'n';
+      filter_advance(ps);
+
+      ret = filter_node(ps, FILTER_NODE_HOST, -1, -1);
+      if (ret >= 0)
+        {
+          node = &ps->nodes[ret];
+          node->dir = dir;
+          if (filter_parse_addr(ps, net, &node->k, &node->mask) < 0)
+            {
+              return -EINVAL;
+            }
+        }
+
+      return ret;
+    }
+
+  if (filter_accept(ps, "port", NULL))
+    {
+      port = strtol(ps->tok, &end, 0);
+      if (ps->tok[0] == '\0' || *end != '\0' || port < 0 || port > 65535)
+        {
+          printf("ERROR: invalid port '%s'\n", ps->tok);
+          return -EINVAL;
+        }
+
+      ret = filter_node(ps, FILTER_NODE_PORT, -1, -1);
+      if (ret >= 0)
+        {
+          ps->nodes[ret].dir = dir;
+          ps->nodes[ret].k = port;
+          filter_advance(ps);
+        }
+
+      return ret;
+    }
+
+  if (dir != FILTER_DIR_ANY)
+    {
+      printf("ERROR: expected host, net or port near '%s'\n", ps->tok);
+      return -EINVAL;
+    }
+
+  if (filter_accept(ps, "ip", NULL))
+    {
+      ret = filter_node(ps, FILTER_NODE_ETHER, -1, -1);
+      if (ret >= 0)
+        {
+          ps->nodes[ret].k = ETHTYPE_IP;
+        }
+
+      return ret;
+    }
+
+  if (filter_accept(ps, "ip6", NULL))
+    {
+      ret = filter_node(ps, FILTER_NODE_ETHER, -1, -1);
+      if (ret >= 0)
+        {
+          ps->nodes[ret].k = ETHTYPE_IP6;
+        }
+
+      return ret;
+    }
+
+  if (filter_accept(ps, "arp", NULL))
+    {
+      ret = filter_node(ps, FILTER_NODE_ETHER, -1, -1);
+      if (ret >= 0)
+        {
+          ps->nodes[ret].k = ETHTYPE_ARP;
+        }
+
+      return ret;
+    }
+
+  if (filter_accept(ps, "icmp", NULL))
+    {
+      ret = filter_node(ps, FILTER_NODE_PROTO, -1, -1);
+      if (ret >= 0)
+        {
+          ps->nodes[ret].v4 = IPPROTO_ICMP;
+        }
+
+      return ret;
+    }
+
+  if (filter_accept(ps, "icmp6", NULL))
+    {
+      ret = filter_node(ps, FILTER_NODE_PROTO, -1, -1);
+      if (ret >= 0)
+        {
+          ps->nodes[ret].v6 = IPPROTO_ICMP6;
+        }
+
+      return ret;
+    }
+
+  if (strcmp(ps->tok, "tcp") == 0 || strcmp(ps->tok, "udp") == 0)
+    {
+      proto = ps->tok[0] == 't' ? IPPROTO_TCP : IPPROTO_UDP;
+      filter_advance(ps);
+
+      ret = filter_node(ps, FILTER_NODE_PROTO, -1, -1);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      ps->nodes[ret].v4 = proto;
+      ps->nodes[ret].v6 = proto;
+
+      /* "tcp port 80" is "tcp and port 80" */
+
+      if (strcmp(ps->tok, "port") == 0 || strcmp(ps->tok, "src") == 0 ||
+          strcmp(ps->tok, "dst") == 0)
+        {
+          right = filter_parse_prim(ps);
+          if (right < 0)
+            {
+              return right;
+            }
+
+          ret = filter_node(ps, FILTER_NODE_AND, ret, right);
+        }
+
+      return ret;
+    }
+
+  if (ps->tok[0] == '\0')
+    {
+      printf("ERROR: unexpected end of filter expression\n");
+    }
+  else
+    {
+      printf("ERROR: syntax error near '%s'\n", ps->tok);
+    }
+
+  return -EINVAL;
+}
+
+/****************************************************************************
+ * Name: filter_parse_not
+ ****************************************************************************/
+
+static int filter_parse_not(FAR struct filter_parser_s *ps)
+{
+  int ret;
+
+  if (filter_accept(ps, "not", "!"))
+    {
+      ret = filter_parse_not(ps);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      return filter_node(ps, FILTER_NODE_NOT, ret, -1);
+    }
+
+  if (filter_accept(ps, "(", NULL))
+    {
+      ret = filter_parse_or(ps);
+      if (ret >= 0 && !filter_accept(ps, ")", NULL))
+        {
+          printf("ERROR: missing ')' near '%s'\n", ps->tok);
+          return -EINVAL;
+        }
+
+      return ret;
+    }
+
+  return filter_parse_prim(ps);
+}
+
+/****************************************************************************
+ * Name: filter_parse_and
+ ****************************************************************************/
+
+static int filter_parse_and(FAR struct filter_parser_s *ps)
+{
+  int right;
+  int ret;
+
+  ret = filter_parse_not(ps);
+  while (ret >= 0 && filter_accept(ps, "and", "&&"))
+    {
+      right = filter_parse_not(ps);
+      if (right < 0)
+        {
+          return right;
+        }
+
+      ret = filter_node(ps, FILTER_NODE_AND, ret, right);
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: filter_parse_or
+ ****************************************************************************/
+
+static int filter_parse_or(FAR struct filter_parser_s *ps)
+{
+  int right;
+  int ret;
+
+  ret = filter_parse_and(ps);
+  while (ret >= 0 && filter_accept(ps, "or", "||"))
+    {
+      right = filter_parse_and(ps);
+      if (right < 0)
+        {
+          return right;
+        }
+
+      ret = filter_node(ps, FILTER_NODE_OR, ret, right);
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: gen_label
+ ****************************************************************************/
+
+static int gen_label(FAR struct filter_gen_s *gen)
+{
+  if (gen->nlabels >= FILTER_MAX_LABELS)
+    {
+      gen->overflow = true;
+      return 0;
+    }
+
+  gen->labels[gen->nlabels] = -1;
+  return gen->nlabels++;
+}
+
+/****************************************************************************
+ * Name: gen_place
+ ****************************************************************************/
+
+static void gen_place(FAR struct filter_gen_s *gen, int label)
+{
+  gen->labels[label] = gen->n;
+}
+
+/****************************************************************************
+ * Name: gen_emit
+ ****************************************************************************/
+
+static void gen_emit(FAR struct filter_gen_s *gen, uint16_t code,
+                     uint32_t k, int jt, int jf)
+{
+  if (gen->n >= BPF_MAXINSNS)
+    {
+      gen->overflow = true;
+      return;
+    }
+
+  gen->insns[gen->n].code = code;
+  gen->insns[gen->n].k    = k;
+  gen->jt[gen->n]         = jt;
+  gen->jf[gen->n]         = jf;
+  gen->n++;
+}
+
+/****************************************************************************
+ * Name: gen_stmt
+ ****************************************************************************/
+
+static void gen_stmt(FAR struct filter_gen_s *gen, uint16_t code,
+                     uint32_t k)
+{
+  gen_emit(gen, code, k, FILTER_LABEL_NEXT, FILTER_LABEL_NEXT);
+}
+
+/****************************************************************************
+ * Name: gen_ports
+ *
+ * Description:
+ *   Compare the TCP/UDP source and/or destination port, loaded with the
+ *   given addressing mode.
+ *
+ ****************************************************************************/
+
+static void gen_ports(FAR struct filter_gen_s *gen,
+                      FAR const struct filter_node_s *node, uint16_t mode,
+                      uint32_t off, int t, int f)
+{
+  if (node->dir != FILTER_DIR_DST)
+    {
+      gen_stmt(gen, BPF_LD | BPF_H | mode, off);
+      gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, node->k, t,
+               node->dir == FILTER_DIR_SRC ? f : FILTER_LABEL_NEXT);
+    }
+
+  if (node->dir != FILTER_DIR_SRC)
+    {
+      gen_stmt(gen, BPF_LD | BPF_H | mode, off + 2);
+      gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, node->k, t, f);
+    }
+}
+
+/****************************************************************************
+ * Name: gen_node
+ *
+ * Description:
+ *   Generate the code of a node that jumps to label t if the packet
+ *   matches, and to label f otherwise.  All labels placed while generating
+ *   are behind the jumps to them, as classic BPF only jumps forward.
+ *
+ ****************************************************************************/
+
+static void gen_node(FAR struct filter_gen_s *gen,
+                     FAR const struct filter_node_s *nodes, int index,
+                     int t, int f)
+{
+  FAR const struct filter_node_s *node = &nodes[index];
+  int l6;
+  int lp;
+
+  switch (node->type)
+    {
+      case FILTER_NODE_AND:
+        lp = gen_label(gen);
+        gen_node(gen, nodes, node->left, lp, f);
+        gen_place(gen, lp);
+        gen_node(gen, nodes, node->right, t, f);
+        break;
+
+      case FILTER_NODE_OR:
+        lp = gen_label(gen);
+        gen_node(gen, nodes, node->left, t, lp);
+        gen_place(gen, lp);
+        gen_node(gen, nodes, node->right, t, f);
+        break;
+
+      case FILTER_NODE_NOT:
+        gen_node(gen, nodes, node->left, f, t);
+        break;
+
+      case FILTER_NODE_ETHER:
+        gen_stmt(gen, BPF_LD | BPF_H | BPF_ABS, ETH_TYPE_OFF);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, node->k, t, f);
+        break;
+
+      case FILTER_NODE_PROTO:
+        l6 = gen_label(gen);
+        gen_stmt(gen, BPF_LD | BPF_H | BPF_ABS, ETH_TYPE_OFF);
+        if (node->v4 != 0)
+          {
+            gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, ETHTYPE_IP,
+                     FILTER_LABEL_NEXT, node->v6 != 0 ? l6 : f);
+            gen_stmt(gen, BPF_LD | BPF_B | BPF_ABS, IP4_PROTO_OFF);
+            gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, node->v4, t, f);
+          }
+
+        gen_place(gen, l6);
+        if (node->v6 != 0)
+          {
+            gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, ETHTYPE_IP6,
+                     FILTER_LABEL_NEXT, f);
+            gen_stmt(gen, BPF_LD | BPF_B | BPF_ABS, IP6_NEXT_OFF);
+            gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, node->v6, t, f);
+          }
+        break;
+
+      case FILTER_NODE_HOST:
+
+        /* IPv4 only */
+
+        gen_stmt(gen, BPF_LD | BPF_H | BPF_ABS, ETH_TYPE_OFF);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, ETHTYPE_IP,
+                 FILTER_LABEL_NEXT, f);
+
+        if (node->dir != FILTER_DIR_DST)
+          {
+            gen_stmt(gen, BPF_LD | BPF_W | BPF_ABS, IP4_SRC_OFF);
+            if (node->mask != UINT32_MAX)
+              {
+                gen_stmt(gen, BPF_ALU | BPF_AND | BPF_K, node->mask);
+              }
+
+            gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, node->k, t,
+                     node->dir == FILTER_DIR_SRC ? f : FILTER_LABEL_NEXT);
+          }
+
+        if (node->dir != FILTER_DIR_SRC)
+          {
+            gen_stmt(gen, BPF_LD | BPF_W | BPF_ABS, IP4_DST_OFF);
+            if (node->mask != UINT32_MAX)
+              {
+                gen_stmt(gen, BPF_ALU | BPF_AND | BPF_K, node->mask);
+              }
+
+            gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, node->k, t, f);
+          }
+        break;
+
+      case FILTER_NODE_PORT:
+
+        /* IPv4: skip fragments, X = IP header length */
+
+        l6 = gen_label(gen);
+        lp = gen_label(gen);
+        gen_stmt(gen, BPF_LD | BPF_H | BPF_ABS, ETH_TYPE_OFF);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, ETHTYPE_IP,
+                 FILTER_LABEL_NEXT, l6);
+        gen_stmt(gen, BPF_LD | BPF_B | BPF_ABS, IP4_PROTO_OFF);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP,
+                 lp, FILTER_LABEL_NEXT);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, lp, f);
+        gen_place(gen, lp);
+        gen_stmt(gen, BPF_LD | BPF_H | BPF_ABS, IP4_FRAG_OFF);
+        gen_emit(gen, BPF_JMP | BPF_JSET | BPF_K, 0x1fff,
+                 f, FILTER_LABEL_NEXT);
+        gen_stmt(gen, BPF_LDX | BPF_B | BPF_MSH, ETH_HDRLEN);
+        gen_ports(gen, node, BPF_IND, ETH_HDRLEN, t, f);
+
+        /* IPv6 without extension headers */
+
+        gen_place(gen, l6);
+        lp = gen_label(gen);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, ETHTYPE_IP6,
+                 FILTER_LABEL_NEXT, f);
+        gen_stmt(gen, BPF_LD | BPF_B | BPF_ABS, IP6_NEXT_OFF);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP,
+                 lp, FILTER_LABEL_NEXT);
+        gen_emit(gen, BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, lp, f);
+        gen_place(gen, lp);
+        gen_ports(gen, node, BPF_ABS, ETH_HDRLEN + IP6_HDRLEN, t, f);
+        break;
+    }
+}
+
+/****************************************************************************
+ * Name: gen_resolve
+ *
+ * Description:
+ *   Replace the jump labels by relative offsets.
+ *
+ ****************************************************************************/
+
+static int gen_resolve(FAR struct filter_gen_s *gen)
+{
+  FAR struct tcpdump_bpf_insn_s *insn;
+  int off;
+  int i;
+
+  for (i = 0; i < gen->n; i++)
+    {
+      insn = &gen->insns[i];
+      if (BPF_CLASS(insn->code) != BPF_JMP)
+        {
+          continue;
+        }
+
+      if (BPF_OP(insn->code) == BPF_JA)
+        {
+          insn->k = gen->labels[gen->jt[i]] - (i + 1);
+          continue;
+        }
+
+      off = gen->jt[i] == FILTER_LABEL_NEXT ? 0 :
+            gen->labels[gen->jt[i]] - (i + 1);
+      if (off < 0 || off > UINT8_MAX)
+        {
+          return -E2BIG;
+        }
+
+      insn->jt = off;
+
+      off = gen->jf[i] == FILTER_LABEL_NEXT ? 0 :
+            gen->labels[gen->jf[i]] - (i + 1);
+      if (off < 0 || off > UINT8_MAX)
+        {
+          return -E2BIG;
+        }
+
+      insn->jf = off;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: filter_load
+ ****************************************************************************/
+
+static bool filter_load(FAR const uint8_t *pkt, uint32_t len,
+                        uint32_t off, uint16_t size, FAR uint32_t *val)
+{
+  switch (size)
+    {
+      case BPF_W:
+        if (off > len || len - off < 4)
+          {
+            return false;
+          }
+
+        *val = ((uint32_t)pkt[off] << 24) | ((uint32_t)pkt[off + 1] << 16) |
+               ((uint32_t)pkt[off + 2] << 8) | pkt[off + 3];
+        return true;
+
+      case BPF_H:
+        if (off > len || len - off < 2)
+          {
+            return false;
+          }
+
+        *val = ((uint32_t)pkt[off] << 8) | pkt[off + 1];
+        return true;
+
+      case BPF_B:
+        if (off >= len)
+          {
+            return false;
+          }
+
+        *val = pkt[off];
+        return true;
+
+      default:
+        return false;
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: tcpdump_filter_compile
+ ****************************************************************************/
+
+int tcpdump_filter_compile(FAR const char *expr, uint32_t snaplen,
+                           FAR struct tcpdump_bpf_prog_s *prog)
+{
+  FAR struct filter_parser_s *ps;
+  FAR struct filter_gen_s *gen;
+  int accept;
+  int reject;
+  int root;
+  int ret;
+
+  prog->len = 0;
+  prog->insns = NULL;
+
+  ps = calloc(1, sizeof(*ps));
+  gen = calloc(1, sizeof(*gen));
+  if (ps == NULL || gen == NULL)
+    {
+      ret = -ENOMEM;
+      goto out;
+    }
+
+  ps->next = expr;
+  filter_advance(ps);
+
+  root = filter_parse_or(ps);
+  if (root < 0)
+    {
+      ret = root;
+      goto out;
+    }
+
+  if (ps->tok[0] != '\0')
+    {
+      printf("ERROR: syntax error near '%s'\n", ps->tok);
+      ret = -EINVAL;
+      goto out;
+    }
+
+  accept = gen_label(gen);
+  reject = gen_label(gen);
+  gen_node(gen, ps->nodes, root, accept, reject);
+  gen_place(gen, accept);
+  gen_stmt(gen, BPF_RET | BPF_K, snaplen);
+  gen_place(gen, reject);
+  gen_stmt(gen, BPF_RET | BPF_K, 0);
+
+  ret = gen->overflow ? -E2BIG : gen_resolve(gen);
+  if (ret < 0)
+    {
+      printf("ERROR: filter expression too complex\n");
+      goto out;
+    }
+
+  prog->insns = malloc(gen->n * sizeof(struct tcpdump_bpf_insn_s));
+  if (prog->insns == NULL)
+    {
+      ret = -ENOMEM;
+      goto out;
+    }
+
+  memcpy(prog->insns, gen->insns, gen->n * sizeof(*prog->insns));
+  prog->len = gen->n;
+
+out:
+  free(gen);
+  free(ps);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tcpdump_filter_free
+ ****************************************************************************/
+
+void tcpdump_filter_free(FAR struct tcpdump_bpf_prog_s *prog)
+{
+  free(prog->insns);
+  prog->insns = NULL;
+  prog->len = 0;
+}
+
+/****************************************************************************
+ * Name: tcpdump_filter_run
+ ****************************************************************************/
+
+uint32_t tcpdump_filter_run(FAR const struct tcpdump_bpf_prog_s *prog,
+                            FAR const uint8_t *pkt, uint32_t len)
+{
+  FAR const struct tcpdump_bpf_insn_s *insn;
+  uint32_t mem[BPF_MEMWORDS];
+  uint32_t pc;
+  uint32_t a = 0;
+  uint32_t x = 0;
+  uint32_t val;
+  uint32_t k;
+
+  for (pc = 0; pc < prog->len; pc++)
+    {
+      insn = &prog->insns[pc];
+      k = insn->k;
+
+      switch (BPF_CLASS(insn->code))
+        {
+          case BPF_LD:
+            switch (BPF_MODE(insn->code))
+              {
+                case BPF_ABS:
+                  if (!filter_load(pkt, len, k, BPF_SIZE(insn->code), &a))
+                    {
+                      return 0;
+                    }
+                  break;
+
+                case BPF_IND:
+                  if (!filter_load(pkt, len, x + k, BPF_SIZE(insn->code),
+                                   &a))
+                    {
+                      return 0;
+                    }
+                  break;
+
+                case BPF_IMM:
+                  a = k;
+                  break;
+
+                case BPF_MEM:
+                  a = mem[k % BPF_MEMWORDS];
+                  break;
+
+                case BPF_LEN:
+                  a = len;
+                  break;
+
+                default:
+                  return 0;
+              }
+            break;
+
+          case BPF_LDX:
+            switch (BPF_MODE(insn->code))
+              {
+                case BPF_MSH:
+                  if (!filter_load(pkt, len, k, BPF_B, &val))
+                    {
+                      return 0;
+                    }
+
+                  x = (val & 0xf) << 2;
+                  break;
+
+                case BPF_IMM:
+                  x = k;
+                  break;
+
+                case BPF_MEM:
+                  x = mem[k % BPF_MEMWORDS];
+                  break;
+
+                case BPF_LEN:
+                  x = len;
+                  break;
+
+                default:
+                  return 0;
+              }
+            break;
+
+          case BPF_ST:
+            mem[k % BPF_MEMWORDS] = a;
+            break;
+
+          case BPF_STX:
+            mem[k % BPF_MEMWORDS] = x;
+            break;
+
+          case BPF_ALU:
+            val = BPF_SRC(insn->code) == BPF_X ? x : k;
+            switch (BPF_OP(insn->code))
+              {
+                case BPF_ADD:
+                  a += val;
+                  break;
+
+                case BPF_SUB:
+                  a -= val;
+                  break;
+
+                case BPF_MUL:
+                  a *= val;
+                  break;
+
+                case BPF_DIV:
+                  if (val == 0)
+                    {
+                      return 0;
+                    }
+
+                  a /= val;
+                  break;
+
+                case BPF_MOD:
+                  if (val == 0)
+                    {
+                      return 0;
+                    }
+
+                  a %= val;
+                  break;
+
+                case BPF_OR:
+                  a |= val;
+                  break;
+
+                case BPF_AND:
+                  a &= val;
+                  break;
+
+                case BPF_XOR:
+                  a ^= val;
+                  break;
+
+                case BPF_LSH:
+                  a = val < 32 ? a << val : 0;
+                  break;
+
+                case BPF_RSH:
+                  a = val < 32 ? a >> val : 0;
+                  break;
+
+                case BPF_NEG:
+                  a = -a;
+                  break;
+
+                default:
+                  return 0;
+              }
+            break;
+
+          case BPF_JMP:
+            val = BPF_SRC(insn->code) == BPF_X ? x : k;
+            switch (BPF_OP(insn->code))
+              {
+                case BPF_JA:
+                  pc += k;
+                  break;
+
+                case BPF_JEQ:
+                  pc += a == val ? insn->jt : insn->jf;
+                  break;
+
+                case BPF_JGT:
+                  pc += a > val ? insn->jt : insn->jf;
+                  break;
+
+                case BPF_JGE:
+                  pc += a >= val ? insn->jt : insn->jf;
+                  break;
+
+                case BPF_JSET:
+                  pc += (a & val) != 0 ? insn->jt : insn->jf;
+                  break;
+
+                default:
+                  return 0;
+              }
+            break;
+
+          case BPF_RET:
+            return BPF_RVAL(insn->code) == BPF_A ? a :
+                   BPF_RVAL(insn->code) == BPF_X ? x : k;
+
+          case BPF_MISC:
+            if (BPF_MISCOP(insn->code) == BPF_TAX)
+              {
+                x = a;
+              }
+            else
+              {
+                a = x;
+              }
+            break;
+        }
+    }
+
+  /* Falling off the end drops the packet */
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: tcpdump_filter_dump
+ ****************************************************************************/
+
+void tcpdump_filter_dump(FAR const struct tcpdump_bpf_prog_s *prog)
+{
+  FAR const struct tcpdump_bpf_insn_s *insn;
+  FAR const char *op;
+  int i;
+
+  static FAR const char * const jmpops[] =
+    {
+      "ja", "jeq", "jgt", "jge", "jset"
+    };
+
+  static FAR const char * const aluops[] =
+    {
+      "add", "sub", "mul", "div", "or", "and", "lsh", "rsh", "neg", "mod",
+      "xor"
+    };
+
+  for (i = 0; i < prog->len; i++)
+    {
+      insn = &prog->insns[i];
+      printf("(%03d) ", i);
+
+      switch (insn->code)
+        {
+          case BPF_LD | BPF_W | BPF_ABS:
+          case BPF_LD | BPF_H | BPF_ABS:
+          case BPF_LD | BPF_B | BPF_ABS:
+            op = BPF_SIZE(insn->code) == BPF_W ? "ld" :
+                 BPF_SIZE(insn->code) == BPF_H ? "ldh" : "ldb";
+            printf("%-8s [%" PRIu32 "]\n", op, insn->k);
+            break;
+
+          case BPF_LD | BPF_W | BPF_IND:
+          case BPF_LD | BPF_H | BPF_IND:
+          case BPF_LD | BPF_B | BPF_IND:
+            op = BPF_SIZE(insn->code) == BPF_W ? "ld" :
+                 BPF_SIZE(insn->code) == BPF_H ? "ldh" : "ldb";
+            printf("%-8s [x + %" PRIu32 "]\n", op, insn->k);
+            break;
+
+          case BPF_LDX | BPF_B | BPF_MSH:
+            printf("%-8s 4*([%" PRIu32 "]&0xf)\n", "ldxb", insn->k);
+            break;
+
+          case BPF_RET | BPF_K:
+            printf("%-8s #%" PRIu32 "\n", "ret", insn->k);
+            break;
+
+          default:
+            if (BPF_CLASS(insn->code) == BPF_JMP &&
+                BPF_OP(insn->code) == BPF_JA)
+              {
+                printf("%-8s %" PRIu32 "\n", "ja", i + 1 + insn->k);
+              }
+            else if (BPF_CLASS(insn->code) == BPF_JMP &&
+                     BPF_SRC(insn->code) == BPF_K &&
+                     (BPF_OP(insn->code) >> 4) < nitems(jmpops))
+              {
+                printf("%-8s #0x%-14" PRIx32 " jt %d\tjf %d\n",
+                       jmpops[BPF_OP(insn->code) >> 4], insn->k,
+                       i + 1 + insn->jt, i + 1 + insn->jf);
+              }
+            else if (BPF_CLASS(insn->code) == BPF_ALU &&
+                     BPF_SRC(insn->code) == BPF_K &&
+                     (BPF_OP(insn->code) >> 4) < nitems(aluops))
+              {
+                printf("%-8s #0x%" PRIx32 "\n",
+                       aluops[BPF_OP(insn->code) >> 4], insn->k);
+              }
+            else
+              {
+                printf("code 0x%04x jt %d jf %d k 0x%08" PRIx32 "\n",
+                       insn->code, insn->jt, insn->jf, insn->k);
+              }
+            break;
+        }
+    }
+}
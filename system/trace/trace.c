@@ -230,6 +230,170 @@ static int trace_cmd_dump(int index, int argc, FAR char **argv,
 }
 #endif
 
+/****************************************************************************
+ * Name: trace_cmd_export
+ ****************************************************************************/
+
+#ifdef CONFIG_SYSTEM_TRACE_CTF
+static int trace_cmd_export(int index, int argc, FAR char **argv,
+                            int notectlfd)
+{
+  FAR const char *path;
+  FAR char *endptr;
+  int duration = 0;
+  bool changed;
+  bool cont = false;
+  int ret;
+
+  /* Usage: trace export [-c] <dir> [<duration>] */
+
+  if (index < argc)
+    {
+      if (strcmp(argv[index], "-c") == 0)
+        {
+          cont = true;
+          index++;
+        }
+    }
+
+  if (index >= argc)
+    {
+      /* <directory> parameter is mandatory. */
+
+      fprintf(stderr,
+              "trace export: no argument\n");
+      return ERROR;
+    }
+
+  path = argv[index++];
+
+  if (index < argc)
+    {
+      duration = strtoul(argv[index], &endptr, 0);
+      if (endptr != argv[index] && *endptr == '\0')
+        {
+          index++;
+        }
+      else
+        {
+          duration = 0;
+        }
+    }
+
+  /* Clear the trace buffer and start tracing while exporting */
+
+  if (!cont)
+    {
+      trace_dump_clear();
+    }
+
+  changed = notectl_enable(true, notectlfd);
+
+  ret = trace_ctf_export_dir(path, duration);
+
+  if (changed)
+    {
+      notectl_enable(false, notectlfd);
+    }
+
+  if (ret < 0)
+    {
+      fprintf(stderr,
+              "trace export: export failed\n");
+      return ERROR;
+    }
+
+  return index;
+}
+#endif
+
+/****************************************************************************
+ * Name: trace_cmd_stream
+ ****************************************************************************/
+
+#ifdef CONFIG_SYSTEM_TRACE_STREAM
+static int trace_cmd_stream(int index, int argc, FAR char **argv,
+                            int notectlfd)
+{
+  FAR const char *dest;
+  FAR char *endptr;
+  int duration = 0;
+  bool changed;
+  bool cont = false;
+  bool udp = false;
+  int ret;
+
+  /* Usage: trace stream [-u][-c] <ipaddr>:<port> [<duration>] */
+
+  while (index < argc)
+    {
+      if (strcmp(argv[index], "-u") == 0)
+        {
+          udp = true;
+          index++;
+        }
+      else if (strcmp(argv[index], "-c") == 0)
+        {
+          cont = true;
+          index++;
+        }
+      else
+        {
+          break;
+        }
+    }
+
+  if (index >= argc)
+    {
+      /* <ipaddr>:<port> parameter is mandatory. */
+
+      fprintf(stderr,
+              "trace stream: no argument\n");
+      return ERROR;
+    }
+
+  dest = argv[index++];
+
+  if (index < argc)
+    {
+      duration = strtoul(argv[index], &endptr, 0);
+      if (endptr != argv[index] && *endptr == '\0')
+        {
+          index++;
+        }
+      else
+        {
+          duration = 0;
+        }
+    }
+
+  /* Clear the trace buffer and start tracing while streaming */
+
+  if (!cont)
+    {
+      trace_dump_clear();
+    }
+
+  changed = notectl_enable(true, notectlfd);
+
+  ret = trace_stream(dest, udp, duration);
+
+  if (changed)
+    {
+      notectl_enable(false, notectlfd);
+    }
+
+  if (ret < 0)
+    {
+      fprintf(stderr,
+              "trace stream: stream failed\n");
+      return ERROR;
+    }
+
+  return index;
+}
+#endif
+
 /****************************************************************************
  * Name: trace_cmd_cmd
  ****************************************************************************/
@@ -803,6 +967,15 @@ static void show_usage(void)
           " dump    [-a][-c][<filename>]        :"
                                 " Output the trace result\n"
           "                                       [-a] <Android SysTrace>\n"
+#endif
+#ifdef CONFIG_SYSTEM_TRACE_CTF
+          " export  [-c] <dir> [<duration>]     :"
+                                " Stream the trace to a CTF directory\n"
+#endif
+#ifdef CONFIG_SYSTEM_TRACE_STREAM
+          " stream  [-u][-c] <ip>:<port> [<sec>]:"
+                                " Stream the trace to trace_recv.py\n"
+          "                                       [-u] <UDP instead of TCP>\n"
 #endif
           " mode    [{+|-}{o|w|s|a|i|d}...]     :"
                                 " Set task trace options\n"
@@ -875,6 +1048,18 @@ int main(int argc, FAR char *argv[])
           i = trace_cmd_dump(i + 1, argc, argv, notectlfd);
         }
 #endif
+#ifdef CONFIG_SYSTEM_TRACE_CTF
+      else if (strcmp(argv[i], "export") == 0)
+        {
+          i = trace_cmd_export(i + 1, argc, argv, notectlfd);
+        }
+#endif
+#ifdef CONFIG_SYSTEM_TRACE_STREAM
+      else if (strcmp(argv[i], "stream") == 0)
+        {
+          i = trace_cmd_stream(i + 1, argc, argv, notectlfd);
+        }
+#endif
 #ifdef CONFIG_SYSTEM_SYSTEM
       else if (strcmp(argv[i], "cmd") == 0)
         {
@@ -51,6 +51,22 @@ typedef enum
   TRACE_TYPE_ANDROID      = 5,  /* Custom Format :       Android ATrace */
 } trace_dump_t;
 
+#ifdef CONFIG_SYSTEM_TRACE_CTF
+
+/* Output of the CTF exporter.  The channel is the CPU index of a stream
+ * packet, or TRACE_CTF_METADATA for the metadata text.  An output that
+ * cannot keep up may return TRACE_CTF_DROPPED, the events of the packet
+ * are then counted in events_discarded of the next packets.
+ */
+
+#define TRACE_CTF_METADATA (-1)
+#define TRACE_CTF_DROPPED  1
+
+typedef CODE int (*trace_ctf_write_t)(FAR void *priv, int channel,
+                                      FAR const void *buf, size_t len);
+
+#endif
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -97,6 +113,58 @@ bool trace_dump_get_overwrite(void);
 
 void trace_dump_set_overwrite(bool mode);
 
+#ifdef CONFIG_SYSTEM_TRACE_CTF
+
+/****************************************************************************
+ * Name: trace_ctf_export
+ *
+ * Description:
+ *   Drain the notes continuously and convert them to the Common Trace
+ *   Format.  The metadata and the per-CPU packets are passed to the write
+ *   callback, packets are at most pktsize bytes long (at most
+ *   CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE).  Stop after duration seconds
+ *   (0: forever) or on SIGINT.
+ *
+ * Returned Value:
+ *   OK on success, a negated errno value on failure.
+ *
+ ****************************************************************************/
+
+int trace_ctf_export(trace_ctf_write_t write, FAR void *priv,
+                     size_t pktsize, int duration);
+
+/****************************************************************************
+ * Name: trace_ctf_export_dir
+ *
+ * Description:
+ *   Export the notes to a CTF trace directory readable by babeltrace and
+ *   Trace Compass.
+ *
+ ****************************************************************************/
+
+int trace_ctf_export_dir(FAR const char *path, int duration);
+
+#endif
+
+#ifdef CONFIG_SYSTEM_TRACE_STREAM
+
+/****************************************************************************
+ * Name: trace_stream
+ *
+ * Description:
+ *   Stream the notes as CTF to a host collector at <ipaddr>:<port>, over
+ *   TCP or UDP, from a low priority drainer thread.  Stop after duration
+ *   seconds (0: forever) or on SIGINT.
+ *
+ * Returned Value:
+ *   OK on success, a negated errno value on failure.
+ *
+ ****************************************************************************/
+
+int trace_stream(FAR const char *dest, bool udp, int duration);
+
+#endif
+
 #else /* CONFIG_DRIVERS_NOTERAM */
 
 #define trace_dump(type,out)
@@ -0,0 +1,1164 @@
+/****************************************************************************
+ * apps/system/trace/trace_ctf.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <nuttx/sched_note.h>
+#include <nuttx/note/noteram_driver.h>
+
+#include "trace.h"
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SYSCALL
+#  ifdef CONFIG_LIB_SYSCALL
+#    include <syscall.h>
+#  else
+#    define CONFIG_LIB_SYSCALL
+#    include <syscall.h>
+#    undef CONFIG_LIB_SYSCALL
+#  endif
+#endif
+
+#define NCPUS CONFIG_SMP_NCPUS
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define get_pid(pid)  ((pid) < NCPUS ? 0 : (pid))
+
+#define CTF_MAGIC             0xc1fc1fc1
+
+/* Packet header (magic, stream_id) and context (timestamp_begin,
+ * timestamp_end, content_size, packet_size, events_discarded, cpu_id)
+ */
+
+#define CTF_PACKET_HDRLEN     (2 * 4 + 5 * 8 + 4)
+
+/* Event header (id, timestamp) */
+
+#define CTF_EVENT_HDRLEN      (2 + 8)
+#define CTF_EVENT_MAXLEN      (CTF_EVENT_HDRLEN + 256 + \
+                               2 * (CONFIG_TASK_NAME_SIZE + 1))
+
+/* Event IDs, the syscall events follow as entry/exit pairs */
+
+#define CTF_EVENT_SCHED_SWITCH      0
+#define CTF_EVENT_SCHED_WAKEUP_NEW  1
+#define CTF_EVENT_SCHED_WAKING      2
+#define CTF_EVENT_SCHED_EXIT        3
+#define CTF_EVENT_IRQ_ENTRY         4
+#define CTF_EVENT_IRQ_EXIT          5
+#define CTF_EVENT_PRINT             6
+#define CTF_EVENT_BINARY            7
+#define CTF_EVENT_SYSCALL           8
+
+/* Smallest packet that holds any event */
+
+#define CTF_PACKET_MINSIZE    (CTF_PACKET_HDRLEN + CTF_EVENT_MAXLEN)
+
+/* Time to wait for new notes when the buffer is drained */
+
+#define CTF_POLL_INTERVAL     10000
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct trace_ctf_task_s
+{
+  FAR struct trace_ctf_task_s *next;
+  pid_t pid;
+  int syscall_nest;
+  char name[CONFIG_TASK_NAME_SIZE + 1];
+};
+
+/* One packet under construction for each CPU (CTF stream) */
+
+struct trace_ctf_cpu_s
+{
+  int intr_nest;
+  bool pendingswitch;
+  int current_state;
+  pid_t current_pid;
+  pid_t next_pid;
+  uint8_t current_priority;
+  uint8_t next_priority;
+
+  uint64_t ts_begin;
+  uint64_t ts_end;
+  uint64_t discarded;
+  uint32_t nevents;
+  size_t len;
+  uint8_t packet[CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE];
+};
+
+struct trace_ctf_s
+{
+  trace_ctf_write_t write;
+  FAR void *priv;
+  size_t pktsize;
+  int notefd;
+  FAR struct trace_ctf_task_s *task;
+
+  /* Note buffer overruns */
+
+  unsigned int owmode;
+  uint32_t overruns;
+
+  /* Event being built */
+
+  uint8_t event[CTF_EVENT_MAXLEN];
+  size_t evlen;
+
+  struct trace_ctf_cpu_s cpu[NCPUS];
+};
+
+/* Output to a CTF trace directory */
+
+struct trace_ctf_dir_s
+{
+  int metafd;
+  int fd[NCPUS];
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static volatile bool g_trace_ctf_stop;
+
+/* The stream definitions of the metadata.  Integers are byte aligned, so
+ * no padding is ever needed between fields.  The LTTng kernel names are
+ * used for the domain, events and fields so that Trace Compass applies its
+ * kernel analyses to the trace.
+ */
+
+static const char g_trace_ctf_metadata[] =
+  "/* CTF 1.8 */\n"
+  "\n"
+  "typealias integer { size = 8; align = 8; signed = false; } := uint8_t;\n"
+  "typealias integer { size = 16; align = 8; signed = false; }"
+  " := uint16_t;\n"
+  "typealias integer { size = 32; align = 8; signed = false; }"
+  " := uint32_t;\n"
+  "typealias integer { size = 64; align = 8; signed = false; }"
+  " := uint64_t;\n"
+  "typealias integer { size = 64; align = 8; signed = false; base = 16; }"
+  " := uint64_hex_t;\n"
+  "typealias integer { size = 32; align = 8; signed = true; } := int32_t;\n"
+  "typealias integer { size = 64; align = 8; signed = true; } := int64_t;\n"
+  "\n"
+  "trace {\n"
+  "  major = 1;\n"
+  "  minor = 8;\n"
+#ifdef CONFIG_ENDIAN_BIG
+  "  byte_order = be;\n"
+#else
+  "  byte_order = le;\n"
+#endif
+  "  packet.header := struct {\n"
+  "    uint32_t magic;\n"
+  "    uint32_t stream_id;\n"
+  "  };\n"
+  "};\n"
+  "\n"
+  "env {\n"
+  "  domain = \"kernel\";\n"
+  "  sysname = \"NuttX\";\n"
+  "  tracer_name = \"lttng-modules\";\n"
+  "  tracer_major = 2;\n"
+  "  tracer_minor = 12;\n"
+  "};\n"
+  "\n"
+  "clock {\n"
+  "  name = \"monotonic\";\n"
+  "  freq = 1000000000;\n"
+  "  offset = 0;\n"
+  "};\n"
+  "\n"
+  "typealias integer {\n"
+  "  size = 64; align = 8; signed = false;\n"
+  "  map = clock.monotonic.value;\n"
+  "} := uint64_clock_monotonic_t;\n"
+  "\n"
+  "stream {\n"
+  "  id = 0;\n"
+  "  packet.context := struct {\n"
+  "    uint64_clock_monotonic_t timestamp_begin;\n"
+  "    uint64_clock_monotonic_t timestamp_end;\n"
+  "    uint64_t content_size;\n"
+  "    uint64_t packet_size;\n"
+  "    uint64_t events_discarded;\n"
+  "    uint32_t cpu_id;\n"
+  "  };\n"
+  "  event.header := struct {\n"
+  "    uint16_t id;\n"
+  "    uint64_clock_monotonic_t timestamp;\n"
+  "  };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"sched_switch\"; id = 0; stream_id = 0;\n"
+  "  fields := struct {\n"
+  "    string prev_comm; int32_t prev_tid; int32_t prev_prio;\n"
+  "    int64_t prev_state;\n"
+  "    string next_comm; int32_t next_tid; int32_t next_prio;\n"
+  "  };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"sched_wakeup_new\"; id = 1; stream_id = 0;\n"
+  "  fields := struct {\n"
+  "    string comm; int32_t tid; int32_t prio; int32_t target_cpu;\n"
+  "  };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"sched_waking\"; id = 2; stream_id = 0;\n"
+  "  fields := struct {\n"
+  "    string comm; int32_t tid; int32_t prio; int32_t target_cpu;\n"
+  "  };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"sched_process_exit\"; id = 3; stream_id = 0;\n"
+  "  fields := struct {\n"
+  "    string comm; int32_t tid; int32_t prio;\n"
+  "  };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"irq_handler_entry\"; id = 4; stream_id = 0;\n"
+  "  fields := struct { int32_t irq; string name; };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"irq_handler_exit\"; id = 5; stream_id = 0;\n"
+  "  fields := struct { int32_t irq; int32_t ret; };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"print\"; id = 6; stream_id = 0;\n"
+  "  fields := struct { uint64_hex_t ip; string buf; };\n"
+  "};\n"
+  "\n"
+  "event {\n"
+  "  name = \"binary\"; id = 7; stream_id = 0;\n"
+  "  fields := struct {\n"
+  "    uint64_hex_t ip; uint8_t event; uint8_t len; uint8_t data[len];\n"
+  "  };\n"
+  "};\n";
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: trace_ctf_sigint
+ ****************************************************************************/
+
+static void trace_ctf_sigint(int signo)
+{
+  g_trace_ctf_stop = true;
+}
+
+/****************************************************************************
+ * Name: trace_ctf_unflatten
+ ****************************************************************************/
+
+static void trace_ctf_unflatten(FAR void *dst,
+                                FAR const uint8_t *src, size_t len)
+{
+#ifdef CONFIG_ENDIAN_BIG
+  FAR uint8_t *end = (FAR uint8_t *)dst + len - 1;
+  while (len-- > 0)
+    {
+      *end-- = *src++;
+    }
+#else
+  memcpy(dst, src, len);
+#endif
+}
+
+/****************************************************************************
+ * Name: trace_ctf_task
+ ****************************************************************************/
+
+static FAR struct trace_ctf_task_s *
+trace_ctf_task(FAR struct trace_ctf_s *ctf, pid_t pid)
+{
+  FAR struct trace_ctf_task_s **tctxp = &ctf->task;
+
+  while (*tctxp != NULL)
+    {
+      if ((*tctxp)->pid == pid)
+        {
+          return *tctxp;
+        }
+
+      tctxp = &((*tctxp)->next);
+    }
+
+  *tctxp = calloc(1, sizeof(struct trace_ctf_task_s));
+  if (*tctxp != NULL)
+    {
+      (*tctxp)->pid = pid;
+
+#ifdef NOTERAM_GETTASKNAME
+        {
+          struct noteram_get_taskname_s tnm;
+
+          tnm.pid = pid;
+          if (ioctl(ctf->notefd, NOTERAM_GETTASKNAME,
+                    (unsigned long)&tnm) == 0)
+            {
+              strlcpy((*tctxp)->name, tnm.taskname,
+                      sizeof((*tctxp)->name));
+            }
+        }
+#endif
+    }
+
+  return *tctxp;
+}
+
+/****************************************************************************
+ * Name: trace_ctf_task_name
+ ****************************************************************************/
+
+static FAR const char *trace_ctf_task_name(FAR struct trace_ctf_s *ctf,
+                                           pid_t pid)
+{
+  FAR struct trace_ctf_task_s *tctx = trace_ctf_task(ctf, pid);
+
+  if (tctx != NULL && tctx->name[0] != '\0')
+    {
+      return tctx->name;
+    }
+
+  return "<noname>";
+}
+
+/****************************************************************************
+ * Name: trace_ctf_put
+ ****************************************************************************/
+
+static void trace_ctf_put(FAR struct trace_ctf_s *ctf,
+                          FAR const void *data, size_t len)
+{
+  len = MIN(len, sizeof(ctf->event) - ctf->evlen);
+  memcpy(ctf->event + ctf->evlen, data, len);
+  ctf->evlen += len;
+}
+
+static void trace_ctf_put_u8(FAR struct trace_ctf_s *ctf, uint8_t val)
+{
+  trace_ctf_put(ctf, &val, sizeof(val));
+}
+
+static void trace_ctf_put_i32(FAR struct trace_ctf_s *ctf, int32_t val)
+{
+  trace_ctf_put(ctf, &val, sizeof(val));
+}
+
+static void trace_ctf_put_u64(FAR struct trace_ctf_s *ctf, uint64_t val)
+{
+  trace_ctf_put(ctf, &val, sizeof(val));
+}
+
+static void trace_ctf_put_str(FAR struct trace_ctf_s *ctf,
+                              FAR const char *str)
+{
+  size_t len = strnlen(str, sizeof(ctf->event) / 2);
+
+  /* Always keep the terminator, even if the string is truncated */
+
+  if (ctf->evlen + len + 1 > sizeof(ctf->event))
+    {
+      len = sizeof(ctf->event) - ctf->evlen - 1;
+    }
+
+  trace_ctf_put(ctf, str, len);
+  trace_ctf_put_u8(ctf, '\0');
+}
+
+/****************************************************************************
+ * Name: trace_ctf_flush
+ *
+ * Description:
+ *   Complete the packet of one CPU and pass it to the output.
+ *
+ ****************************************************************************/
+
+static int trace_ctf_flush(FAR struct trace_ctf_s *ctf, int cpu)
+{
+  FAR struct trace_ctf_cpu_s *cctx = &ctf->cpu[cpu];
+  FAR uint8_t *p = cctx->packet;
+  uint32_t val32;
+  uint64_t val64;
+  int ret;
+
+  if (cctx->len <= CTF_PACKET_HDRLEN)
+    {
+      return OK;
+    }
+
+  val32 = CTF_MAGIC;
+  memcpy(p, &val32, 4);
+  val32 = 0;
+  memcpy(p + 4, &val32, 4);
+  memcpy(p + 8, &cctx->ts_begin, 8);
+  memcpy(p + 16, &cctx->ts_end, 8);
+  val64 = cctx->len * 8;
+  memcpy(p + 24, &val64, 8);
+  memcpy(p + 32, &val64, 8);
+  memcpy(p + 40, &cctx->discarded, 8);
+  val32 = cpu;
+  memcpy(p + 48, &val32, 4);
+
+  ret = ctf->write(ctf->priv, cpu, p, cctx->len);
+  if (ret == TRACE_CTF_DROPPED)
+    {
+      /* Reported as discarded by the following packets of the CPU */
+
+      cctx->discarded += cctx->nevents;
+      ret = OK;
+    }
+
+  cctx->nevents = 0;
+  cctx->len = 0;
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: trace_ctf_emit
+ *
+ * Description:
+ *   Append the event built in ctf->event to the packet of the CPU.
+ *
+ ****************************************************************************/
+
+static int trace_ctf_emit(FAR struct trace_ctf_s *ctf, int cpu,
+                          uint16_t id, uint64_t ts)
+{
+  FAR struct trace_ctf_cpu_s *cctx = &ctf->cpu[cpu];
+  int ret;
+
+  if (cctx->len + CTF_EVENT_HDRLEN + ctf->evlen > ctf->pktsize)
+    {
+      ret = trace_ctf_flush(ctf, cpu);
+      if (ret < 0)
+        {
+          return ret;
+        }
+    }
+
+  if (cctx->len == 0)
+    {
+      cctx->len = CTF_PACKET_HDRLEN;
+      cctx->ts_begin = ts;
+    }
+
+  memcpy(cctx->packet + cctx->len, &id, 2);
+  memcpy(cctx->packet + cctx->len + 2, &ts, 8);
+  memcpy(cctx->packet + cctx->len + CTF_EVENT_HDRLEN, ctf->event,
+         ctf->evlen);
+  cctx->len += CTF_EVENT_HDRLEN + ctf->evlen;
+  cctx->ts_end = ts;
+  cctx->nevents++;
+
+  ctf->evlen = 0;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: trace_ctf_sched_switch
+ ****************************************************************************/
+
+#if defined(CONFIG_SCHED_INSTRUMENTATION_SWITCH) || \
+    defined(CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER)
+static int trace_ctf_sched_switch(FAR struct trace_ctf_s *ctf, int cpu,
+                                  uint64_t ts)
+{
+  FAR struct trace_ctf_cpu_s *cctx = &ctf->cpu[cpu];
+
+  /* Linux task state: 0 running, 1 interruptible, 64 dead */
+
+  trace_ctf_put_str(ctf, trace_ctf_task_name(ctf, cctx->current_pid));
+  trace_ctf_put_i32(ctf, get_pid(cctx->current_pid));
+  trace_ctf_put_i32(ctf, cctx->current_priority);
+  trace_ctf_put_u64(ctf, cctx->current_state == 0 ? 64 :
+                    cctx->current_state <= LAST_READY_TO_RUN_STATE ? 0 : 1);
+  trace_ctf_put_str(ctf, trace_ctf_task_name(ctf, cctx->next_pid));
+  trace_ctf_put_i32(ctf, get_pid(cctx->next_pid));
+  trace_ctf_put_i32(ctf, cctx->next_priority);
+
+  cctx->current_pid = cctx->next_pid;
+  cctx->current_priority = cctx->next_priority;
+  cctx->current_state = TSTATE_TASK_RUNNING;
+  cctx->pendingswitch = false;
+
+  return trace_ctf_emit(ctf, cpu, CTF_EVENT_SCHED_SWITCH, ts);
+}
+#endif
+
+/****************************************************************************
+ * Name: trace_ctf_one
+ *
+ * Description:
+ *   Convert one note into CTF events, like trace_dump_one() does for the
+ *   text formats.
+ *
+ ****************************************************************************/
+
+static int trace_ctf_one(FAR struct trace_ctf_s *ctf, FAR uint8_t *p)
+{
+  FAR struct note_common_s *note = (FAR struct note_common_s *)p;
+  FAR struct trace_ctf_cpu_s *cctx;
+  uint32_t nsec;
+  uint32_t sec;
+  uint64_t ts;
+  pid_t pid;
+  int ret = OK;
+#ifdef CONFIG_SMP
+  int cpu = note->nc_cpu;
+#else
+  int cpu = 0;
+#endif
+
+  cctx = &ctf->cpu[cpu];
+  trace_ctf_unflatten(&pid, note->nc_pid, sizeof(pid));
+  trace_ctf_unflatten(&nsec, note->nc_systime_nsec, sizeof(nsec));
+  trace_ctf_unflatten(&sec, note->nc_systime_sec, sizeof(sec));
+  ts = (uint64_t)sec * NSEC_PER_SEC + nsec;
+
+  if (cctx->current_pid < 0)
+    {
+      cctx->current_pid = pid;
+    }
+
+  switch (note->nc_type)
+    {
+      case NOTE_START:
+        {
+#if CONFIG_TASK_NAME_SIZE > 0
+          FAR struct note_start_s *nst = (FAR struct note_start_s *)p;
+          FAR struct trace_ctf_task_s *tctx;
+
+          tctx = trace_ctf_task(ctf, pid);
+          if (tctx != NULL)
+            {
+              strlcpy(tctx->name, nst->nst_name, sizeof(tctx->name));
+            }
+#endif
+
+          trace_ctf_put_str(ctf, trace_ctf_task_name(ctf, pid));
+          trace_ctf_put_i32(ctf, get_pid(pid));
+          trace_ctf_put_i32(ctf, note->nc_priority);
+          trace_ctf_put_i32(ctf, cpu);
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_SCHED_WAKEUP_NEW, ts);
+        }
+        break;
+
+      case NOTE_STOP:
+        {
+          trace_ctf_put_str(ctf, trace_ctf_task_name(ctf, pid));
+          trace_ctf_put_i32(ctf, get_pid(pid));
+          trace_ctf_put_i32(ctf, note->nc_priority);
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_SCHED_EXIT, ts);
+
+          cctx->current_state = 0;
+        }
+        break;
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SWITCH
+      case NOTE_SUSPEND:
+        {
+          FAR struct note_suspend_s *nsu = (FAR struct note_suspend_s *)p;
+
+          cctx->current_state = nsu->nsu_state;
+        }
+        break;
+
+      case NOTE_RESUME:
+        {
+          cctx->next_pid = pid;
+          cctx->next_priority = note->nc_priority;
+
+          if (cctx->intr_nest == 0)
+            {
+              ret = trace_ctf_sched_switch(ctf, cpu, ts);
+            }
+          else
+            {
+              /* The switch happens when leaving the interrupt handler */
+
+              trace_ctf_put_str(ctf, trace_ctf_task_name(ctf, pid));
+              trace_ctf_put_i32(ctf, get_pid(pid));
+              trace_ctf_put_i32(ctf, note->nc_priority);
+              trace_ctf_put_i32(ctf, cpu);
+              ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_SCHED_WAKING, ts);
+              cctx->pendingswitch = true;
+            }
+        }
+        break;
+#endif
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SYSCALL
+      case NOTE_SYSCALL_ENTER:
+        {
+          FAR struct note_syscall_enter_s *nsc;
+          FAR struct trace_ctf_task_s *tctx;
+          uintptr_t arg;
+          int i;
+
+          /* Skip syscalls from interrupt handlers and nested syscalls */
+
+          tctx = trace_ctf_task(ctf, pid);
+          if (cctx->intr_nest > 0 || tctx == NULL ||
+              ++tctx->syscall_nest > 1)
+            {
+              break;
+            }
+
+          nsc = (FAR struct note_syscall_enter_s *)p;
+          if (nsc->nsc_nr < CONFIG_SYS_RESERVED ||
+              nsc->nsc_nr >= SYS_maxsyscall)
+            {
+              break;
+            }
+
+          trace_ctf_put_u8(ctf, nsc->nsc_argc);
+          for (i = 0; i < nsc->nsc_argc; i++)
+            {
+              trace_ctf_unflatten(&arg, nsc->nsc_args + i * sizeof(arg),
+                                  sizeof(arg));
+              trace_ctf_put_u64(ctf, arg);
+            }
+
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_SYSCALL +
+                               2 * (nsc->nsc_nr - CONFIG_SYS_RESERVED), ts);
+        }
+        break;
+
+      case NOTE_SYSCALL_LEAVE:
+        {
+          FAR struct note_syscall_leave_s *nsc;
+          FAR struct trace_ctf_task_s *tctx;
+          uintptr_t result;
+
+          tctx = trace_ctf_task(ctf, pid);
+          if (cctx->intr_nest > 0 || tctx == NULL ||
+              --tctx->syscall_nest > 0)
+            {
+              break;
+            }
+
+          tctx->syscall_nest = 0;
+
+          nsc = (FAR struct note_syscall_leave_s *)p;
+          if (nsc->nsc_nr < CONFIG_SYS_RESERVED ||
+              nsc->nsc_nr >= SYS_maxsyscall)
+            {
+              break;
+            }
+
+          trace_ctf_unflatten(&result, nsc->nsc_result, sizeof(result));
+          trace_ctf_put_u64(ctf, (int64_t)(intptr_t)result);
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_SYSCALL + 1 +
+                               2 * (nsc->nsc_nr - CONFIG_SYS_RESERVED), ts);
+        }
+        break;
+#endif
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER
+      case NOTE_IRQ_ENTER:
+        {
+          FAR struct note_irqhandler_s *nih;
+          char name[16];
+
+          nih = (FAR struct note_irqhandler_s *)p;
+          snprintf(name, sizeof(name), "%d", nih->nih_irq);
+          trace_ctf_put_i32(ctf, nih->nih_irq);
+          trace_ctf_put_str(ctf, name);
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_IRQ_ENTRY, ts);
+          cctx->intr_nest++;
+        }
+        break;
+
+      case NOTE_IRQ_LEAVE:
+        {
+          FAR struct note_irqhandler_s *nih;
+
+          nih = (FAR struct note_irqhandler_s *)p;
+          trace_ctf_put_i32(ctf, nih->nih_irq);
+          trace_ctf_put_i32(ctf, 1);
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_IRQ_EXIT, ts);
+
+          if (--cctx->intr_nest <= 0)
+            {
+              cctx->intr_nest = 0;
+              if (ret >= 0 && cctx->pendingswitch)
+                {
+                  ret = trace_ctf_sched_switch(ctf, cpu, ts);
+                }
+            }
+        }
+        break;
+#endif
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_DUMP
+      case NOTE_DUMP_STRING:
+        {
+          FAR struct note_string_s *nst;
+          uintptr_t ip;
+
+          nst = (FAR struct note_string_s *)p;
+          trace_ctf_unflatten(&ip, nst->nst_ip, sizeof(ip));
+          trace_ctf_put_u64(ctf, ip);
+          trace_ctf_put_str(ctf, nst->nst_data);
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_PRINT, ts);
+        }
+        break;
+
+      case NOTE_DUMP_BINARY:
+        {
+          FAR struct note_binary_s *nbi;
+          uint8_t count;
+          uintptr_t ip;
+
+          nbi = (FAR struct note_binary_s *)p;
+          count = note->nc_length - sizeof(struct note_binary_s) + 1;
+          trace_ctf_unflatten(&ip, nbi->nbi_ip, sizeof(ip));
+          trace_ctf_put_u64(ctf, ip);
+          trace_ctf_put_u8(ctf, nbi->nbi_event);
+          trace_ctf_put_u8(ctf, count);
+          trace_ctf_put(ctf, nbi->nbi_data, count);
+          ret = trace_ctf_emit(ctf, cpu, CTF_EVENT_BINARY, ts);
+        }
+        break;
+#endif
+
+      default:
+        break;
+    }
+
+  ctf->evlen = 0;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: trace_ctf_overrun
+ *
+ * Description:
+ *   Check whether the note buffer dropped notes since the last check.
+ *   The noteram driver only flags an overflow; it counts neither the
+ *   notes it dropped nor their CPUs.  Each overrun is therefore reported
+ *   as one discarded event on every CPU stream, after the packets that
+ *   hold the notes read so far, so that trace viewers flag the gap.
+ *
+ ****************************************************************************/
+
+static int trace_ctf_overrun(FAR struct trace_ctf_s *ctf)
+{
+#ifdef NOTERAM_MODE_OVERWRITE_OVERFLOW
+  unsigned int mode;
+  int ret = OK;
+  int cpu;
+
+  if (ioctl(ctf->notefd, NOTERAM_GETMODE, (unsigned long)&mode) < 0 ||
+      mode != NOTERAM_MODE_OVERWRITE_OVERFLOW)
+    {
+      return OK;
+    }
+
+  /* Re-arm the overflow flag */
+
+  mode = NOTERAM_MODE_OVERWRITE_DISABLE;
+  ioctl(ctf->notefd, NOTERAM_SETMODE, (unsigned long)&mode);
+  ctf->overruns++;
+
+  for (cpu = 0; ret >= 0 && cpu < NCPUS; cpu++)
+    {
+      ret = trace_ctf_flush(ctf, cpu);
+      ctf->cpu[cpu].discarded++;
+    }
+
+  return ret;
+#else
+  return OK;
+#endif
+}
+
+/****************************************************************************
+ * Name: trace_ctf_metadata
+ *
+ * Description:
+ *   Write the metadata stream: the fixed definitions and one entry/exit
+ *   event pair for each syscall.
+ *
+ ****************************************************************************/
+
+static int trace_ctf_metadata(FAR struct trace_ctf_s *ctf)
+{
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SYSCALL
+  char buf[192];
+  int len;
+  int i;
+#endif
+  int ret;
+
+  ret = ctf->write(ctf->priv, TRACE_CTF_METADATA, g_trace_ctf_metadata,
+                   sizeof(g_trace_ctf_metadata) - 1);
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SYSCALL
+  for (i = 0; ret == OK && i < SYS_nsyscalls; i++)
+    {
+      len = snprintf(buf, sizeof(buf),
+                     "\nevent {\n"
+                     "  name = \"syscall_entry_%s\"; id = %d;"
+                     " stream_id = 0;\n"
+                     "  fields := struct {"
+                     " uint8_t argc; uint64_hex_t args[argc]; };\n"
+                     "};\n",
+                     g_funcnames[i], CTF_EVENT_SYSCALL + 2 * i);
+      ret = ctf->write(ctf->priv, TRACE_CTF_METADATA, buf, len);
+      if (ret != OK)
+        {
+          break;
+        }
+
+      len = snprintf(buf, sizeof(buf),
+                     "\nevent {\n"
+                     "  name = \"syscall_exit_%s\"; id = %d;"
+                     " stream_id = 0;\n"
+                     "  fields := struct { int64_t ret; };\n"
+                     "};\n",
+                     g_funcnames[i], CTF_EVENT_SYSCALL + 2 * i + 1);
+      ret = ctf->write(ctf->priv, TRACE_CTF_METADATA, buf, len);
+    }
+#endif
+
+  /* The trace cannot be decoded without the whole metadata */
+
+  return ret == TRACE_CTF_DROPPED ? -ENOBUFS : ret;
+}
+
+/****************************************************************************
+ * Name: trace_ctf_dir_write
+ ****************************************************************************/
+
+static int trace_ctf_dir_write(FAR void *priv, int channel,
+                               FAR const void *buf, size_t len)
+{
+  FAR struct trace_ctf_dir_s *dir = priv;
+  int fd = channel == TRACE_CTF_METADATA ? dir->metafd : dir->fd[channel];
+  FAR const uint8_t *p = buf;
+  ssize_t ret;
+
+  while (len > 0)
+    {
+      ret = write(fd, p, len);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+
+          return -errno;
+        }
+
+      p += ret;
+      len -= ret;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: trace_ctf_export
+ *
+ * Description:
+ *   Drain the notes continuously and pass them to the output as CTF.
+ *
+ ****************************************************************************/
+
+int trace_ctf_export(trace_ctf_write_t write, FAR void *priv,
+                     size_t pktsize, int duration)
+{
+  FAR struct trace_ctf_s *ctf;
+  FAR struct trace_ctf_task_s *tctx;
+  struct timespec start;
+  struct timespec now;
+  FAR uint8_t *buf;
+  FAR uint8_t *p;
+#ifdef NOTERAM_MODE_OVERWRITE_OVERFLOW
+  unsigned int mode;
+#endif
+  int size;
+  int err = OK;
+  int ret;
+  int cpu;
+
+  if (pktsize < CTF_PACKET_MINSIZE)
+    {
+      fprintf(stderr, "trace: packet size %zu below %d\n",
+              pktsize, CTF_PACKET_MINSIZE);
+      return -EINVAL;
+    }
+
+  ctf = calloc(1, sizeof(*ctf));
+  buf = malloc(CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE);
+  if (ctf == NULL || buf == NULL)
+    {
+      fprintf(stderr, "trace: no memory\n");
+      free(ctf);
+      free(buf);
+      return -ENOMEM;
+    }
+
+  ctf->write = write;
+  ctf->priv = priv;
+  ctf->pktsize = MIN(pktsize, CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE);
+  for (cpu = 0; cpu < NCPUS; cpu++)
+    {
+      ctf->cpu[cpu].current_state = TSTATE_TASK_RUNNING;
+      ctf->cpu[cpu].current_pid = -1;
+      ctf->cpu[cpu].next_pid = -1;
+    }
+
+  ctf->notefd = open("/dev/note/ram", O_RDONLY);
+  if (ctf->notefd < 0)
+    {
+      ret = -errno;
+      fprintf(stderr, "trace: cannot open /dev/note/ram\n");
+      goto errout;
+    }
+
+  ret = trace_ctf_metadata(ctf);
+  if (ret < 0)
+    {
+      goto errout_with_fd;
+    }
+
+#ifdef NOTERAM_MODE_OVERWRITE_OVERFLOW
+  /* Notes overwritten in the ring are lost without a trace, while the
+   * overflow of a ring that is not overwritten is flagged.
+   */
+
+  ctf->owmode = NOTERAM_MODE_OVERWRITE_DISABLE;
+  ioctl(ctf->notefd, NOTERAM_GETMODE, (unsigned long)&ctf->owmode);
+  mode = NOTERAM_MODE_OVERWRITE_DISABLE;
+  ioctl(ctf->notefd, NOTERAM_SETMODE, (unsigned long)&mode);
+#endif
+
+  g_trace_ctf_stop = false;
+  signal(SIGINT, trace_ctf_sigint);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (!g_trace_ctf_stop)
+    {
+      ret = read(ctf->notefd, buf, CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE);
+      if (ret < 0)
+        {
+          ret = -errno;
+          break;
+        }
+
+      if (ret == 0)
+        {
+          /* Drained, hand out the partial packets and wait for more */
+
+          for (cpu = 0; ret >= 0 && cpu < NCPUS; cpu++)
+            {
+              ret = trace_ctf_flush(ctf, cpu);
+            }
+
+          if (ret < 0)
+            {
+              break;
+            }
+
+          clock_gettime(CLOCK_MONOTONIC, &now);
+          if (duration > 0 && now.tv_sec - start.tv_sec >= duration)
+            {
+              break;
+            }
+
+          usleep(CTF_POLL_INTERVAL);
+          continue;
+        }
+
+      p = buf;
+      while (ret > 0)
+        {
+          size = ((FAR struct note_common_s *)p)->nc_length;
+          if (size <= 0 || size > ret)
+            {
+              break;
+            }
+
+          err = trace_ctf_one(ctf, p);
+          if (err < 0)
+            {
+              break;
+            }
+
+          p += size;
+          ret -= size;
+        }
+
+      /* A failed write truncates the trace, report it to the caller */
+
+      if (err < 0)
+        {
+          ret = err;
+          break;
+        }
+
+      ret = trace_ctf_overrun(ctf);
+      if (ret < 0)
+        {
+          break;
+        }
+    }
+
+  signal(SIGINT, SIG_DFL);
+
+#ifdef NOTERAM_MODE_OVERWRITE_OVERFLOW
+  if (ctf->owmode == NOTERAM_MODE_OVERWRITE_OVERFLOW)
+    {
+      ctf->owmode = NOTERAM_MODE_OVERWRITE_DISABLE;
+    }
+
+  ioctl(ctf->notefd, NOTERAM_SETMODE, (unsigned long)&ctf->owmode);
+#endif
+
+  if (ctf->overruns > 0)
+    {
+      fprintf(stderr, "trace: the note buffer overflowed %" PRIu32
+              " times, notes were lost\n", ctf->overruns);
+    }
+
+  for (cpu = 0; cpu < NCPUS; cpu++)
+    {
+      err = trace_ctf_flush(ctf, cpu);
+      if (err < 0 && ret >= 0)
+        {
+          ret = err;
+        }
+    }
+
+errout_with_fd:
+  close(ctf->notefd);
+
+errout:
+  while ((tctx = ctf->task) != NULL)
+    {
+      ctf->task = tctx->next;
+      free(tctx);
+    }
+
+  free(ctf);
+  free(buf);
+  return ret < 0 ? ret : OK;
+}
+
+/****************************************************************************
+ * Name: trace_ctf_export_dir
+ *
+ * Description:
+ *   Export the notes to a CTF trace directory, with the "metadata" file
+ *   and one "channel0_<cpu>" stream file for each CPU.
+ *
+ ****************************************************************************/
+
+int trace_ctf_export_dir(FAR const char *path, int duration)
+{
+  struct trace_ctf_dir_s dir;
+  char name[PATH_MAX];
+  int ret = OK;
+  int cpu;
+
+  if (mkdir(path, 0777) < 0 && errno != EEXIST)
+    {
+      ret = -errno;
+      fprintf(stderr, "trace: cannot create '%s'\n", path);
+      return ret;
+    }
+
+  snprintf(name, sizeof(name), "%s/metadata", path);
+  dir.metafd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (dir.metafd < 0)
+    {
+      ret = -errno;
+      fprintf(stderr, "trace: cannot open '%s'\n", name);
+      return ret;
+    }
+
+  for (cpu = 0; cpu < NCPUS; cpu++)
+    {
+      snprintf(name, sizeof(name), "%s/channel0_%d", path, cpu);
+      dir.fd[cpu] = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (dir.fd[cpu] < 0)
+        {
+          ret = -errno;
+          fprintf(stderr, "trace: cannot open '%s'\n", name);
+          break;
+        }
+    }
+
+  if (ret == OK)
+    {
+      ret = trace_ctf_export(trace_ctf_dir_write, &dir,
+                             CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE, duration);
+    }
+
+  while (cpu-- > 0)
+    {
+      close(dir.fd[cpu]);
+    }
+
+  close(dir.metafd);
+  return ret;
+}
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+# apps/system/trace/trace_recv.py
+#
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.  The
+# ASF licenses this file to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance with the
+# License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+# WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+# License for the specific language governing permissions and limitations
+# under the License.
+#
+
+"""Receive the trace sent by "trace stream" and write a CTF directory.
+
+  On the host:   ./trace_recv.py [-u] [-p 5471] trace_out
+  On the target: trace stream [-u] <host ip>:5471
+
+The output can be opened with babeltrace or Trace Compass.
+"""
+
+import argparse
+import os
+import socket
+import struct
+import sys
+
+STREAM_MAGIC = 0x4E585453  # "NXTS"
+STREAM_HDR = struct.Struct("!IiII")
+STREAM_END = -2
+METADATA = -1
+
+CTF_MAGIC = 0xC1FC1FC1
+
+
+class Collector:
+    def __init__(self, path):
+        self.path = path
+        self.files = {}
+        self.nextseq = 0
+        self.lastchannel = None
+        self.frames = 0
+        self.lost = 0
+        self.late = 0
+        self.discarded = {}
+        os.makedirs(path, exist_ok=True)
+
+    def file(self, channel):
+        if channel not in self.files:
+            if channel == METADATA:
+                name = "metadata"
+            else:
+                name = "channel0_%d" % channel
+            self.files[channel] = open(os.path.join(self.path, name), "wb")
+        return self.files[channel]
+
+    def packet(self, channel, data):
+        # events_discarded is the last field before cpu_id in the packet
+        # context, and is cumulative for each CPU
+
+        if len(data) < 52:
+            return
+        order = "<" if struct.unpack_from("<I", data)[0] == CTF_MAGIC else ">"
+        (discarded,) = struct.unpack_from(order + "Q", data, 40)
+        self.discarded[channel] = discarded
+
+    def frame(self, channel, seq, data):
+        """Handle one frame, return False at the end of the stream."""
+
+        gap = (seq - self.nextseq) & 0xFFFFFFFF
+        if gap >= 0x80000000:
+            # A datagram that arrived after a later one, its place was
+            # already counted as lost
+            self.late += 1
+            return True
+
+        if gap > 0:
+            # The metadata is sent first and in order, a gap next to it
+            # means a chunk of it may be missing
+            if self.frames == 0:
+                sys.exit("error: the start of the stream was lost")
+            if self.lastchannel == METADATA:
+                if channel == METADATA:
+                    sys.exit("error: a metadata frame was lost")
+                print("warning: frames lost after the metadata, it may be cut")
+            self.lost += gap
+
+        self.nextseq = (seq + 1) & 0xFFFFFFFF
+        self.lastchannel = channel
+        self.frames += 1
+
+        if channel == STREAM_END:
+            return False
+        if channel != METADATA:
+            self.packet(channel, data)
+        self.file(channel).write(data)
+        return True
+
+    def close(self):
+        for f in self.files.values():
+            f.close()
+        print(
+            "%d frames, %d lost, %d late, %d events discarded on the target"
+            % (self.frames, self.lost, self.late, sum(self.discarded.values()))
+        )
+        if METADATA not in self.files:
+            print("warning: the metadata was lost")
+
+
+def recv_exact(conn, size):
+    buf = b""
+    while len(buf) < size:
+        chunk = conn.recv(size - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return buf
+
+
+def recv_tcp(args, collector):
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind((args.address, args.port))
+    srv.listen(1)
+    print("listening on tcp %s:%d" % (args.address, args.port))
+    conn, peer = srv.accept()
+    print("connected from %s:%d" % peer)
+
+    while True:
+        hdr = recv_exact(conn, STREAM_HDR.size)
+        if hdr is None:
+            break
+        magic, channel, seq, length = STREAM_HDR.unpack(hdr)
+        if magic != STREAM_MAGIC:
+            sys.exit("error: bad frame magic 0x%08x" % magic)
+        data = recv_exact(conn, length) if length > 0 else b""
+        if data is None or not collector.frame(channel, seq, data):
+            break
+
+    conn.close()
+    srv.close()
+
+
+def recv_udp(args, collector):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+    sock.bind((args.address, args.port))
+    print("listening on udp %s:%d" % (args.address, args.port))
+
+    while True:
+        frame = sock.recv(65536)
+        if len(frame) < STREAM_HDR.size:
+            continue
+        magic, channel, seq, length = STREAM_HDR.unpack_from(frame)
+        if magic != STREAM_MAGIC:
+            continue
+        data = frame[STREAM_HDR.size : STREAM_HDR.size + length]
+        if not collector.frame(channel, seq, data):
+            break
+
+    sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("output", help="CTF trace directory to write")
+    parser.add_argument("-u", "--udp", action="store_true", help="use UDP")
+    parser.add_argument("-a", "--address", default="0.0.0.0")
+    parser.add_argument("-p", "--port", type=int, default=5471)
+    args = parser.parse_args()
+
+    collector = Collector(args.output)
+    try:
+        if args.udp:
+            recv_udp(args, collector)
+        else:
+            recv_tcp(args, collector)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        collector.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,347 @@
+/****************************************************************************
+ * apps/system/trace/trace_stream.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef CONFIG_NET_UDP
+#  include <nuttx/net/netconfig.h>
+#endif
+
+#include "trace.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Every frame starts with a header in network byte order:
+ *
+ *   uint32 magic, int32 channel, uint32 sequence, uint32 length
+ *
+ * followed by length bytes of metadata text or of a CTF packet.  The
+ * sequence number lets the receiver detect frames lost over UDP.
+ */
+
+#define TRACE_STREAM_MAGIC    0x4e585453  /* "NXTS" */
+#define TRACE_STREAM_HDRLEN   16
+
+/* Channel of the frame sent when the stream ends */
+
+#define TRACE_STREAM_END      (-2)
+
+/* A UDP frame must fit in one datagram, IP fragments of a large frame
+ * would be lost together and are not sent by every network driver.
+ */
+
+#ifdef CONFIG_NET_UDP
+#  define TRACE_STREAM_UDPLEN (MIN_UDP_MSS - TRACE_STREAM_HDRLEN)
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct trace_stream_s
+{
+  int sd;
+  bool udp;
+  int duration;
+  int result;
+  size_t maxlen;                /* Largest frame payload */
+
+  /* Statistics */
+
+  uint32_t seq;
+  uint32_t dropped;
+  uint64_t bytes;
+
+  uint8_t frame[TRACE_STREAM_HDRLEN + CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE];
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: trace_stream_send
+ *
+ * Description:
+ *   Send one frame.  Over UDP a packet frame that the network cannot take
+ *   right now is dropped instead of stalling the drainer.  The metadata
+ *   and the end of the stream are always sent, since the trace cannot be
+ *   decoded without them.
+ *
+ ****************************************************************************/
+
+static int trace_stream_send(FAR struct trace_stream_s *stream,
+                             int channel, FAR const void *buf, size_t len)
+{
+  FAR uint8_t *p = stream->frame;
+  uint32_t val;
+  ssize_t ret;
+
+  val = htonl(TRACE_STREAM_MAGIC);
+  memcpy(p, &val, 4);
+  val = htonl((uint32_t)channel);
+  memcpy(p + 4, &val, 4);
+  val = htonl(stream->seq++);
+  memcpy(p + 8, &val, 4);
+  val = htonl(len);
+  memcpy(p + 12, &val, 4);
+  if (len > 0)
+    {
+      memcpy(p + TRACE_STREAM_HDRLEN, buf, len);
+    }
+
+  len += TRACE_STREAM_HDRLEN;
+
+  if (stream->udp)
+    {
+      ret = send(stream->sd, p, len, channel >= 0 ? MSG_DONTWAIT : 0);
+      if (ret < 0)
+        {
+          if (channel >= 0 &&
+              (errno == EAGAIN || errno == ENOMEM || errno == ENOBUFS))
+            {
+              stream->dropped++;
+              return TRACE_CTF_DROPPED;
+            }
+
+          return -errno;
+        }
+
+      stream->bytes += len;
+      return OK;
+    }
+
+  while (len > 0)
+    {
+      ret = send(stream->sd, p, len, 0);
+      if (ret < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+
+          return -errno;
+        }
+
+      stream->bytes += ret;
+      p += ret;
+      len -= ret;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: trace_stream_write
+ ****************************************************************************/
+
+static int trace_stream_write(FAR void *priv, int channel,
+                              FAR const void *buf, size_t len)
+{
+  FAR struct trace_stream_s *stream = priv;
+  FAR const uint8_t *p = buf;
+  size_t chunk;
+  int ret = OK;
+
+  /* The metadata is larger than a packet, split it */
+
+  while (len > 0)
+    {
+      chunk = MIN(len, stream->maxlen);
+      ret = trace_stream_send(stream, channel, p, chunk);
+      if (ret < 0)
+        {
+          fprintf(stderr, "trace stream: send failed: %d\n", ret);
+          break;
+        }
+
+      p += chunk;
+      len -= chunk;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: trace_stream_drainer
+ *
+ * Description:
+ *   The drainer thread, it runs at a low priority so that streaming
+ *   disturbs the traced system as little as possible.
+ *
+ ****************************************************************************/
+
+static FAR void *trace_stream_drainer(FAR void *arg)
+{
+  FAR struct trace_stream_s *stream = arg;
+
+  stream->result = trace_ctf_export(trace_stream_write, stream,
+                                    stream->maxlen, stream->duration);
+  trace_stream_send(stream, TRACE_STREAM_END, NULL, 0);
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: trace_stream_connect
+ ****************************************************************************/
+
+static int trace_stream_connect(FAR const char *dest, bool udp)
+{
+  struct sockaddr_in addr;
+  char host[INET_ADDRSTRLEN];
+  FAR const char *port;
+  int ret;
+  int sd;
+
+  /* Usage: <ipaddr>:<port> */
+
+  port = strrchr(dest, ':');
+  if (port == NULL || port == dest ||
+      port - dest >= sizeof(host) || atoi(port + 1) <= 0)
+    {
+      fprintf(stderr, "trace stream: invalid address '%s'\n", dest);
+      return -EINVAL;
+    }
+
+  memset(&addr, 0, sizeof(addr));
+  strlcpy(host, dest, port - dest + 1);
+  addr.sin_family = AF_INET;
+  addr.sin_port   = htons(atoi(port + 1));
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+      fprintf(stderr, "trace stream: invalid address '%s'\n", dest);
+      return -EINVAL;
+    }
+
+  sd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+  if (sd < 0)
+    {
+      ret = -errno;
+      fprintf(stderr, "trace stream: socket failed: %d\n", ret);
+      return ret;
+    }
+
+  /* A connected UDP socket only needs send() */
+
+  if (connect(sd, (FAR struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      ret = -errno;
+      fprintf(stderr, "trace stream: cannot connect to '%s': %d\n",
+              dest, ret);
+      close(sd);
+      return ret;
+    }
+
+  return sd;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: trace_stream
+ *
+ * Description:
+ *   Stream the notes as CTF to a host collector.
+ *
+ ****************************************************************************/
+
+int trace_stream(FAR const char *dest, bool udp, int duration)
+{
+  FAR struct trace_stream_s *stream;
+  struct sched_param param;
+  pthread_attr_t attr;
+  pthread_t thread;
+  int ret;
+
+  stream = calloc(1, sizeof(*stream));
+  if (stream == NULL)
+    {
+      fprintf(stderr, "trace stream: no memory\n");
+      return -ENOMEM;
+    }
+
+  stream->udp = udp;
+  stream->duration = duration;
+  stream->maxlen = CONFIG_SYSTEM_TRACE_CTF_PACKETSIZE;
+#ifdef CONFIG_NET_UDP
+  if (udp)
+    {
+      stream->maxlen = MIN(stream->maxlen, TRACE_STREAM_UDPLEN);
+    }
+#endif
+
+  stream->sd = trace_stream_connect(dest, udp);
+  if (stream->sd < 0)
+    {
+      ret = stream->sd;
+      goto errout;
+    }
+
+  pthread_attr_init(&attr);
+  param.sched_priority = CONFIG_SYSTEM_TRACE_STREAM_PRIORITY;
+  pthread_attr_setschedparam(&attr, &param);
+  pthread_attr_setstacksize(&attr, CONFIG_SYSTEM_TRACE_STREAM_STACKSIZE);
+
+  ret = pthread_create(&thread, &attr, trace_stream_drainer, stream);
+  pthread_attr_destroy(&attr);
+  if (ret != 0)
+    {
+      fprintf(stderr, "trace stream: pthread_create failed: %d\n", ret);
+      ret = -ret;
+      goto errout_with_sd;
+    }
+
+  pthread_join(thread, NULL);
+  ret = stream->result;
+
+  printf("trace stream: %" PRIu32 " frames, %" PRIu64 " bytes, "
+         "%" PRIu32 " dropped\n",
+         stream->seq, stream->bytes, stream->dropped);
+
+errout_with_sd:
+  close(stream->sd);
+
+errout:
+  free(stream);
+  return ret;
+}
@@ -44,6 +44,7 @@
 
 #define ORB_MAX_PRINT_NAME 32
 #define ORB_TOP_WAIT_TIME  1000
+#define ORB_PROF_NBUCKETS  16
 
 /****************************************************************************
  * Private Types
@@ -57,6 +58,26 @@ struct listen_object_s
   unsigned long     generation;   /* Latest generation */
 };
 
+/* Profile of one subscription over one ORB_TOP_WAIT_TIME window, except
+ * for the largest batch and lost samples, which are totals.
+ */
+
+struct listen_prof_s
+{
+  int                   fd;           /* Subscriber handle */
+  struct orb_batch_info info;         /* Generation accounting */
+  unsigned int          nbuffer;      /* Queue size of the topic */
+  unsigned long         count;        /* Samples copied */
+  uint64_t              latsum;       /* Sum of latencies, us */
+  uint32_t              latmax;       /* Maximum latency, us */
+  uint32_t              hist[ORB_PROF_NBUCKETS]; /* Latency in
+                                                  * [1 << i, 2 << i), bucket
+                                                  * 0 from 0, the last one
+                                                  * without upper bound */
+  unsigned int          batchmax;     /* Most samples copied at once */
+  unsigned long         lost;         /* Samples lost in the queue */
+};
+
 /****************************************************************************
  * Private Function Prototypes
  ****************************************************************************/
@@ -77,6 +98,8 @@ static int listener_update(FAR struct list_node *objlist,
 static void listener_top(FAR struct list_node *objlist,
                          FAR const char *filter,
                          bool only_once);
+static void listener_profile(FAR struct list_node *objlist, int nb_objects,
+                             FAR const char *csv, bool only_once);
 
 /****************************************************************************
  * Private Data
@@ -120,7 +143,10 @@ listener <command> [arguments...]\n\
 \t             default: 0\n\
 \t[-t <val> ]  Time of listener, in seconds, default: 5\n\
 \t[-T       ]  Top, continuously print updating objects\n\
-\t[-l       ]  Top only execute once.\n\
+\t[-p       ]  Profile, continuously print bandwidth, publish-to-copy\n\
+\t             latency, largest batch and lost samples\n\
+\t[-c <file>]  Profile, also append each report to a CSV file\n\
+\t[-l       ]  Top / profile only execute once.\n\
   ");
 }
 
@@ -693,6 +719,363 @@ static void listener_top(FAR struct list_node *objlist,
   while (!quit && !only_once);
 }
 
+/****************************************************************************
+ * Name: listener_profile_update
+ *
+ * Description:
+ *   Copy all queued samples of a subscription and account them.
+ *
+ * Input Parameters:
+ *   meta     The uORB metadata.
+ *   prof     Profile of the subscription.
+ *   buffer   Buffer for prof->nbuffer samples.
+ *
+ * Returned Value:
+ *   None.
+ ****************************************************************************/
+
+static void listener_profile_update(FAR const struct orb_metadata *meta,
+                                    FAR struct listen_prof_s *prof,
+                                    FAR uint8_t *buffer)
+{
+  orb_abstime timestamp;
+  orb_abstime now;
+  uint32_t latency;
+  size_t n;
+  size_t i;
+  int bucket;
+
+  if (orb_copy_batch(prof->fd, buffer, prof->nbuffer, &n, &prof->info) < 0)
+    {
+      return;
+    }
+
+  now          = orb_absolute_time();
+  prof->lost  += prof->info.lost;
+  prof->count += n;
+  if (n > prof->batchmax)
+    {
+      prof->batchmax = n;
+    }
+
+  /* Topics start with the publish timestamp */
+
+  for (i = 0; i < n && meta->o_size >= sizeof(timestamp); i++)
+    {
+      memcpy(&timestamp, buffer + i * meta->o_size, sizeof(timestamp));
+      if (timestamp == 0 || timestamp > now)
+        {
+          continue;
+        }
+
+      latency       = now - timestamp > UINT32_MAX ?
+                      UINT32_MAX : now - timestamp;
+      prof->latsum += latency;
+      if (latency > prof->latmax)
+        {
+          prof->latmax = latency;
+        }
+
+      bucket = 0;
+      while (bucket < ORB_PROF_NBUCKETS - 1 && latency >= (2u << bucket))
+        {
+          bucket++;
+        }
+
+      prof->hist[bucket]++;
+    }
+}
+
+/****************************************************************************
+ * Name: listener_profile_percentile
+ *
+ * Description:
+ *   Upper bound of the latency histogram bucket with the given percentile,
+ *   0 if no latency was measured.
+ ****************************************************************************/
+
+static uint32_t listener_profile_percentile(FAR struct listen_prof_s *prof,
+                                            unsigned int percent)
+{
+  unsigned long total = 0;
+  unsigned long sum = 0;
+  int i;
+
+  for (i = 0; i < ORB_PROF_NBUCKETS; i++)
+    {
+      total += prof->hist[i];
+    }
+
+  if (total == 0)
+    {
+      return 0;
+    }
+
+  for (i = 0; i < ORB_PROF_NBUCKETS; i++)
+    {
+      sum += prof->hist[i];
+      if (sum * 100 >= total * percent)
+        {
+          break;
+        }
+    }
+
+  return i < ORB_PROF_NBUCKETS - 1 ? (2u << i) : UINT32_MAX;
+}
+
+/****************************************************************************
+ * Name: listener_profile_report
+ *
+ * Description:
+ *   Print and export the profile of one window, then start a new one.
+ *
+ * Input Parameters:
+ *   objlist    List of objects.
+ *   profs      Profiles, same order as objlist.
+ *   file       CSV file or NULL.
+ *   elapsed    Length of the window, us.
+ *
+ * Returned Value:
+ *   None.
+ ****************************************************************************/
+
+static void listener_profile_report(FAR struct list_node *objlist,
+                                    FAR struct listen_prof_s *profs,
+                                    FAR FILE *file, orb_abstime elapsed)
+{
+  FAR struct listen_object_s *tmp;
+  FAR struct listen_prof_s *prof;
+  struct orb_state state;
+  unsigned long rate;
+  unsigned long bps;
+  uint32_t latavg;
+  int i = 0;
+  int j;
+
+  uorbinfo_raw("\033[K" "%-*s INST #SUB RATE    B/S LAT_AVG LAT_P99 "
+               "LAT_MAX BATCH  LOST", ORB_MAX_PRINT_NAME - 2, "NAME");
+
+  list_for_every_entry(objlist, tmp, struct listen_object_s, node)
+    {
+      prof = &profs[i++];
+      if (prof->fd < 0 || orb_get_state(prof->fd, &state) < 0)
+        {
+          continue;
+        }
+
+      rate   = elapsed ? prof->count * 1000000ull / elapsed : 0;
+      bps    = rate * tmp->object.meta->o_size;
+      latavg = prof->count ? prof->latsum / prof->count : 0;
+
+      uorbinfo_raw("\033[K" "%-*s %2u %4" PRIu32 " %4lu %6lu %7" PRIu32
+                   " %7" PRIu32 " %7" PRIu32 " %5u %5lu",
+                   ORB_MAX_PRINT_NAME, tmp->object.meta->o_name,
+                   tmp->object.instance, state.nsubscribers, rate, bps,
+                   latavg, listener_profile_percentile(prof, 99),
+                   prof->latmax, prof->batchmax, prof->lost);
+
+      if (file != NULL)
+        {
+          fprintf(file, "%" PRIu64 ",%s,%d,%" PRIu32 ",%lu,%lu,%" PRIu32
+                  ",%" PRIu32 ",%" PRIu32 ",%u,%lu,%" PRIu64,
+                  orb_absolute_time(), tmp->object.meta->o_name,
+                  tmp->object.instance, state.nsubscribers, rate, bps,
+                  latavg, listener_profile_percentile(prof, 99),
+                  prof->latmax, prof->batchmax, prof->lost,
+                  state.generation);
+
+          for (j = 0; j < ORB_PROF_NBUCKETS; j++)
+            {
+              fprintf(file, ",%" PRIu32, prof->hist[j]);
+            }
+
+          fputc('\n', file);
+        }
+
+      /* Start a new window */
+
+      prof->count  = 0;
+      prof->latsum = 0;
+      prof->latmax = 0;
+      memset(prof->hist, 0, sizeof(prof->hist));
+    }
+
+  if (file != NULL)
+    {
+      fflush(file);
+    }
+}
+
+/****************************************************************************
+ * Name: listener_profile
+ *
+ * Description:
+ *   Subscribe objects and continuously print their bandwidth, latency
+ *   and losses, like listener_top().  Exited when the user presses the
+ *   enter key.
+ *
+ * Input Parameters:
+ *   objlist    List of objects.
+ *   nb_objects Length of objects list.
+ *   csv        CSV file to append the reports to, or NULL.
+ *   only_once  Print only one report, then exit.
+ *
+ * Returned Value:
+ *   None.
+ ****************************************************************************/
+
+static void listener_profile(FAR struct list_node *objlist, int nb_objects,
+                             FAR const char *csv, bool only_once)
+{
+  FAR struct listen_object_s *tmp;
+  FAR struct listen_prof_s *profs;
+  FAR struct pollfd *fds;
+  FAR uint8_t *buffer = NULL;
+  FAR FILE *file = NULL;
+  struct orb_state state;
+  orb_abstime start;
+  orb_abstime now;
+  size_t buflen = 0;
+  bool quit = false;
+  int i;
+
+  profs = calloc(nb_objects, sizeof(struct listen_prof_s));
+  fds   = calloc(nb_objects + 1, sizeof(struct pollfd));
+  if (!profs || !fds)
+    {
+      goto out;
+    }
+
+  for (i = 0; i < nb_objects; i++)
+    {
+      profs[i].fd = -1;
+    }
+
+  if (csv)
+    {
+      file = fopen(csv, "a");
+      if (!file)
+        {
+          uorbinfo_raw("Failed to open %s: %d", csv, errno);
+          goto out;
+        }
+
+      /* Appending to an existing file must not repeat the header */
+
+      if (fseek(file, 0, SEEK_END) == 0 && ftell(file) == 0)
+        {
+          fprintf(file, "time,name,instance,subscribers,rate,bps,lat_avg,"
+                  "lat_p99,lat_max,batch_max,lost,generation");
+          for (i = 0; i < ORB_PROF_NBUCKETS; i++)
+            {
+              fprintf(file, ",lat_lt_%u", 2u << i);
+            }
+
+          fputc('\n', file);
+        }
+    }
+
+  /* Subscribe all objects, the last pollfd is the console */
+
+  i = 0;
+  list_for_every_entry(objlist, tmp, struct listen_object_s, node)
+    {
+      FAR struct listen_prof_s *prof = &profs[i];
+      size_t len;
+
+      prof->fd     = orb_subscribe_multi(tmp->object.meta,
+                                         tmp->object.instance);
+      fds[i].fd     = prof->fd;
+      fds[i].events = POLLIN;
+      i++;
+
+      prof->nbuffer = 1;
+      if (prof->fd >= 0 && orb_get_state(prof->fd, &state) >= 0 &&
+          state.queue_size > 1)
+        {
+          prof->nbuffer = state.queue_size;
+        }
+
+      len = prof->nbuffer * tmp->object.meta->o_size;
+      buflen = len > buflen ? len : buflen;
+    }
+
+  fds[nb_objects].fd     = STDIN_FILENO;
+  fds[nb_objects].events = POLLIN;
+
+  buffer = malloc(buflen);
+  if (!buffer)
+    {
+      goto out;
+    }
+
+  uorbinfo_raw("\033[2J\n"); /* clear screen */
+
+  start = orb_absolute_time();
+  while (!quit && !g_should_exit)
+    {
+      now = orb_absolute_time();
+      if (now - start >= ORB_TOP_WAIT_TIME * 1000ull)
+        {
+          if (!only_once)
+            {
+              uorbinfo_raw("\033[H"); /* move cursor to top left corner */
+            }
+
+          listener_profile_report(objlist, profs, file, now - start);
+          if (only_once)
+            {
+              break;
+            }
+
+          start = now;
+          continue;
+        }
+
+      if (poll(fds, nb_objects + 1,
+               ORB_TOP_WAIT_TIME - (now - start) / 1000) <= 0)
+        {
+          continue;
+        }
+
+      if (fds[nb_objects].revents & POLLIN)
+        {
+          char c;
+
+          quit = read(STDIN_FILENO, &c, 1) > 0;
+        }
+
+      i = 0;
+      list_for_every_entry(objlist, tmp, struct listen_object_s, node)
+        {
+          if (fds[i].revents & POLLIN)
+            {
+              listener_profile_update(tmp->object.meta, &profs[i], buffer);
+            }
+
+          i++;
+        }
+    }
+
+out:
+  for (i = 0; profs && fds && i < nb_objects; i++)
+    {
+      if (profs[i].fd >= 0)
+        {
+          orb_unsubscribe(profs[i].fd);
+        }
+    }
+
+  if (file)
+    {
+      fclose(file);
+    }
+
+  free(buffer);
+  free(fds);
+  free(profs);
+}
+
 static void exit_handler(int signo)
 {
   g_should_exit = true;
@@ -711,6 +1094,8 @@ int main(int argc, FAR char *argv[])
   int nb_msgs       = 0;
   int timeout       = 5;
   bool top          = false;
+  bool profile      = false;
+  FAR char *csv     = NULL;
   bool only_once    = false;
   FAR char *filter  = NULL;
   int ret;
@@ -724,7 +1109,7 @@ int main(int argc, FAR char *argv[])
 
   /* Pasrse Argument */
 
-  while ((ch = getopt(argc, argv, "r:b:n:t:Tlh")) != EOF)
+  while ((ch = getopt(argc, argv, "r:b:n:t:Tpc:lh")) != EOF)
     {
       switch (ch)
       {
@@ -764,6 +1149,15 @@ int main(int argc, FAR char *argv[])
           top = true;
           break;
 
+        case 'p':
+          profile = true;
+          break;
+
+        case 'c':
+          profile = true;
+          csv = optarg;
+          break;
+
         case 'l':
           only_once = true;
           break;
@@ -788,7 +1182,11 @@ int main(int argc, FAR char *argv[])
       return 0;
     }
 
-  if (top)
+  if (profile)
+    {
+      listener_profile(&objlist, ret, csv, only_once);
+    }
+  else if (top)
     {
       listener_top(&objlist, filter, only_once);
     }
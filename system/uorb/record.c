@@ -0,0 +1,609 @@
+/****************************************************************************
+ * apps/system/uorb/record.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <uORB/uORB.h>
+
+#include "record.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct record_topic_s
+{
+  struct orb_object     object;     /* Recorded object */
+  struct orb_batch_info info;       /* Lost generation accounting */
+  unsigned int          nbuffer;    /* Elements copied per batch */
+  unsigned long         count;      /* Recorded samples */
+  unsigned long         lost;       /* Samples lost in the queue */
+};
+
+struct record_s
+{
+  FAR FILE                  *file;
+  FAR struct record_topic_s *topics;
+  FAR struct pollfd         *fds;
+  int                        ntopics;
+  struct uorb_log_index_s    index[UORB_LOG_INDEX_MAX];
+  int                        nindex;
+  orb_abstime                index_interval;
+  orb_abstime                index_next;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static bool g_should_exit;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void usage(void)
+{
+  uorbinfo_raw("\n\
+Record uORB topics to a binary log that uorb_replay can publish again.\n\
+\n\
+uorb_record [arguments...] <t1,t2,...>\n\
+\t<topics_name> Topic names separated by ','.  A name without instance\n\
+\t             number records all instances\n\
+\t[-f <file>]  Log file, default: " CONFIG_UORB_RECORD_PATH "\n\
+\t[-r <val> ]  Subscription rate (unlimited if 0), default: 0\n\
+\t[-t <val> ]  Recording time in seconds (until Ctrl+C if 0),\n\
+\t             default: 0\n\
+\t[-i <val> ]  Seek index interval in ms, default: 1000\n\
+\t[-h       ]  Show this help\n\
+  ");
+}
+
+static void exit_handler(int signo)
+{
+  g_should_exit = true;
+}
+
+/****************************************************************************
+ * Name: record_write
+ *
+ * Description:
+ *   Write one record to the log.
+ *
+ * Returned Value:
+ *   0 on success, otherwise -1.
+ ****************************************************************************/
+
+static int record_write(FAR struct record_s *rec, uint8_t type,
+                        uint8_t id, FAR const void *data1, size_t len1,
+                        FAR const void *data2, size_t len2)
+{
+  struct uorb_log_record_s hdr;
+
+  hdr.size = len1 + len2;
+  hdr.type = type;
+  hdr.id   = id;
+
+  if (fwrite(&hdr, sizeof(hdr), 1, rec->file) != 1 ||
+      fwrite(data1, len1, 1, rec->file) != 1 ||
+      (len2 > 0 && fwrite(data2, len2, 1, rec->file) != 1))
+    {
+      return -1;
+    }
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: record_patch
+ *
+ * Description:
+ *   Overwrite a field of the file header and return to the end of the log.
+ *
+ * Returned Value:
+ *   0 on success, otherwise -1.
+ ****************************************************************************/
+
+static int record_patch(FAR struct record_s *rec, off_t offset,
+                        FAR const void *data, size_t len)
+{
+  int ret = 0;
+
+  if (fseeko(rec->file, offset, SEEK_SET) < 0 ||
+      fwrite(data, len, 1, rec->file) != 1)
+    {
+      ret = -1;
+    }
+
+  if (fseeko(rec->file, 0, SEEK_END) < 0)
+    {
+      ret = -1;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: record_add_topic
+ *
+ * Description:
+ *   Subscribe to an object and write its TOPIC record.
+ ****************************************************************************/
+
+static int record_add_topic(FAR struct record_s *rec,
+                            FAR const struct orb_metadata *meta,
+                            int instance, int interval)
+{
+  FAR struct record_topic_s *topic;
+  struct uorb_log_topic_s desc;
+  struct orb_state state;
+  int fd;
+
+  if (rec->ntopics >= UORB_LOG_MAX_TOPICS)
+    {
+      return -E2BIG;
+    }
+
+  /* A DATA record holds the timestamp and the sample in a payload of at
+   * most UINT16_MAX bytes
+   */
+
+  if (meta->o_size + sizeof(orb_abstime) > UINT16_MAX)
+    {
+      uorbinfo_raw("%s is too large to record", meta->o_name);
+      return -EFBIG;
+    }
+
+  fd = orb_subscribe_multi(meta, instance);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  if (interval != 0)
+    {
+      orb_set_interval(fd, interval);
+    }
+
+  topic = &rec->topics[rec->ntopics];
+  memset(topic, 0, sizeof(*topic));
+  topic->object.meta     = meta;
+  topic->object.instance = instance;
+  topic->nbuffer         = 1;
+
+  if (orb_get_state(fd, &state) >= 0 && state.queue_size > 1)
+    {
+      topic->nbuffer = state.queue_size;
+    }
+
+  desc.size     = meta->o_size;
+  desc.instance = instance;
+  desc.queue    = topic->nbuffer > UINT8_MAX ? UINT8_MAX : topic->nbuffer;
+
+  if (record_write(rec, UORB_LOG_TOPIC, rec->ntopics, &desc, sizeof(desc),
+                   meta->o_name, strlen(meta->o_name) + 1) < 0)
+    {
+      orb_unsubscribe(fd);
+      return -EIO;
+    }
+
+  rec->fds[rec->ntopics].fd     = fd;
+  rec->fds[rec->ntopics].events = POLLIN;
+  rec->ntopics++;
+
+  uorbinfo_raw("record %s%d", meta->o_name, instance);
+  return 0;
+}
+
+/****************************************************************************
+ * Name: record_add_topics
+ *
+ * Description:
+ *   Add all objects listed in the filter.
+ ****************************************************************************/
+
+static int record_add_topics(FAR struct record_s *rec,
+                             FAR const char *filter, int interval)
+{
+  FAR const struct orb_metadata *meta;
+  FAR const char *member = filter;
+  FAR const char *tmp;
+  char name[ORB_PATH_MAX];
+  size_t len;
+  int instance;
+  int ret;
+
+  do
+    {
+      while (*member == ',')
+        {
+          member++;
+        }
+
+      tmp = strchr(member, ',');
+      len = tmp ? tmp - member : strlen(member);
+      if (len == 0 || len >= ORB_PATH_MAX)
+        {
+          break;
+        }
+
+      strlcpy(name, member, len + 1);
+      member = tmp;
+
+      meta = orb_get_meta(name);
+      if (meta == NULL)
+        {
+          uorbinfo_raw("unknown topic %s", name);
+          return -ENOENT;
+        }
+
+      if (isdigit(name[len - 1]))
+        {
+          ret = record_add_topic(rec, meta, name[len - 1] - '0', interval);
+        }
+      else
+        {
+          instance = 0;
+          do
+            {
+              ret = record_add_topic(rec, meta, instance++, interval);
+            }
+          while (ret >= 0 && orb_exists(meta, instance) == 0);
+        }
+
+      if (ret < 0)
+        {
+          return ret;
+        }
+    }
+  while (tmp);
+
+  return rec->ntopics > 0 ? 0 : -EINVAL;
+}
+
+/****************************************************************************
+ * Name: record_index
+ *
+ * Description:
+ *   Add a seek index entry for the DATA record about to be written.
+ ****************************************************************************/
+
+static void record_index(FAR struct record_s *rec, orb_abstime timestamp)
+{
+  int i;
+
+  if (timestamp < rec->index_next)
+    {
+      return;
+    }
+
+  /* Halve the index resolution when it is full */
+
+  if (rec->nindex == UORB_LOG_INDEX_MAX)
+    {
+      for (i = 0; i < UORB_LOG_INDEX_MAX / 2; i++)
+        {
+          rec->index[i] = rec->index[2 * i];
+        }
+
+      rec->nindex          = UORB_LOG_INDEX_MAX / 2;
+      rec->index_interval *= 2;
+    }
+
+  rec->index[rec->nindex].timestamp = timestamp;
+  rec->index[rec->nindex].offset    = ftello(rec->file);
+  rec->nindex++;
+
+  rec->index_next = timestamp + rec->index_interval;
+}
+
+/****************************************************************************
+ * Name: record_topic
+ *
+ * Description:
+ *   Copy all queued samples of a topic and append them to the log.
+ ****************************************************************************/
+
+static int record_topic(FAR struct record_s *rec, int id,
+                        FAR uint8_t *buffer)
+{
+  FAR struct record_topic_s *topic = &rec->topics[id];
+  FAR const struct orb_metadata *meta = topic->object.meta;
+  orb_abstime timestamp;
+  orb_abstime now;
+  size_t n;
+  size_t i;
+  int ret;
+
+  ret = orb_copy_batch(rec->fds[id].fd, buffer, topic->nbuffer, &n,
+                       &topic->info);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  now          = orb_absolute_time();
+  topic->lost += topic->info.lost;
+
+  for (i = 0; i < n; i++, buffer += meta->o_size)
+    {
+      /* Prefer the timestamp that leads every topic structure */
+
+      timestamp = 0;
+      if (meta->o_size >= sizeof(timestamp))
+        {
+          memcpy(&timestamp, buffer, sizeof(timestamp));
+        }
+
+      if (timestamp == 0 || timestamp > now)
+        {
+          timestamp = now;
+        }
+
+      record_index(rec, timestamp);
+
+      ret = record_write(rec, UORB_LOG_DATA, id, &timestamp,
+                         sizeof(timestamp), buffer, meta->o_size);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      topic->count++;
+    }
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: record_close
+ *
+ * Description:
+ *   Write the seek index and patch its offset and the start time into
+ *   the file header.  The rest of the header is written when the file is
+ *   opened, so that a recording cut short can still be replayed.
+ ****************************************************************************/
+
+static int record_close(FAR struct record_s *rec, orb_abstime start)
+{
+  uint64_t index = 0;
+  off_t offset;
+  int ret = 0;
+
+  start  = rec->nindex > 0 ? rec->index[0].timestamp : start;
+  offset = ftello(rec->file);
+  if (rec->nindex > 0 && offset > 0 &&
+      record_write(rec, UORB_LOG_INDEX, 0, rec->index,
+                   rec->nindex * sizeof(struct uorb_log_index_s),
+                   NULL, 0) >= 0)
+    {
+      index = offset;
+    }
+
+  if (record_patch(rec, offsetof(struct uorb_log_header_s, start),
+                   &start, sizeof(start)) < 0 ||
+      record_patch(rec, offsetof(struct uorb_log_header_s, index),
+                   &index, sizeof(index)) < 0)
+    {
+      ret = -1;
+    }
+
+  if (fclose(rec->file) != 0)
+    {
+      ret = -1;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  FAR const char *path = CONFIG_UORB_RECORD_PATH;
+  FAR struct record_s *rec;
+  FAR uint8_t *buffer = NULL;
+  struct uorb_log_header_s header;
+  orb_abstime start;
+  size_t buflen = 0;
+  int topic_rate = 0;
+  int duration = 0;
+  int index_ms = 1000;
+  int ret = EXIT_FAILURE;
+  int ch;
+  int i;
+
+  g_should_exit = false;
+  if (signal(SIGINT, exit_handler) == SIG_ERR)
+    {
+      return EXIT_FAILURE;
+    }
+
+  while ((ch = getopt(argc, argv, "f:r:t:i:h")) != EOF)
+    {
+      switch (ch)
+        {
+          case 'f':
+            path = optarg;
+            break;
+
+          case 'r':
+            topic_rate = strtol(optarg, NULL, 0);
+            break;
+
+          case 't':
+            duration = strtol(optarg, NULL, 0);
+            break;
+
+          case 'i':
+            index_ms = strtol(optarg, NULL, 0);
+            break;
+
+          case 'h':
+          default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+  if (optind >= argc || topic_rate < 0 || duration < 0 || index_ms <= 0)
+    {
+      usage();
+      return EXIT_FAILURE;
+    }
+
+  rec = calloc(1, sizeof(struct record_s));
+  if (rec == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+
+  rec->topics = calloc(UORB_LOG_MAX_TOPICS, sizeof(struct record_topic_s));
+  rec->fds    = calloc(UORB_LOG_MAX_TOPICS, sizeof(struct pollfd));
+  rec->index_interval = index_ms * 1000ull;
+
+  rec->file = fopen(path, "w+");
+  if (rec->topics == NULL || rec->fds == NULL || rec->file == NULL)
+    {
+      uorbinfo_raw("failed to open %s: %d", path, errno);
+      goto errout;
+    }
+
+  /* The index and the start time are patched when the recording ends */
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, UORB_LOG_MAGIC, sizeof(UORB_LOG_MAGIC));
+  header.version = UORB_LOG_VERSION;
+  if (fwrite(&header, sizeof(header), 1, rec->file) != 1)
+    {
+      uorbinfo_raw("failed to write %s: %d", path, errno);
+      goto errout;
+    }
+
+  ret = record_add_topics(rec, argv[optind],
+                          topic_rate ? 1000000 / topic_rate : 0);
+  if (ret < 0)
+    {
+      uorbinfo_raw("failed to add topics: %d", ret);
+      ret = EXIT_FAILURE;
+      goto errout_with_file;
+    }
+
+  header.ntopics = rec->ntopics;
+  if (record_patch(rec, offsetof(struct uorb_log_header_s, ntopics),
+                   &header.ntopics, sizeof(header.ntopics)) < 0 ||
+      fflush(rec->file) != 0)
+    {
+      uorbinfo_raw("failed to write %s: %d", path, errno);
+      ret = EXIT_FAILURE;
+      goto errout_with_file;
+    }
+
+  /* One buffer large enough for a batch of any topic */
+
+  for (i = 0; i < rec->ntopics; i++)
+    {
+      size_t len = rec->topics[i].nbuffer *
+                   rec->topics[i].object.meta->o_size;
+
+      buflen = len > buflen ? len : buflen;
+    }
+
+  buffer = malloc(buflen);
+  if (buffer == NULL)
+    {
+      ret = EXIT_FAILURE;
+      goto errout_with_file;
+    }
+
+  start = orb_absolute_time();
+
+  while (!g_should_exit &&
+         (duration == 0 ||
+          orb_absolute_time() - start < duration * 1000000ull))
+    {
+      if (poll(rec->fds, rec->ntopics, 1000) <= 0)
+        {
+          continue;
+        }
+
+      for (i = 0; i < rec->ntopics; i++)
+        {
+          if ((rec->fds[i].revents & POLLIN) &&
+              record_topic(rec, i, buffer) < 0)
+            {
+              uorbinfo_raw("write failed: %d", errno);
+              g_should_exit = true;
+              break;
+            }
+        }
+    }
+
+  for (i = 0; i < rec->ntopics; i++)
+    {
+      uorbinfo_raw("%s%d: %lu samples, %lu lost",
+                   rec->topics[i].object.meta->o_name,
+                   rec->topics[i].object.instance,
+                   rec->topics[i].count, rec->topics[i].lost);
+    }
+
+  ret = EXIT_SUCCESS;
+
+errout_with_file:
+  for (i = 0; i < rec->ntopics; i++)
+    {
+      orb_unsubscribe(rec->fds[i].fd);
+    }
+
+  if (record_close(rec, orb_absolute_time()) < 0)
+    {
+      uorbinfo_raw("failed to complete %s", path);
+      ret = EXIT_FAILURE;
+    }
+
+  rec->file = NULL;
+
+errout:
+  if (rec->file != NULL)
+    {
+      fclose(rec->file);
+    }
+
+  free(buffer);
+  free(rec->fds);
+  free(rec->topics);
+  free(rec);
+  return ret;
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+ * apps/system/uorb/record.h
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __APP_SYSTEM_UORB_RECORD_H
+#define __APP_SYSTEM_UORB_RECORD_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Log file layout:
+ *
+ *   struct uorb_log_header_s
+ *   TOPIC record for each recorded topic
+ *   DATA records, ordered by the time they were copied
+ *   INDEX record (only if the recording was closed properly)
+ *
+ * Every record starts with struct uorb_log_record_s.  All fields are
+ * in the byte order of the recording target.  File offsets are 64 bits
+ * wide, so the size of a log is only limited by off_t.  A payload is at
+ * most UINT16_MAX bytes, topics with larger samples are not recorded.
+ */
+
+#define UORB_LOG_MAGIC         "uORBLOG"
+#define UORB_LOG_VERSION       2
+
+#define UORB_LOG_TOPIC         1    /* struct uorb_log_topic_s + name */
+#define UORB_LOG_DATA          2    /* uint64_t timestamp + raw sample */
+#define UORB_LOG_INDEX         3    /* struct uorb_log_index_s[] */
+
+#define UORB_LOG_MAX_TOPICS    256
+#define UORB_LOG_INDEX_MAX     1024
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct uorb_log_header_s
+{
+  char     magic[8];                /* UORB_LOG_MAGIC */
+  uint64_t start;                   /* Timestamp of the first sample,
+                                     * 0 if the recording was cut short */
+  uint64_t index;                   /* File offset of the INDEX record,
+                                     * 0 if there is none */
+  uint16_t version;                 /* UORB_LOG_VERSION */
+  uint16_t ntopics;                 /* Number of TOPIC records */
+  uint32_t reserved;
+};
+
+struct uorb_log_record_s
+{
+  uint16_t size;                    /* Payload size */
+  uint8_t  type;                    /* UORB_LOG_* */
+  uint8_t  id;                      /* Topic id of TOPIC and DATA */
+};
+
+struct uorb_log_topic_s
+{
+  uint16_t size;                    /* Sample size */
+  uint8_t  instance;                /* Recorded instance */
+  uint8_t  queue;                   /* Queue size of the topic */
+};
+
+/* The seek index holds the position of the first DATA record after
+ * every index interval.  It is thinned out by dropping every other entry
+ * whenever UORB_LOG_INDEX_MAX is reached, so any length of recording
+ * fits in one record.
+ */
+
+struct uorb_log_index_s
+{
+  uint64_t timestamp;               /* Timestamp of the DATA record */
+  uint64_t offset;                  /* File offset of the DATA record */
+};
+
+#endif /* __APP_SYSTEM_UORB_RECORD_H */
@@ -0,0 +1,414 @@
+/****************************************************************************
+ * apps/system/uorb/replay.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uORB/uORB.h>
+
+#include "record.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct replay_topic_s
+{
+  FAR const struct orb_metadata *meta;
+  struct orb_metadata rebuilt;      /* Metadata rebuilt from the log */
+  char                name[ORB_PATH_MAX];
+  int                 instance;
+  int                 fd;
+  unsigned long       count;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static bool g_should_exit;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void usage(void)
+{
+  uorbinfo_raw("\n\
+Publish the topics of a uorb_record log again with the recorded timing.\n\
+\n\
+uorb_replay [arguments...]\n\
+\t[-f <file>]  Log file, default: " CONFIG_UORB_RECORD_PATH "\n\
+\t[-x <val> ]  Speed in percent of real time (no delays if 0),\n\
+\t             default: 100\n\
+\t[-s <val> ]  Start offset in seconds, default: 0\n\
+\t[-n       ]  Advertise new instances instead of the recorded ones\n\
+\t[-h       ]  Show this help\n\
+  ");
+}
+
+static void exit_handler(int signo)
+{
+  g_should_exit = true;
+}
+
+/****************************************************************************
+ * Name: replay_read
+ *
+ * Description:
+ *   Read the next record and its payload.
+ *
+ * Returned Value:
+ *   0 on success, -ENODATA at the end of the log, otherwise -EIO.
+ ****************************************************************************/
+
+static int replay_read(FAR FILE *file, FAR struct uorb_log_record_s *hdr,
+                       FAR uint8_t *payload)
+{
+  if (fread(hdr, sizeof(*hdr), 1, file) != 1)
+    {
+      return feof(file) ? -ENODATA : -EIO;
+    }
+
+  if (hdr->size > 0 && fread(payload, hdr->size, 1, file) != 1)
+    {
+      return feof(file) ? -ENODATA : -EIO;
+    }
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: replay_seek
+ *
+ * Description:
+ *   Seek to the last index entry before the given time.
+ *
+ * Returned Value:
+ *   0 on success, otherwise a negative errno.
+ ****************************************************************************/
+
+static int replay_seek(FAR FILE *file,
+                       FAR const struct uorb_log_header_s *header,
+                       orb_abstime timestamp, FAR uint8_t *payload)
+{
+  FAR const struct uorb_log_index_s *index;
+  struct uorb_log_record_s hdr;
+  off_t offset;
+  int lo;
+  int hi;
+  int n;
+  int ret;
+
+  if (header->index == 0)
+    {
+      return -ENOENT;
+    }
+
+  offset = ftello(file);
+  if (fseeko(file, header->index, SEEK_SET) < 0)
+    {
+      return -EIO;
+    }
+
+  ret = replay_read(file, &hdr, payload);
+  if (ret < 0 || hdr.type != UORB_LOG_INDEX)
+    {
+      fseeko(file, offset, SEEK_SET);
+      return ret < 0 ? ret : -EINVAL;
+    }
+
+  /* Binary search of the last entry not later than timestamp */
+
+  index = (FAR const struct uorb_log_index_s *)payload;
+  n     = hdr.size / sizeof(struct uorb_log_index_s);
+  lo    = 0;
+  hi    = n;
+
+  while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+
+      if (index[mid].timestamp <= timestamp)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+
+  if (lo > 0)
+    {
+      offset = index[lo - 1].offset;
+    }
+
+  return fseeko(file, offset, SEEK_SET) < 0 ? -EIO : 0;
+}
+
+/****************************************************************************
+ * Name: replay_wait
+ *
+ * Description:
+ *   Sleep until the given log time is due.
+ ****************************************************************************/
+
+static void replay_wait(orb_abstime log_time, orb_abstime log_start,
+                        orb_abstime real_start, int speed)
+{
+  orb_abstime due;
+  orb_abstime now;
+
+  if (speed == 0 || log_time <= log_start)
+    {
+      return;
+    }
+
+  due = real_start + (log_time - log_start) * 100 / speed;
+  now = orb_absolute_time();
+  if (due > now)
+    {
+      usleep(due - now);
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  FAR const char *path = CONFIG_UORB_RECORD_PATH;
+  FAR struct replay_topic_s *topics;
+  FAR struct replay_topic_s *topic;
+  FAR struct uorb_log_topic_s *desc;
+  struct uorb_log_header_s header;
+  struct uorb_log_record_s hdr;
+  FAR uint8_t *payload;
+  FAR uint8_t *sample;
+  orb_abstime log_start = 0;
+  orb_abstime real_start;
+  orb_abstime timestamp;
+  bool new_instance = false;
+  int start_sec = 0;
+  int speed = 100;
+  int ret = EXIT_FAILURE;
+  FAR FILE *file;
+  int ch;
+  int i;
+
+  g_should_exit = false;
+  if (signal(SIGINT, exit_handler) == SIG_ERR)
+    {
+      return EXIT_FAILURE;
+    }
+
+  while ((ch = getopt(argc, argv, "f:x:s:nh")) != EOF)
+    {
+      switch (ch)
+        {
+          case 'f':
+            path = optarg;
+            break;
+
+          case 'x':
+            speed = strtol(optarg, NULL, 0);
+            break;
+
+          case 's':
+            start_sec = strtol(optarg, NULL, 0);
+            break;
+
+          case 'n':
+            new_instance = true;
+            break;
+
+          case 'h':
+          default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+  if (speed < 0 || start_sec < 0)
+    {
+      usage();
+      return EXIT_FAILURE;
+    }
+
+  file = fopen(path, "r");
+  if (file == NULL)
+    {
+      uorbinfo_raw("failed to open %s: %d", path, errno);
+      return EXIT_FAILURE;
+    }
+
+  topics  = calloc(UORB_LOG_MAX_TOPICS, sizeof(struct replay_topic_s));
+  payload = malloc(UINT16_MAX);
+  if (topics == NULL || payload == NULL)
+    {
+      goto errout;
+    }
+
+  for (i = 0; i < UORB_LOG_MAX_TOPICS; i++)
+    {
+      topics[i].fd = -1;
+    }
+
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, UORB_LOG_MAGIC, sizeof(UORB_LOG_MAGIC)) != 0 ||
+      header.version != UORB_LOG_VERSION)
+    {
+      uorbinfo_raw("%s is not a uORB log", path);
+      goto errout;
+    }
+
+  /* Advertise the recorded topics */
+
+  for (i = 0; i < header.ntopics; i++)
+    {
+      if (replay_read(file, &hdr, payload) < 0 ||
+          hdr.type != UORB_LOG_TOPIC || hdr.size <= sizeof(*desc))
+        {
+          uorbinfo_raw("bad topic record %d", i);
+          goto errout;
+        }
+
+      desc  = (FAR struct uorb_log_topic_s *)payload;
+      topic = &topics[hdr.id];
+      strlcpy(topic->name, (FAR const char *)(desc + 1),
+              sizeof(topic->name));
+      topic->instance = desc->instance;
+
+      /* Prefer the metadata of this build, it carries the format and the
+       * print callback.  A topic that is unknown or has changed its size
+       * is published with the metadata rebuilt from the log.
+       */
+
+      topic->meta = orb_get_meta(topic->name);
+      if (topic->meta == NULL || topic->meta->o_size != desc->size)
+        {
+          topic->rebuilt.o_name = topic->name;
+          topic->rebuilt.o_size = desc->size;
+          topic->meta           = &topic->rebuilt;
+        }
+
+      topic->fd = orb_advertise_multi_queue(topic->meta, NULL,
+                                            new_instance ? NULL :
+                                            &topic->instance,
+                                            desc->queue);
+      if (topic->fd < 0)
+        {
+          uorbinfo_raw("advertise %s%d failed: %d", topic->name,
+                       topic->instance, errno);
+          goto errout;
+        }
+    }
+
+  if (start_sec > 0 && header.start != 0)
+    {
+      replay_seek(file, &header, header.start + start_sec * 1000000ull,
+                  payload);
+    }
+
+  /* Publish the samples */
+
+  real_start = orb_absolute_time();
+
+  while (!g_should_exit)
+    {
+      ret = replay_read(file, &hdr, payload);
+      if (ret == -ENODATA || (ret == 0 && hdr.type == UORB_LOG_INDEX))
+        {
+          ret = EXIT_SUCCESS;
+          break;
+        }
+      else if (ret < 0)
+        {
+          uorbinfo_raw("read failed: %d", ret);
+          ret = EXIT_FAILURE;
+          break;
+        }
+
+      topic = &topics[hdr.id];
+      if (hdr.type != UORB_LOG_DATA || topic->fd < 0 ||
+          hdr.size != sizeof(timestamp) + topic->meta->o_size)
+        {
+          continue;
+        }
+
+      memcpy(&timestamp, payload, sizeof(timestamp));
+      if (log_start == 0)
+        {
+          log_start = timestamp;
+        }
+
+      replay_wait(timestamp, log_start, real_start, speed);
+
+      /* Move the sample's own timestamp to the replay time */
+
+      sample = payload + sizeof(timestamp);
+      if (topic->meta->o_size >= sizeof(timestamp) &&
+          memcmp(sample, &timestamp, sizeof(timestamp)) == 0)
+        {
+          timestamp = orb_absolute_time();
+          memcpy(sample, &timestamp, sizeof(timestamp));
+        }
+
+      orb_publish_multi(topic->fd, sample, topic->meta->o_size);
+      topic->count++;
+    }
+
+  for (i = 0; i < UORB_LOG_MAX_TOPICS; i++)
+    {
+      if (topics[i].fd >= 0)
+        {
+          uorbinfo_raw("%s%d: %lu samples", topics[i].name,
+                       topics[i].instance, topics[i].count);
+        }
+    }
+
+errout:
+  if (topics != NULL)
+    {
+      for (i = 0; i < UORB_LOG_MAX_TOPICS; i++)
+        {
+          if (topics[i].fd >= 0)
+            {
+              orb_unadvertise(topics[i].fd);
+            }
+        }
+    }
+
+  free(payload);
+  free(topics);
+  fclose(file);
+  return ret;
+}
@@ -23,6 +23,7 @@
  ****************************************************************************/
 
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
 #include <poll.h>
 #include <string.h>
@@ -33,6 +34,10 @@
 
 #include "utility.h"
 
+#ifdef CONFIG_UORB_DISPATCHER
+#  include <uORB/dispatcher.h>
+#endif
+
 /****************************************************************************
  * Private Data
  ****************************************************************************/
@@ -1003,6 +1008,168 @@ static int test_queue_poll_notify(void)
   return OK;
 }
 
+static int test_batch(void)
+{
+  const int queue_size  = 8;
+  const int overflow_by = 3;
+  struct orb_test_medium_s sample;
+  struct orb_test_medium_s batch[8];
+  struct orb_batch_info info;
+  struct orb_state state;
+  int instance = 0;
+  size_t n;
+  int afd;
+  int sfd;
+  int i;
+
+  test_note("Testing orb batch copy");
+
+  memset(&info, 0, sizeof(info));
+
+  afd = orb_advertise_multi_queue(ORB_ID(orb_test_medium_batch), NULL,
+                                  &instance, queue_size);
+  if (afd < 0)
+    {
+      return test_fail("advertise failed: %d", errno);
+    }
+
+  sfd = orb_subscribe(ORB_ID(orb_test_medium_batch));
+  if (sfd < 0)
+    {
+      return test_fail("subscribe failed: %d", errno);
+    }
+
+  for (i = 0; i < queue_size / 2; i++)
+    {
+      sample.val = i;
+      orb_publish(ORB_ID(orb_test_medium_batch), afd, &sample);
+    }
+
+  if (OK != orb_copy_batch(sfd, batch, queue_size, &n, &info))
+    {
+      return test_fail("batch(1) failed: %d", errno);
+    }
+
+  if (n != queue_size / 2 || info.lost != 0)
+    {
+      return test_fail("batch(1) got %zu lost %" PRIu64, n, info.lost);
+    }
+
+  /* The last copied element has the generation of the topic */
+
+  if (OK != orb_get_state(sfd, &state) ||
+      info.first + n - 1 != state.generation)
+    {
+      return test_fail("batch(1) first %" PRIu64 " generation %" PRIu64,
+                       info.first, state.generation);
+    }
+
+  for (i = 0; i < (int)n; i++)
+    {
+      if (batch[i].val != i)
+        {
+          return test_fail("batch(1) element %d is %d", i, batch[i].val);
+        }
+    }
+
+  /* overflow the queue, the oldest elements must be reported lost */
+
+  for (i = 0; i < queue_size + overflow_by; i++)
+    {
+      sample.val = i;
+      orb_publish(ORB_ID(orb_test_medium_batch), afd, &sample);
+    }
+
+  if (OK != orb_copy_batch(sfd, batch, queue_size, &n, &info))
+    {
+      return test_fail("batch(2) failed: %d", errno);
+    }
+
+  if (n != queue_size || info.lost != overflow_by ||
+      batch[0].val != overflow_by)
+    {
+      return test_fail("batch(2) got %zu lost %" PRIu64 " first %d",
+                       n, info.lost, batch[0].val);
+    }
+
+  orb_unadvertise(afd);
+  orb_unsubscribe(sfd);
+
+  return test_note("PASS orb batch copy");
+}
+
+#ifdef CONFIG_UORB_DISPATCHER
+static void dispatcher_cb(FAR void *arg, FAR const void *data, size_t n,
+                          FAR const struct orb_batch_info *info)
+{
+  FAR const struct orb_test_medium_s *samples = data;
+  FAR int *order = arg;
+
+  /* Record the sample values in call order */
+
+  order[order[0]++ + 1] = samples[n - 1].val;
+}
+
+static int test_dispatcher(void)
+{
+  struct orb_dispatcher_s disp;
+  struct orb_test_medium_s sample;
+  int order[4];
+  int instance0 = 0;
+  int instance1 = 1;
+  int afd0;
+  int afd1;
+  int ret;
+
+  test_note("Testing orb dispatcher");
+
+  memset(order, 0, sizeof(order));
+
+  afd0 = orb_advertise_multi_queue(ORB_ID(orb_test_medium_batch), NULL,
+                                   &instance0, 1);
+  afd1 = orb_advertise_multi_queue(ORB_ID(orb_test_medium_batch), NULL,
+                                   &instance1, 1);
+  if (afd0 < 0 || afd1 < 0)
+    {
+      return test_fail("advertise failed: %d", errno);
+    }
+
+  ret = orb_dispatcher_init(&disp, 2);
+  if (ret < 0)
+    {
+      return test_fail("dispatcher init failed: %d", ret);
+    }
+
+  if (orb_dispatcher_add(&disp, ORB_ID(orb_test_medium_batch), 0, 1, 0, 0,
+                         dispatcher_cb, order) < 0 ||
+      orb_dispatcher_add(&disp, ORB_ID(orb_test_medium_batch), 1, 2, 0, 0,
+                         dispatcher_cb, order) < 0)
+    {
+      return test_fail("dispatcher add failed");
+    }
+
+  sample.val = 100;
+  orb_publish(ORB_ID(orb_test_medium_batch), afd0, &sample);
+  sample.val = 200;
+  orb_publish(ORB_ID(orb_test_medium_batch), afd1, &sample);
+
+  /* The higher priority instance 1 must be dispatched first */
+
+  ret = orb_dispatcher_run_once(&disp, 1000);
+  if (ret != 2 || order[0] != 2 || order[1] != 200 || order[2] != 100)
+    {
+      return test_fail("dispatch got %d callbacks, order %d %d",
+                       ret, order[1], order[2]);
+    }
+
+  orb_dispatcher_deinit(&disp);
+  orb_unadvertise(afd0);
+  orb_unadvertise(afd1);
+
+  return test_note("PASS orb dispatcher");
+}
+#endif
+
 static int test(void)
 {
   int afds[4];
@@ -1051,6 +1218,20 @@ static int test(void)
       return ret;
     }
 
+  ret = test_batch();
+  if (ret != OK)
+    {
+      return ret;
+    }
+
+#ifdef CONFIG_UORB_DISPATCHER
+  ret = test_dispatcher();
+  if (ret != OK)
+    {
+      return ret;
+    }
+#endif
+
   return test_queue_poll_notify();
 }
 
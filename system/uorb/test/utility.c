@@ -82,6 +82,8 @@ ORB_DEFINE(orb_test_medium_queue, struct orb_test_medium_s,
            print_orb_test_medium_msg);
 ORB_DEFINE(orb_test_medium_queue_poll, struct orb_test_medium_s,
            print_orb_test_medium_msg);
+ORB_DEFINE(orb_test_medium_batch, struct orb_test_medium_s,
+           print_orb_test_medium_msg);
 ORB_DEFINE(orb_test_large, struct orb_test_large_s,
            print_orb_test_large_msg);
 
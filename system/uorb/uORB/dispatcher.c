@@ -0,0 +1,342 @@
+/****************************************************************************
+ * apps/system/uorb/uORB/dispatcher.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <uORB/dispatcher.h>
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: orb_dispatcher_find
+ ****************************************************************************/
+
+static int orb_dispatcher_find(FAR struct orb_dispatcher_s *disp, int fd)
+{
+  int i;
+
+  for (i = 0; i < disp->nsubs; i++)
+    {
+      if (disp->fds[i].fd == fd)
+        {
+          return i;
+        }
+    }
+
+  return -ENOENT;
+}
+
+/****************************************************************************
+ * Name: orb_dispatcher_grow
+ *
+ * Description:
+ *   Make the sample buffer hold bufneed bytes.  It is not moved while a
+ *   callback runs, since the callback's data points into it.
+ ****************************************************************************/
+
+static int orb_dispatcher_grow(FAR struct orb_dispatcher_s *disp)
+{
+  FAR uint8_t *buffer;
+
+  if (disp->bufneed <= disp->buflen || disp->dispatching)
+    {
+      return 0;
+    }
+
+  buffer = realloc(disp->buffer, disp->bufneed);
+  if (buffer == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  disp->buffer = buffer;
+  disp->buflen = disp->bufneed;
+  return 0;
+}
+
+/****************************************************************************
+ * Name: orb_dispatcher_dispatch
+ *
+ * Description:
+ *   Copy all queued samples of a subscription and run its callback.
+ ****************************************************************************/
+
+static int orb_dispatcher_dispatch(FAR struct orb_dispatcher_s *disp,
+                                   int i)
+{
+  FAR struct orb_dispatch_sub_s *sub = &disp->subs[i];
+  size_t n;
+  int ret;
+
+  ret = orb_copy_batch(disp->fds[i].fd, disp->buffer, sub->nbuffer, &n,
+                       &sub->info);
+  if (ret < 0)
+    {
+      return -errno;
+    }
+
+  if (sub->info.lost > 0)
+    {
+      uorbwarn("%s lost %" PRIu64, sub->meta->o_name, sub->info.lost);
+    }
+
+  if (n > 0)
+    {
+      disp->dispatching = true;
+      sub->cb(sub->arg, disp->buffer, n, &sub->info);
+      disp->dispatching = false;
+    }
+
+  return n > 0;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int orb_dispatcher_init(FAR struct orb_dispatcher_s *disp, int maxsubs)
+{
+  memset(disp, 0, sizeof(*disp));
+
+  disp->subs = calloc(maxsubs, sizeof(struct orb_dispatch_sub_s));
+  disp->fds  = calloc(maxsubs, sizeof(struct pollfd));
+  if (disp->subs == NULL || disp->fds == NULL)
+    {
+      free(disp->subs);
+      free(disp->fds);
+      return -ENOMEM;
+    }
+
+  disp->maxsubs = maxsubs;
+  return 0;
+}
+
+void orb_dispatcher_deinit(FAR struct orb_dispatcher_s *disp)
+{
+  int i;
+
+  for (i = 0; i < disp->nsubs; i++)
+    {
+      orb_unsubscribe(disp->fds[i].fd);
+    }
+
+  free(disp->buffer);
+  free(disp->fds);
+  free(disp->subs);
+  memset(disp, 0, sizeof(*disp));
+}
+
+int orb_dispatcher_add(FAR struct orb_dispatcher_s *disp,
+                       FAR const struct orb_metadata *meta, int instance,
+                       int priority, unsigned interval, unsigned batch,
+                       orb_dispatch_cb_t cb, FAR void *arg)
+{
+  FAR struct orb_dispatch_sub_s *sub;
+  struct orb_state state;
+  size_t len;
+  int fd;
+  int i;
+
+  if (cb == NULL)
+    {
+      return -EINVAL;
+    }
+
+  if (disp->nsubs == disp->maxsubs)
+    {
+      return -ENOSPC;
+    }
+
+  fd = orb_subscribe_multi(meta, instance);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  if (interval != 0)
+    {
+      orb_set_interval(fd, interval);
+    }
+
+  if (batch != 0)
+    {
+      orb_set_batch_interval(fd, batch);
+    }
+
+  /* Every callback gets all samples the topic can queue */
+
+  if (orb_get_state(fd, &state) < 0 || state.queue_size == 0)
+    {
+      state.queue_size = 1;
+    }
+
+  /* Added from a callback, the buffer grows before the next poll() */
+
+  len = state.queue_size * meta->o_size;
+  if (len > disp->bufneed)
+    {
+      disp->bufneed = len;
+      if (orb_dispatcher_grow(disp) < 0)
+        {
+          disp->bufneed = disp->buflen;
+          orb_unsubscribe(fd);
+          return -ENOMEM;
+        }
+    }
+
+  /* Keep subscriptions sorted by decreasing priority, so the callbacks of
+   * updates found by the same poll() run in priority order.
+   */
+
+  for (i = disp->nsubs; i > 0 && disp->subs[i - 1].priority < priority;
+       i--)
+    {
+      disp->subs[i] = disp->subs[i - 1];
+      disp->fds[i]  = disp->fds[i - 1];
+    }
+
+  sub = &disp->subs[i];
+  memset(sub, 0, sizeof(*sub));
+  sub->meta     = meta;
+  sub->cb       = cb;
+  sub->arg      = arg;
+  sub->nbuffer  = state.queue_size;
+  sub->priority = priority;
+  sub->batch    = batch != 0;
+
+  disp->fds[i].fd      = fd;
+  disp->fds[i].events  = POLLIN;
+  disp->fds[i].revents = 0;
+  disp->nsubs++;
+
+  return fd;
+}
+
+int orb_dispatcher_remove(FAR struct orb_dispatcher_s *disp, int fd)
+{
+  int i;
+
+  i = orb_dispatcher_find(disp, fd);
+  if (i < 0)
+    {
+      return i;
+    }
+
+  /* Drop the batch request so the hardware FIFO is not kept running */
+
+  if (disp->subs[i].batch)
+    {
+      orb_set_batch_interval(fd, 0);
+    }
+
+  orb_unsubscribe(fd);
+
+  disp->nsubs--;
+  for (; i < disp->nsubs; i++)
+    {
+      disp->subs[i] = disp->subs[i + 1];
+      disp->fds[i]  = disp->fds[i + 1];
+    }
+
+  return 0;
+}
+
+int orb_dispatcher_run_once(FAR struct orb_dispatcher_s *disp, int timeout)
+{
+  int nsubs = disp->nsubs;
+  int count = 0;
+  int ret;
+  int i;
+
+  ret = orb_dispatcher_grow(disp);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  ret = poll(disp->fds, nsubs, timeout);
+  if (ret <= 0)
+    {
+      return ret < 0 ? -errno : 0;
+    }
+
+  for (i = 0; i < nsubs && !disp->stop; i++)
+    {
+      if (!(disp->fds[i].revents & POLLIN))
+        {
+          continue;
+        }
+
+      ret = orb_dispatcher_dispatch(disp, i);
+      if (ret < 0)
+        {
+          uorberr("%s dispatch failed %d", disp->subs[i].meta->o_name,
+                  ret);
+          continue;
+        }
+
+      count += ret;
+
+      /* A callback changed the subscriptions, poll again */
+
+      if (disp->nsubs != nsubs)
+        {
+          break;
+        }
+    }
+
+  return count;
+}
+
+int orb_dispatcher_run(FAR struct orb_dispatcher_s *disp)
+{
+  int ret = 0;
+
+  disp->stop = false;
+
+  while (!disp->stop)
+    {
+      ret = orb_dispatcher_run_once(disp, CONFIG_UORB_DISPATCHER_TIMEOUT);
+      if (ret == -EINTR)
+        {
+          continue;
+        }
+      else if (ret < 0)
+        {
+          return ret;
+        }
+    }
+
+  return 0;
+}
+
+void orb_dispatcher_stop(FAR struct orb_dispatcher_s *disp)
+{
+  disp->stop = true;
+}
@@ -0,0 +1,193 @@
+/****************************************************************************
+ * apps/system/uorb/uORB/dispatcher.h
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __APP_SYSTEM_UORB_UORB_DISPATCHER_H
+#define __APP_SYSTEM_UORB_UORB_DISPATCHER_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <poll.h>
+
+#include <uORB/uORB.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Subscription callback.  data holds n samples, oldest first, and info
+ * the generation of the first one and the samples lost before it.
+ */
+
+typedef CODE void (*orb_dispatch_cb_t)(FAR void *arg, FAR const void *data,
+                                       size_t n,
+                                       FAR const struct orb_batch_info *info);
+
+struct orb_dispatch_sub_s
+{
+  FAR const struct orb_metadata *meta;      /* Subscribed topic */
+  orb_dispatch_cb_t              cb;        /* Callback */
+  FAR void                      *arg;       /* Callback argument */
+  struct orb_batch_info          info;      /* Generation accounting */
+  unsigned int                   nbuffer;   /* Samples per callback */
+  int                            priority;  /* Higher runs first */
+  bool                           batch;     /* Batch interval was set */
+};
+
+struct orb_dispatcher_s
+{
+  FAR struct orb_dispatch_sub_s *subs;      /* Sorted by priority */
+  FAR struct pollfd             *fds;       /* Same order as subs */
+  FAR uint8_t                   *buffer;    /* Samples of one callback */
+  size_t                         buflen;
+  size_t                         bufneed;   /* buflen once grown */
+  int                            nsubs;
+  int                            maxsubs;
+  bool                           dispatching; /* A callback is running */
+  volatile bool                  stop;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: orb_dispatcher_init
+ *
+ * Description:
+ *   Initialize a dispatcher that serves up to maxsubs subscriptions from
+ *   one thread with a single poll().
+ *
+ *   Subscriptions may only be added or removed while the dispatcher is
+ *   not running, or from its callbacks.
+ *
+ * Input Parameters:
+ *   disp     The dispatcher.
+ *   maxsubs  Maximum number of subscriptions.
+ *
+ * Returned Value:
+ *   0 on success, otherwise a negative errno.
+ ****************************************************************************/
+
+int orb_dispatcher_init(FAR struct orb_dispatcher_s *disp, int maxsubs);
+
+/****************************************************************************
+ * Name: orb_dispatcher_deinit
+ *
+ * Description:
+ *   Unsubscribe all topics and free the dispatcher resources.
+ ****************************************************************************/
+
+void orb_dispatcher_deinit(FAR struct orb_dispatcher_s *disp);
+
+/****************************************************************************
+ * Name: orb_dispatcher_add
+ *
+ * Description:
+ *   Subscribe to a topic instance and register its callback.
+ *
+ *   The callbacks of the subscriptions that one poll() finds ready run in
+ *   order of decreasing priority.  The priority only orders those
+ *   callbacks: a running callback is not preempted, and an update that
+ *   arrives meanwhile waits for the next poll() whatever its priority.
+ *   Every callback receives all samples queued for its subscription at
+ *   once.
+ *
+ * Input Parameters:
+ *   disp       The dispatcher.
+ *   meta       The uORB metadata (usually from the ORB_ID() macro)
+ *   instance   The instance of the topic.
+ *   priority   Callback priority, higher runs first.
+ *   interval   Minimum update interval in us (orb_set_interval()), or 0.
+ *   batch      Batch interval in us (orb_set_batch_interval()), or 0.
+ *   cb         The callback.
+ *   arg        The callback argument.
+ *
+ * Returned Value:
+ *   The subscription fd on success, otherwise a negative errno.
+ ****************************************************************************/
+
+int orb_dispatcher_add(FAR struct orb_dispatcher_s *disp,
+                       FAR const struct orb_metadata *meta, int instance,
+                       int priority, unsigned interval, unsigned batch,
+                       orb_dispatch_cb_t cb, FAR void *arg);
+
+/****************************************************************************
+ * Name: orb_dispatcher_remove
+ *
+ * Description:
+ *   Unsubscribe a subscription returned by orb_dispatcher_add().
+ *
+ * Returned Value:
+ *   0 on success, -ENOENT if fd is not a subscription of disp.
+ ****************************************************************************/
+
+int orb_dispatcher_remove(FAR struct orb_dispatcher_s *disp, int fd);
+
+/****************************************************************************
+ * Name: orb_dispatcher_run_once
+ *
+ * Description:
+ *   Wait for updates and run the callbacks of all ready subscriptions.
+ *
+ * Input Parameters:
+ *   disp     The dispatcher.
+ *   timeout  Maximum wait time in ms, negative to wait forever.
+ *
+ * Returned Value:
+ *   The number of callbacks that ran, otherwise a negative errno.
+ ****************************************************************************/
+
+int orb_dispatcher_run_once(FAR struct orb_dispatcher_s *disp, int timeout);
+
+/****************************************************************************
+ * Name: orb_dispatcher_run
+ *
+ * Description:
+ *   Run callbacks until orb_dispatcher_stop() is called.
+ *
+ * Returned Value:
+ *   0 when stopped, otherwise a negative errno.
+ ****************************************************************************/
+
+int orb_dispatcher_run(FAR struct orb_dispatcher_s *disp);
+
+/****************************************************************************
+ * Name: orb_dispatcher_stop
+ *
+ * Description:
+ *   Make orb_dispatcher_run() return.  May be called from a callback or
+ *   a signal handler; other threads are noticed within
+ *   CONFIG_UORB_DISPATCHER_TIMEOUT ms.
+ ****************************************************************************/
+
+void orb_dispatcher_stop(FAR struct orb_dispatcher_s *disp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __APP_SYSTEM_UORB_UORB_DISPATCHER_H */
@@ -24,6 +24,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
 #include <sys/ioctl.h>
@@ -199,6 +200,82 @@ ssize_t orb_copy_multi(int fd, FAR void *buffer, size_t len)
   return read(fd, buffer, len);
 }
 
+int orb_copy_batch(int fd, FAR void *buffer, size_t maxn, FAR size_t *n,
+                   FAR struct orb_batch_info *info)
+{
+  struct sensor_state_s before;
+  struct sensor_state_s after;
+  uint64_t oldest;
+  ssize_t ret;
+  bool more;
+
+  *n = 0;
+
+  ret = ioctl(fd, SNIOC_GET_STATE, (unsigned long)(uintptr_t)&before);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  if (before.esize == 0)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  ret = orb_copy_multi(fd, buffer, maxn * before.esize);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  *n = ret / before.esize;
+  if (info == NULL)
+    {
+      return 0;
+    }
+
+  ret = ioctl(fd, SNIOC_GET_STATE, (unsigned long)(uintptr_t)&after);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  ret = orb_check(fd, &more);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  /* If the queue was drained and nothing was published meanwhile, the
+   * copied elements are the newest ones.  Otherwise they start at the
+   * oldest element still queued.  Generations count from 1, as in
+   * SNIOC_GET_STATE.
+   */
+
+  if (!more && after.generation == before.generation)
+    {
+      info->first = before.generation - *n + 1;
+    }
+  else
+    {
+      oldest = before.generation > before.nbuffer ?
+               before.generation - before.nbuffer + 1 : 1;
+      info->first = info->next > oldest ? info->next : oldest;
+    }
+
+  info->lost = info->next != 0 && info->first > info->next ?
+               info->first - info->next : 0;
+  if (info->lost > 0)
+    {
+      uorbinfo("lost generations %" PRIu64 "..%" PRIu64,
+               info->next, info->first - 1);
+    }
+
+  info->next = info->first + *n;
+  return 0;
+}
+
 int orb_get_state(int fd, FAR struct orb_state *state)
 {
   struct sensor_state_s tmp;
@@ -72,6 +72,22 @@ struct orb_object
 
 typedef uint64_t orb_abstime;
 
+/* Generation accounting of orb_copy_batch() */
+
+struct orb_batch_info
+{
+  uint64_t next;                /* In: generation expected next, 0 if not
+                                 * known yet.  Out: updated for the next
+                                 * call.
+                                 */
+  uint64_t first;               /* Generation of the first copied element,
+                                 * the first element published is 1
+                                 */
+  uint64_t lost;                /* Elements overwritten before they were
+                                 * copied, generations [next, first)
+                                 */
+};
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
@@ -452,6 +468,35 @@ static inline int orb_copy(FAR const struct orb_metadata *meta,
   return ret == meta->o_size ? 0 : -1;
 }
 
+/****************************************************************************
+ * Name: orb_copy_batch
+ *
+ * Description:
+ *   Fetch up to maxn queued elements of a topic with one read() instead of
+ *   one orb_copy_multi() per element.  The elements are copied oldest
+ *   first; element i has generation (info->first + i) and, as with every
+ *   topic, its own timestamp.  Generations count from 1, like the
+ *   generation of orb_get_state().
+ *
+ *   If info is given, elements that were overwritten in the topic queue
+ *   since the previous call are reported.  The accounting is exact when
+ *   the call drains the queue, so maxn should not be less than the queue
+ *   size of the topic.
+ *
+ * Input Parameters:
+ *   fd       A fd returned from orb_subscribe.
+ *   buffer   Pointer to the buffer receiving maxn elements.
+ *   maxn     Maximum number of elements to copy.
+ *   n        Returned number of copied elements.
+ *   info     Generation accounting, or NULL.
+ *
+ * Returned Value:
+ *   0 on success, -1 otherwise with errno set accordingly.
+ ****************************************************************************/
+
+int orb_copy_batch(int fd, FAR void *buffer, size_t maxn, FAR size_t *n,
+                   FAR struct orb_batch_info *info);
+
 /****************************************************************************
  * Name: orb_get_state
  *
@@ -0,0 +1,145 @@
+/****************************************************************************
+ * apps/testing/focbench/focbench.h
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TESTING_FOCBENCH_FOCBENCH_H
+#define __APPS_TESTING_FOCBENCH_FOCBENCH_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Motor model parameters.  The inertia is small so that the motor covers
+ * the whole speed range up to the voltage limit during one run.
+ */
+
+#define FOCBENCH_MODEL_POLES   (7)
+#define FOCBENCH_MODEL_RES     (0.11f)
+#define FOCBENCH_MODEL_IND     (0.0002f)
+#define FOCBENCH_MODEL_INER    (0.00002f)
+#define FOCBENCH_MODEL_FLUX    (0.001f)
+#define FOCBENCH_MODEL_IADC    (0.001f)
+
+/* Current controller bandwidth [rad/s] */
+
+#define FOCBENCH_CTRL_BW       (2000.0f)
+
+/* Observers configuration */
+
+#define FOCBENCH_ONFO_GAIN     (30000.0f)
+#define FOCBENCH_ONFO_GAINSLOW (0.5f)
+#define FOCBENCH_OSMO_KSLIDE   (0.99f)
+#define FOCBENCH_OSMO_ERRMAX   (0.99f)
+#define FOCBENCH_ODIV_SAMPLES  (10)
+#define FOCBENCH_ODIV_FILTER   (0.8f)
+#define FOCBENCH_OPLL_KP       (1000.0f)
+#define FOCBENCH_OPLL_KI       (0.0f)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Angle source */
+
+enum focbench_ang_e
+{
+  FOCBENCH_ANG_SENSOR = 0,      /* Ideal sensor (model rotor angle) */
+  FOCBENCH_ANG_ONFO   = 1,      /* Nonlinear flux observer */
+  FOCBENCH_ANG_OSMO   = 2,      /* Sliding mode observer */
+  FOCBENCH_ANG_NUM
+};
+
+/* Velocity observer */
+
+enum focbench_vel_e
+{
+  FOCBENCH_VEL_NONE = 0,        /* No velocity observer */
+  FOCBENCH_VEL_ODIV = 1,        /* DIV velocity observer */
+  FOCBENCH_VEL_OPLL = 2,        /* PLL velocity observer */
+  FOCBENCH_VEL_NUM
+};
+
+/* Benchmark configuration */
+
+struct focbench_cfg_s
+{
+  uint32_t steps;               /* Number of control steps */
+  uint32_t decim;               /* Trace decimation */
+  float    per;                 /* Control period [s] */
+  float    vbus;                /* Bus voltage [V] */
+  float    iq_ref;              /* Q current reference [A] */
+};
+
+/* One trace sample */
+
+struct focbench_sample_s
+{
+  float iq;                     /* Q current */
+  float id;                     /* D current */
+  float ang_err;                /* Observer angle error [rad] */
+  float vel;                    /* Observer velocity [rad/s] */
+};
+
+/* Benchmark result */
+
+struct focbench_res_s
+{
+  uint64_t                      handler;  /* Handler ticks sum */
+  uint64_t                      angle;    /* Angle observer ticks sum */
+  uint64_t                      vel;      /* Velocity observer ticks sum */
+  uint32_t                      steps;    /* Executed steps */
+  float                         iq_rms;   /* Q current error RMS */
+  float                         id_rms;   /* D current error RMS */
+  float                         ang_rms;  /* Angle error RMS */
+  FAR struct focbench_sample_s *trace;    /* Trace buffer */
+  uint32_t                      ntrace;   /* Trace buffer capacity */
+  uint32_t                      nsamples; /* Trace samples recorded */
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+#ifdef CONFIG_INDUSTRY_FOC_FLOAT
+/****************************************************************************
+ * Name: focbench_run_f32
+ ****************************************************************************/
+
+int focbench_run_f32(FAR struct focbench_cfg_s *cfg, int ang, int vel,
+                     FAR struct focbench_res_s *res);
+#endif
+
+#ifdef CONFIG_INDUSTRY_FOC_FIXED16
+/****************************************************************************
+ * Name: focbench_run_b16
+ ****************************************************************************/
+
+int focbench_run_b16(FAR struct focbench_cfg_s *cfg, int ang, int vel,
+                     FAR struct focbench_res_s *res);
+#endif
+
+#endif /* __APPS_TESTING_FOCBENCH_FOCBENCH_H */
@@ -0,0 +1,527 @@
+/****************************************************************************
+ * apps/testing/focbench/focbench_b16.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <nuttx/arch.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <fixedmath.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <dspb16.h>
+
+#include "industry/foc/foc_common.h"
+#include "industry/foc/fixed16/foc_angle.h"
+#include "industry/foc/fixed16/foc_handler.h"
+#include "industry/foc/fixed16/foc_model.h"
+#include "industry/foc/fixed16/foc_velocity.h"
+
+#include "focbench.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Benchmark instance data */
+
+struct focbench_b16_s
+{
+  foc_handler_b16_t  handler;   /* FOC handler */
+  foc_model_b16_t    model;     /* PMSM model */
+  foc_angle_b16_t    angle;     /* Angle observer */
+  foc_velocity_b16_t vel;       /* Velocity observer */
+  bool               ang_en;    /* Angle observer initialized */
+  bool               vel_en;    /* Velocity observer initialized */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: focbench_angle_init_b16
+ ****************************************************************************/
+
+static int focbench_angle_init_b16(FAR struct focbench_b16_s *fb,
+                                   FAR struct focbench_cfg_s *cfg, int ang)
+{
+#ifdef CONFIG_INDUSTRY_FOC_ANGLE_ONFO
+  struct foc_angle_onfo_cfg_b16_s onfo_cfg;
+#endif
+#ifdef CONFIG_INDUSTRY_FOC_ANGLE_OSMO
+  struct foc_angle_osmo_cfg_b16_s osmo_cfg;
+#endif
+  int ret = OK;
+
+  switch (ang)
+    {
+      case FOCBENCH_ANG_SENSOR:
+        {
+          return OK;
+        }
+
+#ifdef CONFIG_INDUSTRY_FOC_ANGLE_ONFO
+      case FOCBENCH_ANG_ONFO:
+        {
+          ret = foc_angle_init_b16(&fb->angle, &g_foc_angle_onfo_b16);
+          if (ret < 0)
+            {
+              return ret;
+            }
+
+          onfo_cfg.per       = ftob16(cfg->per);
+          onfo_cfg.gain      = ftob16(FOCBENCH_ONFO_GAIN);
+          onfo_cfg.gain_slow = ftob16(FOCBENCH_ONFO_GAINSLOW);
+          motor_phy_params_init_b16(&onfo_cfg.phy,
+                                    FOCBENCH_MODEL_POLES,
+                                    ftob16(FOCBENCH_MODEL_RES),
+                                    ftob16(FOCBENCH_MODEL_IND),
+                                    ftob16(FOCBENCH_MODEL_FLUX));
+
+          ret = foc_angle_cfg_b16(&fb->angle, &onfo_cfg);
+          break;
+        }
+#endif
+
+#ifdef CONFIG_INDUSTRY_FOC_ANGLE_OSMO
+      case FOCBENCH_ANG_OSMO:
+        {
+          ret = foc_angle_init_b16(&fb->angle, &g_foc_angle_osmo_b16);
+          if (ret < 0)
+            {
+              return ret;
+            }
+
+          osmo_cfg.per     = ftob16(cfg->per);
+          osmo_cfg.k_slide = ftob16(FOCBENCH_OSMO_KSLIDE);
+          osmo_cfg.err_max = ftob16(FOCBENCH_OSMO_ERRMAX);
+          motor_phy_params_init_b16(&osmo_cfg.phy,
+                                    FOCBENCH_MODEL_POLES,
+                                    ftob16(FOCBENCH_MODEL_RES),
+                                    ftob16(FOCBENCH_MODEL_IND),
+                                    ftob16(FOCBENCH_MODEL_FLUX));
+
+          ret = foc_angle_cfg_b16(&fb->angle, &osmo_cfg);
+          break;
+        }
+#endif
+
+      default:
+        {
+          return -ENOTSUP;
+        }
+    }
+
+  fb->ang_en = true;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: focbench_vel_init_b16
+ ****************************************************************************/
+
+static int focbench_vel_init_b16(FAR struct focbench_b16_s *fb,
+                                 FAR struct focbench_cfg_s *cfg, int vel)
+{
+#ifdef CONFIG_INDUSTRY_FOC_VELOCITY_ODIV
+  struct foc_vel_div_b16_cfg_s odiv_cfg;
+#endif
+#ifdef CONFIG_INDUSTRY_FOC_VELOCITY_OPLL
+  struct foc_vel_pll_b16_cfg_s opll_cfg;
+#endif
+  int ret = OK;
+
+  switch (vel)
+    {
+      case FOCBENCH_VEL_NONE:
+        {
+          return OK;
+        }
+
+#ifdef CONFIG_INDUSTRY_FOC_VELOCITY_ODIV
+      case FOCBENCH_VEL_ODIV:
+        {
+          ret = foc_velocity_init_b16(&fb->vel, &g_foc_velocity_odiv_b16);
+          if (ret < 0)
+            {
+              return ret;
+            }
+
+          odiv_cfg.samples = FOCBENCH_ODIV_SAMPLES;
+          odiv_cfg.filter  = ftob16(FOCBENCH_ODIV_FILTER);
+          odiv_cfg.per     = ftob16(cfg->per);
+
+          ret = foc_velocity_cfg_b16(&fb->vel, &odiv_cfg);
+          break;
+        }
+#endif
+
+#ifdef CONFIG_INDUSTRY_FOC_VELOCITY_OPLL
+      case FOCBENCH_VEL_OPLL:
+        {
+          ret = foc_velocity_init_b16(&fb->vel, &g_foc_velocity_opll_b16);
+          if (ret < 0)
+            {
+              return ret;
+            }
+
+          opll_cfg.kp  = ftob16(FOCBENCH_OPLL_KP);
+          opll_cfg.ki  = ftob16(FOCBENCH_OPLL_KI);
+          opll_cfg.per = ftob16(cfg->per);
+
+          ret = foc_velocity_cfg_b16(&fb->vel, &opll_cfg);
+          break;
+        }
+#endif
+
+      default:
+        {
+          return -ENOTSUP;
+        }
+    }
+
+  fb->vel_en = true;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: focbench_init_b16
+ ****************************************************************************/
+
+static int focbench_init_b16(FAR struct focbench_b16_s *fb,
+                             FAR struct focbench_cfg_s *cfg,
+                             int ang, int vel)
+{
+  struct foc_initdata_b16_s       ctrl_cfg;
+  struct foc_mod_cfg_b16_s        mod_cfg;
+  struct foc_model_pmsm_cfg_b16_s pmsm_cfg;
+  int                             ret = OK;
+
+  memset(fb, 0, sizeof(struct focbench_b16_s));
+
+  /* Initialize observers first, so that not supported combinations are
+   * rejected before anything else is allocated
+   */
+
+  ret = focbench_angle_init_b16(fb, cfg, ang);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  ret = focbench_vel_init_b16(fb, cfg, vel);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  /* Initialize FOC handler */
+
+  ret = foc_handler_init_b16(&fb->handler,
+                             &g_foc_control_pi_b16,
+                             &g_foc_mod_svm3_b16);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  /* PI gains from the current loop bandwidth */
+
+  ctrl_cfg.id_kp = ftob16(FOCBENCH_MODEL_IND * FOCBENCH_CTRL_BW);
+  ctrl_cfg.id_ki = ftob16(FOCBENCH_MODEL_RES * FOCBENCH_CTRL_BW * cfg->per);
+  ctrl_cfg.iq_kp = ctrl_cfg.id_kp;
+  ctrl_cfg.iq_ki = ctrl_cfg.id_ki;
+
+  mod_cfg.pwm_duty_max = ftob16(0.95f);
+
+  foc_handler_cfg_b16(&fb->handler, &ctrl_cfg, &mod_cfg);
+
+  /* Initialize PMSM model */
+
+  ret = foc_model_init_b16(&fb->model, &g_foc_model_pmsm_ops_b16);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  pmsm_cfg.poles      = FOCBENCH_MODEL_POLES;
+  pmsm_cfg.res        = ftob16(FOCBENCH_MODEL_RES);
+  pmsm_cfg.ind        = ftob16(FOCBENCH_MODEL_IND);
+  pmsm_cfg.iner       = ftob16(FOCBENCH_MODEL_INER);
+  pmsm_cfg.flux_link  = ftob16(FOCBENCH_MODEL_FLUX);
+  pmsm_cfg.ind_d      = ftob16(FOCBENCH_MODEL_IND);
+  pmsm_cfg.ind_q      = ftob16(FOCBENCH_MODEL_IND);
+  pmsm_cfg.per        = ftob16(cfg->per);
+  pmsm_cfg.iphase_adc = ftob16(FOCBENCH_MODEL_IADC);
+
+  return foc_model_cfg_b16(&fb->model, &pmsm_cfg);
+}
+
+/****************************************************************************
+ * Name: focbench_deinit_b16
+ ****************************************************************************/
+
+static void focbench_deinit_b16(FAR struct focbench_b16_s *fb)
+{
+  if (fb->model.ops != NULL)
+    {
+      foc_model_deinit_b16(&fb->model);
+    }
+
+  if (fb->handler.ops.ctrl != NULL)
+    {
+      foc_handler_deinit_b16(&fb->handler);
+    }
+
+  if (fb->vel_en == true)
+    {
+      foc_velocity_deinit_b16(&fb->vel);
+    }
+
+  if (fb->ang_en == true)
+    {
+      foc_angle_deinit_b16(&fb->angle);
+    }
+}
+
+/****************************************************************************
+ * Name: focbench_angerr_b16
+ *
+ * Description:
+ *   Get the angle difference normalized to [-PI, PI)
+ *
+ ****************************************************************************/
+
+static float focbench_angerr_b16(b16_t a, b16_t b)
+{
+  float err = b16tof(a - b);
+
+  while (err >= M_PI_F)
+    {
+      err -= 2.0f * M_PI_F;
+    }
+
+  while (err < -M_PI_F)
+    {
+      err += 2.0f * M_PI_F;
+    }
+
+  return err;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: focbench_run_b16
+ *
+ * Description:
+ *   Run the fixed16 FOC controller in a closed loop with the PMSM model.
+ *
+ *   The handler is always driven with the model rotor angle.  Angle
+ *   observers run in shadow mode on the same controller state and only
+ *   their error is reported, because a sensorless start from standstill
+ *   requires the whole start-up routine which is not the subject of this
+ *   benchmark.
+ *
+ * Input Parameter:
+ *   cfg - benchmark configuration
+ *   ang - angle source (enum focbench_ang_e)
+ *   vel - velocity observer (enum focbench_vel_e)
+ *   res - benchmark result
+ *
+ * Returned Value:
+ *   OK on success, -ENOTSUP if the combination is not supported by the
+ *   current configuration, other negated errno on failure.
+ *
+ ****************************************************************************/
+
+int focbench_run_b16(FAR struct focbench_cfg_s *cfg, int ang, int vel,
+                     FAR struct focbench_res_s *res)
+{
+  struct focbench_b16_s           fb;
+  struct foc_model_state_b16_s    mstate;
+  struct foc_state_b16_s          fstate;
+  struct foc_handler_input_b16_s  hin;
+  struct foc_handler_output_b16_s hout;
+  struct foc_angle_in_b16_s       ain;
+  struct foc_angle_out_b16_s      aout;
+  struct foc_velocity_in_b16_s    vin;
+  struct foc_velocity_out_b16_s   vout;
+  dq_frame_b16_t                  dq_ref;
+  dq_frame_b16_t                  vdq_comp;
+  b16_t                           angle   = 0;
+  b16_t                           ang_obs = 0;
+  float                           ang_err = 0.0f;
+  float                           iq_err  = 0.0f;
+  float                           iq_sq   = 0.0f;
+  float                           id_sq   = 0.0f;
+  float                           ang_sq  = 0.0f;
+  uint32_t                        nerr    = 0;
+  uint32_t                        i       = 0;
+  clock_t                         t0      = 0;
+  clock_t                         t1      = 0;
+  int                             ret     = OK;
+
+  DEBUGASSERT(cfg);
+  DEBUGASSERT(res);
+  DEBUGASSERT(cfg->decim > 0);
+
+  ret = focbench_init_b16(&fb, cfg, ang, vel);
+  if (ret < 0)
+    {
+      goto errout;
+    }
+
+  memset(&fstate, 0, sizeof(fstate));
+  memset(&ain, 0, sizeof(ain));
+  memset(&aout, 0, sizeof(aout));
+  memset(&vin, 0, sizeof(vin));
+  memset(&vout, 0, sizeof(vout));
+
+  dq_ref.d   = 0;
+  dq_ref.q   = ftob16(cfg->iq_ref);
+  vdq_comp.d = 0;
+  vdq_comp.q = 0;
+
+  hin.dq_ref   = &dq_ref;
+  hin.vdq_comp = &vdq_comp;
+  hin.vbus     = ftob16(cfg->vbus);
+  hin.mode     = FOC_HANDLER_MODE_CURRENT;
+
+  ain.state = &fstate;
+  ain.dir   = DIR_CW_B16;
+  vin.state = &fstate;
+  vin.dir   = DIR_CW_B16;
+
+  res->handler  = 0;
+  res->angle    = 0;
+  res->vel      = 0;
+  res->steps    = 0;
+  res->nsamples = 0;
+  res->iq_rms   = 0.0f;
+  res->id_rms   = 0.0f;
+  res->ang_rms  = 0.0f;
+
+  for (i = 0; i < cfg->steps; i += 1)
+    {
+      /* Ideal sensor - the model rotor angle */
+
+      foc_model_state_b16(&fb.model, &mstate);
+
+      angle   = mstate.angle;
+      ang_obs = angle;
+
+      /* Angle observer in shadow mode */
+
+      if (fb.ang_en == true)
+        {
+          ain.angle = angle;
+          ain.vel   = mstate.omega_e;
+
+          t0 = up_perf_gettime();
+          foc_angle_run_b16(&fb.angle, &ain, &aout);
+          t1 = up_perf_gettime();
+
+          res->angle += (uint32_t)(t1 - t0);
+          ang_obs     = aout.angle;
+        }
+
+      /* Velocity observer on the observed angle */
+
+      if (fb.vel_en == true)
+        {
+          vin.angle = ang_obs;
+          vin.vel   = vout.velocity;
+
+          t0 = up_perf_gettime();
+          foc_velocity_run_b16(&fb.vel, &vin, &vout);
+          t1 = up_perf_gettime();
+
+          res->vel += (uint32_t)(t1 - t0);
+        }
+
+      /* Current controller */
+
+      hin.current = mstate.curr;
+      hin.angle   = angle;
+
+      t0 = up_perf_gettime();
+      ret = foc_handler_run_b16(&fb.handler, &hin, &hout);
+      t1 = up_perf_gettime();
+      if (ret < 0)
+        {
+          goto errout;
+        }
+
+      res->handler += (uint32_t)(t1 - t0);
+
+      foc_handler_state_b16(&fb.handler, &fstate);
+
+      /* Tracking accuracy after the start-up transient */
+
+      ang_err = focbench_angerr_b16(ang_obs, angle);
+
+      if (i >= cfg->steps / 2)
+        {
+          iq_err  = b16tof(fstate.idq.q) - cfg->iq_ref;
+          iq_sq  += iq_err * iq_err;
+          id_sq  += b16tof(fstate.idq.d) * b16tof(fstate.idq.d);
+          ang_sq += ang_err * ang_err;
+          nerr   += 1;
+        }
+
+      if (i % cfg->decim == 0 && res->nsamples < res->ntrace)
+        {
+          res->trace[res->nsamples].iq      = b16tof(fstate.idq.q);
+          res->trace[res->nsamples].id      = b16tof(fstate.idq.d);
+          res->trace[res->nsamples].ang_err = ang_err;
+          res->trace[res->nsamples].vel     = b16tof(vout.velocity);
+          res->nsamples += 1;
+        }
+
+      /* Plant */
+
+      foc_model_run_b16(&fb.model, 0, &fstate.vab);
+    }
+
+  res->steps = cfg->steps;
+
+  if (nerr > 0)
+    {
+      res->iq_rms  = sqrtf(iq_sq / nerr);
+      res->id_rms  = sqrtf(id_sq / nerr);
+      res->ang_rms = sqrtf(ang_sq / nerr);
+    }
+
+errout:
+  focbench_deinit_b16(&fb);
+  return ret;
+}
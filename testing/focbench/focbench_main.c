@@ -0,0 +1,608 @@
+/****************************************************************************
+ * apps/testing/focbench/focbench_main.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <nuttx/arch.h>
+
+#include <sys/param.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "focbench.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define FOCBENCH_STEPS_DEFAULT  (20000)
+#define FOCBENCH_DECIM_DEFAULT  (100)
+#define FOCBENCH_PER_DEFAULT    (0.0001f)
+#define FOCBENCH_VBUS_DEFAULT   (12.0f)
+#define FOCBENCH_IQ_DEFAULT     (1.0f)
+#define FOCBENCH_TOL_DEFAULT    (0.01f)
+
+/* Maximum allowed Q current tracking error (RMS) relative to the
+ * reference, plus an absolute floor for small references that covers the
+ * current sensor resolution.  This catches broken controllers even without
+ * golden traces.
+ */
+
+#define FOCBENCH_IQ_RMS_MAX     (0.1f)
+#define FOCBENCH_IQ_RMS_MIN     (0.01f)
+
+/* With both number types enabled, the f32 controller is the reference for
+ * the b16 one.  Both run the same algorithm on the same model, so their
+ * currents must agree within this tolerance.  The observers are not
+ * compared, they differ within their own accuracy.
+ */
+
+#if defined(CONFIG_INDUSTRY_FOC_FLOAT) && \
+    defined(CONFIG_INDUSTRY_FOC_FIXED16)
+#  define FOCBENCH_XREF
+#  define FOCBENCH_XREF_TOL     (0.05f)
+#endif
+
+#define FOCBENCH_LINE_MAX       (128)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Number type runner */
+
+struct focbench_type_s
+{
+  FAR const char *name;
+  CODE int (*run)(FAR struct focbench_cfg_s *cfg, int ang, int vel,
+                  FAR struct focbench_res_s *res);
+};
+
+/* Program arguments */
+
+struct focbench_args_s
+{
+  struct focbench_cfg_s cfg;    /* Benchmark configuration */
+  FAR const char       *type;   /* Number type filter */
+  FAR const char       *wpath;  /* Golden trace output */
+  FAR const char       *cpath;  /* Golden trace to check against */
+  float                 tol;    /* Golden trace tolerance */
+};
+
+#ifdef FOCBENCH_XREF
+/* f32 traces, the reference for b16 */
+
+struct focbench_xref_s
+{
+  FAR struct focbench_sample_s *trace;
+  uint32_t nsamples[FOCBENCH_ANG_NUM][FOCBENCH_VEL_NUM];
+};
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const struct focbench_type_s g_focbench_types[] =
+{
+#ifdef CONFIG_INDUSTRY_FOC_FLOAT
+  {
+    "f32", focbench_run_f32
+  },
+#endif
+#ifdef CONFIG_INDUSTRY_FOC_FIXED16
+  {
+    "b16", focbench_run_b16
+  },
+#endif
+};
+
+static FAR const char *g_focbench_ang[FOCBENCH_ANG_NUM] =
+{
+  "sensor", "onfo", "osmo"
+};
+
+static FAR const char *g_focbench_vel[FOCBENCH_VEL_NUM] =
+{
+  "none", "odiv", "opll"
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: show_usage
+ ****************************************************************************/
+
+static void show_usage(FAR const char *progname, int exitcode)
+{
+  printf("Usage: %s [-n steps] [-i iq] [-d decim] [-T f32|b16]\n"
+         "          [-w golden] [-c golden] [-t tol] [-h]\n",
+         progname);
+  printf("  -n  number of control steps (default %d)\n",
+         FOCBENCH_STEPS_DEFAULT);
+  printf("  -i  Q current reference [A]\n");
+  printf("  -d  trace decimation (default %d)\n",
+         FOCBENCH_DECIM_DEFAULT);
+  printf("  -T  run only the given number type\n");
+  printf("  -w  write the tracking traces to a golden file\n");
+  printf("  -c  check the tracking traces against a golden file\n");
+  printf("  -t  golden trace tolerance (default %.3f)\n",
+         FOCBENCH_TOL_DEFAULT);
+  printf("  -h  show this help\n");
+
+  exit(exitcode);
+}
+
+/****************************************************************************
+ * Name: focbench_ns
+ *
+ * Description:
+ *   Convert the perf counter ticks sum to nanoseconds per step
+ *
+ ****************************************************************************/
+
+static uint32_t focbench_ns(uint64_t ticks, uint32_t steps)
+{
+  uint64_t freq = up_perf_getfreq();
+
+  if (freq == 0 || steps == 0)
+    {
+      return 0;
+    }
+
+  return (uint32_t)(ticks * 1000000000 / freq / steps);
+}
+
+/****************************************************************************
+ * Name: focbench_near
+ ****************************************************************************/
+
+static bool focbench_near(float val, float golden, float tol)
+{
+  return fabsf(val - golden) <= tol + tol * fabsf(golden);
+}
+
+/****************************************************************************
+ * Name: focbench_golden_write
+ ****************************************************************************/
+
+static void focbench_golden_write(FAR FILE *f, FAR const char *type,
+                                  int ang, int vel,
+                                  FAR struct focbench_res_s *res)
+{
+  uint32_t i = 0;
+
+  for (i = 0; i < res->nsamples; i += 1)
+    {
+      fprintf(f, "%s %s %s %" PRIu32 " %.6f %.6f %.6f %.3f\n",
+              type, g_focbench_ang[ang], g_focbench_vel[vel], i,
+              res->trace[i].iq, res->trace[i].id,
+              res->trace[i].ang_err, res->trace[i].vel);
+    }
+}
+
+/****************************************************************************
+ * Name: focbench_golden_check
+ *
+ * Description:
+ *   Compare the traces with the next lines of the golden file.  The golden
+ *   file must have been recorded with the same options.
+ *
+ * Returned Value:
+ *   Number of mismatched samples.
+ *
+ ****************************************************************************/
+
+static int focbench_golden_check(FAR FILE *f, FAR const char *type,
+                                 int ang, int vel, float tol,
+                                 FAR struct focbench_res_s *res)
+{
+  struct focbench_sample_s gold;
+  char                     line[FOCBENCH_LINE_MAX];
+  char                     gtype[8];
+  char                     gang[8];
+  char                     gvel[8];
+  uint32_t                 idx  = 0;
+  uint32_t                 i    = 0;
+  int                      fail = 0;
+
+  for (i = 0; i < res->nsamples; i += 1)
+    {
+      if (fgets(line, sizeof(line), f) == NULL ||
+          sscanf(line, "%7s %7s %7s %" SCNu32 " %f %f %f %f",
+                 gtype, gang, gvel, &idx, &gold.iq, &gold.id,
+                 &gold.ang_err, &gold.vel) != 8)
+        {
+          printf("  golden: missing sample %" PRIu32 "\n", i);
+          return fail + 1;
+        }
+
+      if (strcmp(gtype, type) != 0 ||
+          strcmp(gang, g_focbench_ang[ang]) != 0 ||
+          strcmp(gvel, g_focbench_vel[vel]) != 0 ||
+          idx != i)
+        {
+          printf("  golden: unexpected record %s %s %s %" PRIu32 "\n",
+                 gtype, gang, gvel, idx);
+          return fail + 1;
+        }
+
+      if (!focbench_near(res->trace[i].iq, gold.iq, tol) ||
+          !focbench_near(res->trace[i].id, gold.id, tol) ||
+          !focbench_near(res->trace[i].ang_err, gold.ang_err, tol) ||
+          !focbench_near(res->trace[i].vel, gold.vel, tol))
+        {
+          if (fail == 0)
+            {
+              printf("  golden: sample %" PRIu32 " differs:"
+                     " iq %.6f/%.6f id %.6f/%.6f"
+                     " ang_err %.6f/%.6f vel %.3f/%.3f\n", i,
+                     res->trace[i].iq, gold.iq,
+                     res->trace[i].id, gold.id,
+                     res->trace[i].ang_err, gold.ang_err,
+                     res->trace[i].vel, gold.vel);
+            }
+
+          fail += 1;
+        }
+    }
+
+  return fail;
+}
+
+#ifdef FOCBENCH_XREF
+/****************************************************************************
+ * Name: focbench_xref_save
+ ****************************************************************************/
+
+static void focbench_xref_save(FAR struct focbench_xref_s *xref,
+                               int ang, int vel,
+                               FAR struct focbench_res_s *res)
+{
+  memcpy(&xref->trace[(ang * FOCBENCH_VEL_NUM + vel) * res->ntrace],
+         res->trace, res->nsamples * sizeof(struct focbench_sample_s));
+  xref->nsamples[ang][vel] = res->nsamples;
+}
+
+/****************************************************************************
+ * Name: focbench_xref_check
+ *
+ * Description:
+ *   Compare the currents with the f32 traces of the same combination.
+ *
+ * Returned Value:
+ *   Number of mismatched samples.
+ *
+ ****************************************************************************/
+
+static int focbench_xref_check(FAR struct focbench_xref_s *xref,
+                               int ang, int vel,
+                               FAR struct focbench_res_s *res)
+{
+  FAR struct focbench_sample_s *ref;
+  uint32_t                      i    = 0;
+  int                           fail = 0;
+
+  if (xref->nsamples[ang][vel] != res->nsamples)
+    {
+      /* No f32 run of this combination */
+
+      return 0;
+    }
+
+  ref = &xref->trace[(ang * FOCBENCH_VEL_NUM + vel) * res->ntrace];
+
+  for (i = 0; i < res->nsamples; i += 1)
+    {
+      if (!focbench_near(res->trace[i].iq, ref[i].iq, FOCBENCH_XREF_TOL) ||
+          !focbench_near(res->trace[i].id, ref[i].id, FOCBENCH_XREF_TOL))
+        {
+          if (fail == 0)
+            {
+              printf("  f32: sample %" PRIu32 " differs:"
+                     " iq %.6f/%.6f id %.6f/%.6f\n", i,
+                     res->trace[i].iq, ref[i].iq,
+                     res->trace[i].id, ref[i].id);
+            }
+
+          fail += 1;
+        }
+    }
+
+  return fail;
+}
+#endif
+
+/****************************************************************************
+ * Name: focbench_parse_args
+ ****************************************************************************/
+
+static void focbench_parse_args(FAR struct focbench_args_s *args,
+                                int argc, FAR char *argv[])
+{
+  int option;
+
+  while ((option = getopt(argc, argv, "n:i:d:T:w:c:t:h")) != ERROR)
+    {
+      switch (option)
+        {
+          case 'n':
+            args->cfg.steps = strtoul(optarg, NULL, 0);
+            break;
+
+          case 'i':
+            args->cfg.iq_ref = strtof(optarg, NULL);
+            break;
+
+          case 'd':
+            args->cfg.decim = strtoul(optarg, NULL, 0);
+            break;
+
+          case 'T':
+            args->type = optarg;
+            break;
+
+          case 'w':
+            args->wpath = optarg;
+            break;
+
+          case 'c':
+            args->cpath = optarg;
+            break;
+
+          case 't':
+            args->tol = strtof(optarg, NULL);
+            break;
+
+          case 'h':
+            show_usage(argv[0], EXIT_SUCCESS);
+            break;
+
+          default:
+            printf("Unknown option: %c\n", optopt);
+            show_usage(argv[0], EXIT_FAILURE);
+            break;
+        }
+    }
+
+  if (args->cfg.steps == 0 || args->cfg.decim == 0)
+    {
+      printf("Invalid number of steps or decimation\n");
+      show_usage(argv[0], EXIT_FAILURE);
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: main
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  FAR const struct focbench_type_s *type = NULL;
+  struct focbench_args_s            args;
+  struct focbench_res_s             res;
+#ifdef FOCBENCH_XREF
+  struct focbench_xref_s            xref;
+#endif
+  FAR FILE                         *wfile = NULL;
+  FAR FILE                         *cfile = NULL;
+  uint32_t                          hns   = 0;
+  uint32_t                          ans   = 0;
+  uint32_t                          vns   = 0;
+  int                               fail  = 0;
+  int                               t     = 0;
+  int                               ang   = 0;
+  int                               vel   = 0;
+  int                               ret   = OK;
+
+  memset(&args, 0, sizeof(args));
+  memset(&res, 0, sizeof(res));
+
+  args.cfg.steps  = FOCBENCH_STEPS_DEFAULT;
+  args.cfg.decim  = FOCBENCH_DECIM_DEFAULT;
+  args.cfg.per    = FOCBENCH_PER_DEFAULT;
+  args.cfg.vbus   = FOCBENCH_VBUS_DEFAULT;
+  args.cfg.iq_ref = FOCBENCH_IQ_DEFAULT;
+  args.tol        = FOCBENCH_TOL_DEFAULT;
+
+  focbench_parse_args(&args, argc, argv);
+
+  /* Allocate trace buffer */
+
+  res.ntrace = args.cfg.steps / args.cfg.decim + 1;
+  res.trace  = malloc(res.ntrace * sizeof(struct focbench_sample_s));
+  if (res.trace == NULL)
+    {
+      printf("ERROR: failed to allocate trace buffer\n");
+      return EXIT_FAILURE;
+    }
+
+#ifdef FOCBENCH_XREF
+  memset(&xref, 0, sizeof(xref));
+  if (args.type == NULL)
+    {
+      xref.trace = malloc(FOCBENCH_ANG_NUM * FOCBENCH_VEL_NUM * res.ntrace *
+                          sizeof(struct focbench_sample_s));
+      if (xref.trace == NULL)
+        {
+          printf("ERROR: failed to allocate reference buffer\n");
+          fail += 1;
+          goto errout;
+        }
+    }
+#endif
+
+  if (args.wpath != NULL)
+    {
+      wfile = fopen(args.wpath, "w");
+      if (wfile == NULL)
+        {
+          printf("ERROR: failed to open %s %d\n", args.wpath, errno);
+          fail += 1;
+          goto errout;
+        }
+    }
+
+  if (args.cpath != NULL)
+    {
+      cfile = fopen(args.cpath, "r");
+      if (cfile == NULL)
+        {
+          printf("ERROR: failed to open %s %d\n", args.cpath, errno);
+          fail += 1;
+          goto errout;
+        }
+    }
+
+  printf("steps %" PRIu32 " per %.6f vbus %.1f iq_ref %.3f\n",
+         args.cfg.steps, args.cfg.per, args.cfg.vbus, args.cfg.iq_ref);
+  printf("%-4s %-6s %-5s %8s %8s %8s %8s %9s %9s\n",
+         "type", "angle", "vel", "handler", "angle", "vel", "total",
+         "iq_rms", "ang_rms");
+  printf("%-4s %-6s %-5s %8s %8s %8s %8s %9s %9s\n",
+         "", "", "", "[ns]", "[ns]", "[ns]", "[ns]", "[A]", "[rad]");
+
+  for (t = 0; t < nitems(g_focbench_types); t += 1)
+    {
+      type = &g_focbench_types[t];
+
+      if (args.type != NULL && strcmp(args.type, type->name) != 0)
+        {
+          continue;
+        }
+
+      for (ang = 0; ang < FOCBENCH_ANG_NUM; ang += 1)
+        {
+          for (vel = 0; vel < FOCBENCH_VEL_NUM; vel += 1)
+            {
+              ret = type->run(&args.cfg, ang, vel, &res);
+              if (ret == -ENOTSUP)
+                {
+                  /* Observer not enabled in this configuration */
+
+                  continue;
+                }
+              else if (ret < 0)
+                {
+                  printf("%-4s %-6s %-5s ERROR %d\n", type->name,
+                         g_focbench_ang[ang], g_focbench_vel[vel], ret);
+                  fail += 1;
+                  continue;
+                }
+
+              hns = focbench_ns(res.handler, res.steps);
+              ans = focbench_ns(res.angle, res.steps);
+              vns = focbench_ns(res.vel, res.steps);
+
+              printf("%-4s %-6s %-5s %8" PRIu32 " %8" PRIu32
+                     " %8" PRIu32 " %8" PRIu32 " %9.5f %9.5f\n",
+                     type->name, g_focbench_ang[ang], g_focbench_vel[vel],
+                     hns, ans, vns, hns + ans + vns,
+                     res.iq_rms, res.ang_rms);
+
+              /* The current loop must track the reference regardless of
+               * the observers that only run in shadow mode.
+               */
+
+              if (res.iq_rms > FOCBENCH_IQ_RMS_MAX * fabsf(args.cfg.iq_ref) +
+                               FOCBENCH_IQ_RMS_MIN)
+                {
+                  printf("  FAIL: Q current tracking error too large\n");
+                  fail += 1;
+                }
+
+#ifdef FOCBENCH_XREF
+              if (xref.trace != NULL)
+                {
+                  if (type->run == focbench_run_f32)
+                    {
+                      focbench_xref_save(&xref, ang, vel, &res);
+                    }
+                  else
+                    {
+                      ret = focbench_xref_check(&xref, ang, vel, &res);
+                      if (ret > 0)
+                        {
+                          printf("  FAIL: %d samples differ from f32\n",
+                                 ret);
+                          fail += 1;
+                        }
+                    }
+                }
+#endif
+
+              if (wfile != NULL)
+                {
+                  focbench_golden_write(wfile, type->name, ang, vel, &res);
+                }
+
+              if (cfile != NULL)
+                {
+                  ret = focbench_golden_check(cfile, type->name, ang, vel,
+                                              args.tol, &res);
+                  if (ret > 0)
+                    {
+                      printf("  FAIL: %d samples differ from golden\n",
+                             ret);
+                      fail += 1;
+                    }
+                }
+            }
+        }
+    }
+
+errout:
+  if (wfile != NULL)
+    {
+      fclose(wfile);
+    }
+
+  if (cfile != NULL)
+    {
+      fclose(cfile);
+    }
+
+#ifdef FOCBENCH_XREF
+  free(xref.trace);
+#endif
+
+  free(res.trace);
+
+  printf("%s\n", fail == 0 ? "PASSED" : "FAILED");
+
+  return fail == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}